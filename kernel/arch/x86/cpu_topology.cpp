@@ -25,11 +25,17 @@ static uint32_t core_shift = 0;
 static uint32_t package_mask = ~0;
 static uint32_t package_shift = 0;
 
+// Number of low apic id bits that distinguish cpus sharing the last level
+// cache. Until proven otherwise, assume the cache is shared package wide.
+static uint32_t cache_shift = 0;
+static bool cache_shift_valid = false;
+
 static int initialized;
 
 static void legacy_topology_init(void);
 static void modern_intel_topology_init(void);
 static void extended_amd_topology_init(void);
+static void cache_topology_init(enum x86_cpuid_leaf_num leaf);
 
 void x86_cpu_topology_init(void) {
     if (atomic_swap(&initialized, 1)) {
@@ -43,6 +49,48 @@ void x86_cpu_topology_init(void) {
     } else {
         legacy_topology_init();
     }
+
+    if (x86_vendor == X86_VENDOR_AMD && x86_feature_test(X86_FEATURE_AMD_TOPO)) {
+        cache_topology_init(X86_CPUID_AMD_CACHE_TOPOLOGY);
+    } else if (x86_get_cpuid_leaf(X86_CPUID_BASE)->a >= X86_CPUID_CACHE_V2) {
+        cache_topology_init(X86_CPUID_CACHE_V2);
+    }
+}
+
+// Walk the deterministic cache parameters leaf (Intel leaf 4, or its AMD
+// twin 0x8000001d, which shares the layout) and find how many apic ids share
+// the highest level cache.
+static void cache_topology_init(enum x86_cpuid_leaf_num leaf_num) {
+    uint32_t highest_level = 0;
+    uint32_t max_sharing = 0;
+
+    for (uint32_t i = 0;; i++) {
+        struct cpuid_leaf leaf;
+        if (!x86_get_cpuid_subleaf(leaf_num, i, &leaf)) {
+            return;
+        }
+
+        // a cache type of 0 terminates the list
+        uint32_t type = BITS(leaf.a, 4, 0);
+        if (type == 0) {
+            break;
+        }
+
+        uint32_t level = BITS_SHIFT(leaf.a, 7, 5);
+        if (level > highest_level) {
+            highest_level = level;
+            max_sharing = BITS_SHIFT(leaf.a, 25, 14) + 1;
+        }
+    }
+
+    if (highest_level == 0) {
+        return;
+    }
+
+    cache_shift = log2_uint_ceil(max_sharing);
+    cache_shift_valid = true;
+    LTRACEF("L%u cache shared by up to %u apic ids, cache shift %u\n",
+            highest_level, max_sharing, cache_shift);
 }
 
 static void modern_intel_topology_init(void) {
@@ -148,4 +196,10 @@ void x86_cpu_topology_decode(uint32_t apic_id, x86_cpu_topology_t* topo) {
     topo->package_id = (apic_id & package_mask) >> package_shift;
     topo->core_id = (apic_id & core_mask) >> core_shift;
     topo->smt_id = apic_id & smt_mask;
+
+    if (cache_shift_valid) {
+        topo->cache_id = (cache_shift >= 32) ? 0 : (apic_id >> cache_shift);
+    } else {
+        topo->cache_id = topo->package_id;
+    }
 }
@@ -41,8 +41,7 @@ private:
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
-    void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                           bool was_terminal) final;
+    void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
 
@@ -64,8 +63,7 @@ private:
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
-    void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                           bool was_terminal) final;
+    void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
 };
@@ -98,6 +96,14 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // The PCID tagging this aspace's TLB entries, or 0 if it shares the
+    // untagged context with the kernel and is flushed on every switch.
+    uint16_t pcid() const { return pcid_; }
+
+    // Note that the TLB entries of this aspace may be out of date on every cpu
+    // that is not running in it, so they get flushed when next switched to.
+    void MarkPcidStale() { pcid_stale_cpus_.store(-1); }
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
@@ -131,6 +137,13 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // Process context identifier, see pcid().
+    uint16_t pcid_ = 0;
+
+    // CPUs that may hold out of date TLB entries tagged with pcid_.
+    // Actually an mp_cpu_mask_t, but header dependencies.
+    fbl::atomic_int pcid_stale_cpus_{0};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
@@ -16,7 +16,13 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <bitmap/raw-bitmap.h>
+#include <bitmap/storage.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
@@ -33,6 +39,14 @@ uint8_t g_paddr_width = 32;
 /* True if the system supports 1GB pages */
 static bool supports_huge_pages = false;
 
+/* set if user aspaces tag their TLB entries with a PCID, so that switching
+ * between them does not flush the TLB */
+static bool use_pcid = false;
+
+/* switches into a tagged user aspace that kept or flushed its TLB entries */
+KCOUNTER(pcid_switch_noflush_count, "kernel.x86.pcid.switch_noflush");
+KCOUNTER(pcid_switch_flush_count, "kernel.x86.pcid.switch_flush");
+
 /* top level kernel page tables, initialized in start.S */
 volatile pt_entry_t pml4[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE);
 volatile pt_entry_t pdp[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE); /* temporary */
@@ -105,6 +119,63 @@ static bool x86_mmu_check_paddr(paddr_t paddr) {
     return paddr <= max_paddr;
 }
 
+namespace {
+
+// PCID 0 is the untagged context shared by the kernel aspace and any user
+// aspace that could not be given one of its own.
+constexpr uint16_t kFirstUserPcid = 1;
+constexpr uint16_t kMaxUserPcid = X86_CR3_PCID_MASK;
+
+class PcidAllocator {
+public:
+    PcidAllocator() { bitmap_.Reset(kMaxUserPcid + 1); }
+    ~PcidAllocator() = default;
+
+    zx_status_t Alloc(uint16_t* pcid);
+    void Free(uint16_t pcid);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PcidAllocator);
+
+    fbl::Mutex lock_;
+    uint16_t last_ TA_GUARDED(lock_) = kFirstUserPcid - 1;
+
+    bitmap::RawBitmapGeneric<bitmap::FixedStorage<kMaxUserPcid + 1>> bitmap_ TA_GUARDED(lock_);
+};
+
+zx_status_t PcidAllocator::Alloc(uint16_t* pcid) {
+    fbl::AutoLock al(&lock_);
+
+    // search from the last allocated id + 1, wrapping around to the start of the range
+    size_t val;
+    bool notfound = bitmap_.Get(last_ + 1, kMaxUserPcid + 1, &val);
+    if (unlikely(notfound)) {
+        notfound = bitmap_.Get(kFirstUserPcid, kMaxUserPcid + 1, &val);
+        if (unlikely(notfound)) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+    }
+    bitmap_.SetOne(val);
+
+    DEBUG_ASSERT(val <= kMaxUserPcid);
+    last_ = static_cast<uint16_t>(val);
+    *pcid = last_;
+
+    LTRACEF("new pcid %#x\n", *pcid);
+    return ZX_OK;
+}
+
+void PcidAllocator::Free(uint16_t pcid) {
+    LTRACEF("free pcid %#x\n", pcid);
+
+    fbl::AutoLock al(&lock_);
+    bitmap_.ClearOne(pcid);
+}
+
+PcidAllocator pcid_allocator;
+
+} // namespace
+
 /**
  * @brief  invalidate all TLB entries, including global entries
  */
@@ -119,53 +190,73 @@ static void x86_tlb_global_invalidate() {
     }
 }
 
+/**
+ * @brief  invalidate all non-global TLB entries for the current address space
+ */
+static void x86_tlb_nonglobal_invalidate() {
+    x86_set_cr3(x86_get_cr3());
+}
+
 /* Task used for invalidating a TLB entry on each CPU */
 struct TlbInvalidatePage_context {
     ulong target_cr3;
-    vaddr_t vaddr;
-    enum PageTableLevel level;
-    bool global_page;
+    const PendingTlbInvalidation* pending;
 };
 static void TlbInvalidatePage_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
 
-    ulong cr3 = x86_get_cr3();
-    if (context->target_cr3 != cr3 && !context->global_page) {
+    ulong cr3 = x86_get_cr3() & X86_CR3_BASE_MASK;
+    if (context->target_cr3 != cr3 && !context->pending->contains_global) {
         /* This invalidation doesn't apply to this CPU, ignore it */
         return;
     }
 
-    switch (context->level) {
-    case PML4_L:
-        x86_tlb_global_invalidate();
-        break;
-    case PDP_L:
-    case PD_L:
-    case PT_L:
-        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)context->vaddr));
-        break;
+    if (context->pending->full_shootdown) {
+        if (context->pending->contains_global) {
+            x86_tlb_global_invalidate();
+        } else {
+            x86_tlb_nonglobal_invalidate();
+        }
+        return;
+    }
+
+    for (uint i = 0; i < context->pending->count; ++i) {
+        const auto& item = context->pending->item[i];
+        if (context->target_cr3 != cr3 && !item.is_global) {
+            /* This entry belongs to another address space */
+            continue;
+        }
+
+        switch (item.page_level) {
+        case PML4_L:
+            panic("PML4_L invld found; should not be here\n");
+        case PDP_L:
+        case PD_L:
+        case PT_L:
+            __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)item.addr));
+            break;
+        }
     }
 }
 
 /**
- * @brief Invalidate a single page at a given page table level
+ * @brief Execute a queued TLB invalidation
  *
  * @param pt The page table we're invalidating for (if nullptr, assume for current one)
- * @param vaddr The virtual address we are invalidating the TLB entry for
- * @param level The page table level that maps this vaddr
- * @param global_page True if we are invalidating a global mapping
+ * @param pending The planned invalidation
  *
- * TODO(ZX-979): Optimize this.  This is horribly inefficient.
- * We should also change this to pool invalidations from a single
- * "transaction" and then only execute a single mp_sync_exec for that
- * transaction, rather than one per page.
+ * All the invalidations of one page table operation are sent to the other
+ * CPUs together, in a single mp_sync_exec.
  */
-static void x86_tlb_invalidate_page(X86PageTableBase* pt, vaddr_t vaddr,
-                                    enum PageTableLevel level, bool global_page) {
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
+static void x86_tlb_invalidate_page(X86PageTableBase* pt, PendingTlbInvalidation* pending) {
+    if (pending->count == 0 && !pending->full_shootdown) {
+        return;
+    }
+
+    ulong cr3 = pt ? pt->phys() : x86_get_cr3() & X86_CR3_BASE_MASK;
     struct TlbInvalidatePage_context task_context = {
-        .target_cr3 = cr3, .vaddr = vaddr, .level = level, .global_page = global_page,
+        .target_cr3 = cr3, .pending = pending,
     };
 
     /* Target only CPUs this aspace is active on.  It may be the case that some
@@ -175,11 +266,22 @@ static void x86_tlb_invalidate_page(X86PageTableBase* pt, vaddr_t vaddr,
      * case, it will get a spurious request to flush. */
     mp_ipi_target_t target;
     cpu_mask_t target_mask = 0;
-    if (global_page || pt == nullptr) {
+    if (pending->contains_global || pt == nullptr) {
         target = MP_IPI_TARGET_ALL;
     } else {
+        X86ArchVmAspace* aspace = static_cast<X86ArchVmAspace*>(pt->ctx());
+
+        /* CPUs that ran in a tagged aspace keep its entries after they switch
+         * away, so make them flush when they come back.  This must happen
+         * before sampling the active CPUs: a CPU that switches in after
+         * the sample then sees the mark, and one that switched in before it
+         * gets the IPI. */
+        if (aspace->pcid() != 0) {
+            aspace->MarkPcidStale();
+        }
+
         target = MP_IPI_TARGET_MASK;
-        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
+        target_mask = aspace->active_cpus();
     }
 
     mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
@@ -282,9 +384,8 @@ X86PageTableBase::PtFlags X86PageTableMmu::split_flags(PageTableLevel level,
     return flags;
 }
 
-void X86PageTableMmu::TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                        bool was_terminal) {
-    x86_tlb_invalidate_page(this, vaddr, level, global_page);
+void X86PageTableMmu::TlbInvalidate(PendingTlbInvalidation* pending) {
+    x86_tlb_invalidate_page(this, pending);
 }
 
 uint X86PageTableMmu::pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) {
@@ -392,8 +493,7 @@ X86PageTableBase::PtFlags X86PageTableEpt::split_flags(PageTableLevel level,
     return flags;
 }
 
-void X86PageTableEpt::TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                        bool was_terminal) {
+void X86PageTableEpt::TlbInvalidate(PendingTlbInvalidation* pending) {
     // TODO(ZX-981): Implement this.
 }
 
@@ -420,7 +520,9 @@ void x86_mmu_early_init() {
 
     // Unmap the lower identity mapping.
     pml4[0] = 0;
-    x86_tlb_invalidate_page(nullptr, 0, PML4_L, false);
+    PendingTlbInvalidation tlb;
+    tlb.enqueue(0, PML4_L, /* global */ true, /* terminal */ false);
+    x86_tlb_invalidate_page(nullptr, &tlb);
 
     /* get the address width from the CPU */
     uint8_t vaddr_width = x86_linear_address_width();
@@ -439,7 +541,16 @@ void x86_mmu_early_init() {
     LTRACEF("paddr_width %u vaddr_width %u\n", g_paddr_width, g_vaddr_width);
 }
 
-void x86_mmu_init(void) {}
+void x86_mmu_init(void) {
+    use_pcid = x86_feature_test(X86_FEATURE_PCID) &&
+               cmdline_get_bool("kernel.x86.pcid", true);
+    if (use_pcid) {
+        /* the secondary CPUs enable it in x86_mmu_percpu_init */
+        x86_set_cr3(x86_get_cr3() & X86_CR3_BASE_MASK);
+        x86_set_cr4(x86_get_cr4() | X86_CR4_PCIDE);
+    }
+    dprintf(INFO, "x86: PCID %s\n", use_pcid ? "enabled" : "disabled");
+}
 
 X86PageTableBase::X86PageTableBase() {
 }
@@ -532,6 +643,13 @@ zx_status_t X86ArchVmAspace::Init(vaddr_t base, size_t size, uint mmu_flags) {
             return status;
         }
 
+        /* without a PCID of its own the aspace falls back to being flushed
+         * on every switch */
+        if (use_pcid && pcid_allocator.Alloc(&pcid_) == ZX_OK) {
+            /* a previous owner of the PCID may have left entries behind */
+            pcid_stale_cpus_.store(-1);
+        }
+
         LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p\n", pt_->phys(), pt_->virt());
     }
     fbl::atomic_init(&active_cpus_, 0);
@@ -548,6 +666,10 @@ zx_status_t X86ArchVmAspace::Destroy() {
     } else {
         static_cast<X86PageTableMmu*>(pt_)->Destroy(base_, size_);
     }
+    if (pcid_ != 0) {
+        pcid_allocator.Free(pcid_);
+        pcid_ = 0;
+    }
     return ZX_OK;
 }
 
@@ -587,12 +709,28 @@ void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace
         aspace->canary_.Assert();
         paddr_t phys = aspace->pt_phys();
         LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
-        x86_set_cr3(phys);
 
-        if (old_aspace != nullptr) {
+        /* mark ourselves active before looking for stale entries; see
+         * x86_tlb_invalidate_page for the other half of this */
+        aspace->active_cpus_.fetch_or(cpu_bit);
+
+        ulong cr3 = phys;
+        if (aspace->pcid_ != 0) {
+            cr3 |= aspace->pcid_;
+            /* keep the entries tagged with this PCID unless a shootdown
+             * happened since this CPU last ran in the aspace */
+            if (!(aspace->pcid_stale_cpus_.fetch_and(~cpu_bit) & cpu_bit)) {
+                cr3 |= X86_CR3_NOFLUSH;
+                kcounter_add(pcid_switch_noflush_count, 1u);
+            } else {
+                kcounter_add(pcid_switch_flush_count, 1u);
+            }
+        }
+        x86_set_cr3(cr3);
+
+        if (old_aspace != nullptr && old_aspace != aspace) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
-        aspace->active_cpus_.fetch_or(cpu_bit);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
         x86_set_cr3(kernel_pt_phys);
@@ -631,6 +769,11 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    if (use_pcid) {
+        /* PCIDE may only be set while the loaded PCID is 0 */
+        x86_set_cr3(x86_get_cr3() & X86_CR3_BASE_MASK);
+        cr4 |= X86_CR4_PCIDE;
+    }
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
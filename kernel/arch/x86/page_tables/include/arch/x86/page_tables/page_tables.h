@@ -8,6 +8,7 @@
 
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
+#include <sys/types.h>
 
 typedef uint64_t pt_entry_t;
 #define PRIxPTE PRIx64
@@ -20,6 +21,37 @@ enum PageTableLevel {
     PML4_L,
 };
 
+// Structure for tracking TLB invalidations that are owed for page table
+// entries changed during a single operation, so that they can be sent to the
+// other CPUs as one batch once the operation is done.
+struct PendingTlbInvalidation {
+    struct Item {
+        vaddr_t addr;
+        PageTableLevel page_level;
+        bool is_global;
+        bool is_terminal;
+    };
+
+    // Add address |v|, translated at depth |level|, to the set of addresses to
+    // be invalidated.  Past kMaxPages addresses the batch turns into a full
+    // invalidation.
+    void enqueue(vaddr_t v, PageTableLevel level, bool is_global_page, bool is_terminal);
+
+    // Clear the list of pending invalidations
+    void clear();
+
+    // Maximum number of addresses invalidated one at a time
+    static constexpr uint kMaxPages = 32;
+
+    Item item[kMaxPages];
+    // Number of valid entries in item
+    uint count = 0;
+    // If true, ignore item and invalidate the whole TLB
+    bool full_shootdown = false;
+    // If true, at least one of the invalidations is for a global page
+    bool contains_global = false;
+};
+
 class X86PageTableBase {
 public:
     X86PageTableBase();
@@ -74,9 +106,8 @@ protected:
     // Return the hardware flags to use on smaller pages after a splitting a
     // large page with flags |flags|.
     virtual PtFlags split_flags(PageTableLevel level, PtFlags flags) = 0;
-    // Invalidate a single page at the given level
-    virtual void TlbInvalidatePage(PageTableLevel level, vaddr_t vaddr, bool global_page,
-                                   bool was_terminal) = 0;
+    // Execute the given pending invalidation
+    virtual void TlbInvalidate(PendingTlbInvalidation* pending) = 0;
     // Convert PtFlags to ARCH_MMU_* flags.
     virtual uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) = 0;
     // Returns true if a cache flush is necessary for pagetable changes to be
@@ -98,28 +129,29 @@ private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(X86PageTableBase);
 
     class CacheLineFlusher;
+    class ConsistencyManager;
     struct MappingCursor;
 
     zx_status_t AddMapping(volatile pt_entry_t* table, uint mmu_flags,
                            PageTableLevel level, const MappingCursor& start_cursor,
-                           MappingCursor* new_cursor) TA_REQ(lock_);
+                           MappingCursor* new_cursor, ConsistencyManager* cm) TA_REQ(lock_);
     zx_status_t AddMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                              const MappingCursor& start_cursor,
-                             MappingCursor* new_cursor) TA_REQ(lock_);
+                             MappingCursor* new_cursor, ConsistencyManager* cm) TA_REQ(lock_);
 
     bool RemoveMapping(volatile pt_entry_t* table,
                        PageTableLevel level, const MappingCursor& start_cursor,
-                       MappingCursor* new_cursor) TA_REQ(lock_);
+                       MappingCursor* new_cursor, ConsistencyManager* cm) TA_REQ(lock_);
     bool RemoveMappingL0(volatile pt_entry_t* table,
                          const MappingCursor& start_cursor,
-                         MappingCursor* new_cursor) TA_REQ(lock_);
+                         MappingCursor* new_cursor, ConsistencyManager* cm) TA_REQ(lock_);
 
     zx_status_t UpdateMapping(volatile pt_entry_t* table, uint mmu_flags,
                               PageTableLevel level, const MappingCursor& start_cursor,
-                              MappingCursor* new_cursor) TA_REQ(lock_);
+                              MappingCursor* new_cursor, ConsistencyManager* cm) TA_REQ(lock_);
     zx_status_t UpdateMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                                 const MappingCursor& start_cursor,
-                                MappingCursor* new_cursor) TA_REQ(lock_);
+                                MappingCursor* new_cursor, ConsistencyManager* cm) TA_REQ(lock_);
 
     zx_status_t GetMapping(volatile pt_entry_t* table, vaddr_t vaddr,
                            PageTableLevel level,
@@ -130,14 +162,13 @@ private:
                              volatile pt_entry_t** mapping) TA_REQ(lock_);
 
     zx_status_t SplitLargePage(PageTableLevel level, vaddr_t vaddr,
-                               volatile pt_entry_t* pte) TA_REQ(lock_);
-
-    void UpdateEntry(CacheLineFlusher* flusher,
-                     PageTableLevel level, vaddr_t vaddr, volatile pt_entry_t* pte,
-                     paddr_t paddr, PtFlags flags, bool was_terminal) TA_REQ(lock_);
-    void UnmapEntry(CacheLineFlusher* flusher,
-                    PageTableLevel level, vaddr_t vaddr, volatile pt_entry_t* pte,
-                    bool was_terminal) TA_REQ(lock_);
+                               volatile pt_entry_t* pte, ConsistencyManager* cm) TA_REQ(lock_);
+
+    void UpdateEntry(ConsistencyManager* cm, PageTableLevel level, vaddr_t vaddr,
+                     volatile pt_entry_t* pte, paddr_t paddr, PtFlags flags,
+                     bool was_terminal) TA_REQ(lock_);
+    void UnmapEntry(ConsistencyManager* cm, PageTableLevel level, vaddr_t vaddr,
+                    volatile pt_entry_t* pte, bool was_terminal) TA_REQ(lock_);
 
     fbl::Canary<fbl::magic("X86P")> canary_;
 
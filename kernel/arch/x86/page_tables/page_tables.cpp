@@ -9,6 +9,7 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/page_tables/constants.h>
 #include <assert.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <trace.h>
@@ -134,6 +135,88 @@ void X86PageTableBase::CacheLineFlusher::FlushPtEntry(const volatile pt_entry_t*
     }
 }
 
+void PendingTlbInvalidation::enqueue(vaddr_t v, PageTableLevel level, bool is_global_page,
+                                     bool is_terminal) {
+    if (is_global_page) {
+        contains_global = true;
+    }
+
+    // We mark PML4_L entries as full shootdowns, since it's going to be
+    // expensive one way or another.
+    if (count >= fbl::count_of(item) || level == PML4_L) {
+        full_shootdown = true;
+        return;
+    }
+    item[count].page_level = level;
+    item[count].is_global = is_global_page;
+    item[count].is_terminal = is_terminal;
+    item[count].addr = v;
+    count++;
+}
+
+void PendingTlbInvalidation::clear() {
+    count = 0;
+    full_shootdown = false;
+    contains_global = false;
+}
+
+// Utility for keeping the page tables consistent from a cache and TLB point of
+// view over the course of one operation.  Page table changes are written back
+// and the TLB invalidations they require are sent to the other CPUs as a
+// single batch when the operation finishes, and page tables removed along the
+// way are only freed after that, once no TLB can still be walking them.
+class X86PageTableBase::ConsistencyManager {
+public:
+    explicit ConsistencyManager(X86PageTableBase* pt);
+    ~ConsistencyManager();
+
+    // Queue a page table page to be freed once the invalidations are done.
+    void queue_free(vm_page_t* page) {
+        list_add_tail(&to_free_, &page->free.node);
+    }
+
+    // Record that the entry for |vaddr| at |level| was changed or removed.
+    void queue_invalidation(PageTableLevel level, vaddr_t vaddr, bool was_terminal) {
+        tlb_.enqueue(vaddr, level, is_kernel_address(vaddr), was_terminal);
+    }
+
+    CacheLineFlusher* clf() { return &clf_; }
+
+    // Perform the invalidations and free the pages queued so far.
+    void Finish();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ConsistencyManager);
+
+    X86PageTableBase* const pt_;
+    CacheLineFlusher clf_;
+    PendingTlbInvalidation tlb_;
+    list_node to_free_ = LIST_INITIAL_VALUE(to_free_);
+};
+
+X86PageTableBase::ConsistencyManager::ConsistencyManager(X86PageTableBase* pt)
+    : pt_(pt), clf_(pt->needs_cache_flushes()) {
+}
+
+X86PageTableBase::ConsistencyManager::~ConsistencyManager() {
+    Finish();
+}
+
+void X86PageTableBase::ConsistencyManager::Finish() {
+    // Write back the page table changes before invalidating, to avoid a race
+    // in which non-coherent remapping hardware sees an old entry after the
+    // invalidation.
+    clf_.ForceFlush();
+    if (tlb_.count > 0 || tlb_.full_shootdown) {
+        pt_->TlbInvalidate(&tlb_);
+        tlb_.clear();
+    }
+
+    if (!list_is_empty(&to_free_)) {
+        pmm_free(&to_free_);
+    }
+}
+
 struct X86PageTableBase::MappingCursor {
 public:
     /**
@@ -157,9 +240,9 @@ public:
     size_t size;
 };
 
-void X86PageTableBase::UpdateEntry(CacheLineFlusher* flusher,
-                                   PageTableLevel level, vaddr_t vaddr, volatile pt_entry_t* pte,
-                                   paddr_t paddr, PtFlags flags, bool was_terminal) {
+void X86PageTableBase::UpdateEntry(ConsistencyManager* cm, PageTableLevel level, vaddr_t vaddr,
+                                   volatile pt_entry_t* pte, paddr_t paddr, PtFlags flags,
+                                   bool was_terminal) {
     DEBUG_ASSERT(pte);
     DEBUG_ASSERT(IS_PAGE_ALIGNED(paddr));
 
@@ -167,35 +250,26 @@ void X86PageTableBase::UpdateEntry(CacheLineFlusher* flusher,
 
     /* set the new entry */
     *pte = paddr | flags | X86_MMU_PG_P;
-    flusher->FlushPtEntry(pte);
+    cm->clf()->FlushPtEntry(pte);
 
-    /* attempt to invalidate the page */
+    /* queue an invalidation of the page */
     if (IS_PAGE_PRESENT(olde)) {
-        // Force the flush before the TLB invalidation, to avoid a race in which
-        // non-coherent remapping hardware sees the old PTE after the
-        // invalidation.
-        flusher->ForceFlush();
-        TlbInvalidatePage(level, vaddr, is_kernel_address(vaddr), was_terminal);
+        cm->queue_invalidation(level, vaddr, was_terminal);
     }
 }
 
-void X86PageTableBase::UnmapEntry(CacheLineFlusher* flusher,
-                                  PageTableLevel level, vaddr_t vaddr, volatile pt_entry_t* pte,
-                                  bool was_terminal) {
+void X86PageTableBase::UnmapEntry(ConsistencyManager* cm, PageTableLevel level, vaddr_t vaddr,
+                                  volatile pt_entry_t* pte, bool was_terminal) {
     DEBUG_ASSERT(pte);
 
     pt_entry_t olde = *pte;
 
     *pte = 0;
-    flusher->FlushPtEntry(pte);
+    cm->clf()->FlushPtEntry(pte);
 
-    /* attempt to invalidate the page */
+    /* queue an invalidation of the page */
     if (IS_PAGE_PRESENT(olde)) {
-        // Force the flush before the TLB invalidation, to avoid a race in which
-        // non-coherent remapping hardware sees the old PTE after the
-        // invalidation.
-        flusher->ForceFlush();
-        TlbInvalidatePage(level, vaddr, is_kernel_address(vaddr), was_terminal);
+        cm->queue_invalidation(level, vaddr, was_terminal);
     }
 }
 
@@ -219,7 +293,7 @@ static volatile pt_entry_t* _map_alloc_page(void) {
  * @brief Split the given large page into smaller pages
  */
 zx_status_t X86PageTableBase::SplitLargePage(PageTableLevel level, vaddr_t vaddr,
-                                             volatile pt_entry_t* pte) {
+                                             volatile pt_entry_t* pte, ConsistencyManager* cm) {
     DEBUG_ASSERT_MSG(level != PT_L, "tried splitting PT_L");
     LTRACEF_LEVEL(2, "splitting table %p at level %d\n", pte, level);
 
@@ -232,8 +306,6 @@ zx_status_t X86PageTableBase::SplitLargePage(PageTableLevel level, vaddr_t vaddr
     paddr_t paddr_base = paddr_from_pte(level, *pte);
     PtFlags flags = split_flags(level, *pte & X86_LARGE_FLAGS_MASK);
 
-    CacheLineFlusher clf(needs_cache_flushes());
-
     DEBUG_ASSERT(page_aligned(level, vaddr));
     vaddr_t new_vaddr = vaddr;
     paddr_t new_paddr = paddr_base;
@@ -242,7 +314,7 @@ zx_status_t X86PageTableBase::SplitLargePage(PageTableLevel level, vaddr_t vaddr
         volatile pt_entry_t* e = m + i;
         // If this is a PDP_L (i.e. huge page), flags will include the
         // PS bit still, so the new PD entries will be large pages.
-        UpdateEntry(&clf, lower_level(level), new_vaddr, e, new_paddr, flags,
+        UpdateEntry(cm, lower_level(level), new_vaddr, e, new_paddr, flags,
                     false /* was_terminal */);
         new_vaddr += ps;
         new_paddr += ps;
@@ -250,7 +322,7 @@ zx_status_t X86PageTableBase::SplitLargePage(PageTableLevel level, vaddr_t vaddr
     DEBUG_ASSERT(new_vaddr == vaddr + page_size(level));
 
     flags = intermediate_flags();
-    UpdateEntry(&clf, level, vaddr, pte, X86_VIRT_TO_PHYS(m), flags, true /* was_terminal */);
+    UpdateEntry(cm, level, vaddr, pte, X86_VIRT_TO_PHYS(m), flags, true /* was_terminal */);
     pages_++;
     return ZX_OK;
 }
@@ -335,19 +407,19 @@ zx_status_t X86PageTableBase::GetMappingL0(volatile pt_entry_t* table, vaddr_t v
  * @return true if at least one page was unmapped at this level
  */
 bool X86PageTableBase::RemoveMapping(volatile pt_entry_t* table, PageTableLevel level,
-                                     const MappingCursor& start_cursor, MappingCursor* new_cursor) {
+                                     const MappingCursor& start_cursor, MappingCursor* new_cursor,
+                                     ConsistencyManager* cm) {
     DEBUG_ASSERT(table);
     LTRACEF("L: %d, %016" PRIxPTR " %016zx\n", level, start_cursor.vaddr,
             start_cursor.size);
     DEBUG_ASSERT(check_vaddr(start_cursor.vaddr));
 
     if (level == PT_L) {
-        return RemoveMappingL0(table, start_cursor, new_cursor);
+        return RemoveMappingL0(table, start_cursor, new_cursor, cm);
     }
 
     *new_cursor = start_cursor;
 
-    CacheLineFlusher clf(needs_cache_flushes());
     bool unmapped = false;
     size_t ps = page_size(level);
     uint index = vaddr_to_index(level, new_cursor->vaddr);
@@ -365,7 +437,7 @@ bool X86PageTableBase::RemoveMapping(volatile pt_entry_t* table, PageTableLevel
             bool vaddr_level_aligned = page_aligned(level, new_cursor->vaddr);
             // If the request covers the entire large page, just unmap it
             if (vaddr_level_aligned && new_cursor->size >= ps) {
-                UnmapEntry(&clf, level, new_cursor->vaddr, e, true /* was_terminal */);
+                UnmapEntry(cm, level, new_cursor->vaddr, e, true /* was_terminal */);
                 unmapped = true;
 
                 new_cursor->vaddr += ps;
@@ -375,11 +447,11 @@ bool X86PageTableBase::RemoveMapping(volatile pt_entry_t* table, PageTableLevel
             }
             // Otherwise, we need to split it
             vaddr_t page_vaddr = new_cursor->vaddr & ~(ps - 1);
-            zx_status_t status = SplitLargePage(level, page_vaddr, e);
+            zx_status_t status = SplitLargePage(level, page_vaddr, e, cm);
             if (status != ZX_OK) {
                 // If split fails, just unmap the whole thing, and let a
                 // subsequent page fault clean it up.
-                UnmapEntry(&clf, level, new_cursor->vaddr, e, true /* was_terminal */);
+                UnmapEntry(cm, level, new_cursor->vaddr, e, true /* was_terminal */);
                 unmapped = true;
 
                 new_cursor->SkipEntry(level);
@@ -391,7 +463,7 @@ bool X86PageTableBase::RemoveMapping(volatile pt_entry_t* table, PageTableLevel
         MappingCursor cursor;
         volatile pt_entry_t* next_table = get_next_table_from_entry(pt_val);
         bool lower_unmapped = RemoveMapping(next_table, lower_level(level),
-                                            *new_cursor, &cursor);
+                                            *new_cursor, &cursor, cm);
 
         // If we were requesting to unmap everything in the lower page table,
         // we know we can unmap the lower level page table.  Otherwise, if
@@ -415,7 +487,7 @@ bool X86PageTableBase::RemoveMapping(volatile pt_entry_t* table, PageTableLevel
             LTRACEF("L: %d free pt v %#" PRIxPTR " phys %#" PRIxPTR "\n",
                     level, (uintptr_t)next_table, ptable_phys);
 
-            UnmapEntry(&clf, level, new_cursor->vaddr, e, false /* was_terminal */);
+            UnmapEntry(cm, level, new_cursor->vaddr, e, false /* was_terminal */);
             vm_page_t* page = paddr_to_vm_page(ptable_phys);
 
             DEBUG_ASSERT(page);
@@ -423,7 +495,7 @@ bool X86PageTableBase::RemoveMapping(volatile pt_entry_t* table, PageTableLevel
                              "page %p state %u, paddr %#" PRIxPTR "\n", page, page->state,
                              X86_VIRT_TO_PHYS(next_table));
 
-            pmm_free_page(page);
+            cm->queue_free(page);
             pages_--;
             unmapped = true;
         }
@@ -439,19 +511,18 @@ bool X86PageTableBase::RemoveMapping(volatile pt_entry_t* table, PageTableLevel
 // Base case of RemoveMapping for smallest page size.
 bool X86PageTableBase::RemoveMappingL0(volatile pt_entry_t* table,
                                        const MappingCursor& start_cursor,
-                                       MappingCursor* new_cursor) {
+                                       MappingCursor* new_cursor, ConsistencyManager* cm) {
     LTRACEF("%016" PRIxPTR " %016zx\n", start_cursor.vaddr, start_cursor.size);
     DEBUG_ASSERT(IS_PAGE_ALIGNED(start_cursor.size));
 
     *new_cursor = start_cursor;
 
-    CacheLineFlusher clf(needs_cache_flushes());
     bool unmapped = false;
     uint index = vaddr_to_index(PT_L, new_cursor->vaddr);
     for (; index != NO_OF_PT_ENTRIES && new_cursor->size != 0; ++index) {
         volatile pt_entry_t* e = table + index;
         if (IS_PAGE_PRESENT(*e)) {
-            UnmapEntry(&clf, PT_L, new_cursor->vaddr, e, true /* was_terminal */);
+            UnmapEntry(cm, PT_L, new_cursor->vaddr, e, true /* was_terminal */);
             unmapped = true;
         }
 
@@ -479,7 +550,7 @@ bool X86PageTableBase::RemoveMappingL0(volatile pt_entry_t* table,
  */
 zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_flags,
                                          PageTableLevel level, const MappingCursor& start_cursor,
-                                         MappingCursor* new_cursor) {
+                                         MappingCursor* new_cursor, ConsistencyManager* cm) {
     DEBUG_ASSERT(table);
     DEBUG_ASSERT(check_vaddr(start_cursor.vaddr));
     DEBUG_ASSERT(check_paddr(start_cursor.paddr));
@@ -488,7 +559,7 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
     *new_cursor = start_cursor;
 
     if (level == PT_L) {
-        return AddMappingL0(table, mmu_flags, start_cursor, new_cursor);
+        return AddMappingL0(table, mmu_flags, start_cursor, new_cursor, cm);
     }
 
     // Disable thread safety analysis, since Clang has trouble noticing that
@@ -500,7 +571,7 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
             // new_cursor->size should be how much is left to be mapped still
             cursor.size -= new_cursor->size;
             if (cursor.size > 0) {
-                RemoveMapping(table, level, cursor, &result);
+                RemoveMapping(table, level, cursor, &result, cm);
                 DEBUG_ASSERT(result.size == 0);
             }
         }
@@ -509,7 +580,6 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
     X86PageTableBase::IntermediatePtFlags interm_flags = intermediate_flags();
     X86PageTableBase::PtFlags term_flags = terminal_flags(level, mmu_flags);
 
-    CacheLineFlusher clf(needs_cache_flushes());
 
     size_t ps = page_size(level);
     bool level_supports_large_pages = supports_page_size(level);
@@ -528,7 +598,7 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
         if (level_supports_large_pages && !IS_PAGE_PRESENT(pt_val) && level_valigned &&
             level_paligned && new_cursor->size >= ps) {
 
-            UpdateEntry(&clf, level, new_cursor->vaddr, table + index,
+            UpdateEntry(cm, level, new_cursor->vaddr, table + index,
                         new_cursor->paddr, term_flags | X86_MMU_PG_PS, false /* was_terminal */);
             new_cursor->paddr += ps;
             new_cursor->vaddr += ps;
@@ -544,7 +614,7 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
 
                 LTRACEF_LEVEL(2, "new table %p at level %d\n", m, level);
 
-                UpdateEntry(&clf, level, new_cursor->vaddr, e,
+                UpdateEntry(cm, level, new_cursor->vaddr, e,
                             X86_VIRT_TO_PHYS(m), interm_flags, false /* was_terminal */);
                 pt_val = *e;
                 pages_++;
@@ -552,7 +622,7 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
 
             MappingCursor cursor;
             ret = AddMapping(get_next_table_from_entry(pt_val), mmu_flags,
-                             lower_level(level), *new_cursor, &cursor);
+                             lower_level(level), *new_cursor, &cursor, cm);
             *new_cursor = cursor;
             DEBUG_ASSERT(new_cursor->size <= start_cursor.size);
             if (ret != ZX_OK) {
@@ -567,14 +637,13 @@ zx_status_t X86PageTableBase::AddMapping(volatile pt_entry_t* table, uint mmu_fl
 // Base case of AddMapping for smallest page size.
 zx_status_t X86PageTableBase::AddMappingL0(volatile pt_entry_t* table, uint mmu_flags,
                                            const MappingCursor& start_cursor,
-                                           MappingCursor* new_cursor) {
+                                           MappingCursor* new_cursor, ConsistencyManager* cm) {
     DEBUG_ASSERT(IS_PAGE_ALIGNED(start_cursor.size));
 
     *new_cursor = start_cursor;
 
     X86PageTableBase::PtFlags term_flags = terminal_flags(PT_L, mmu_flags);
 
-    CacheLineFlusher clf(needs_cache_flushes());
     uint index = vaddr_to_index(PT_L, new_cursor->vaddr);
     for (; index != NO_OF_PT_ENTRIES && new_cursor->size != 0; ++index) {
         volatile pt_entry_t* e = table + index;
@@ -582,7 +651,7 @@ zx_status_t X86PageTableBase::AddMappingL0(volatile pt_entry_t* table, uint mmu_
             return ZX_ERR_ALREADY_EXISTS;
         }
 
-        UpdateEntry(&clf, PT_L, new_cursor->vaddr, e, new_cursor->paddr, term_flags,
+        UpdateEntry(cm, PT_L, new_cursor->vaddr, e, new_cursor->paddr, term_flags,
                     false /* was_terminal */);
 
         new_cursor->paddr += PAGE_SIZE;
@@ -607,14 +676,14 @@ zx_status_t X86PageTableBase::AddMappingL0(volatile pt_entry_t* table, uint mmu_
  */
 zx_status_t X86PageTableBase::UpdateMapping(volatile pt_entry_t* table, uint mmu_flags,
                                             PageTableLevel level, const MappingCursor& start_cursor,
-                                            MappingCursor* new_cursor) {
+                                            MappingCursor* new_cursor, ConsistencyManager* cm) {
     DEBUG_ASSERT(table);
     LTRACEF("L: %d, %016" PRIxPTR " %016zx\n", level, start_cursor.vaddr,
             start_cursor.size);
     DEBUG_ASSERT(check_vaddr(start_cursor.vaddr));
 
     if (level == PT_L) {
-        return UpdateMappingL0(table, mmu_flags, start_cursor, new_cursor);
+        return UpdateMappingL0(table, mmu_flags, start_cursor, new_cursor, cm);
     }
 
     zx_status_t ret = ZX_OK;
@@ -622,7 +691,6 @@ zx_status_t X86PageTableBase::UpdateMapping(volatile pt_entry_t* table, uint mmu
 
     X86PageTableBase::PtFlags term_flags = terminal_flags(level, mmu_flags);
 
-    CacheLineFlusher clf(needs_cache_flushes());
     size_t ps = page_size(level);
     uint index = vaddr_to_index(level, new_cursor->vaddr);
     for (; index != NO_OF_PT_ENTRIES && new_cursor->size != 0; ++index) {
@@ -639,7 +707,7 @@ zx_status_t X86PageTableBase::UpdateMapping(volatile pt_entry_t* table, uint mmu
             // If the request covers the entire large page, just change the
             // permissions
             if (vaddr_level_aligned && new_cursor->size >= ps) {
-                UpdateEntry(&clf, level, new_cursor->vaddr, e,
+                UpdateEntry(cm, level, new_cursor->vaddr, e,
                             paddr_from_pte(level, pt_val),
                             term_flags | X86_MMU_PG_PS, true /* was_terminal */);
                 new_cursor->vaddr += ps;
@@ -649,7 +717,7 @@ zx_status_t X86PageTableBase::UpdateMapping(volatile pt_entry_t* table, uint mmu
             }
             // Otherwise, we need to split it
             vaddr_t page_vaddr = new_cursor->vaddr & ~(ps - 1);
-            ret = SplitLargePage(level, page_vaddr, e);
+            ret = SplitLargePage(level, page_vaddr, e, cm);
             if (ret != ZX_OK) {
                 // If we failed to split the table, just unmap it.  Subsequent
                 // page faults will bring it back in.
@@ -658,7 +726,7 @@ zx_status_t X86PageTableBase::UpdateMapping(volatile pt_entry_t* table, uint mmu
                 cursor.size = ps;
 
                 MappingCursor tmp_cursor;
-                RemoveMapping(table, level, cursor, &tmp_cursor);
+                RemoveMapping(table, level, cursor, &tmp_cursor, cm);
 
                 new_cursor->SkipEntry(level);
             }
@@ -668,7 +736,7 @@ zx_status_t X86PageTableBase::UpdateMapping(volatile pt_entry_t* table, uint mmu
         MappingCursor cursor;
         volatile pt_entry_t* next_table = get_next_table_from_entry(pt_val);
         ret = UpdateMapping(next_table, mmu_flags, lower_level(level),
-                            *new_cursor, &cursor);
+                            *new_cursor, &cursor, cm);
         *new_cursor = cursor;
         if (ret != ZX_OK) {
             // Currently this can't happen
@@ -684,7 +752,7 @@ zx_status_t X86PageTableBase::UpdateMapping(volatile pt_entry_t* table, uint mmu
 zx_status_t X86PageTableBase::UpdateMappingL0(volatile pt_entry_t* table,
                                               uint mmu_flags,
                                               const MappingCursor& start_cursor,
-                                              MappingCursor* new_cursor) {
+                                              MappingCursor* new_cursor, ConsistencyManager* cm) {
     LTRACEF("%016" PRIxPTR " %016zx\n", start_cursor.vaddr, start_cursor.size);
     DEBUG_ASSERT(IS_PAGE_ALIGNED(start_cursor.size));
 
@@ -692,14 +760,13 @@ zx_status_t X86PageTableBase::UpdateMappingL0(volatile pt_entry_t* table,
 
     X86PageTableBase::PtFlags term_flags = terminal_flags(PT_L, mmu_flags);
 
-    CacheLineFlusher clf(needs_cache_flushes());
     uint index = vaddr_to_index(PT_L, new_cursor->vaddr);
     for (; index != NO_OF_PT_ENTRIES && new_cursor->size != 0; ++index) {
         volatile pt_entry_t* e = table + index;
         pt_entry_t pt_val = *e;
         // Skip unmapped pages (we may encounter these due to demand paging)
         if (IS_PAGE_PRESENT(pt_val)) {
-            UpdateEntry(&clf, PT_L, new_cursor->vaddr, e, paddr_from_pte(PT_L, pt_val), term_flags,
+            UpdateEntry(cm, PT_L, new_cursor->vaddr, e, paddr_from_pte(PT_L, pt_val), term_flags,
                         true /* was_terminal */);
         }
 
@@ -725,12 +792,14 @@ zx_status_t X86PageTableBase::UnmapPages(vaddr_t vaddr, const size_t count,
     fbl::AutoLock a(&lock_);
     DEBUG_ASSERT(virt_);
 
+    ConsistencyManager cm(this);
+
     MappingCursor start = {
         .paddr = 0, .vaddr = vaddr, .size = count * PAGE_SIZE,
     };
 
     MappingCursor result;
-    RemoveMapping(virt_, top_level(), start, &result);
+    RemoveMapping(virt_, top_level(), start, &result, &cm);
     DEBUG_ASSERT(result.size == 0);
 
     if (unmapped)
@@ -762,6 +831,7 @@ zx_status_t X86PageTableBase::MapPages(vaddr_t vaddr, paddr_t* phys, size_t coun
     DEBUG_ASSERT(virt_);
 
     PageTableLevel top = top_level();
+    ConsistencyManager cm(this);
 
     // TODO(teisenbe): Improve performance of this function by integrating deeper into
     // the algorithm (e.g. make the cursors aware of the page array).
@@ -773,7 +843,7 @@ zx_status_t X86PageTableBase::MapPages(vaddr_t vaddr, paddr_t* phys, size_t coun
             };
 
             MappingCursor result;
-            RemoveMapping(virt_, top, start, &result);
+            RemoveMapping(virt_, top, start, &result, &cm);
             DEBUG_ASSERT(result.size == 0);
         }
     });
@@ -784,7 +854,7 @@ zx_status_t X86PageTableBase::MapPages(vaddr_t vaddr, paddr_t* phys, size_t coun
             .paddr = phys[idx], .vaddr = v, .size = PAGE_SIZE,
         };
         MappingCursor result;
-        zx_status_t status = AddMapping(virt_, mmu_flags, top, start, &result);
+        zx_status_t status = AddMapping(virt_, mmu_flags, top, start, &result, &cm);
         if (status != ZX_OK) {
             dprintf(SPEW, "Add mapping failed with err=%d\n", status);
             return status;
@@ -822,11 +892,13 @@ zx_status_t X86PageTableBase::MapPagesContiguous(vaddr_t vaddr, paddr_t paddr,
     fbl::AutoLock a(&lock_);
     DEBUG_ASSERT(virt_);
 
+    ConsistencyManager cm(this);
+
     MappingCursor start = {
         .paddr = paddr, .vaddr = vaddr, .size = count * PAGE_SIZE,
     };
     MappingCursor result;
-    zx_status_t status = AddMapping(virt_, mmu_flags, top_level(), start, &result);
+    zx_status_t status = AddMapping(virt_, mmu_flags, top_level(), start, &result, &cm);
     if (status != ZX_OK) {
         dprintf(SPEW, "Add mapping failed with err=%d\n", status);
         return status;
@@ -855,11 +927,13 @@ zx_status_t X86PageTableBase::ProtectPages(vaddr_t vaddr, size_t count, uint mmu
 
     fbl::AutoLock a(&lock_);
 
+    ConsistencyManager cm(this);
+
     MappingCursor start = {
         .paddr = 0, .vaddr = vaddr, .size = count * PAGE_SIZE,
     };
     MappingCursor result;
-    zx_status_t status = UpdateMapping(virt_, mmu_flags, top_level(), start, &result);
+    zx_status_t status = UpdateMapping(virt_, mmu_flags, top_level(), start, &result, &cm);
     if (status != ZX_OK) {
         return status;
     }
@@ -12,6 +12,7 @@
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/bootstrap16.h>
+#include <arch/x86/cpu_topology.h>
 #include <arch/x86/descriptor.h>
 #include <arch/x86/mmu_mem_types.h>
 #include <arch/x86/mp.h>
@@ -23,6 +24,39 @@
 #include <vm/vm_aspace.h>
 #include <zircon/types.h>
 
+// Tell the scheduler which cpus share a core and which share a last level
+// cache, so it can spread load across cores before doubling up on siblings.
+static void x86_init_sched_topology(uint32_t* apic_ids, uint32_t num_cpus) {
+    x86_cpu_topology_t topo[SMP_MAX_CPUS];
+    int cpu_num[SMP_MAX_CPUS];
+
+    for (uint32_t i = 0; i < num_cpus; ++i) {
+        x86_cpu_topology_decode(apic_ids[i], &topo[i]);
+        cpu_num[i] = x86_apic_id_to_cpu_num(apic_ids[i]);
+    }
+
+    for (uint32_t i = 0; i < num_cpus; ++i) {
+        if (cpu_num[i] < 0) {
+            continue;
+        }
+
+        cpu_mask_t smt = 0;
+        cpu_mask_t cache = 0;
+        for (uint32_t j = 0; j < num_cpus; ++j) {
+            if (cpu_num[j] < 0 || topo[j].package_id != topo[i].package_id) {
+                continue;
+            }
+            if (topo[j].cache_id == topo[i].cache_id) {
+                cache |= cpu_num_to_mask(cpu_num[j]);
+            }
+            if (topo[j].core_id == topo[i].core_id) {
+                smt |= cpu_num_to_mask(cpu_num[j]);
+            }
+        }
+        mp_set_cpu_topology(cpu_num[i], smt, cache | smt);
+    }
+}
+
 void x86_init_smp(uint32_t* apic_ids, uint32_t num_cpus) {
     DEBUG_ASSERT(num_cpus <= UINT8_MAX);
     zx_status_t status = x86_allocate_ap_structures(apic_ids, (uint8_t)num_cpus);
@@ -31,6 +65,8 @@ void x86_init_smp(uint32_t* apic_ids, uint32_t num_cpus) {
         return;
     }
 
+    x86_init_sched_topology(apic_ids, num_cpus);
+
     lk_init_secondary_cpus(num_cpus - 1);
 }
 
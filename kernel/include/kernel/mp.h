@@ -87,6 +87,12 @@ struct mp_state {
 
     /* lock for serializing CPU hotplug/unplug operations */
     mutex_t hotplug_lock;
+
+    /* for each cpu, the set of cpus sharing its physical core and the set sharing its
+     * last level cache, each including the cpu itself. zero if the arch layer did not
+     * report any topology for the cpu. */
+    cpu_mask_t smt_siblings[SMP_MAX_CPUS];
+    cpu_mask_t cache_siblings[SMP_MAX_CPUS];
 };
 
 extern struct mp_state mp;
@@ -94,6 +100,9 @@ extern struct mp_state mp;
 void mp_set_curr_cpu_online(bool online);
 void mp_set_curr_cpu_active(bool active);
 
+/* called by the arch layer to describe which cpus share hardware with |cpu| */
+void mp_set_cpu_topology(cpu_num_t cpu, cpu_mask_t smt_siblings, cpu_mask_t cache_siblings);
+
 static inline int mp_is_cpu_active(cpu_num_t cpu) {
     return atomic_load((int*)&mp.active_cpus) & cpu_num_to_mask(cpu);
 }
@@ -144,4 +153,18 @@ static inline cpu_mask_t mp_get_realtime_mask(void) {
     return mp.realtime_cpus;
 }
 
+/* cpus sharing a physical core with |cpu|. without topology information every cpu is
+ * treated as its own core. */
+static inline cpu_mask_t mp_get_smt_siblings(cpu_num_t cpu) {
+    cpu_mask_t mask = is_valid_cpu_num(cpu) ? mp.smt_siblings[cpu] : 0;
+    return mask ? mask : cpu_num_to_mask(cpu);
+}
+
+/* cpus sharing a last level cache with |cpu|. without topology information every cpu
+ * is treated as sharing one cache. */
+static inline cpu_mask_t mp_get_cache_siblings(cpu_num_t cpu) {
+    cpu_mask_t mask = is_valid_cpu_num(cpu) ? mp.cache_siblings[cpu] : 0;
+    return mask ? mask : CPU_MASK_ALL;
+}
+
 __END_CDECLS
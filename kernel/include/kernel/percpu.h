@@ -8,6 +8,7 @@
 #include <arch/ops.h>
 #include <kernel/align.h>
 #include <kernel/event.h>
+#include <kernel/spinlock.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
@@ -19,15 +20,52 @@ __BEGIN_CDECLS
 
 struct percpu {
     /* per cpu timer queue */
-    struct list_node timer_queue;
+    struct timer_queue timer_queue;
 
     /* per cpu preemption timer */
     timer_t preempt_timer;
 
+    /* protects the run queue and bitmap below. nests inside thread_lock, and
+     * only one cpu's run queue lock may be held at a time.
+     */
+    spin_lock_t run_queue_lock;
+
     /* per cpu run queue and bitmap to indicate which queues are non empty */
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
 
+    /* deadline class threads, sorted by absolute deadline. they run ahead of the
+     * priority queues above and are also protected by run_queue_lock. */
+    struct list_node deadline_queue;
+
+    /* deadline class threads that used up their budget, sorted by replenish time,
+     * and the timer that hands them back their budget */
+    struct list_node deadline_throttled;
+    timer_t deadline_timer;
+
+    /* bandwidth reserved by the deadline class threads placed on this cpu, in the
+     * scheduler's fixed point. protected by thread_lock. */
+    uint64_t deadline_bw;
+
+    /* threads other cpus have woken onto this one, not yet sorted into the run queue.
+     * drained by this cpu from its reschedule ipi. also protected by run_queue_lock. */
+    struct list_node wakeup_queue;
+
+    /* a thread woken by the running thread and handed its cpu, to be switched to ahead of the
+     * run queue when the running thread next reschedules. not counted in run_queue_count.
+     * also protected by run_queue_lock. */
+    thread_t* handoff_thread;
+
+    /* number of threads sitting in the run queue, wakeup queue and deadline queue */
+    uint32_t run_queue_count;
+
+    /* decaying average of runnable threads on this cpu, 8 bit fixed point */
+    uint32_t load_avg;
+
+    /* the thread this cpu last switched to. only written by this cpu, in the scheduler, and
+     * read without locks by code that only compares it against a thread pointer */
+    thread_t* volatile running_thread;
+
     /* timestamp of the last reschedule IPI sent to this cpu */
     /* 0 means no pending IPI */
     zx_time_t ipi_timestamp;
@@ -22,6 +22,18 @@ void sched_reschedule(void);
 void sched_resched_internal(void);
 void sched_unblock_idle(thread_t* t);
 void sched_migrate(thread_t* t);
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t period, zx_duration_t budget,
+                               zx_duration_t deadline);
+
+/* priority inheritance. sched_pi_link records that |waiter| is blocked on a lock held by
+ * |owner| and sched_pi_unlink undoes that, returning the old owner. neither updates any
+ * priorities; call sched_pi_recompute on each owner whose set of waiters changed to
+ * propagate the change along the chain of blocked owners. */
+void sched_pi_link(thread_t* waiter, thread_t* owner);
+thread_t* sched_pi_unlink(thread_t* waiter);
+
+/* returns true if a thread on the current cpu's run queue changed priority */
+bool sched_pi_recompute(thread_t* t);
 
 /* return true if the thread was placed on the current cpu's run queue */
 /* this usually means the caller should locally reschedule soon */
@@ -29,3 +41,7 @@ bool sched_unblock(thread_t* t) __WARN_UNUSED_RESULT;
 bool sched_unblock_list(struct list_node* list) __WARN_UNUSED_RESULT;
 
 void sched_transition_off_cpu(cpu_num_t old_cpu);
+
+/* sort threads woken onto the current cpu by other cpus into its run queue. called from
+ * the reschedule ipi with interrupts disabled and without thread_lock held */
+void sched_drain_wakeup_queue(void);
@@ -59,6 +59,7 @@ typedef void (*thread_tls_callback_t)(void* tls_value);
 #define THREAD_FLAG_REAL_TIME                (1 << 3)
 #define THREAD_FLAG_IDLE                     (1 << 4)
 #define THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK (1 << 5)
+#define THREAD_FLAG_DEADLINE                 (1 << 6)
 
 #define THREAD_SIGNAL_KILL                   (1 << 0)
 #define THREAD_SIGNAL_SUSPEND                (1 << 1)
@@ -93,6 +94,27 @@ typedef struct thread {
     int base_priority;
     int priority_boost;
 
+    /* priority inheritance. a thread blocked on a lock held by pi_owner lends it its priority
+     * through pi_waiter_node on the owner's pi_waiters list. inherited_priority is the highest
+     * priority lent to this thread, or 0 if none. protected by thread_lock. */
+    int inherited_priority;
+    struct thread* pi_owner;
+    struct list_node pi_waiters;
+    struct list_node pi_waiter_node;
+
+    /* deadline scheduling class parameters, only meaningful with THREAD_FLAG_DEADLINE set.
+     * the budget left in the current period is tracked in remaining_time_slice. */
+    zx_duration_t deadline_period;
+    zx_duration_t deadline_budget;
+    zx_duration_t deadline_relative;
+    zx_time_t deadline_abs;       /* absolute deadline of the current period */
+    zx_time_t deadline_replenish; /* when the budget comes back, if throttled */
+    bool deadline_throttled;      /* out of budget and parked until deadline_replenish */
+    cpu_num_t deadline_cpu;       /* the cpu the reservation is placed on and runs on */
+
+    /* ready, but parked on curr_cpu's wakeup queue rather than in its run queue */
+    bool wakeup_queued;
+
     /* current cpu the thread is either running on or in the ready queue, undefined otherwise */
     cpu_num_t curr_cpu;
     cpu_num_t last_cpu;      /* last cpu the thread ran on, INVALID_CPU if it's never run */
@@ -153,6 +175,10 @@ typedef struct thread {
      * only be true if preempt_disable is also true. */
     bool preempt_pending;
 
+    /* set by the thread itself around a wakeup it is about to block or reschedule after, so
+     * that this cpu switches straight to the thread it wakes. see thread_set_handoff_wakeup(). */
+    bool handoff_wakeup;
+
     /* thread local storage, intialized to zero */
     void* tls[THREAD_MAX_TLS_ENTRY];
 
@@ -215,12 +241,26 @@ zx_status_t thread_join(thread_t* t, int* retcode, zx_time_t deadline);
 zx_status_t thread_detach_and_resume(thread_t* t);
 zx_status_t thread_set_real_time(thread_t* t);
 
+/* move the thread into the deadline scheduling class: every |period| it is guaranteed
+ * |budget| worth of cpu time, delivered by |deadline| after the start of the period.
+ * a zero period returns the thread to the fixed priority class. */
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t period, zx_duration_t budget,
+                                zx_duration_t deadline);
+
 /* scheduler routines to be used by regular kernel code */
 void thread_yield(void);      /* give up the cpu and time slice voluntarily */
 void thread_preempt(void);    /* get preempted at irq time */
 void thread_reschedule(void); /* revaluate the run queue on the current cpu,
                                  can be used after waking up threads */
 
+/* while enabled, the next thread the current thread wakes is handed the current cpu and
+ * lent what is left of the current thread's time slice, rather than being placed on
+ * whichever cpu looks least loaded. the scheduler switches straight to it the next time the
+ * current thread blocks or reschedules, unless a more urgent thread is queued by then. meant
+ * to bracket no more than the one wakeup of a synchronous exchange, after which the current
+ * thread blocks or reschedules. */
+void thread_set_handoff_wakeup(bool handoff);
+
 void thread_owner_name(thread_t* t, char out_name[THREAD_NAME_LENGTH]);
 
 // print the backtrace on the current thread
@@ -285,6 +325,10 @@ static inline bool thread_is_real_time_or_idle(thread_t* t) {
     return !!(t->flags & (THREAD_FLAG_REAL_TIME | THREAD_FLAG_IDLE));
 }
 
+static inline bool thread_is_deadline(thread_t* t) {
+    return !!(t->flags & THREAD_FLAG_DEADLINE);
+}
+
 /* the current thread */
 #include <arch/current_thread.h>
 thread_t* get_current_thread(void);
@@ -28,9 +28,24 @@ enum slack_mode {
     TIMER_SLACK_EARLY,  // slack interval is (deadline - slack, dealine]
 };
 
+// A per-cpu queue of pending timers.  Timers are kept in a binary search tree
+// ordered by scheduled_time (a treap, balanced by a hash of each timer's
+// address), so that setting or canceling a timer is O(log n) in the number of
+// pending timers.
+struct timer_queue {
+    struct timer* root;
+    struct timer* head; // earliest timer in the queue, or NULL if empty
+};
+
 typedef struct timer {
     int magic;
-    struct list_node node;
+
+    // The queue the timer is set on, or NULL if it is not set, and its links
+    // within that queue's tree.
+    struct timer_queue* queue;
+    struct timer* parent;
+    struct timer* left;
+    struct timer* right;
 
     zx_time_t scheduled_time;
     int64_t slack; // Stores the applied slack adjustment from
@@ -45,7 +60,10 @@ typedef struct timer {
 #define TIMER_INITIAL_VALUE(t)              \
     {                                       \
         .magic = TIMER_MAGIC,               \
-        .node = LIST_INITIAL_CLEARED_VALUE, \
+        .queue = NULL,                      \
+        .parent = NULL,                     \
+        .left = NULL,                       \
+        .right = NULL,                      \
         .scheduled_time = 0,                \
         .slack = 0,                         \
         .callback = NULL,                   \
@@ -401,6 +401,17 @@ void mp_set_curr_cpu_active(bool active) {
     }
 }
 
+void mp_set_cpu_topology(cpu_num_t cpu, cpu_mask_t smt_siblings, cpu_mask_t cache_siblings) {
+    DEBUG_ASSERT(is_valid_cpu_num(cpu));
+    DEBUG_ASSERT(smt_siblings & cpu_num_to_mask(cpu));
+    DEBUG_ASSERT((smt_siblings & cache_siblings) == smt_siblings);
+
+    LTRACEF("cpu %u smt %#x cache %#x\n", cpu, smt_siblings, cache_siblings);
+
+    mp.smt_siblings[cpu] = smt_siblings;
+    mp.cache_siblings[cpu] = cache_siblings;
+}
+
 enum handler_return mp_mbx_generic_irq(void) {
     DEBUG_ASSERT(arch_ints_disabled());
     const cpu_num_t local_cpu = arch_curr_cpu_num();
@@ -438,6 +449,10 @@ enum handler_return mp_mbx_reschedule_irq(void) {
         }
     }
 
+    /* sort in whatever the sender woke onto this cpu while we are here, so that the
+     * reschedule at the end of the interrupt does not have to */
+    sched_drain_wakeup_queue();
+
     return (mp.active_cpus & cpu_num_to_mask(cpu)) ? INT_RESCHEDULE : INT_NO_RESCHEDULE;
 }
 
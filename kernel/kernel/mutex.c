@@ -20,14 +20,27 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/mp.h>
+#include <kernel/percpu.h>
 #include <kernel/sched.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
+// Upper bound on how long mutex_acquire spins on a running holder before blocking anyway.
+// Past this the critical section is long enough that a block and wake is cheap in comparison.
+#define MUTEX_SPIN_MAX ZX_USEC(50)
+
+// counts contended acquires that got the mutex by spinning on a running holder.
+KCOUNTER(mutex_spin_acquire_count, "kernel.mutex.spin_acquire");
+// counts contended acquires that gave up spinning, or never started, and blocked.
+KCOUNTER(mutex_block_count, "kernel.mutex.block");
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -59,6 +72,65 @@ void mutex_destroy(mutex_t* m) {
     wait_queue_destroy(&m->wait);
 }
 
+// Returns true if |holder| is what |cpu| is running. This only compares pointers, so it is
+// safe even if |holder| has since released the mutex, exited and been freed.
+static bool mutex_holder_running_on(uintptr_t holder, cpu_num_t cpu) {
+    return (uintptr_t)percpu[cpu].running_thread == holder;
+}
+
+// Returns the cpu other than the current one that |holder| is running on, or INVALID_CPU.
+static cpu_num_t mutex_holder_cpu(uintptr_t holder) {
+    cpu_mask_t others = mp_get_active_mask() & ~cpu_num_to_mask(arch_curr_cpu_num());
+    while (others) {
+        cpu_num_t cpu = lowest_cpu_set(others);
+        others &= ~cpu_num_to_mask(cpu);
+        if (mutex_holder_running_on(holder, cpu))
+            return cpu;
+    }
+    return INVALID_CPU;
+}
+
+// Spin while the holder of |m| is running on another cpu, on the bet that it will release the
+// mutex before a block and wake would have finished. Returns true if the mutex was acquired.
+static bool mutex_spin(mutex_t* m, thread_t* ct) {
+    zx_time_t deadline = ZX_TIME_INFINITE;
+    uintptr_t holder = 0;
+    cpu_num_t holder_cpu = INVALID_CPU;
+
+    for (;;) {
+        uintptr_t oldval = mutex_val(m);
+        if (oldval == 0) {
+            if (atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))
+                return true;
+            continue;
+        }
+
+        // once there are waiters the mutex is handed straight to one of them on release, so
+        // there is nothing to be gained from spinning
+        if (oldval & MUTEX_FLAG_QUEUED)
+            return false;
+
+        // The holder is never dereferenced: without the thread lock nothing keeps it alive.
+        // Instead look for it among the threads the other cpus are running, and once found
+        // keep checking just that cpu.
+        if (oldval != holder) {
+            holder = oldval;
+            holder_cpu = mutex_holder_cpu(holder);
+        }
+        if (holder_cpu == INVALID_CPU || !mutex_holder_running_on(holder, holder_cpu))
+            return false;
+
+        zx_time_t now = current_time();
+        if (deadline == ZX_TIME_INFINITE) {
+            deadline = now + MUTEX_SPIN_MAX;
+        } else if (now >= deadline) {
+            return false;
+        }
+
+        arch_spinloop_pause();
+    }
+}
+
 /**
  * @brief  Acquire the mutex
  */
@@ -83,6 +155,12 @@ retry:
               ct, ct->name, m);
 #endif
 
+    // the holder may be about to release it, in which case spinning beats blocking
+    if (mutex_spin(m, ct)) {
+        kcounter_add(mutex_spin_acquire_count, 1u);
+        return;
+    }
+
     // we contended with someone else, will probably need to block
     THREAD_LOCK(state);
 
@@ -100,6 +178,14 @@ retry:
         goto retry;
     }
 
+    kcounter_add(mutex_block_count, 1u);
+
+    // lend our priority to the holder, and through it to anything the holder is blocked on,
+    // so that a lower priority holder cannot be starved while we wait on it
+    thread_t* holder = (thread_t*)(oldval & ~MUTEX_FLAG_QUEUED);
+    sched_pi_link(ct, holder);
+    (void)sched_pi_recompute(holder);
+
     // we have signalled that we're blocking, so drop into the wait queue
     zx_status_t ret = wait_queue_block(&m->wait, ZX_TIME_INFINITE);
     if (unlikely(ret < ZX_OK)) {
@@ -149,6 +235,17 @@ static inline void mutex_release_internal(mutex_t* m, bool reschedule, bool thre
     thread_t* t = wait_queue_dequeue_one(&m->wait, ZX_OK);
     DEBUG_ASSERT_MSG(t, "mutex_release: wait queue didn't have anything, but m->val = %#" PRIxPTR "\n", mutex_val(m));
 
+    // the new owner stops lending us its priority, and the waiters left behind lend theirs
+    // to the new owner instead
+    sched_pi_unlink(t);
+    thread_t* waiter;
+    list_for_every_entry (&m->wait.list, waiter, thread_t, queue_node) {
+        sched_pi_unlink(waiter);
+        sched_pi_link(waiter, t);
+    }
+    bool pi_resched = sched_pi_recompute(ct);
+    pi_resched |= sched_pi_recompute(t);
+
     // we woke up a thread, mark the mutex owned by that thread
     uintptr_t newval = (uintptr_t)t | (wait_queue_is_empty(&m->wait) ? 0 : MUTEX_FLAG_QUEUED);
 
@@ -160,8 +257,12 @@ static inline void mutex_release_internal(mutex_t* m, bool reschedule, bool thre
     ktrace(TAG_KWAIT_WAKE, (uintptr_t)&m->wait >> 32, (uintptr_t)&m->wait, 1, 0);
 
     // wake up the new thread, putting it in a run queue on a cpu. reschedule if the local
-    // cpu run queue was modified
-    bool local_resched = sched_unblock(t);
+    // cpu run queue was modified. a lock changing hands is never the wakeup the current
+    // thread asked to hand off, so keep that for the thread it is meant for
+    bool handoff = ct->handoff_wakeup;
+    ct->handoff_wakeup = false;
+    bool local_resched = sched_unblock(t) || pi_resched;
+    ct->handoff_wakeup = handoff;
     if (reschedule && local_resched)
         sched_reschedule();
 
@@ -12,8 +12,11 @@
 #include <inttypes.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
+#include <kernel/cmdline.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <lk/init.h>
 #include <list.h>
 #include <platform.h>
 #include <printf.h>
@@ -52,13 +55,58 @@
 /* threads get 10ms to run before they use up their time slice and the scheduler is invoked */
 #define THREAD_INITIAL_TIME_SLICE ZX_MSEC(10)
 
+/* cpu load is tracked in fixed point, with one runnable thread == SCHED_LOAD_SCALE */
+#define SCHED_LOAD_SHIFT 8
+#define SCHED_LOAD_SCALE (1u << SCHED_LOAD_SHIFT)
+
+/* each reschedule moves the load average 1/2^SCHED_LOAD_DECAY of the way to the current sample */
+#define SCHED_LOAD_DECAY 3
+
+/* the extra load a cpu must be willing to carry before a thread is moved onto it away from
+ * the cpu it last ran on, scaled by how much cache the two cpus share */
+#define SCHED_MIGRATE_COST_SMT (SCHED_LOAD_SCALE / 2)
+#define SCHED_MIGRATE_COST_CACHE SCHED_LOAD_SCALE
+#define SCHED_MIGRATE_COST_REMOTE (SCHED_LOAD_SCALE * 2)
+
+/* extra load charged to a cpu whose smt sibling is busy, since they share a core */
+#define SCHED_LOAD_SMT_BUSY (SCHED_LOAD_SCALE / 2)
+
+// counts the number of threads pulled from another cpu's run queue by an idle cpu.
+KCOUNTER(sched_steal_count, "kernel.sched.steal");
+// counts the number of times a busy cpu kicked an idle cpu to come steal work.
+KCOUNTER(sched_idle_kick_count, "kernel.sched.idle_kick");
+// counts the number of times a cpu switched straight to a thread handed off by the thread that woke it.
+KCOUNTER(sched_handoff_count, "kernel.sched.handoff");
+
+// counts the number of times a deadline class thread ran out of budget and was throttled.
+KCOUNTER(sched_deadline_throttle_count, "kernel.sched.deadline.throttle");
+// counts the number of times a deadline class thread was still runnable past its deadline.
+KCOUNTER(sched_deadline_miss_count, "kernel.sched.deadline.miss");
+
+/* place wakeups by cpu load and let idle cpus steal queued threads */
+static bool load_balance = true;
+
+/* let a thread about to block or yield switch straight to the thread it wakes */
+static bool handoff = true;
+
+/* deadline class bandwidth is tracked as a fraction of a cpu in this many bits of fixed point */
+#define SCHED_BW_SHIFT 20
+
+/* deadline class threads may reserve at most this share of any one cpu, so the fixed
+ * priority threads on it are never starved outright. this also caps a single thread. */
+#define SCHED_DEADLINE_MAX_BW_PERCENT 90
+#define SCHED_DEADLINE_MAX_CPU_BW \
+    (((uint64_t)SCHED_DEADLINE_MAX_BW_PERCENT << SCHED_BW_SHIFT) / 100)
+
+static enum handler_return deadline_replenish_tick(timer_t* timer, zx_time_t now, void* arg);
+
 static bool local_migrate_if_needed(thread_t* curr_thread);
 
 /* compute the effective priority of a thread */
 static int effec_priority(const thread_t* t) {
     int ep = t->base_priority + t->priority_boost;
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
-    return ep;
+    return MAX(ep, t->inherited_priority);
 }
 
 /* boost the priority of the thread by +1 */
@@ -66,7 +114,7 @@ static void boost_thread(thread_t* t) {
     if (NO_BOOST)
         return;
 
-    if (unlikely(thread_is_real_time_or_idle(t)))
+    if (unlikely(thread_is_real_time_or_idle(t) || thread_is_deadline(t)))
         return;
 
     if (t->priority_boost < MAX_PRIORITY_ADJ &&
@@ -83,7 +131,7 @@ static void deboost_thread(thread_t* t, bool quantum_expiration) {
     if (NO_BOOST)
         return;
 
-    if (unlikely(thread_is_real_time_or_idle(t)))
+    if (unlikely(thread_is_real_time_or_idle(t) || thread_is_deadline(t)))
         return;
 
     int boost_floor;
@@ -135,6 +183,95 @@ static cpu_mask_t rand_cpu(cpu_mask_t mask) {
     }
 }
 
+/* the current load on a cpu, combining the threads waiting in its run queue, whether it is
+ * running anything right now, whether its core is shared with a busy sibling, and its recent
+ * history */
+static uint32_t cpu_load(cpu_num_t cpu) {
+    const struct percpu* c = &percpu[cpu];
+
+    uint32_t load = c->run_queue_count << SCHED_LOAD_SHIFT;
+    if (!mp_is_cpu_idle(cpu))
+        load += SCHED_LOAD_SCALE;
+
+    cpu_mask_t siblings = mp_get_smt_siblings(cpu) & ~cpu_num_to_mask(cpu);
+    if (siblings & ~mp_get_idle_mask())
+        load += SCHED_LOAD_SMT_BUSY;
+
+    return load + c->load_avg;
+}
+
+/* the relative cost of moving a thread that last ran on |from| over to |to| */
+static uint32_t migration_cost(cpu_num_t from, cpu_num_t to) {
+    if (!is_valid_cpu_num(from) || from == to)
+        return 0;
+
+    cpu_mask_t to_mask = cpu_num_to_mask(to);
+    if (mp_get_smt_siblings(from) & to_mask)
+        return SCHED_MIGRATE_COST_SMT;
+    if (mp_get_cache_siblings(from) & to_mask)
+        return SCHED_MIGRATE_COST_CACHE;
+    return SCHED_MIGRATE_COST_REMOTE;
+}
+
+/* pick the cpu out of the passed in mask that is cheapest for a thread that last ran on
+ * |last_cpu|, weighing each cpu's load against the cost of migrating there */
+static cpu_mask_t least_loaded_cpu(cpu_mask_t mask, cpu_num_t last_cpu) {
+    mask &= mp_get_active_mask();
+
+    cpu_mask_t best = 0;
+    uint32_t best_cost = UINT32_MAX;
+    while (mask) {
+        cpu_num_t cpu = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(cpu);
+
+        uint32_t cost = cpu_load(cpu) + migration_cost(last_cpu, cpu);
+        if (cost < best_cost) {
+            best = cpu_num_to_mask(cpu);
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+/* pick an idle cpu out of the passed in mask for a thread that last ran near |near_cpu|.
+ * a cpu whose whole core is idle is preferred over the sibling of a busy core, and a cpu
+ * sharing a last level cache with |near_cpu| is preferred over one further away.
+ */
+static cpu_mask_t pick_idle_cpu(cpu_mask_t idle_mask, cpu_num_t near_cpu) {
+    cpu_mask_t all_idle = mp_get_idle_mask();
+
+    cpu_mask_t idle_cores = 0;
+    cpu_mask_t mask = idle_mask;
+    while (mask) {
+        cpu_num_t cpu = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(cpu);
+
+        if ((mp_get_smt_siblings(cpu) & ~all_idle) == 0)
+            idle_cores |= cpu_num_to_mask(cpu);
+    }
+
+    cpu_mask_t near = mp_get_cache_siblings(near_cpu);
+    if (idle_cores & near)
+        return rand_cpu(idle_cores & near);
+    if (idle_mask & near)
+        return rand_cpu(idle_mask & near);
+    if (idle_cores)
+        return rand_cpu(idle_cores);
+    return rand_cpu(idle_mask);
+}
+
+/* fold the current number of runnable threads on the cpu into its decaying load average */
+static void update_cpu_load(cpu_num_t cpu, bool running_idle) {
+    struct percpu* c = &percpu[cpu];
+
+    uint32_t sample = c->run_queue_count << SCHED_LOAD_SHIFT;
+    if (!running_idle)
+        sample += SCHED_LOAD_SCALE;
+
+    c->load_avg = c->load_avg - (c->load_avg >> SCHED_LOAD_DECAY) + (sample >> SCHED_LOAD_DECAY);
+}
+
 /* find a cpu to wake up */
 static cpu_mask_t find_cpu_mask(thread_t* t) {
     /* get the last cpu the thread ran on */
@@ -165,13 +302,22 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
             return last_ran_cpu_mask;
         }
 
-        /* pick an idle_cpu */
+        /* pick an idle_cpu, staying close to where the thread last ran */
         DEBUG_ASSERT((idle_cpu_mask & mp_get_active_mask()) == idle_cpu_mask);
-        return rand_cpu(idle_cpu_mask);
+        cpu_num_t near_cpu = is_valid_cpu_num(t->last_cpu) ? t->last_cpu : arch_curr_cpu_num();
+        return pick_idle_cpu(idle_cpu_mask, near_cpu);
     }
 
     /* no idle cpus in our affinity mask */
 
+    if (load_balance) {
+        /* go to the least loaded cpu, unless the warm cache on the cpu it last ran on is
+         * worth more than the shorter queue */
+        cpu_mask_t least = least_loaded_cpu(cpu_affinity, t->last_cpu);
+        if (least != 0)
+            return least;
+    }
+
     /* if the last cpu it ran on is in the affinity mask and not the current cpu, pick that */
     if ((last_ran_cpu_mask & cpu_affinity & active_cpu_mask) &&
         last_ran_cpu_mask != curr_cpu_mask) {
@@ -195,35 +341,367 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
 }
 
 /* run queue manipulation */
-static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
+
+/* each cpu's run queue is guarded by its own spinlock so that queue manipulation
+ * on one cpu does not bounce cache lines with queue manipulation on another. a
+ * thread woken onto a remote cpu is parked on that cpu's wakeup queue, which only
+ * takes the remote lock long enough to append to a list, and the reschedule ipi
+ * that follows has the remote cpu sort it into its priority queues itself, under
+ * nothing but its own run queue lock.
+ *
+ * this is not a split of thread_lock. every path that wakes, blocks, enqueues or
+ * dequeues a thread still holds thread_lock, and the run queue locks nest inside
+ * it; only the ipi drain of a wakeup queue runs without it. contention on
+ * thread_lock is therefore unchanged by the per-cpu locks.
+ */
+static inline void run_queue_lock(struct percpu* c) TA_ACQ(c->run_queue_lock) {
+    DEBUG_ASSERT(arch_ints_disabled());
+    spin_lock(&c->run_queue_lock);
+}
+
+static inline void run_queue_unlock(struct percpu* c) TA_REL(c->run_queue_lock) {
+    spin_unlock(&c->run_queue_lock);
+}
+
+static void add_to_run_queue_locked(struct percpu* c, thread_t* t, bool head)
+    TA_REQ(c->run_queue_lock) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
     int ep = effec_priority(t);
+    if (head) {
+        list_add_head(&c->run_queue[ep], &t->queue_node);
+    } else {
+        list_add_tail(&c->run_queue[ep], &t->queue_node);
+    }
+    c->run_queue_bitmap |= (1u << ep);
+    c->run_queue_count++;
+}
 
-    list_add_head(&percpu[cpu].run_queue[ep], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << ep);
+static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
+    struct percpu* c = &percpu[cpu];
+    run_queue_lock(c);
+    add_to_run_queue_locked(c, t, true);
+    run_queue_unlock(c);
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
 }
 
 static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) {
+    struct percpu* c = &percpu[cpu];
+    run_queue_lock(c);
+    add_to_run_queue_locked(c, t, false);
+    run_queue_unlock(c);
+
+    /* mark the cpu as busy since the run queue now has at least one item in it */
+    mp_set_cpu_busy(cpu);
+}
+
+/* park a woken thread on |cpu|'s wakeup queue. the caller kicks |cpu| with a reschedule ipi,
+ * which sorts it into the run queue proper */
+static void insert_in_wakeup_queue(cpu_num_t cpu, thread_t* t) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
+    DEBUG_ASSERT(!thread_is_deadline(t));
 
-    int ep = effec_priority(t);
+    struct percpu* c = &percpu[cpu];
+    run_queue_lock(c);
+    list_add_tail(&c->wakeup_queue, &t->queue_node);
+    t->wakeup_queued = true;
+    c->run_queue_count++;
+    run_queue_unlock(c);
+
+    /* the thread counts as queued, so the cpu is no longer idle */
+    mp_set_cpu_busy(cpu);
+}
+
+/* move everything on |c|'s wakeup queue into its run queue, in the order it was woken */
+static void drain_wakeup_queue_locked(struct percpu* c) TA_REQ(c->run_queue_lock) {
+    thread_t* t;
+    while ((t = list_remove_head_type(&c->wakeup_queue, thread_t, queue_node))) {
+        DEBUG_ASSERT(t->state == THREAD_READY);
+        DEBUG_ASSERT(t->curr_cpu == (cpu_num_t)(c - percpu));
+        t->wakeup_queued = false;
+        c->run_queue_count--;
+        add_to_run_queue_locked(c, t, t->remaining_time_slice > 0);
+    }
+}
+
+void sched_drain_wakeup_queue(void) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    struct percpu* c = &percpu[arch_curr_cpu_num()];
+    run_queue_lock(c);
+    drain_wakeup_queue_locked(c);
+    run_queue_unlock(c);
+}
+
+/* pull a ready thread out of whatever run queue it is sitting in */
+static void remove_from_run_queue(thread_t* t) {
+    DEBUG_ASSERT(t->state == THREAD_READY);
+    DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
+
+    struct percpu* c = &percpu[t->curr_cpu];
+    run_queue_lock(c);
 
-    list_add_tail(&percpu[cpu].run_queue[ep], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << ep);
+    /* handed off threads are not in any queue */
+    if (c->handoff_thread == t) {
+        c->handoff_thread = NULL;
+        run_queue_unlock(c);
+        return;
+    }
+
+    DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
+    list_delete(&t->queue_node);
+
+    if (t->wakeup_queued) {
+        /* not sorted into a priority queue yet */
+        t->wakeup_queued = false;
+        c->run_queue_count--;
+    } else if (t->deadline_throttled) {
+        /* parked threads are not counted as runnable */
+        t->deadline_throttled = false;
+    } else if (thread_is_deadline(t)) {
+        c->run_queue_count--;
+    } else {
+        c->run_queue_count--;
+
+        int pri = effec_priority(t);
+        if (list_is_empty(&c->run_queue[pri])) {
+            c->run_queue_bitmap &= ~(1u << pri);
+        }
+    }
+
+    run_queue_unlock(c);
+}
+
+/* deadline class threads run earliest deadline first, under a constant bandwidth server: each
+ * period they get their budget back and a fresh absolute deadline. a thread that uses up its
+ * budget early is throttled until its next period, which is what keeps a misbehaving deadline
+ * thread from starving everything else.
+ */
+
+/* the share of a cpu a deadline class thread reserves */
+static uint64_t deadline_bw(zx_duration_t budget, zx_duration_t period) {
+    return ((uint64_t)budget << SCHED_BW_SHIFT) / (uint64_t)period;
+}
+
+/* pick a cpu out of |mask| to place a deadline class reservation of |bw| on: |prefer| if it
+ * still has room, otherwise the cpu with the least reserved so far. the caller checks that the
+ * cpu returned has room, since if the least reserved one does not, none does. */
+static cpu_num_t deadline_pick_cpu(cpu_mask_t mask, uint64_t bw, cpu_num_t prefer) {
+    mask &= mp_get_active_mask();
+
+    if (is_valid_cpu_num(prefer) && (mask & cpu_num_to_mask(prefer)) &&
+        percpu[prefer].deadline_bw + bw <= SCHED_DEADLINE_MAX_CPU_BW)
+        return prefer;
+
+    cpu_num_t best = INVALID_CPU;
+    while (mask) {
+        cpu_num_t cpu = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(cpu);
+
+        if (best == INVALID_CPU || percpu[cpu].deadline_bw < percpu[best].deadline_bw)
+            best = cpu;
+    }
+
+    return best;
+}
+
+/* the cpu a deadline class thread runs on. if a change of affinity or a cpu going offline
+ * has taken it away from the cpu its reservation was placed on, the reservation moves with
+ * it. should no allowed cpu have room left the thread runs overcommitted on the least
+ * reserved one, rather than not at all. */
+static cpu_num_t deadline_home_cpu(thread_t* t) {
+    DEBUG_ASSERT(thread_is_deadline(t));
+
+    cpu_num_t cpu = t->deadline_cpu;
+    cpu_mask_t allowed = t->cpu_affinity & mp_get_active_mask();
+    if (likely(allowed & cpu_num_to_mask(cpu)))
+        return cpu;
+
+    uint64_t bw = deadline_bw(t->deadline_budget, t->deadline_period);
+    percpu[cpu].deadline_bw -= bw;
+    cpu = deadline_pick_cpu(allowed, bw, t->last_cpu);
+    if (cpu == INVALID_CPU) {
+        /* same fallback as find_cpu_mask when the affinity mask has no active cpus */
+        cpu = arch_curr_cpu_num();
+    }
+    percpu[cpu].deadline_bw += bw;
+    t->deadline_cpu = cpu;
+
+    return cpu;
+}
+
+/* start a new period for a deadline class thread */
+static void replenish_deadline_thread(thread_t* t, zx_time_t period_start) {
+    t->remaining_time_slice = t->deadline_budget;
+    t->deadline_abs = period_start + t->deadline_relative;
+}
+
+/* a deadline class thread is becoming runnable. if what is left of its budget cannot be
+ * used before its current deadline without exceeding its reserved bandwidth, start a new
+ * period now rather than letting it run on borrowed time */
+static void deadline_thread_wakeup(thread_t* t, zx_time_t now) {
+    if (now >= t->deadline_abs ||
+        (uint64_t)t->remaining_time_slice * (uint64_t)t->deadline_period >
+            (uint64_t)t->deadline_budget * (uint64_t)(t->deadline_abs - now)) {
+        replenish_deadline_thread(t, now);
+    }
+}
+
+/* insert a deadline class thread into |cpu|'s earliest deadline first queue */
+static void insert_in_deadline_queue(cpu_num_t cpu, thread_t* t) {
+    DEBUG_ASSERT(!list_in_list(&t->queue_node));
+    DEBUG_ASSERT(!t->deadline_throttled);
+
+    struct percpu* c = &percpu[cpu];
+    run_queue_lock(c);
+
+    thread_t* entry;
+    bool inserted = false;
+    list_for_every_entry (&c->deadline_queue, entry, thread_t, queue_node) {
+        if (t->deadline_abs < entry->deadline_abs) {
+            list_add_before(&entry->queue_node, &t->queue_node);
+            inserted = true;
+            break;
+        }
+    }
+    if (!inserted)
+        list_add_tail(&c->deadline_queue, &t->queue_node);
+    c->run_queue_count++;
+
+    run_queue_unlock(c);
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
 }
 
+/* park a deadline class thread that has run out of budget on the local cpu until its next
+ * period starts */
+static void throttle_deadline_thread(thread_t* t) {
+    DEBUG_ASSERT(thread_is_deadline(t));
+    DEBUG_ASSERT(!list_in_list(&t->queue_node));
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    struct percpu* c = &percpu[cpu];
+    zx_time_t now = current_time();
+
+    /* the next period starts one period after the current one did */
+    t->deadline_replenish = t->deadline_abs - t->deadline_relative + t->deadline_period;
+    if (t->deadline_replenish <= now) {
+        /* we are already into the next period, so there is nothing to wait for */
+        replenish_deadline_thread(t, now);
+        insert_in_deadline_queue(cpu, t);
+        t->curr_cpu = cpu;
+        return;
+    }
+
+    kcounter_add(sched_deadline_throttle_count, 1u);
+    LOCAL_KTRACE2("deadline_throttle", (uint32_t)t->user_tid, cpu);
+
+    t->curr_cpu = cpu;
+    t->deadline_throttled = true;
+
+    run_queue_lock(c);
+    thread_t* entry;
+    bool inserted = false;
+    list_for_every_entry (&c->deadline_throttled, entry, thread_t, queue_node) {
+        if (t->deadline_replenish < entry->deadline_replenish) {
+            list_add_before(&entry->queue_node, &t->queue_node);
+            inserted = true;
+            break;
+        }
+    }
+    if (!inserted)
+        list_add_tail(&c->deadline_throttled, &t->queue_node);
+    bool first = list_peek_head_type(&c->deadline_throttled, thread_t, queue_node) == t;
+    run_queue_unlock(c);
+
+    if (first)
+        timer_set_oneshot(&c->deadline_timer, t->deadline_replenish, deadline_replenish_tick,
+                          (void*)(uintptr_t)cpu);
+}
+
+/* pull the first throttled thread off |cpu|'s list if its budget is due back by |now| */
+static thread_t* pop_replenished_thread(cpu_num_t cpu, zx_time_t now, zx_time_t* next) {
+    struct percpu* c = &percpu[cpu];
+
+    run_queue_lock(c);
+    thread_t* t = list_peek_head_type(&c->deadline_throttled, thread_t, queue_node);
+    if (t && t->deadline_replenish <= now) {
+        list_delete(&t->queue_node);
+        t->deadline_throttled = false;
+    } else {
+        *next = t ? t->deadline_replenish : ZX_TIME_INFINITE;
+        t = NULL;
+    }
+    run_queue_unlock(c);
+
+    return t;
+}
+
+/* put a ready thread into |cpu|'s queues, or park it if it is a deadline class thread that
+ * has no budget left */
+static void insert_ready_thread(cpu_num_t cpu, thread_t* t) {
+    if (thread_is_deadline(t)) {
+        if (t->remaining_time_slice <= 0) {
+            throttle_deadline_thread(t);
+        } else {
+            insert_in_deadline_queue(cpu, t);
+        }
+    } else if (t->remaining_time_slice > 0) {
+        insert_in_run_queue_head(cpu, t);
+    } else {
+        insert_in_run_queue_tail(cpu, t);
+    }
+}
+
 static thread_t* sched_get_top_thread(cpu_num_t cpu) {
     /* pop the head of the highest priority queue with any threads
      * queued up on the passed in cpu.
      */
     struct percpu* c = &percpu[cpu];
+    run_queue_lock(c);
+
+    /* pick up anything woken onto this cpu whose ipi has not been handled yet */
+    drain_wakeup_queue_locked(c);
+
+    /* switch straight to a thread handed this cpu by its waker, unless something more urgent
+     * has been queued since, in which case it waits at the head of its queue instead */
+    thread_t* handed_off = c->handoff_thread;
+    if (handed_off) {
+        c->handoff_thread = NULL;
+        bool outranked = !list_is_empty(&c->deadline_queue);
+        if (!outranked && c->run_queue_bitmap) {
+            int highest_queue = HIGHEST_PRIORITY - __builtin_clz(c->run_queue_bitmap) -
+                                (int)(sizeof(c->run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
+            outranked = highest_queue > effec_priority(handed_off);
+        }
+        if (!outranked) {
+            run_queue_unlock(c);
+
+            DEBUG_ASSERT(handed_off->curr_cpu == cpu);
+            kcounter_add(sched_handoff_count, 1u);
+            LOCAL_KTRACE2("sched_get_top handoff", (uint32_t)handed_off->user_tid,
+                          handed_off->remaining_time_slice);
+
+            return handed_off;
+        }
+        add_to_run_queue_locked(c, handed_off, true);
+    }
+
+    /* deadline class threads run ahead of every fixed priority queue */
+    if (unlikely(!list_is_empty(&c->deadline_queue))) {
+        thread_t* newthread = list_remove_head_type(&c->deadline_queue, thread_t, queue_node);
+        c->run_queue_count--;
+        run_queue_unlock(c);
+
+        DEBUG_ASSERT(newthread->curr_cpu == cpu);
+        LOCAL_KTRACE2("sched_get_top deadline", (uint32_t)newthread->user_tid, newthread->remaining_time_slice);
+
+        return newthread;
+    }
+
     if (likely(c->run_queue_bitmap)) {
         uint highest_queue = HIGHEST_PRIORITY - __builtin_clz(c->run_queue_bitmap) -
                              (sizeof(c->run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
@@ -239,15 +717,98 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
         if (list_is_empty(&c->run_queue[highest_queue]))
             c->run_queue_bitmap &= ~(1u << highest_queue);
 
+        /* a freshly started idle thread is queued once, and never counted */
+        if (likely(!thread_is_idle(newthread)))
+            c->run_queue_count--;
+
+        run_queue_unlock(c);
+
         LOCAL_KTRACE2("sched_get_top", newthread->priority_boost, newthread->base_priority);
 
         return newthread;
     }
+    run_queue_unlock(c);
 
     /* no threads to run, select the idle thread for this cpu */
     return &c->idle_thread;
 }
 
+/* pull the highest priority thread that is allowed to run on |cpu| out of the busiest
+ * other cpu's run queue. returns NULL if there is nothing worth stealing.
+ */
+static thread_t* sched_steal_thread(cpu_num_t cpu) {
+    /* find the cpu with the most threads waiting to run, preferring ones that share a
+     * cache with us when queues are close in length */
+    cpu_mask_t candidates = mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+    cpu_num_t busiest = INVALID_CPU;
+    uint32_t busiest_score = 0;
+    while (candidates) {
+        cpu_num_t i = lowest_cpu_set(candidates);
+        candidates &= ~cpu_num_to_mask(i);
+
+        uint32_t count = percpu[i].run_queue_count;
+        if (count == 0)
+            continue;
+
+        uint32_t score = (count << SCHED_LOAD_SHIFT) + SCHED_MIGRATE_COST_REMOTE -
+                         migration_cost(i, cpu);
+        if (score > busiest_score) {
+            busiest = i;
+            busiest_score = score;
+        }
+    }
+    if (busiest == INVALID_CPU)
+        return NULL;
+
+    /* take the least recently queued thread at the highest priority that may run here */
+    struct percpu* c = &percpu[busiest];
+    thread_t* stolen = NULL;
+    run_queue_lock(c);
+    drain_wakeup_queue_locked(c);
+    uint32_t bitmap = c->run_queue_bitmap;
+    while (bitmap && !stolen) {
+        uint pri = HIGHEST_PRIORITY - __builtin_clz(bitmap) -
+                   (sizeof(bitmap) * CHAR_BIT - NUM_PRIORITIES);
+        bitmap &= ~(1u << pri);
+
+        thread_t* t;
+        list_for_every_entry (&c->run_queue[pri], t, thread_t, queue_node) {
+            if (t->cpu_affinity & cpu_num_to_mask(cpu)) {
+                list_delete(&t->queue_node);
+                c->run_queue_count--;
+                if (list_is_empty(&c->run_queue[pri]))
+                    c->run_queue_bitmap &= ~(1u << pri);
+                stolen = t;
+                break;
+            }
+        }
+    }
+    run_queue_unlock(c);
+
+    if (stolen) {
+        DEBUG_ASSERT(stolen->state == THREAD_READY);
+        DEBUG_ASSERT(stolen->curr_cpu == busiest);
+        stolen->curr_cpu = cpu;
+        kcounter_add(sched_steal_count, 1u);
+        LOCAL_KTRACE2("sched_steal", (uint32_t)stolen->user_tid, busiest);
+    }
+    return stolen;
+}
+
+/* if the local cpu has threads waiting behind the current one while other cpus sit idle,
+ * kick an idle cpu so it comes and steals one of them */
+static void kick_idle_cpu(cpu_num_t cpu) {
+    if (percpu[cpu].run_queue_count == 0)
+        return;
+
+    cpu_mask_t idle = mp_get_idle_mask() & mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+    if (idle == 0)
+        return;
+
+    kcounter_add(sched_idle_kick_count, 1u);
+    mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(lowest_cpu_set(idle)), 0);
+}
+
 void sched_block(void) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -262,12 +823,67 @@ void sched_block(void) {
     sched_resched_internal();
 }
 
+/* if the current thread asked for its next wakeup to be handed off, give |t| this cpu with
+ * whatever is left of the current thread's time slice. the scheduler switches straight to it
+ * the next time the current thread blocks or reschedules, without it passing through the run
+ * queue. this skips cpu selection and the ipi a remote wakeup would cost, and keeps both ends
+ * of a synchronous exchange on one cpu.
+ */
+static bool handoff_to_local_cpu(thread_t* t) {
+    thread_t* current_thread = get_current_thread();
+    if (likely(!current_thread->handoff_wakeup) || arch_in_int_handler())
+        return false;
+
+    /* only the first thread woken is handed off */
+    current_thread->handoff_wakeup = false;
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    if (!handoff || thread_is_deadline(t) || thread_is_deadline(current_thread) ||
+        !(t->cpu_affinity & cpu_num_to_mask(cpu)) || !mp_is_cpu_active(cpu))
+        return false;
+
+    struct percpu* c = &percpu[cpu];
+    run_queue_lock(c);
+    if (c->handoff_thread) {
+        /* the last thread handed off has not run yet, so this one takes the normal path */
+        run_queue_unlock(c);
+        return false;
+    }
+    t->curr_cpu = cpu;
+    c->handoff_thread = t;
+    run_queue_unlock(c);
+
+    /* real time threads have no time slice to lend */
+    if (!thread_is_real_time_or_idle(current_thread)) {
+        zx_duration_t ran = current_time() - current_thread->last_started_running;
+        zx_duration_t left = current_thread->remaining_time_slice -
+                             MIN(ran, current_thread->remaining_time_slice);
+        t->remaining_time_slice = MAX(t->remaining_time_slice, left);
+    }
+
+    LOCAL_KTRACE2("sched_handoff", (uint32_t)current_thread->user_tid, (uint32_t)t->user_tid);
+    return true;
+}
+
 /* find a cpu to run the thread on, put it in the run queue for that cpu, and accumulate a list
  * of cpus we'll need to reschedule, including the local cpu.
  */
 static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* accum_cpu_mask) {
-    /* find a core to run it on */
-    cpu_mask_t cpu = find_cpu_mask(t);
+    /* a deadline class thread with no budget left is not going to run anywhere until its next
+     * period, so there is no cpu to pick yet */
+    if (thread_is_deadline(t) && t->remaining_time_slice <= 0) {
+        throttle_deadline_thread(t);
+        return;
+    }
+
+    /* no reschedule: the handed off thread runs when the waker blocks or reschedules */
+    if (handoff_to_local_cpu(t))
+        return;
+
+    /* find a core to run it on. a deadline class thread only runs where its bandwidth is
+     * reserved */
+    cpu_mask_t cpu = thread_is_deadline(t) ? cpu_num_to_mask(deadline_home_cpu(t))
+                                           : find_cpu_mask(t);
     cpu_num_t cpu_num;
 
     DEBUG_ASSERT(cpu != 0);
@@ -280,10 +896,10 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* ac
     }
 
     t->curr_cpu = cpu_num;
-    if (t->remaining_time_slice > 0) {
-        insert_in_run_queue_head(cpu_num, t);
+    if (cpu_num != arch_curr_cpu_num() && !thread_is_deadline(t)) {
+        insert_in_wakeup_queue(cpu_num, t);
     } else {
-        insert_in_run_queue_tail(cpu_num, t);
+        insert_ready_thread(cpu_num, t);
     }
 }
 
@@ -296,6 +912,8 @@ bool sched_unblock(thread_t* t) {
 
     /* thread is being woken up, boost its priority */
     boost_thread(t);
+    if (thread_is_deadline(t))
+        deadline_thread_wakeup(t, current_time());
 
     /* stuff the new thread in the run queue */
     t->state = THREAD_READY;
@@ -325,6 +943,8 @@ bool sched_unblock_list(struct list_node* list) {
 
         /* thread is being woken up, boost its priority */
         boost_thread(t);
+        if (thread_is_deadline(t))
+            deadline_thread_wakeup(t, current_time());
 
         /* stuff the new thread in the run queue */
         t->state = THREAD_READY;
@@ -345,12 +965,19 @@ void sched_unblock_idle(thread_t* t) {
     DEBUG_ASSERT(t->cpu_affinity && (t->cpu_affinity & (t->cpu_affinity - 1)) == 0);
 
     /* idle thread is special case, just jam it into the cpu's run queue in the thread's
-     * affinity mask and mark it ready.
+     * affinity mask and mark it ready. it is not runnable work, so it is left out of
+     * run_queue_count and does not mark the cpu busy.
      */
     t->state = THREAD_READY;
     cpu_num_t cpu = lowest_cpu_set(t->cpu_affinity);
     t->curr_cpu = cpu;
-    insert_in_run_queue_head(cpu, t);
+
+    int ep = effec_priority(t);
+    struct percpu* c = &percpu[cpu];
+    run_queue_lock(c);
+    list_add_head(&c->run_queue[ep], &t->queue_node);
+    c->run_queue_bitmap |= (1u << ep);
+    run_queue_unlock(c);
 }
 
 /* the thread is voluntarily giving up its time slice */
@@ -371,7 +998,8 @@ void sched_yield(void) {
     if (local_migrate_if_needed(current_thread))
         return;
 
-    insert_in_run_queue_tail(arch_curr_cpu_num(), current_thread);
+    /* a deadline class thread yielding is done with this period */
+    insert_ready_thread(arch_curr_cpu_num(), current_thread);
     sched_resched_internal();
 }
 
@@ -393,16 +1021,16 @@ void sched_preempt(void) {
         if (current_thread->remaining_time_slice <= 0) {
             /* if we're out of quantum, deboost the thread and put it at the tail of a queue */
             deboost_thread(current_thread, true);
+
+            /* the quantum expiring is our periodic chance to spread queued work to idle cpus */
+            if (load_balance)
+                kick_idle_cpu(curr_cpu);
         }
 
         if (local_migrate_if_needed(current_thread))
             return;
 
-        if (current_thread->remaining_time_slice > 0) {
-            insert_in_run_queue_head(curr_cpu, current_thread);
-        } else {
-            insert_in_run_queue_tail(curr_cpu, current_thread);
-        }
+        insert_ready_thread(curr_cpu, current_thread);
     }
 
     sched_resched_internal();
@@ -435,11 +1063,7 @@ void sched_reschedule(void) {
         if (local_migrate_if_needed(current_thread))
             return;
 
-        if (current_thread->remaining_time_slice > 0) {
-            insert_in_run_queue_head(curr_cpu, current_thread);
-        } else {
-            insert_in_run_queue_tail(curr_cpu, current_thread);
-        }
+        insert_ready_thread(curr_cpu, current_thread);
     }
 
     sched_resched_internal();
@@ -473,6 +1097,17 @@ void sched_transition_off_cpu(cpu_num_t old_cpu) {
         DEBUG_ASSERT(!local_resched);
     }
 
+    // Throttled deadline threads would otherwise wait on this cpu's replenish timer, so
+    // hand them their budget back early and send them elsewhere.
+    timer_cancel(&percpu[old_cpu].deadline_timer);
+    zx_time_t now = current_time();
+    zx_time_t next;
+    while ((t = pop_replenished_thread(old_cpu, ZX_TIME_INFINITE, &next))) {
+        replenish_deadline_thread(t, now);
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+        DEBUG_ASSERT(!local_resched);
+    }
+
     if (accum_cpu_mask) {
         mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
     }
@@ -489,6 +1124,13 @@ static bool local_migrate_if_needed(thread_t* curr_thread) {
         migrate_current_thread(curr_thread);
         return true;
     }
+
+    /* a deadline class thread whose reservation was placed on another cpu moves there */
+    if (unlikely(thread_is_deadline(curr_thread) &&
+                 deadline_home_cpu(curr_thread) != curr_thread->curr_cpu)) {
+        migrate_current_thread(curr_thread);
+        return true;
+    }
     return false;
 }
 
@@ -526,17 +1168,9 @@ void sched_migrate(thread_t* t) {
             return;
         }
 
-        // it's sitting in a run queue somewhere, so pull it out of that one and find a new home
-        DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
-        list_delete(&t->queue_node);
-
-        DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
-
-        struct percpu* c = &percpu[t->curr_cpu];
-        int pri = effec_priority(t);
-        if (list_is_empty(&c->run_queue[pri])) {
-            c->run_queue_bitmap &= ~(1u << pri);
-        }
+        // it's sitting in a run queue somewhere, so pull it out of that one and find a new home,
+        // staying as close in the cache hierarchy to where it last ran as the new mask allows
+        remove_from_run_queue(t);
 
         find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
         break;
@@ -554,6 +1188,192 @@ void sched_migrate(thread_t* t) {
     }
 }
 
+/* move a thread in or out of the deadline scheduling class. a zero period returns it to the
+ * fixed priority class.
+ */
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t period, zx_duration_t budget,
+                               zx_duration_t deadline) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(!thread_is_idle(t));
+
+    /* no single thread may take more of a cpu than the whole class is allowed */
+    uint64_t new_bw = period ? deadline_bw(budget, period) : 0;
+    if (new_bw > SCHED_DEADLINE_MAX_CPU_BW)
+        return ZX_ERR_INVALID_ARGS;
+
+    /* admission control: the reservation is placed on the one cpu the thread will run on, and
+     * only if that cpu has room for it, or the guarantees made to the deadline threads
+     * already there would not hold */
+    bool was_deadline = thread_is_deadline(t);
+    uint64_t old_bw = was_deadline ? deadline_bw(t->deadline_budget, t->deadline_period) : 0;
+    if (was_deadline)
+        percpu[t->deadline_cpu].deadline_bw -= old_bw;
+
+    cpu_num_t cpu = INVALID_CPU;
+    if (period) {
+        cpu_num_t prefer = was_deadline ? t->deadline_cpu
+                           : t->state == THREAD_RUNNING ? t->curr_cpu
+                                                        : t->last_cpu;
+        cpu = deadline_pick_cpu(t->cpu_affinity, new_bw, prefer);
+        if (cpu == INVALID_CPU || percpu[cpu].deadline_bw + new_bw > SCHED_DEADLINE_MAX_CPU_BW) {
+            if (was_deadline)
+                percpu[t->deadline_cpu].deadline_bw += old_bw;
+            return ZX_ERR_NO_RESOURCES;
+        }
+        percpu[cpu].deadline_bw += new_bw;
+    }
+
+    /* pull the thread out of whatever queue it sits in while its class changes */
+    bool queued = (t->state == THREAD_READY);
+    if (queued)
+        remove_from_run_queue(t);
+
+    if (period) {
+        t->flags |= THREAD_FLAG_DEADLINE;
+        t->deadline_period = period;
+        t->deadline_budget = budget;
+        t->deadline_relative = deadline;
+        t->deadline_cpu = cpu;
+        t->priority_boost = 0;
+        replenish_deadline_thread(t, current_time());
+    } else {
+        t->flags &= ~THREAD_FLAG_DEADLINE;
+        t->deadline_period = 0;
+        t->deadline_budget = 0;
+        t->deadline_relative = 0;
+        t->deadline_abs = 0;
+        t->deadline_cpu = INVALID_CPU;
+        t->remaining_time_slice = 0;
+    }
+
+    bool local_resched = false;
+    cpu_mask_t accum_cpu_mask = 0;
+    if (queued) {
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+    } else if (t->state == THREAD_RUNNING) {
+        /* make whichever cpu it is running on reevaluate with the new parameters */
+        if (t == get_current_thread()) {
+            local_resched = true;
+        } else {
+            accum_cpu_mask = cpu_num_to_mask(t->curr_cpu);
+        }
+    }
+
+    if (accum_cpu_mask) {
+        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+    }
+    if (local_resched) {
+        sched_reschedule();
+    }
+
+    return ZX_OK;
+}
+
+/* timer that hands throttled deadline class threads their budget back at the start of their
+ * next period */
+static enum handler_return deadline_replenish_tick(timer_t* timer, zx_time_t now,
+                                                   void* arg) TA_NO_THREAD_SAFETY_ANALYSIS {
+    cpu_num_t cpu = (cpu_num_t)(uintptr_t)arg;
+
+    /* sched_transition_off_cpu may be cancelling this timer while holding the thread lock */
+    if (timer_trylock_or_cancel(timer, &thread_lock))
+        return INT_NO_RESCHEDULE;
+
+    bool local_resched = false;
+    cpu_mask_t accum_cpu_mask = 0;
+    zx_time_t next = ZX_TIME_INFINITE;
+    thread_t* t;
+    while ((t = pop_replenished_thread(cpu, now, &next))) {
+        replenish_deadline_thread(t, t->deadline_replenish);
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+    }
+
+    if (next != ZX_TIME_INFINITE)
+        timer_set_oneshot(timer, next, deadline_replenish_tick, arg);
+
+    if (accum_cpu_mask)
+        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+
+    spin_unlock(&thread_lock);
+
+    return local_resched ? INT_RESCHEDULE : INT_NO_RESCHEDULE;
+}
+
+/* how many owners deep priority inheritance is propagated. this also bounds the walk if
+ * userspace manages to build a cycle of futex owners. */
+#define SCHED_PI_MAX_CHAIN 32
+
+/* the priority a blocked thread lends to the owner of the lock it waits on. the wakeup boost
+ * is left out so that it does not leak into owners. */
+static int pi_donor_priority(const thread_t* t) {
+    return MAX(t->base_priority, t->inherited_priority);
+}
+
+void sched_pi_link(thread_t* waiter, thread_t* owner) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(waiter->pi_owner == NULL);
+    DEBUG_ASSERT(waiter != owner);
+
+    waiter->pi_owner = owner;
+    list_add_tail(&owner->pi_waiters, &waiter->pi_waiter_node);
+}
+
+thread_t* sched_pi_unlink(thread_t* waiter) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    thread_t* owner = waiter->pi_owner;
+    if (owner) {
+        list_delete(&waiter->pi_waiter_node);
+        waiter->pi_owner = NULL;
+    }
+    return owner;
+}
+
+/* recompute the priority |t| inherits from its waiters, and if it changed, carry that on to
+ * whatever |t| is itself blocked behind */
+bool sched_pi_recompute(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    bool local_resched = false;
+    cpu_mask_t accum_cpu_mask = 0;
+    cpu_num_t curr_cpu = arch_curr_cpu_num();
+
+    for (int depth = 0; t && depth < SCHED_PI_MAX_CHAIN; depth++) {
+        int pri = 0;
+        thread_t* waiter;
+        list_for_every_entry (&t->pi_waiters, waiter, thread_t, pi_waiter_node) {
+            pri = MAX(pri, pi_donor_priority(waiter));
+        }
+        if (pri == t->inherited_priority)
+            break;
+
+        LOCAL_KTRACE2("pi_inherit", (uint32_t)t->user_tid, pri);
+
+        if (t->state == THREAD_READY && !thread_is_deadline(t)) {
+            /* it is queued by its effective priority, so move it to its new queue */
+            cpu_num_t cpu = t->curr_cpu;
+            remove_from_run_queue(t);
+            t->inherited_priority = pri;
+            insert_ready_thread(cpu, t);
+
+            if (cpu == curr_cpu) {
+                local_resched = true;
+            } else {
+                accum_cpu_mask |= cpu_num_to_mask(cpu);
+            }
+        } else {
+            t->inherited_priority = pri;
+        }
+
+        t = t->pi_owner;
+    }
+
+    if (accum_cpu_mask)
+        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+
+    return local_resched;
+}
+
 /* preemption timer that is set whenever a thread is scheduled */
 static enum handler_return sched_timer_tick(timer_t* t, zx_time_t now, void* arg) {
     /* if the preemption timer went off on the idle or a real time thread, ignore it */
@@ -614,8 +1434,17 @@ void sched_resched_internal(void) {
     /* pick a new thread to run */
     thread_t* newthread = sched_get_top_thread(cpu);
 
+    /* rather than going idle, see if another cpu has work queued up that we can take */
+    if (load_balance && thread_is_idle(newthread) && mp_is_cpu_active(cpu)) {
+        thread_t* stolen = sched_steal_thread(cpu);
+        if (stolen)
+            newthread = stolen;
+    }
+
     DEBUG_ASSERT(newthread);
 
+    update_cpu_load(cpu, thread_is_idle(newthread));
+
     newthread->state = THREAD_RUNNING;
 
     thread_t* oldthread = current_thread;
@@ -635,8 +1464,22 @@ void sched_resched_internal(void) {
     oldthread->runtime_ns += old_runtime;
     oldthread->remaining_time_slice -= MIN(old_runtime, oldthread->remaining_time_slice);
 
-    /* set up quantum for the new thread if it was consumed */
-    if (newthread->remaining_time_slice == 0) {
+    if (thread_is_deadline(oldthread) && oldthread->state == THREAD_READY) {
+        /* a deadline class thread still waiting to run past its deadline has missed it */
+        if (now > oldthread->deadline_abs)
+            kcounter_add(sched_deadline_miss_count, 1u);
+
+        /* it was queued before its last stretch of runtime was charged, so if that used up
+         * the rest of its budget it has to wait for its next period instead */
+        if (oldthread->remaining_time_slice <= 0 && !oldthread->deadline_throttled) {
+            remove_from_run_queue(oldthread);
+            throttle_deadline_thread(oldthread);
+        }
+    }
+
+    /* set up quantum for the new thread if it was consumed. deadline class threads only
+     * get budget back when their period is replenished. */
+    if (newthread->remaining_time_slice == 0 && !thread_is_deadline(newthread)) {
         newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
     }
 
@@ -686,7 +1529,7 @@ void sched_resched_internal(void) {
                              cpu, oldthread, oldthread->name, newthread, newthread->name);
 
         /* make sure the time slice is reasonable */
-        DEBUG_ASSERT(newthread->remaining_time_slice > 0 && newthread->remaining_time_slice < ZX_SEC(1));
+        DEBUG_ASSERT(newthread->remaining_time_slice > 0 && newthread->remaining_time_slice <= ZX_SEC(1));
 
         /* use a special version of the timer set api that lets it reset an existing timer efficiently, given
          * that we cannot possibly race with our own timer because interrupts are disabled.
@@ -732,13 +1575,27 @@ void sched_resched_internal(void) {
         vmm_context_switch(oldthread->aspace, newthread->aspace);
     }
 
+    percpu[cpu].running_thread = newthread;
+
     /* do the low level context switch */
     final_context_switch(oldthread, newthread);
 }
 
 void sched_init_early(void) {
     /* initialize the run queues */
-    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        spin_lock_init(&percpu[cpu].run_queue_lock);
         for (unsigned int i = 0; i < NUM_PRIORITIES; i++)
             list_initialize(&percpu[cpu].run_queue[i]);
+        list_initialize(&percpu[cpu].wakeup_queue);
+        list_initialize(&percpu[cpu].deadline_queue);
+        list_initialize(&percpu[cpu].deadline_throttled);
+    }
+}
+
+static void sched_init(uint level) {
+    load_balance = cmdline_get_bool("kernel.sched.load-balance", true);
+    handoff = cmdline_get_bool("kernel.sched.handoff", true);
 }
+
+LK_INIT_HOOK(sched, sched_init, LK_INIT_LEVEL_THREADING);
@@ -71,6 +71,7 @@ static void thread_do_suspend(void);
 static void init_thread_struct(thread_t* t, const char* name) {
     memset(t, 0, sizeof(thread_t));
     t->magic = THREAD_MAGIC;
+    list_initialize(&t->pi_waiters);
     strlcpy(t->name, name, sizeof(t->name));
     wait_queue_init(&t->retcode_wait_queue);
 }
@@ -268,6 +269,52 @@ zx_status_t thread_set_real_time(thread_t* t) {
     return ZX_OK;
 }
 
+/**
+ * @brief Move a thread into or out of the deadline scheduling class
+ *
+ * Every |period| the thread is guaranteed |budget| worth of cpu time, delivered
+ * within |deadline| of the start of the period. A thread that uses up its budget
+ * is not run again until its next period. A |period| of zero returns the thread
+ * to normal priority based scheduling.
+ *
+ * @param t         Thread to change
+ * @param period    Length of each period
+ * @param budget    Cpu time guaranteed per period
+ * @param deadline  Time from the start of a period by which the budget is delivered
+ *
+ * @return ZX_OK on success, ZX_ERR_INVALID_ARGS if the budget is more of a cpu than
+ * any one thread may reserve, ZX_ERR_NO_RESOURCES if no cpu the thread may run on
+ * can guarantee the requested bandwidth.
+ */
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t period, zx_duration_t budget,
+                                zx_duration_t deadline) {
+    if (!t)
+        return ZX_ERR_INVALID_ARGS;
+
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    if (period != 0 &&
+        (budget <= 0 || budget > deadline || deadline > period || period > ZX_SEC(1)))
+        return ZX_ERR_INVALID_ARGS;
+
+    /* the idle threads and real time threads are outside of the scheduler's control */
+    if (thread_is_real_time_or_idle(t))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    THREAD_LOCK(state);
+    zx_status_t status;
+    if (t->state == THREAD_DEATH) {
+        status = ZX_ERR_BAD_STATE;
+    } else if (period == 0 && !thread_is_deadline(t)) {
+        status = ZX_OK;
+    } else {
+        status = sched_set_deadline(t, period, budget, deadline);
+    }
+    THREAD_UNLOCK(state);
+
+    return status;
+}
+
 /**
  * @brief  Make a suspended thread executable.
  *
@@ -494,6 +541,15 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread, int retcode
     current_thread->state = THREAD_DEATH;
     current_thread->retcode = retcode;
 
+    /* give back any bandwidth reserved by the deadline class */
+    if (thread_is_deadline(current_thread))
+        sched_set_deadline(current_thread, 0, 0, 0);
+
+    /* threads still lending us priority are waiting on a lock we will never release */
+    thread_t* waiter;
+    while ((waiter = list_peek_head_type(&current_thread->pi_waiters, thread_t, pi_waiter_node)))
+        sched_pi_unlink(waiter);
+
     /* if we're detached, then do our teardown here */
     if (current_thread->flags & THREAD_FLAG_DETACHED) {
         /* remove it from the master thread list */
@@ -827,6 +883,11 @@ void thread_reschedule(void) {
     THREAD_UNLOCK(state);
 }
 
+void thread_set_handoff_wakeup(bool handoff) {
+    /* only ever read back by the scheduler on behalf of this thread, on this cpu */
+    get_current_thread()->handoff_wakeup = handoff;
+}
+
 /* timer callback to wake up a sleeping thread */
 static enum handler_return thread_sleep_handler(timer_t* timer, zx_time_t now,
                                                 void* arg) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -1013,6 +1074,7 @@ void thread_init_early(void) {
 void thread_init(void) {
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
         timer_init(&percpu[i].preempt_timer);
+        timer_init(&percpu[i].deadline_timer);
     }
 }
 
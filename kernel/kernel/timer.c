@@ -28,7 +28,6 @@
 #include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
-#include <list.h>
 #include <malloc.h>
 #include <platform.h>
 #include <platform/timer.h>
@@ -43,118 +42,203 @@ void timer_init(timer_t* timer) {
     *timer = (timer_t)TIMER_INITIAL_VALUE(*timer);
 }
 
+// Treap priority of a timer.  A hash of its address is as good as a random
+// number for keeping the tree balanced, and needs no storage.
+static inline uint32_t timer_priority(const timer_t* timer) {
+    return (uint32_t)(((uint64_t)(uintptr_t)timer * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+// The timer following |timer| in its queue, or NULL if it is the last.
+static timer_t* timer_queue_next(const timer_t* timer) {
+    if (timer->right) {
+        timer_t* t = timer->right;
+        while (t->left)
+            t = t->left;
+        return t;
+    }
+    while (timer->parent && timer->parent->right == timer)
+        timer = timer->parent;
+    return timer->parent;
+}
+
+// Rotate |timer| up above its parent, preserving the order of the queue.
+static void timer_queue_rotate_up(struct timer_queue* queue, timer_t* timer) {
+    timer_t* parent = timer->parent;
+    timer_t* grandparent = parent->parent;
+
+    if (parent->left == timer) {
+        parent->left = timer->right;
+        if (timer->right)
+            timer->right->parent = parent;
+        timer->right = parent;
+    } else {
+        parent->right = timer->left;
+        if (timer->left)
+            timer->left->parent = parent;
+        timer->left = parent;
+    }
+    parent->parent = timer;
+
+    timer->parent = grandparent;
+    if (!grandparent)
+        queue->root = timer;
+    else if (grandparent->left == parent)
+        grandparent->left = timer;
+    else
+        grandparent->right = timer;
+}
+
+// Add |timer| to |queue| at its scheduled_time, after any timers already
+// scheduled for the same time.
+static void timer_queue_insert(struct timer_queue* queue, timer_t* timer) {
+    timer_t* parent = NULL;
+    timer_t** link = &queue->root;
+    bool is_head = true;
+
+    while (*link) {
+        parent = *link;
+        if (timer->scheduled_time < parent->scheduled_time) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            is_head = false;
+        }
+    }
+
+    timer->queue = queue;
+    timer->parent = parent;
+    timer->left = NULL;
+    timer->right = NULL;
+    *link = timer;
+
+    if (is_head)
+        queue->head = timer;
+
+    while (timer->parent && timer_priority(timer) > timer_priority(timer->parent))
+        timer_queue_rotate_up(queue, timer);
+}
+
+// Remove |timer| from the queue it is in.
+static void timer_queue_remove(timer_t* timer) {
+    struct timer_queue* queue = timer->queue;
+    DEBUG_ASSERT(queue);
+
+    if (queue->head == timer)
+        queue->head = timer_queue_next(timer);
+
+    // Push the timer down until it has at most one child, then splice it out.
+    while (timer->left && timer->right) {
+        timer_t* child = (timer_priority(timer->left) > timer_priority(timer->right))
+                             ? timer->left
+                             : timer->right;
+        timer_queue_rotate_up(queue, child);
+    }
+
+    timer_t* child = timer->left ? timer->left : timer->right;
+    if (child)
+        child->parent = timer->parent;
+    if (!timer->parent)
+        queue->root = child;
+    else if (timer->parent->left == timer)
+        timer->parent->left = child;
+    else
+        timer->parent->right = child;
+
+    timer->queue = NULL;
+    timer->parent = NULL;
+    timer->left = NULL;
+    timer->right = NULL;
+}
+
 static void insert_timer_in_queue(uint cpu, timer_t* timer,
                                   uint64_t early_slack, uint64_t late_slack) {
 
     DEBUG_ASSERT(arch_ints_disabled());
     LTRACEF("timer %p, cpu %u, scheduled %" PRIu64 "\n", timer, cpu, timer->scheduled_time);
 
+    struct timer_queue* queue = &percpu[cpu].timer_queue;
+
     zx_time_t earliest_deadline = timer->scheduled_time - early_slack;
     zx_time_t latest_deadline = timer->scheduled_time + late_slack;
 
+    // Only the timers immediately around the new one are candidates for
+    // coalescing: the latest one scheduled before it (|prev|) and the earliest
+    // one scheduled at or after it (|next|).
+    const timer_t* prev = NULL;
+    const timer_t* next = NULL;
+    for (const timer_t* t = queue->root; t;) {
+        if (t->scheduled_time < timer->scheduled_time) {
+            prev = t;
+            t = t->right;
+        } else {
+            next = t;
+            t = t->left;
+        }
+    }
+
     // For inserting the timer we consider several cases. In general we
-    // want to coalesce with the current timer unless we can prove that
-    // either that:
-    //  1- there is no slack overlap with current timer OR
-    //  2- the next timer is a better fit.
+    // want to coalesce with an existing timer unless we can prove that
+    // there is no slack overlap with either neighbor.
     //
     // In diagrams that follow
-    // - Let |e| be the current (existing) timer deadline
+    // - Let |p| be the previous timer deadline if any
     // - Let |t| be the deadline of the timer we are inserting
     // - Let |n| be the next timer deadline if any
-    // - Let |x| be the end of the list (not a timer)
     // - Let |(| and |)| the earliest_deadline and latest_deadline.
     //
-    timer_t* entry;
+    const timer_t* target = NULL;
 
-    list_for_every_entry (&percpu[cpu].timer_queue, entry, timer_t, node) {
-        if (entry->scheduled_time > latest_deadline) {
-            // New timer latest is earlier than the current timer.
-            // Just add upfront as is, without slack.
-            //
-            //   ---------t---)--e-------------------------------> time
-            //
-            timer->slack = 0ull;
-            list_add_before(&entry->node, &timer->node);
-            return;
-        }
-
-        if (entry->scheduled_time >= timer->scheduled_time) {
-            //  New timer slack overlaps and is to the left (or equal). We
-            //  coalesce with current by scheduling late.
-            //
-            //  --------(----t---e-)----------------------------> time
-            //
-            timer->slack = entry->scheduled_time - timer->scheduled_time;
-            timer->scheduled_time = entry->scheduled_time;
-            list_add_after(&entry->node, &timer->node);
-            return;
-        }
-
-        if (entry->scheduled_time < earliest_deadline) {
-            // new timer earliest is later than the current timer. This case
-            // is handled in a future iteration.
-            //
-            //   ----------------e--(---t-----------------------> time
-            //
-            continue;
-        }
-
-        // New timer is to the right of current timer and there is overlap
-        // with the current timer, but could the next timer (if any) be
-        // a better fit?
+    if (prev != NULL && prev->scheduled_time >= earliest_deadline) {
+        // There is slack overlap with the previous timer, but could the next
+        // timer (if any) be a better fit?
         //
-        //  -------------(--e---t-----?-------------------> time
+        //  -------------(--p---t-----?-------------------> time
         //
-
-        const timer_t* next =
-            list_next_type(&percpu[cpu].timer_queue, &entry->node, timer_t, node);
+        target = prev;
 
         if (next != NULL) {
-            if (next->scheduled_time <= timer->scheduled_time) {
-                // The new timer is to the right of the next timer. There is no
-                // chance the current timer is a better fit.
+            if (next->scheduled_time == timer->scheduled_time) {
+                // The next timer is due at exactly the same time, so
+                // coalesce with it with no adjustment.
                 //
-                //  -------------(--e---n---t----------------------> time
+                //  -------------(--p---t,n------------------------> time
                 //
-                continue;
-            }
-
-            if (next->scheduled_time < latest_deadline) {
+                target = next;
+            } else if (next->scheduled_time < latest_deadline) {
                 // There is slack overlap with the next timer, and also with the
-                // current timer. Which coalescing is a better match?
+                // previous timer. Which coalescing is a better match?
                 //
-                //  --------------(-e---t---n-)-----------------------> time
+                //  --------------(-p---t---n-)-----------------------> time
                 //
-                zx_duration_t delta_entry = timer->scheduled_time - entry->scheduled_time;
+                zx_duration_t delta_prev = timer->scheduled_time - prev->scheduled_time;
                 zx_duration_t delta_next = next->scheduled_time - timer->scheduled_time;
-                if (delta_next < delta_entry) {
-                    // New timer is closer to the next timer, handle it in the
-                    // next iteration.
-                    continue;
-                }
+                if (delta_next < delta_prev)
+                    target = next;
             }
         }
-
-        // Handles the remaining cases, note that there is overlap with
-        // the current timer.
+    } else if (next != NULL && next->scheduled_time <= latest_deadline) {
+        //  New timer slack overlaps the next timer only. We coalesce with it
+        //  by scheduling late.
         //
-        //  1- this is the last timer (next == NULL) or
-        //  2- there is no overlap with the next timer, or
-        //  3- there is overlap with both current and next but
-        //     current is closer.
+        //  --------(----t---n-)----------------------------> time
         //
-        //  So we coalesce by scheduling early.
+        target = next;
+    }
+
+    if (target != NULL) {
+        // Coalesce by adopting the target's deadline, which is early if it
+        // was the previous timer and late if it was the next.
+        timer->slack = target->scheduled_time - timer->scheduled_time;
+        timer->scheduled_time = target->scheduled_time;
+    } else {
+        // No overlap with either neighbor. Add as is, without slack.
         //
-        timer->slack = entry->scheduled_time - timer->scheduled_time;
-        timer->scheduled_time = entry->scheduled_time;
-        list_add_after(&entry->node, &timer->node);
-        return;
+        //   ---p----(---t---)--n----------------------------> time
+        //
+        timer->slack = 0ull;
     }
 
-    // Walked off the end of the list and there was no overlap.
-    timer->slack = 0ull;
-    list_add_tail(&percpu[cpu].timer_queue, &timer->node);
+    timer_queue_insert(queue, timer);
 }
 
 void timer_set(timer_t* timer, zx_time_t deadline,
@@ -166,8 +250,8 @@ void timer_set(timer_t* timer, zx_time_t deadline,
     DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
     DEBUG_ASSERT(mode <= TIMER_SLACK_EARLY);
 
-    if (list_in_list(&timer->node)) {
-        panic("timer %p already in list\n", timer);
+    if (timer->queue) {
+        panic("timer %p already in queue\n", timer);
     }
 
     zx_duration_t late_slack;
@@ -220,7 +304,7 @@ void timer_set(timer_t* timer, zx_time_t deadline,
 
     insert_timer_in_queue(cpu, timer, early_slack, late_slack);
 
-    if (list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node) == timer) {
+    if (percpu[cpu].timer_queue.head == timer) {
         /* we just modified the head of the timer queue */
         LTRACEF("setting new timer for %" PRIu64 " nsecs\n", deadline);
         platform_set_oneshot_timer(deadline);
@@ -252,8 +336,8 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
     }
 
     /* remove it from the queue if it was present */
-    if (list_in_list(&timer->node))
-        list_delete(&timer->node);
+    if (timer->queue)
+        timer_queue_remove(timer);
 
     /* set up the structure */
     timer->scheduled_time = deadline;
@@ -267,7 +351,7 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
 
     insert_timer_in_queue(cpu, timer, 0u, 0u);
 
-    if (list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node) == timer) {
+    if (percpu[cpu].timer_queue.head == timer) {
         /* we just modified the head of the timer queue */
         LTRACEF("setting new timer for %" PRIu64 " nsecs\n", deadline);
         platform_set_oneshot_timer(deadline);
@@ -305,14 +389,14 @@ bool timer_cancel(timer_t* timer) {
     bool callback_not_running;
 
     /* if the timer is in a queue, remove it and adjust hardware timers if needed */
-    if (list_in_list(&timer->node)) {
+    if (timer->queue) {
         callback_not_running = true;
 
         /* save a copy of the old head of the queue */
-        timer_t* oldhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer_t* oldhead = percpu[cpu].timer_queue.head;
 
         /* remove our timer from the queue */
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
         /* TODO(cpu): if  after removing |timer| there is one other single timer with
            the same scheduled_time and slack non-zero then it is possible to return
@@ -321,7 +405,7 @@ bool timer_cancel(timer_t* timer) {
         /* see if we've just modified the head of this cpu's timer queue */
         /* if we modified another cpu's queue, we'll just let it fire and sort itself out */
         if (unlikely(oldhead == timer)) {
-            timer_t* newhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+            timer_t* newhead = percpu[cpu].timer_queue.head;
             if (newhead) {
                 LTRACEF("setting new timer to %" PRIu64 "\n", newhead->scheduled_time);
                 platform_set_oneshot_timer(newhead->scheduled_time);
@@ -365,7 +449,7 @@ enum handler_return timer_tick(zx_time_t now) {
 
     for (;;) {
         /* see if there's an event to process */
-        timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer = percpu[cpu].timer_queue.head;
         if (likely(timer == 0))
             break;
         LTRACEF("next item on timer queue %p at %" PRIu64 " now %" PRIu64 " (%p, arg %p)\n",
@@ -378,7 +462,7 @@ enum handler_return timer_tick(zx_time_t now) {
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                          "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                          timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        timer_queue_remove(timer);
 
         /* mark the timer busy */
         timer->active_cpu = cpu;
@@ -408,7 +492,7 @@ enum handler_return timer_tick(zx_time_t now) {
     }
 
     /* reset the timer to the next event */
-    timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer = percpu[cpu].timer_queue.head;
     if (timer) {
         /* has to be the case or it would have fired already */
         DEBUG_ASSERT(timer->scheduled_time > now);
@@ -446,19 +530,19 @@ void timer_transition_off_cpu(uint old_cpu) {
     spin_lock_irqsave(&timer_lock, state);
     uint cpu = arch_curr_cpu_num();
 
-    timer_t* old_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer_t* old_head = percpu[cpu].timer_queue.head;
 
-    timer_t *entry = NULL, *tmp_entry = NULL;
+    timer_t* entry;
     /* Move all timers from old_cpu to this cpu */
-    list_for_every_entry_safe (&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
-        list_delete(&entry->node);
+    while ((entry = percpu[old_cpu].timer_queue.head) != NULL) {
+        timer_queue_remove(entry);
         // We lost the original asymmetric slack information so when we combine them
         // with the other timer queue they are not coalesced again.
         // TODO(cpu): figure how important this case is.
         insert_timer_in_queue(cpu, entry, 0u, 0u);
     }
 
-    timer_t* new_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer_t* new_head = percpu[cpu].timer_queue.head;
     if (new_head != NULL && new_head != old_head) {
         /* we just modified the head of the timer queue */
         LTRACEF("setting new timer for %" PRIu64 " nsecs\n", new_head->scheduled_time);
@@ -474,7 +558,7 @@ void timer_thaw_percpu(void) {
 
     uint cpu = arch_curr_cpu_num();
 
-    timer_t* t = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer_t* t = percpu[cpu].timer_queue.head;
     if (t) {
         LTRACEF("rescheduling timer for %" PRIu64 " nsecs\n", t->scheduled_time);
         platform_set_oneshot_timer(t->scheduled_time);
@@ -486,7 +570,8 @@ void timer_thaw_percpu(void) {
 void timer_queue_init(void) {
     timer_lock = SPIN_LOCK_INITIAL_VALUE;
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
-        list_initialize(&percpu[i].timer_queue);
+        percpu[i].timer_queue.root = NULL;
+        percpu[i].timer_queue.head = NULL;
     }
 }
 
@@ -504,7 +589,7 @@ static void dump_timer_queues(char* buf, size_t len) {
 
             timer_t* t;
             zx_time_t last = now;
-            list_for_every_entry (&percpu[i].timer_queue, t, timer_t, node) {
+            for (t = percpu[i].timer_queue.head; t; t = timer_queue_next(t)) {
                 zx_duration_t delta_now = (t->scheduled_time > now) ? (t->scheduled_time - now) : 0;
                 zx_duration_t delta_last = (t->scheduled_time > last) ? (t->scheduled_time - last) : 0;
                 ptr += snprintf(buf + ptr, len - ptr,
@@ -0,0 +1,82 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <kernel/align.h>
+#include <kernel/cpu.h>
+#include <kernel/spinlock.h>
+#include <sys/types.h>
+#include <zircon/thread_annotations.h>
+
+// A pool of fixed-size objects carved from chunks of kernel heap. Chunks are
+// added as needed, up to |max_count| objects, and are never given back to the
+// heap. Each cpu keeps a small cache of free objects, so an Alloc()/Free()
+// pair normally takes only an uncontended per-cpu spinlock; the shared depot
+// behind |lock_| is touched about once every kCpuCacheBatch objects.
+//
+// Alloc() and Free() may not be called from interrupt context.
+class SlabAllocator {
+public:
+    // |object_size| is rounded up to kAlignment. The slab grows by
+    // |chunk_count| objects at a time.
+    SlabAllocator(size_t object_size, size_t chunk_count, size_t max_count);
+
+    // Returns uninitialized storage for one object, or nullptr if |max_count|
+    // objects are in use or the heap is exhausted.
+    void* Alloc();
+    void Free(void* ptr);
+
+    size_t object_size() const { return object_size_; }
+
+    // The number of objects in use. Racy; only meant for diagnostics.
+    size_t DiagnosticCount();
+    // The number of free objects cached by |cpu|. Racy; only meant for
+    // diagnostics.
+    size_t DiagnosticCachedCount(cpu_num_t cpu);
+
+    static constexpr size_t kAlignment = 16u;
+    static constexpr size_t kCpuCacheBatch = 32u;
+    static constexpr size_t kCpuCacheMax = 2 * kCpuCacheBatch;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SlabAllocator);
+
+    struct FreeObject {
+        FreeObject* next;
+    };
+
+    struct CpuCache {
+        SpinLock lock;
+        FreeObject* head TA_GUARDED(lock) = nullptr;
+        size_t count TA_GUARDED(lock) = 0u;
+    } __CPU_ALIGN;
+
+    CpuCache& cache();
+
+    // Moves up to |count| free objects from the depot to a list returned in
+    // |head|, growing the slab if the depot is empty. Returns the number of
+    // objects moved.
+    size_t TakeBatch(size_t count, FreeObject** head);
+    // Gives the |count| objects starting at |head| back to the depot.
+    void ReturnBatch(FreeObject* head, size_t count);
+    bool GrowLocked() TA_REQ(lock_);
+    // Once the slab is full, takes a free object cached by any cpu.
+    FreeObject* StealCached();
+
+    const size_t object_size_;
+    const size_t chunk_count_;
+    const size_t max_count_;
+
+    CpuCache caches_[SMP_MAX_CPUS];
+
+    fbl::Mutex lock_;
+    FreeObject* depot_ TA_GUARDED(lock_) = nullptr;
+    size_t depot_count_ TA_GUARDED(lock_) = 0u;
+    size_t total_count_ TA_GUARDED(lock_) = 0u;
+};
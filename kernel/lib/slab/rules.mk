@@ -0,0 +1,18 @@
+# Copyright 2018 The Fuchsia Authors
+#
+# Use of this source code is governed by a MIT-style
+# license that can be found in the LICENSE file or at
+# https://opensource.org/licenses/MIT
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_DEPS := \
+    kernel/lib/fbl
+
+MODULE_SRCS := \
+	$(LOCAL_DIR)/slab.cpp \
+	$(LOCAL_DIR)/slab_tests.cpp
+
+include make/module.mk
@@ -0,0 +1,164 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/slab.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <kernel/auto_lock.h>
+#include <lib/heap.h>
+
+using fbl::AutoLock;
+
+SlabAllocator::SlabAllocator(size_t object_size, size_t chunk_count, size_t max_count)
+    : object_size_(fbl::round_up(fbl::max(object_size, sizeof(FreeObject)), kAlignment)),
+      chunk_count_(chunk_count), max_count_(max_count) {
+    DEBUG_ASSERT(chunk_count_ > 0u);
+    DEBUG_ASSERT(max_count_ % chunk_count_ == 0u);
+}
+
+SlabAllocator::CpuCache& SlabAllocator::cache() {
+    return caches_[arch_curr_cpu_num()];
+}
+
+void* SlabAllocator::Alloc() {
+    FreeObject* obj = nullptr;
+    {
+        CpuCache& c = cache();
+        AutoSpinLockIrqSave guard(&c.lock);
+        obj = c.head;
+        if (obj != nullptr) {
+            c.head = obj->next;
+            --c.count;
+            return obj;
+        }
+    }
+
+    FreeObject* batch = nullptr;
+    size_t count = TakeBatch(kCpuCacheBatch, &batch);
+    if (count == 0u)
+        return StealCached();
+
+    if (count > 1u) {
+        // Keep the rest of the batch on this cpu.
+        FreeObject* tail = batch->next;
+        while (tail->next != nullptr)
+            tail = tail->next;
+
+        CpuCache& c = cache();
+        AutoSpinLockIrqSave guard(&c.lock);
+        tail->next = c.head;
+        c.head = batch->next;
+        c.count += count - 1u;
+    }
+    return batch;
+}
+
+void SlabAllocator::Free(void* ptr) {
+    auto obj = static_cast<FreeObject*>(ptr);
+
+    FreeObject* spill = nullptr;
+    {
+        CpuCache& c = cache();
+        AutoSpinLockIrqSave guard(&c.lock);
+        obj->next = c.head;
+        c.head = obj;
+        if (++c.count <= kCpuCacheMax)
+            return;
+
+        // Hand a batch back to the depot, keeping the object just freed
+        // since it is the most likely to still be cache-hot.
+        spill = obj->next;
+        FreeObject* tail = spill;
+        for (size_t i = 1u; i < kCpuCacheBatch; ++i)
+            tail = tail->next;
+        obj->next = tail->next;
+        tail->next = nullptr;
+        c.count -= kCpuCacheBatch;
+    }
+    ReturnBatch(spill, kCpuCacheBatch);
+}
+
+size_t SlabAllocator::TakeBatch(size_t count, FreeObject** head) {
+    AutoLock al(&lock_);
+    if (depot_ == nullptr && !GrowLocked())
+        return 0u;
+
+    FreeObject* tail = depot_;
+    size_t taken = 1u;
+    while (taken < count && tail->next != nullptr) {
+        tail = tail->next;
+        ++taken;
+    }
+
+    *head = depot_;
+    depot_ = tail->next;
+    tail->next = nullptr;
+    depot_count_ -= taken;
+    return taken;
+}
+
+void SlabAllocator::ReturnBatch(FreeObject* head, size_t count) {
+    FreeObject* tail = head;
+    while (tail->next != nullptr)
+        tail = tail->next;
+
+    AutoLock al(&lock_);
+    tail->next = depot_;
+    depot_ = head;
+    depot_count_ += count;
+}
+
+bool SlabAllocator::GrowLocked() {
+    if (total_count_ == max_count_)
+        return false;
+
+    auto chunk = static_cast<uint8_t*>(memalign(kAlignment, chunk_count_ * object_size_));
+    if (chunk == nullptr)
+        return false;
+
+    for (size_t i = chunk_count_; i > 0u; --i) {
+        auto obj = reinterpret_cast<FreeObject*>(chunk + (i - 1u) * object_size_);
+        obj->next = depot_;
+        depot_ = obj;
+    }
+    depot_count_ += chunk_count_;
+    total_count_ += chunk_count_;
+    return true;
+}
+
+SlabAllocator::FreeObject* SlabAllocator::StealCached() {
+    for (auto& c : caches_) {
+        AutoSpinLockIrqSave guard(&c.lock);
+        FreeObject* obj = c.head;
+        if (obj != nullptr) {
+            c.head = obj->next;
+            --c.count;
+            return obj;
+        }
+    }
+    return nullptr;
+}
+
+size_t SlabAllocator::DiagnosticCachedCount(cpu_num_t cpu) {
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+    CpuCache& c = caches_[cpu];
+    AutoSpinLockIrqSave guard(&c.lock);
+    return c.count;
+}
+
+size_t SlabAllocator::DiagnosticCount() {
+    size_t cached = 0u;
+    for (auto& c : caches_) {
+        AutoSpinLockIrqSave guard(&c.lock);
+        cached += c.count;
+    }
+
+    AutoLock al(&lock_);
+    return total_count_ - depot_count_ - cached;
+}
@@ -0,0 +1,164 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/slab.h>
+
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <stdlib.h>
+#include <unittest.h>
+
+// The slabs below never give their chunks back to the heap, so each test
+// keeps them small.
+
+namespace {
+
+constexpr size_t kBatch = SlabAllocator::kCpuCacheBatch;
+constexpr size_t kCacheMax = SlabAllocator::kCpuCacheMax;
+
+// Keeps the current thread on |cpu| until it goes out of scope, so that the
+// per-cpu cache it uses stays the same.
+class AutoPinCpu {
+public:
+    explicit AutoPinCpu(cpu_num_t cpu)
+        : thread_(get_current_thread()), old_affinity_(thread_->cpu_affinity) {
+        thread_set_cpu_affinity(thread_, cpu_num_to_mask(cpu));
+    }
+    ~AutoPinCpu() { thread_set_cpu_affinity(thread_, old_affinity_); }
+
+private:
+    thread_t* const thread_;
+    const cpu_mask_t old_affinity_;
+};
+
+// An empty cache is refilled with a whole batch from the depot, and keeps
+// everything but the object handed out.
+bool cpu_cache_refill_test(void* context) {
+    BEGIN_TEST;
+    const cpu_num_t cpu = arch_curr_cpu_num();
+    AutoPinCpu pin(cpu);
+
+    SlabAllocator slab(sizeof(uint64_t), kBatch * 2, kBatch * 4);
+    EXPECT_EQ(SlabAllocator::kAlignment, slab.object_size(), "size rounded up\n");
+
+    void* objs[kBatch + 1];
+    objs[0] = slab.Alloc();
+    REQUIRE_NONNULL(objs[0], "alloc\n");
+    EXPECT_EQ(kBatch - 1, slab.DiagnosticCachedCount(cpu), "rest of the batch cached\n");
+    EXPECT_EQ(1u, slab.DiagnosticCount(), "in use\n");
+
+    for (size_t i = 1; i < kBatch; i++) {
+        objs[i] = slab.Alloc();
+        REQUIRE_NONNULL(objs[i], "alloc\n");
+        EXPECT_TRUE(IS_ALIGNED(objs[i], SlabAllocator::kAlignment), "alignment\n");
+    }
+    EXPECT_EQ(0u, slab.DiagnosticCachedCount(cpu), "batch used up\n");
+
+    objs[kBatch] = slab.Alloc();
+    REQUIRE_NONNULL(objs[kBatch], "alloc\n");
+    EXPECT_EQ(kBatch - 1, slab.DiagnosticCachedCount(cpu), "second batch cached\n");
+    EXPECT_EQ(kBatch + 1, slab.DiagnosticCount(), "in use\n");
+
+    // the object freed last is the first handed out again
+    slab.Free(objs[kBatch]);
+    EXPECT_EQ(objs[kBatch], slab.Alloc(), "freed object reused\n");
+
+    for (void* obj : objs)
+        slab.Free(obj);
+    EXPECT_EQ(0u, slab.DiagnosticCount(), "in use after free\n");
+    END_TEST;
+}
+
+// A cache that grows past kCpuCacheMax hands a batch back to the depot.
+bool cpu_cache_spill_test(void* context) {
+    BEGIN_TEST;
+    const cpu_num_t cpu = arch_curr_cpu_num();
+    AutoPinCpu pin(cpu);
+
+    static constexpr size_t kCount = kCacheMax + kBatch;
+    SlabAllocator slab(sizeof(uint64_t), kBatch, kCount);
+
+    void* objs[kCount];
+    for (size_t i = 0; i < kCount; i++) {
+        objs[i] = slab.Alloc();
+        REQUIRE_NONNULL(objs[i], "alloc\n");
+    }
+    EXPECT_EQ(0u, slab.DiagnosticCachedCount(cpu), "cache used up\n");
+
+    for (size_t i = 0; i < kCount; i++) {
+        slab.Free(objs[i]);
+        size_t cached = slab.DiagnosticCachedCount(cpu);
+        EXPECT_LE(cached, kCacheMax, "cache over its limit\n");
+        if (i + 1 == kCacheMax + 1)
+            EXPECT_EQ(kCacheMax + 1 - kBatch, cached, "batch spilled\n");
+    }
+    EXPECT_EQ(kCacheMax, slab.DiagnosticCachedCount(cpu), "cached after free\n");
+    EXPECT_EQ(0u, slab.DiagnosticCount(), "in use after free\n");
+
+    // the spilled batch went back to the depot, so the slab is whole again
+    for (size_t i = 0; i < kCount; i++) {
+        objs[i] = slab.Alloc();
+        REQUIRE_NONNULL(objs[i], "alloc after spill\n");
+    }
+    EXPECT_NULL(slab.Alloc(), "alloc past max_count\n");
+    for (void* obj : objs)
+        slab.Free(obj);
+    END_TEST;
+}
+
+// Once the slab has grown to |max_count|, allocations fail unless another
+// cpu has free objects cached, which are stolen one at a time.
+bool exhaustion_test(void* context) {
+    BEGIN_TEST;
+    const cpu_num_t cpu = arch_curr_cpu_num();
+    AutoPinCpu pin(cpu);
+
+    static constexpr size_t kCount = kBatch * 2;
+    SlabAllocator slab(sizeof(uint64_t), kBatch, kCount);
+
+    void* objs[kCount];
+    for (size_t i = 0; i < kCount; i++) {
+        objs[i] = slab.Alloc();
+        REQUIRE_NONNULL(objs[i], "alloc\n");
+    }
+    EXPECT_NULL(slab.Alloc(), "alloc past max_count\n");
+    EXPECT_EQ(kCount, slab.DiagnosticCount(), "in use\n");
+
+    for (void* obj : objs)
+        slab.Free(obj);
+    EXPECT_EQ(kCount, slab.DiagnosticCachedCount(cpu), "all cached on this cpu\n");
+
+    const cpu_mask_t others = mp_get_online_mask() & ~cpu_num_to_mask(cpu);
+    if (others == 0) {
+        unittest_printf("only one cpu online, stealing not checked\n");
+    } else {
+        const cpu_num_t other = lowest_cpu_set(others);
+        AutoPinCpu pin_other(other);
+
+        for (size_t i = 0; i < kCount; i++) {
+            objs[i] = slab.Alloc();
+            REQUIRE_NONNULL(objs[i], "alloc stolen from another cpu\n");
+        }
+        EXPECT_NULL(slab.Alloc(), "alloc past max_count\n");
+        EXPECT_EQ(0u, slab.DiagnosticCachedCount(cpu), "all stolen\n");
+        EXPECT_EQ(0u, slab.DiagnosticCachedCount(other), "none cached by the thief\n");
+
+        for (void* obj : objs)
+            slab.Free(obj);
+    }
+    EXPECT_EQ(0u, slab.DiagnosticCount(), "in use after free\n");
+    END_TEST;
+}
+
+} // namespace
+
+#define SLAB_UNITTEST(fname) UNITTEST(#fname, fname)
+
+UNITTEST_START_TESTCASE(slab_tests)
+SLAB_UNITTEST(cpu_cache_refill_test)
+SLAB_UNITTEST(cpu_cache_spill_test)
+SLAB_UNITTEST(exhaustion_test)
+UNITTEST_END_TESTCASE(slab_tests, "slab", "Slab allocator test", nullptr, nullptr);
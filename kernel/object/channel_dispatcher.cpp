@@ -13,6 +13,7 @@
 #include <trace.h>
 
 #include <kernel/event.h>
+#include <kernel/thread.h>
 #include <platform.h>
 #include <object/handle.h>
 #include <object/message_packet.h>
@@ -71,6 +72,7 @@ ChannelDispatcher::~ChannelDispatcher() {
 
     messages_.clear();
     message_count_ = 0;
+    message_bytes_ = 0;
 }
 
 zx_status_t ChannelDispatcher::add_observer(StateObserver* observer) {
@@ -156,6 +158,7 @@ zx_status_t ChannelDispatcher::Read(uint32_t* msg_size,
 
     *msg = messages_.pop_front();
     message_count_--;
+    message_bytes_ -= (*msg)->allocated_size();
 
     if (messages_.is_empty())
         UpdateState(ZX_CHANNEL_READABLE, 0u);
@@ -178,7 +181,7 @@ zx_status_t ChannelDispatcher::Write(fbl::unique_ptr<MessagePacket> msg) {
         other = other_;
     }
 
-    if (other->WriteSelf(fbl::move(msg)) > 0)
+    if (other->WriteSelf(fbl::move(msg), false) > 0)
         thread_reschedule();
 
     return ZX_OK;
@@ -216,8 +219,10 @@ zx_status_t ChannelDispatcher::Call(fbl::unique_ptr<MessagePacket> msg,
         waiters_.push_back(waiter);
     }
 
-    // (1) Write outbound message to opposing endpoint.
-    other->WriteSelf(fbl::move(msg));
+    // (1) Write outbound message to opposing endpoint. We are about to block
+    // waiting for the reply, so let this cpu switch straight to the server
+    // thread this wakes rather than wait for another cpu to get around to it.
+    other->WriteSelf(fbl::move(msg), true);
 
     // Reuse the code from the half-call used for retrying a Call after thread
     // suspend.
@@ -259,7 +264,7 @@ zx_status_t ChannelDispatcher::ResumeInterruptedCall(MessageWaiter* waiter,
     return status;
 }
 
-int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
+int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg, bool handoff) {
     canary_.Assert();
 
     AutoLock lock(&lock_);
@@ -279,10 +284,16 @@ int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
             }
         }
     }
+    message_bytes_ += msg->allocated_size();
     messages_.push_back(fbl::move(msg));
     message_count_++;
 
+    // bracket no more than the wakeup of a thread waiting to read the message
+    if (handoff)
+        thread_set_handoff_wakeup(true);
     UpdateState(0u, ZX_CHANNEL_READABLE);
+    if (handoff)
+        thread_set_handoff_wakeup(false);
     return 0;
 }
 
@@ -340,7 +351,13 @@ int ChannelDispatcher::MessageWaiter::Deliver(fbl::unique_ptr<MessagePacket> msg
 
     msg_ = fbl::move(msg);
     status_ = ZX_OK;
-    return event_.Signal(ZX_OK);
+
+    // The writer reschedules as soon as this returns a wakeup, so hand it the
+    // caller and let this cpu switch straight to it.
+    thread_set_handoff_wakeup(true);
+    int woken = event_.Signal(ZX_OK);
+    thread_set_handoff_wakeup(false);
+    return woken;
 }
 
 int ChannelDispatcher::MessageWaiter::Cancel(zx_status_t status) {
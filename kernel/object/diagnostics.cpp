@@ -13,6 +13,7 @@
 #include <lib/console.h>
 #include <lib/ktrace.h>
 #include <fbl/auto_lock.h>
+#include <object/channel_dispatcher.h>
 #include <object/handle.h>
 #include <object/job_dispatcher.h>
 #include <object/port_dispatcher.h>
@@ -60,7 +61,7 @@ static void DumpProcessListKeyMap() {
 }
 
 static const char* ObjectTypeToString(zx_obj_type_t type) {
-    static_assert(ZX_OBJ_TYPE_LAST == 24, "need to update switch below");
+    static_assert(ZX_OBJ_TYPE_LAST == 25, "need to update switch below");
 
     switch (type) {
         case ZX_OBJ_TYPE_PROCESS: return "process";
@@ -82,6 +83,7 @@ static const char* ObjectTypeToString(zx_obj_type_t type) {
         case ZX_OBJ_TYPE_VCPU: return "vcpu";
         case ZX_OBJ_TYPE_TIMER: return "timer";
         case ZX_OBJ_TYPE_IOMMU: return "iommu";
+        case ZX_OBJ_TYPE_PAGER: return "pager";
         default: return "???";
     }
 }
@@ -170,8 +172,13 @@ void DumpProcessHandles(zx_koid_t id) {
     uint32_t total = 0;
     pd->ForEachHandle([&](zx_handle_t handle, zx_rights_t rights,
                           const Dispatcher* disp) {
-        printf("%9x %7" PRIu64 " : %s\n",
+        printf("%9x %7" PRIu64 " : %s",
             handle, disp->get_koid(), ObjectTypeToString(disp->get_type()));
+        if (auto chan = DownCastDispatcher<const ChannelDispatcher>(disp)) {
+            printf(" (%" PRIu64 " msgs, %zu bytes)",
+                   chan->DiagnosticMessageCount(), chan->DiagnosticMessageBytes());
+        }
+        printf("\n");
         ++total;
         return ZX_OK;
     });
@@ -9,6 +9,8 @@
 #include <assert.h>
 #include <lib/user_copy/user_ptr.h>
 #include <fbl/auto_lock.h>
+#include <kernel/sched.h>
+#include <object/process_dispatcher.h>
 #include <object/thread_dispatcher.h>
 #include <trace.h>
 #include <zircon/types.h>
@@ -61,11 +63,16 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     node = thread->futex_node();
     node->set_hash_key(futex_key);
     node->SetAsSingletonList();
+    node->SetPiWaiter(nullptr, ZX_HANDLE_INVALID);
 
+    return BlockNodeLocked(node, deadline);
+}
+
+zx_status_t FutexContext::BlockNodeLocked(FutexNode* node, zx_time_t deadline) {
     QueueNodesLocked(node);
 
     // Block current thread.  This releases lock_ and does not reacquire it.
-    result = node->BlockThread(&lock_, deadline);
+    zx_status_t result = node->BlockThread(&lock_, deadline);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node->IsInQueue());
         // All the work necessary for removing us from the hash table was done by FutexWake()
@@ -202,6 +209,133 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
     return ZX_OK;
 }
 
+zx_status_t FutexContext::FutexWaitPi(user_in_ptr<const int> value_ptr, int current_value,
+                                      zx_handle_t self, zx_time_t deadline) {
+    LTRACE_ENTRY;
+
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    // Waiting only makes sense once the owner knows to hand the futex off.
+    if (!(current_value & ZX_FUTEX_PI_WAITERS))
+        return ZX_ERR_INVALID_ARGS;
+    zx_handle_t owner_handle = static_cast<zx_handle_t>(current_value & ~ZX_FUTEX_PI_WAITERS);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    ThreadDispatcher* thread = ThreadDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> self_thread;
+    zx_status_t result = up->GetDispatcher(self, &self_thread);
+    if (result != ZX_OK)
+        return result;
+    if (self_thread.get() != thread)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<ThreadDispatcher> owner;
+    result = up->GetDispatcher(owner_handle, &owner);
+    if (result != ZX_OK)
+        return result;
+    if (owner.get() == thread)
+        return ZX_ERR_BAD_STATE;
+
+    // As in FutexWait(), checking the value and queueing must be atomic with
+    // respect to FutexWakePi().
+    lock_.Acquire();
+
+    int value;
+    result = value_ptr.copy_from_user(&value);
+    if (result != ZX_OK) {
+        lock_.Release();
+        return result;
+    }
+    if (value != current_value) {
+        lock_.Release();
+        return ZX_ERR_BAD_STATE;
+    }
+
+    FutexNode* node = thread->futex_node();
+    node->set_hash_key(futex_key);
+    node->SetAsSingletonList();
+    node->SetPiWaiter(get_current_thread(), self);
+
+    {
+        // Lend our priority to the owner.  An owner that has already exited has
+        // nothing to lend it to; it will never hand the futex off either, so that
+        // is left for the deadline to sort out.
+        AutoThreadLock lock;
+        thread_t* owner_thread = owner->kernel_thread();
+        if (owner_thread->state != THREAD_DEATH) {
+            sched_pi_link(get_current_thread(), owner_thread);
+            sched_pi_recompute(owner_thread);
+        }
+    }
+
+    return BlockNodeLocked(node, deadline);
+}
+
+zx_status_t FutexContext::FutexWakePi(user_inout_ptr<int> value_ptr) {
+    LTRACE_ENTRY;
+
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    AutoLock lock(&lock_);
+
+    // Only the owner named in the futex word may release it.
+    int value;
+    zx_status_t result = value_ptr.copy_from_user(&value);
+    if (result != ZX_OK)
+        return result;
+    zx_handle_t owner_handle = static_cast<zx_handle_t>(value & ~ZX_FUTEX_PI_WAITERS);
+    fbl::RefPtr<ThreadDispatcher> owner;
+    if (ProcessDispatcher::GetCurrent()->GetDispatcher(owner_handle, &owner) != ZX_OK ||
+        owner.get() != ThreadDispatcher::GetCurrent())
+        return ZX_ERR_ACCESS_DENIED;
+
+    FutexNode* head = futex_table_.erase(futex_key);
+    if (!head) {
+        // nobody to hand off to, so the futex is simply unlocked
+        return value_ptr.copy_to_user(0);
+    }
+
+    FutexNode* next;
+    {
+        AutoThreadLock thread_lock;
+        next = FutexNode::FindHighestPriorityPiWaiter(head);
+    }
+
+    int new_value = static_cast<int>(next->pi_self());
+    if (!head->IsSingletonList())
+        new_value |= ZX_FUTEX_PI_WAITERS;
+    result = value_ptr.copy_to_user(new_value);
+    if (result != ZX_OK) {
+        futex_table_.insert(head);
+        return result;
+    }
+
+    // The waiters left behind lend their priority to the new owner.  This has to
+    // happen before it is woken, since it may run and exit right away.
+    if (next->pi_thread()) {
+        AutoThreadLock thread_lock;
+        FutexNode::SetPiOwner(head, next->pi_thread());
+    }
+
+    bool any_woken = false;
+    FutexNode* remaining = FutexNode::WakeNode(head, next, &any_woken);
+
+    if (remaining)
+        futex_table_.insert(remaining);
+
+    if (any_woken) {
+        lock.release();
+        thread_reschedule();
+    }
+
+    return ZX_OK;
+}
+
 void FutexContext::QueueNodesLocked(FutexNode* head) {
     DEBUG_ASSERT(lock_.IsHeld());
 
@@ -235,5 +369,7 @@ bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
     FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
     if (new_head)
         futex_table_.insert(new_head);
+
+    node->ReleasePiOwner();
     return true;
 }
@@ -8,7 +8,9 @@
 
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/mutex.h>
+#include <kernel/sched.h>
 #include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
@@ -109,6 +111,18 @@ FutexNode* FutexNode::WakeThreads(FutexNode* node, uint32_t count,
     return node;
 }
 
+FutexNode* FutexNode::WakeNode(FutexNode* list_head, FutexNode* node, bool* out_any_woken) {
+    list_head = RemoveNodeFromList(list_head, node);
+    node->set_hash_key(0);
+
+    // This call can cause |node| to be freed, so we must not dereference
+    // |node| after this.
+    if (node->WakeThread())
+        *out_any_woken = true;
+
+    return list_head;
+}
+
 // This removes up to |count| nodes from |list_head|.  It returns the new
 // list head (i.e. the list of remaining nodes), which may be null (empty).
 // On return, |list_head| is the list of nodes that were removed --
@@ -184,6 +198,7 @@ bool FutexNode::WakeThread() {
 
     // We must do this before we wake the thread, to handle case 2.
     MarkAsNotInQueue();
+    ReleasePiOwner();
 
     // Place the waiting thread in the runnable state, but do not
     // reschedule yet.  Our caller is currently holding the main
@@ -196,6 +211,66 @@ bool FutexNode::WakeThread() {
     return wait_queue_wake_one(&wait_queue_, /* reschedule */ false, ZX_OK);
 }
 
+void FutexNode::ReleasePiOwner() {
+    if (!pi_thread_)
+        return;
+
+    {
+        AutoThreadLock lock;
+        thread_t* owner = sched_pi_unlink(pi_thread_);
+        if (owner)
+            sched_pi_recompute(owner);
+    }
+
+    // The wait is over, so later handoffs and boosts must not find this node.
+    SetPiWaiter(nullptr, ZX_HANDLE_INVALID);
+}
+
+FutexNode* FutexNode::FindHighestPriorityPiWaiter(FutexNode* list_head) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    // Ties go to the longest waiter, which is the one nearest the head.
+    FutexNode* best = list_head;
+    int best_priority = -1;
+    FutexNode* node = list_head;
+    do {
+        if (node->pi_thread_) {
+            // This matches the priority the thread lends to the owner, which leaves
+            // out any wakeup boost.
+            int priority = fbl::max(node->pi_thread_->base_priority,
+                                    node->pi_thread_->inherited_priority);
+            if (priority > best_priority) {
+                best = node;
+                best_priority = priority;
+            }
+        }
+        node = node->queue_next_;
+    } while (node != list_head);
+
+    return best;
+}
+
+void FutexNode::SetPiOwner(FutexNode* list_head, thread_t* owner) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    thread_t* old_owner = nullptr;
+    FutexNode* node = list_head;
+    do {
+        if (node->pi_thread_ && node->pi_thread_ != owner) {
+            thread_t* prev = sched_pi_unlink(node->pi_thread_);
+            if (prev != old_owner && old_owner)
+                sched_pi_recompute(old_owner);
+            old_owner = prev;
+            sched_pi_link(node->pi_thread_, owner);
+        }
+        node = node->queue_next_;
+    } while (node != list_head);
+
+    if (old_owner)
+        sched_pi_recompute(old_owner);
+    sched_pi_recompute(owner);
+}
+
 // Set |node1| and |node2|'s list pointers so that |node1| is immediately
 // before |node2| in the linked list.
 void FutexNode::RelinkAsAdjacent(FutexNode* node1, FutexNode* node2) {
@@ -26,6 +26,8 @@
 #include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 
+#include <vm/vm_object_paged.h>
+
 #include <fbl/function.h>
 
 #include <zircon/types.h>
@@ -122,6 +124,17 @@ private:
 // Called from a dedicated kernel thread when the system is low on memory.
 static void oom_lowmem(size_t shortfall_bytes) {
     printf("OOM: oom_lowmem(shortfall_bytes=%zu) called\n", shortfall_bytes);
+
+    // Caches that can regenerate their contents go before any job does.
+    const size_t shortfall_pages = ROUNDUP_PAGE_SIZE(shortfall_bytes) / PAGE_SIZE;
+    const size_t discarded_pages = VmObjectPaged::EvictDiscardable(shortfall_pages);
+    if (discarded_pages > 0) {
+        printf("OOM: discarded %zu pages of discardable VMOs\n", discarded_pages);
+    }
+    if (discarded_pages >= shortfall_pages) {
+        return;
+    }
+
     printf("OOM: Process mapped committed bytes:\n");
     DumpProcessMemoryUsage("OOM:   ", /*min_pages=*/8 * MB / PAGE_SIZE);
     printf("OOM: Finding a job to kill...\n");
@@ -182,7 +195,6 @@ static void object_glue_init(uint level) TA_NO_THREAD_SAFETY_ANALYSIS {
     Handle::Init();
     root_job = JobDispatcher::CreateRootJob();
     policy_manager = PolicyManager::Create();
-    PortDispatcher::Init();
     // Be sure to update kernel_cmdline.md if any of these defaults change.
     oom_init(cmdline_get_bool("kernel.oom.enable", true),
              ZX_SEC(cmdline_get_uint64("kernel.oom.sleep-sec", 1)),
@@ -35,6 +35,15 @@ public:
 
     void on_zero_handles() final;
 
+    // The number of messages queued on this endpoint and the kernel memory
+    // backing them. Racy; only meant for diagnostics.
+    uint64_t DiagnosticMessageCount() const TA_NO_THREAD_SAFETY_ANALYSIS {
+        return message_count_;
+    }
+    size_t DiagnosticMessageBytes() const TA_NO_THREAD_SAFETY_ANALYSIS {
+        return message_bytes_;
+    }
+
     // Read from this endpoint's message queue.
     // |msg_size| and |msg_handle_count| are in-out parameters. As input, they specify the maximum
     // size and handle count, respectively. On ZX_OK or ZX_ERR_BUFFER_TOO_SMALL, they specify the
@@ -100,7 +109,9 @@ private:
 
     ChannelDispatcher();
     void Init(fbl::RefPtr<ChannelDispatcher> other);
-    int WriteSelf(fbl::unique_ptr<MessagePacket> msg);
+    // |handoff| lends this cpu to the thread woken to read |msg|, for a writer
+    // about to block. A caller woken by a reply is always handed this cpu.
+    int WriteSelf(fbl::unique_ptr<MessagePacket> msg, bool handoff);
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
     void OnPeerZeroHandles();
 
@@ -109,6 +120,8 @@ private:
     fbl::Mutex lock_;
     MessageList messages_ TA_GUARDED(lock_);
     uint64_t message_count_ TA_GUARDED(lock_) = 0;
+    // Sum of allocated_size() over |messages_|.
+    size_t message_bytes_ TA_GUARDED(lock_) = 0;
     WaiterList waiters_ TA_GUARDED(lock_);
     fbl::RefPtr<ChannelDispatcher> other_ TA_GUARDED(lock_);
     zx_koid_t other_koid_ TA_GUARDED(lock_);
@@ -47,6 +47,18 @@ public:
     zx_status_t FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t wake_count, int current_value,
                              user_in_ptr<const int> requeue_ptr, uint32_t requeue_count);
 
+    // FutexWaitPi is FutexWait for priority inheritance futexes, whose value is the handle
+    // of the owning thread ORed with ZX_FUTEX_PI_WAITERS.  While blocked, the current
+    // thread lends its priority to the owner.  |self| is the handle the current thread is
+    // known by in the futex value.  Returning ZX_OK means the futex was handed to the
+    // current thread by FutexWakePi.
+    zx_status_t FutexWaitPi(user_in_ptr<const int> value_ptr, int current_value,
+                            zx_handle_t self, zx_time_t deadline);
+
+    // FutexWakePi releases a priority inheritance futex.  Ownership is handed to the
+    // highest priority waiter, if there is one, and the futex value is updated to match.
+    zx_status_t FutexWakePi(user_inout_ptr<int> value_ptr);
+
 private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
@@ -55,6 +67,9 @@ private:
 
     bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
 
+    // Queues |node| and blocks the current thread on it.  This releases lock_.
+    zx_status_t BlockNodeLocked(FutexNode* node, zx_time_t deadline) TA_REL(lock_);
+
     // protects futex_table_
     fbl::Mutex lock_;
 
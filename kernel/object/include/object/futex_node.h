@@ -27,6 +27,7 @@ public:
 
     bool IsInQueue() const;
     void SetAsSingletonList();
+    bool IsSingletonList() const { return queue_next_ == this; }
 
     // adds a list of nodes to our tail
     void AppendList(FutexNode* head);
@@ -41,9 +42,35 @@ public:
                                      uintptr_t old_hash_key,
                                      uintptr_t new_hash_key);
 
+    // Removes |node| from the list whose first node is |list_head| and wakes its
+    // thread.  Returns the new list head, which may be null.
+    static FutexNode* WakeNode(FutexNode* list_head, FutexNode* node, bool* out_any_woken);
+
     // This must be called with |mutex| held and returns without |mutex| held.
     zx_status_t BlockThread(fbl::Mutex* mutex, zx_time_t deadline) TA_REL(mutex);
 
+    // Priority inheritance waits record the waiting thread and the handle value it is
+    // known by in the futex word, so that ownership of the futex can be handed to it.
+    void SetPiWaiter(thread_t* thread, zx_handle_t self) {
+        pi_thread_ = thread;
+        pi_self_ = self;
+    }
+    thread_t* pi_thread() const { return pi_thread_; }
+    zx_handle_t pi_self() const { return pi_self_; }
+
+    // Stops this node's thread lending its priority to the futex owner, and
+    // clears the waiter recorded by SetPiWaiter().
+    void ReleasePiOwner();
+
+    // Returns the highest priority waiter in the list whose first node is |list_head|.
+    // The thread lock must be held.
+    static FutexNode* FindHighestPriorityPiWaiter(FutexNode* list_head);
+
+    // Makes the priority inheritance waiters in the list whose first node is
+    // |list_head|, other than |owner| itself, lend their priority to |owner|.
+    // The thread lock must be held.
+    static void SetPiOwner(FutexNode* list_head, thread_t* owner);
+
     void set_hash_key(uintptr_t key) {
         hash_key_ = key;
     }
@@ -78,4 +105,8 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    // Set for priority inheritance waits; see SetPiWaiter().
+    thread_t* pi_thread_ = nullptr;
+    zx_handle_t pi_self_ = ZX_HANDLE_INVALID;
 };
@@ -11,6 +11,7 @@
 #include <lib/user_copy/user_ptr.h>
 #include <zircon/types.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/recycler.h>
 #include <fbl/unique_ptr.h>
 
 constexpr uint32_t kMaxMessageSize = 65536u;
@@ -22,7 +23,8 @@ static_assert(ZX_CHANNEL_MAX_MSG_HANDLES == kMaxMessageHandles, "");
 
 class Handle;
 
-class MessagePacket : public fbl::DoublyLinkedListable<fbl::unique_ptr<MessagePacket>> {
+class MessagePacket : public fbl::DoublyLinkedListable<fbl::unique_ptr<MessagePacket>>,
+                      public fbl::Recyclable<MessagePacket> {
 public:
     // Creates a message packet containing the provided data and space for
     // |num_handles| handles. The handles array is uninitialized and must
@@ -48,6 +50,10 @@ public:
 
     void set_owns_handles(bool own_handles) { owns_handles_ = own_handles; }
 
+    // The number of bytes of kernel memory backing this packet, including
+    // the header and any slack left over in its size class.
+    size_t allocated_size() const;
+
     // zx_channel_call treats the leading bytes of the payload as
     // a transaction id of type zx_txid_t.
     zx_txid_t get_txid() const {
@@ -59,7 +65,8 @@ public:
     }
 
 private:
-    MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles);
+    MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles,
+                  uint8_t size_class);
     ~MessagePacket();
 
     // Allocates a new packet that can hold the specified amount of
@@ -67,10 +74,11 @@ private:
     static zx_status_t NewPacket(uint32_t data_size, uint32_t num_handles,
                                  fbl::unique_ptr<MessagePacket>* msg);
 
-    // Create() uses malloc(), so we must delete using free().
-    static void operator delete(void* ptr) {
-        free(ptr);
-    }
+    // Packets come from a size-classed slab, or from malloc() when they are
+    // too large for any class, so they are destroyed and freed here rather
+    // than by operator delete.
+    friend class fbl::Recyclable<MessagePacket>;
+    void fbl_recycle();
     friend class fbl::unique_ptr<MessagePacket>;
 
     // Handles and data are stored in the same buffer: num_handles_ Handle*
@@ -81,4 +89,7 @@ private:
     const uint32_t data_size_;
     const uint16_t num_handles_;
     bool owns_handles_;
+    // Index of the slab this packet came from; heap-allocated packets use
+    // an out-of-range index.
+    const uint8_t size_class_;
 };
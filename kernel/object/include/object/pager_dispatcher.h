@@ -0,0 +1,79 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/ref_ptr.h>
+#include <vm/page_source.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+#include <sys/types.h>
+
+class PagerDispatcher;
+
+// The page source of a VMO created by a pager. Missing pages are asked for with
+// ZX_PKT_TYPE_PAGE_REQUEST packets on a port.
+class PagerSource final : public PageSource,
+                          public fbl::DoublyLinkedListable<fbl::RefPtr<PagerSource>> {
+public:
+    PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                uint64_t key);
+
+    const PagerDispatcher* pager() const { return pager_ptr_; }
+
+private:
+    ~PagerSource() final;
+    friend fbl::RefPtr<PagerSource>;
+
+    // PageSource overrides.
+    zx_status_t SendRequestLocked(uint64_t offset) final TA_REQ(lock_);
+    void OnClose() final;
+
+    zx_status_t QueuePacketLocked(uint16_t command, uint64_t offset, uint64_t length)
+        TA_REQ(lock_);
+
+    // Kept for identification after |pager_| is dropped.
+    const PagerDispatcher* const pager_ptr_;
+    // Dropped when the source is closed, which breaks the cycle with the
+    // pager's list of sources.
+    fbl::RefPtr<PagerDispatcher> pager_;
+    fbl::RefPtr<PortDispatcher> port_ TA_GUARDED(lock_);
+    const uint64_t key_;
+};
+
+class PagerDispatcher final : public Dispatcher {
+public:
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights);
+
+    ~PagerDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PAGER; }
+    void on_zero_handles() final;
+
+    // Creates a VMO of |size| bytes whose pages are asked for on |port|, with |key|.
+    zx_status_t CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key, uint64_t size,
+                          fbl::RefPtr<VmObject>* vmo);
+
+    // Moves the pages of [aux_offset, aux_offset + length) of |aux_vmo| into
+    // [offset, offset + length) of |vmo|, a VMO created by this pager.
+    zx_status_t SupplyPages(VmObject* vmo, uint64_t offset, uint64_t length,
+                            VmObject* aux_vmo, uint64_t aux_offset);
+
+    // Called by a source when it is closed.
+    void RemoveSource(PagerSource* source);
+
+private:
+    PagerDispatcher();
+
+    fbl::Canary<fbl::magic("PGRD")> canary_;
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources_ TA_GUARDED(lock_);
+};
@@ -14,7 +14,9 @@
 #include <zircon/types.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/atomic.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
 #include <fbl/unique_ptr.h>
 
 #include <sys/types.h>
@@ -105,6 +107,30 @@ struct PortPacket final : public fbl::DoublyLinkedListable<PortPacket*> {
     static size_t DiagnosticAllocationCount();
 };
 
+// Charges the packets a process queues with zx_port_queue() against a
+// per-process limit so that one process cannot exhaust the packets shared by
+// everyone. Each outstanding packet holds a reference to the quota it was
+// charged to, so the quota outlives its process while those packets are
+// still queued on some port.
+class PortPacketQuota final : public PortAllocator,
+                              public fbl::RefCounted<PortPacketQuota> {
+public:
+    static zx_status_t Create(fbl::RefPtr<PortPacketQuota>* quota);
+
+    // Returns nullptr if the process is at its limit or the kernel is out
+    // of packets.
+    PortPacket* Alloc() final;
+    void Free(PortPacket* port_packet) final;
+
+    size_t pending_count() const { return pending_count_.load(); }
+    static size_t max_pending_count();
+
+private:
+    PortPacketQuota() = default;
+
+    fbl::atomic<size_t> pending_count_{0u};
+};
+
 // Observers are weakly contained in state trackers until |remove_| member
 // is false at the end of one of OnInitialize(), OnStateChange() or OnCancel()
 // callbacks.
@@ -138,7 +164,6 @@ private:
 
 class PortDispatcher final : public Dispatcher {
 public:
-    static void Init();
     static PortAllocator* DefaultPortAllocator();
     static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                               zx_rights_t* rights);
@@ -152,6 +177,12 @@ public:
     zx_status_t QueueUser(const zx_port_packet_t& packet);
     zx_status_t Dequeue(zx_time_t deadline, zx_port_packet_t* packet);
 
+    // Like Dequeue(), but once a packet is available dequeues up to |count|
+    // packets into |packets| under a single acquisition of the lock. The
+    // number dequeued is returned in |actual|.
+    zx_status_t DequeueBatch(zx_time_t deadline, zx_port_packet_t* packets, size_t count,
+                             size_t* actual);
+
     // Decides who is going to destroy the observer. If it returns |true| it
     // is the duty of the caller. If it is false it is the duty of the port.
     bool CanReap(PortObserver* observer, PortPacket* port_packet);
@@ -177,6 +208,10 @@ private:
     // Called by ExceptionPort.
     void UnlinkExceptionPort(ExceptionPort* eport);
 
+    // Removes the oldest packet from |packets_|, copying it to |out_packet| if
+    // non-null. Returns false if there are no packets.
+    bool DequeueOneLocked(zx_port_packet_t* out_packet) TA_REQ(lock_);
+
     fbl::Canary<fbl::magic("PORT")> canary_;
     fbl::Mutex lock_;
     Semaphore sema_;
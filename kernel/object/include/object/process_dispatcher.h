@@ -13,6 +13,7 @@
 #include <object/futex_context.h>
 #include <object/handle.h>
 #include <object/policy_manager.h>
+#include <object/port_dispatcher.h>
 #include <object/thread_dispatcher.h>
 
 #include <zircon/syscalls/object.h>
@@ -205,6 +206,9 @@ public:
     bool ResetExceptionPort(bool debugger, bool quietly);
     fbl::RefPtr<ExceptionPort> exception_port();
     fbl::RefPtr<ExceptionPort> debugger_exception_port();
+
+    // Accounts for the packets this process queues with zx_port_queue().
+    PortPacketQuota* port_packet_quota() const { return port_packet_quota_.get(); }
     // |eport| can either be the process's eport or that of any parent job.
     void OnExceptionPortRemoval(const fbl::RefPtr<ExceptionPort>& eport);
 
@@ -312,6 +316,9 @@ private:
 
     FutexContext futex_context_;
 
+    // Set by Initialize().
+    fbl::RefPtr<PortPacketQuota> port_packet_quota_;
+
     // our state
     State state_ TA_GUARDED(state_lock_) = State::INITIAL;
     mutable fbl::Mutex state_lock_;
@@ -104,10 +104,15 @@ public:
     zx_status_t Suspend();
     zx_status_t Resume();
 
+    // Moves the thread into (or, with a zero period, out of) the deadline scheduling class.
+    zx_status_t SetDeadline(const zx_thread_deadline_params_t& params);
+
     // accessors
     ProcessDispatcher* process() const { return process_.get(); }
 
     FutexNode* futex_node() { return &futex_node_; }
+    // For lending priority to the owner of a priority inheritance futex.
+    thread_t* kernel_thread() { return &thread_; }
     zx_status_t set_name(const char* name, size_t len) final;
     void get_name(char out_name[ZX_MAX_NAME_LEN]) const final;
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
@@ -37,6 +37,8 @@ public:
     zx_status_t GetSize(uint64_t* size);
     zx_status_t RangeOp(uint32_t op, uint64_t offset, uint64_t size, user_inout_ptr<void> buffer,
                         size_t buffer_size);
+    zx_status_t RangeOpBatch(user_in_ptr<const zx_vmo_range_op_t> ops, size_t count,
+                             size_t* completed);
     zx_status_t Clone(
         uint32_t options, uint64_t offset, uint64_t size, bool copy_name,
         fbl::RefPtr<VmObject>* clone_vmo);
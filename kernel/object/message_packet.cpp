@@ -10,9 +10,50 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <fbl/algorithm.h>
+#include <lib/slab.h>
 #include <zxcpp/new.h>
 #include <object/handle.h>
 
+namespace {
+
+// Each size class grows 16KB at a time and holds on to at most 1MB. A packet
+// that does not fit the largest class, or finds its class exhausted, falls
+// back to the heap.
+constexpr size_t kSlabChunkBytes = 16 * 1024u;
+constexpr size_t kSlabMaxBytes = 1024 * 1024u;
+
+// Total packet sizes, header included, served by each slab. Most channel
+// traffic is small RPC messages, so the classes are weighted towards the
+// low end.
+SlabAllocator message_slabs[] = {
+    {128u, kSlabChunkBytes / 128u, kSlabMaxBytes / 128u},
+    {256u, kSlabChunkBytes / 256u, kSlabMaxBytes / 256u},
+    {512u, kSlabChunkBytes / 512u, kSlabMaxBytes / 512u},
+    {1024u, kSlabChunkBytes / 1024u, kSlabMaxBytes / 1024u},
+    {2048u, kSlabChunkBytes / 2048u, kSlabMaxBytes / 2048u},
+    {4096u, kSlabChunkBytes / 4096u, kSlabMaxBytes / 4096u},
+};
+
+constexpr uint8_t kHeapSizeClass = static_cast<uint8_t>(fbl::count_of(message_slabs));
+
+// Returns storage for a packet of |size| bytes and the class it came from.
+void* AllocPacketStorage(size_t size, uint8_t* size_class) {
+    for (uint8_t i = 0u; i < kHeapSizeClass; ++i) {
+        if (size <= message_slabs[i].object_size()) {
+            void* ptr = message_slabs[i].Alloc();
+            if (ptr == nullptr)
+                break;
+            *size_class = i;
+            return ptr;
+        }
+    }
+    *size_class = kHeapSizeClass;
+    return malloc(size);
+}
+
+}  // namespace
+
 // static
 zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
                                      fbl::unique_ptr<MessagePacket>* msg) {
@@ -25,12 +66,11 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
 
     // Allocate space for the MessagePacket object followed by num_handles
     // Handle*s followed by data_size bytes.
-    // TODO(dbort): Use mbuf-style memory for data_size, ideally allocating from
-    // somewhere other than the heap. Lets us better track and isolate channel
-    // memory usage.
-    char* ptr = static_cast<char*>(malloc(sizeof(MessagePacket) +
-                                          num_handles * sizeof(Handle*) +
-                                          data_size));
+    uint8_t size_class;
+    char* ptr = static_cast<char*>(AllocPacketStorage(sizeof(MessagePacket) +
+                                                      num_handles * sizeof(Handle*) +
+                                                      data_size,
+                                                      &size_class));
     if (ptr == nullptr) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -41,7 +81,7 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
     // of the object.
     msg->reset(new (ptr) MessagePacket(
         data_size, num_handles,
-        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket))));
+        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket)), size_class));
     return ZX_OK;
 }
 
@@ -86,8 +126,26 @@ MessagePacket::~MessagePacket() {
 }
 
 MessagePacket::MessagePacket(uint32_t data_size,
-                             uint32_t num_handles, Handle** handles)
+                             uint32_t num_handles, Handle** handles,
+                             uint8_t size_class)
     : handles_(handles), data_size_(data_size),
       // NewPacket ensures that num_handles fits in 16 bits.
-      num_handles_(static_cast<uint16_t>(num_handles)), owns_handles_(false) {
+      num_handles_(static_cast<uint16_t>(num_handles)), owns_handles_(false),
+      size_class_(size_class) {
+}
+
+size_t MessagePacket::allocated_size() const {
+    if (size_class_ < kHeapSizeClass)
+        return message_slabs[size_class_].object_size();
+    return sizeof(MessagePacket) + num_handles_ * sizeof(Handle*) + data_size_;
+}
+
+void MessagePacket::fbl_recycle() {
+    const uint8_t size_class = size_class_;
+    this->~MessagePacket();
+    if (size_class < kHeapSizeClass) {
+        message_slabs[size_class].Free(this);
+    } else {
+        free(this);
+    }
 }
@@ -0,0 +1,119 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/message_packet.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/unique_ptr.h>
+#include <string.h>
+#include <unittest.h>
+
+namespace {
+
+// The packet sizes served by the message slabs, smallest first.
+constexpr size_t kSizeClasses[] = {128u, 256u, 512u, 1024u, 2048u, 4096u};
+constexpr size_t kLargestClass = kSizeClasses[fbl::count_of(kSizeClasses) - 1];
+// The most packets the largest class holds.
+constexpr size_t kLargestClassMax = 1024 * 1024u / kLargestClass;
+
+// The bytes a packet itself needs, header included.
+size_t PacketSize(uint32_t data_size, uint32_t num_handles) {
+    return sizeof(MessagePacket) + num_handles * sizeof(Handle*) + data_size;
+}
+
+// A packet is charged for the whole of the size class it fits in, or for
+// exactly what it needs if it is too large for any and comes from the heap.
+bool allocated_size_test(void* context) {
+    BEGIN_TEST;
+
+    static const uint32_t kDataSize = 8192u;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[kDataSize]);
+    REQUIRE_TRUE(ac.check(), "");
+    memset(data.get(), 0, kDataSize);
+
+    struct {
+        uint32_t data_size;
+        uint32_t num_handles;
+    } cases[] = {
+        {0u, 0u}, {16u, 0u}, {16u, 4u}, {128u, 0u}, {100u, kMaxMessageHandles},
+        {static_cast<uint32_t>(kLargestClass - sizeof(MessagePacket)), 0u},
+        {static_cast<uint32_t>(kLargestClass - sizeof(MessagePacket)), 1u},
+        {kDataSize, 0u},
+    };
+
+    for (const auto& c : cases) {
+        fbl::unique_ptr<MessagePacket> msg;
+        ASSERT_EQ(ZX_OK, MessagePacket::Create(data.get(), c.data_size, c.num_handles, &msg), "");
+
+        const size_t size = PacketSize(c.data_size, c.num_handles);
+        size_t expected = size;
+        for (size_t class_size : kSizeClasses) {
+            if (size <= class_size) {
+                expected = class_size;
+                break;
+            }
+        }
+        EXPECT_EQ(expected, msg->allocated_size(), "allocated size\n");
+        EXPECT_GE(msg->allocated_size(), size, "allocated size covers the packet\n");
+        EXPECT_EQ(c.data_size, msg->data_size(), "data size\n");
+        EXPECT_EQ(c.num_handles, msg->num_handles(), "handle count\n");
+    }
+
+    END_TEST;
+}
+
+// Once a size class runs out, packets that would fit it come from the heap
+// instead, and are charged only for what they need.
+bool exhausted_class_test(void* context) {
+    BEGIN_TEST;
+
+    // Pick a size the largest class rounds up, so the two sources differ.
+    static const uint32_t kDataSize =
+        static_cast<uint32_t>(kLargestClass - sizeof(MessagePacket) - 64u);
+    const size_t size = PacketSize(kDataSize, 0u);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[kDataSize]);
+    REQUIRE_TRUE(ac.check(), "");
+    memset(data.get(), 0, kDataSize);
+
+    // Other packets in flight may hold some of the class, so keep going until
+    // one falls back rather than counting on an exact number.
+    fbl::DoublyLinkedList<fbl::unique_ptr<MessagePacket>> held;
+    fbl::unique_ptr<MessagePacket> from_heap;
+    for (size_t i = 0; i <= kLargestClassMax; i++) {
+        fbl::unique_ptr<MessagePacket> msg;
+        ASSERT_EQ(ZX_OK, MessagePacket::Create(data.get(), kDataSize, 0u, &msg), "");
+        if (msg->allocated_size() != kLargestClass) {
+            from_heap = fbl::move(msg);
+            break;
+        }
+        held.push_back(fbl::move(msg));
+    }
+    REQUIRE_NONNULL(from_heap, "no packet fell back to the heap\n");
+    EXPECT_EQ(size, from_heap->allocated_size(), "heap packet size\n");
+
+    // Packets freed back to the class make it usable again.
+    from_heap.reset();
+    held.clear();
+    fbl::unique_ptr<MessagePacket> msg;
+    ASSERT_EQ(ZX_OK, MessagePacket::Create(data.get(), kDataSize, 0u, &msg), "");
+    EXPECT_EQ(kLargestClass, msg->allocated_size(), "slab packet size\n");
+
+    END_TEST;
+}
+
+} // namespace
+
+#define MP_UNITTEST(fname) UNITTEST(#fname, fname)
+
+UNITTEST_START_TESTCASE(message_packet_tests)
+MP_UNITTEST(allocated_size_test)
+MP_UNITTEST(exhausted_class_test)
+UNITTEST_END_TESTCASE(message_packet_tests, "msgpacket", "MessagePacket test", nullptr, nullptr);
@@ -0,0 +1,175 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/pager_dispatcher.h>
+
+#include <vm/pmm.h>
+#include <vm/vm_object_paged.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls/port.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+
+#include <assert.h>
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#define LOCAL_TRACE 0
+
+using fbl::AutoLock;
+
+PagerSource::PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                         uint64_t key)
+    : pager_ptr_(pager.get()), pager_(fbl::move(pager)), port_(fbl::move(port)), key_(key) {
+}
+
+PagerSource::~PagerSource() {
+}
+
+zx_status_t PagerSource::SendRequestLocked(uint64_t offset) {
+    return QueuePacketLocked(ZX_PAGER_VMO_READ, offset, PAGE_SIZE);
+}
+
+void PagerSource::OnClose() {
+    {
+        AutoLock a(&lock_);
+        // let the pager know it can forget about the VMO; there's nothing to do
+        // if this can't be delivered
+        QueuePacketLocked(ZX_PAGER_VMO_COMPLETE, 0, 0);
+        port_.reset();
+    }
+
+    if (pager_) {
+        pager_->RemoveSource(this);
+        pager_.reset();
+    }
+}
+
+zx_status_t PagerSource::QueuePacketLocked(uint16_t command, uint64_t offset, uint64_t length) {
+    if (!port_)
+        return ZX_ERR_BAD_STATE;
+
+    auto port_packet = PortDispatcher::DefaultPortAllocator()->Alloc();
+    if (!port_packet)
+        return ZX_ERR_NO_MEMORY;
+
+    port_packet->packet.key = key_;
+    port_packet->packet.type = ZX_PKT_TYPE_PAGE_REQUEST;
+    port_packet->packet.status = ZX_OK;
+    port_packet->packet.page_request.command = command;
+    port_packet->packet.page_request.flags = 0;
+    port_packet->packet.page_request.reserved0 = 0;
+    port_packet->packet.page_request.offset = offset;
+    port_packet->packet.page_request.length = length;
+    port_packet->packet.page_request.reserved1 = 0;
+
+    zx_status_t status = port_->Queue(port_packet, 0u, 0u);
+    if (status != ZX_OK)
+        port_packet->Free();
+    return status;
+}
+
+zx_status_t PagerDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                                    zx_rights_t* rights) {
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) PagerDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = ZX_DEFAULT_PAGER_RIGHTS;
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+PagerDispatcher::PagerDispatcher() {
+}
+
+PagerDispatcher::~PagerDispatcher() {
+    DEBUG_ASSERT(sources_.is_empty());
+}
+
+void PagerDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    // nobody is left to supply pages, so fail the faults waiting on them and
+    // any that come later
+    for (;;) {
+        fbl::RefPtr<PagerSource> source;
+        {
+            AutoLock a(&lock_);
+            source = sources_.pop_front();
+        }
+        if (!source)
+            break;
+        source->Close();
+    }
+}
+
+zx_status_t PagerDispatcher::CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                                       uint64_t size, fbl::RefPtr<VmObject>* vmo) {
+    canary_.Assert();
+
+    fbl::AllocChecker ac;
+    auto source = fbl::AdoptRef(new (&ac) PagerSource(fbl::WrapRefPtr(this), fbl::move(port),
+                                                      key));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    fbl::RefPtr<VmObject> obj;
+    zx_status_t status = VmObjectPaged::CreateExternal(source, PMM_ALLOC_FLAG_MOVABLE, size, &obj);
+    if (status != ZX_OK)
+        return status;
+
+    {
+        AutoLock a(&lock_);
+        sources_.push_back(fbl::move(source));
+    }
+
+    *vmo = fbl::move(obj);
+    return ZX_OK;
+}
+
+zx_status_t PagerDispatcher::SupplyPages(VmObject* vmo, uint64_t offset, uint64_t length,
+                                         VmObject* aux_vmo, uint64_t aux_offset) {
+    canary_.Assert();
+
+    // every page source so far belongs to a pager
+    auto source = static_cast<PagerSource*>(vmo->page_source());
+    if (!source || source->pager() != this)
+        return ZX_ERR_INVALID_ARGS;
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(length) || !IS_PAGE_ALIGNED(aux_offset))
+        return ZX_ERR_INVALID_ARGS;
+    if (offset + length < offset || offset + length > vmo->size())
+        return ZX_ERR_OUT_OF_RANGE;
+    if (length == 0)
+        return ZX_OK;
+
+    list_node pages;
+    list_initialize(&pages);
+    zx_status_t status = aux_vmo->TakePages(aux_offset, length, &pages);
+    if (status != ZX_OK)
+        return status;
+
+    status = vmo->SupplyPages(offset, length, &pages);
+    if (status != ZX_OK) {
+        // the VMO shrank in the meantime
+        pmm_free(&pages);
+    }
+    return status;
+}
+
+void PagerDispatcher::RemoveSource(PagerSource* source) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+    if (source->InContainer())
+        sources_.erase(*source);
+}
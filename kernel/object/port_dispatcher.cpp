@@ -12,10 +12,12 @@
 #include <pow2.h>
 
 #include <fbl/alloc_checker.h>
-#include <fbl/arena.h>
 #include <fbl/auto_lock.h>
+#include <lib/slab.h>
+#include <zxcpp/new.h>
 #include <object/excp_port.h>
 #include <object/handle.h>
+#include <object/process_dispatcher.h>
 #include <zircon/compiler.h>
 #include <zircon/rights.h>
 #include <zircon/syscalls/port.h>
@@ -34,42 +36,92 @@ static_assert(sizeof(zx_packet_guest_io_t) == sizeof(zx_packet_user_t),
 static_assert(sizeof(zx_packet_guest_vcpu_t) == sizeof(zx_packet_user_t),
               "size of zx_packet_guest_vcpu_t must match zx_packet_user_t");
 
-class ArenaPortAllocator final : public PortAllocator {
+namespace {
+
+// The most packets the kernel will hand out at once, across all processes.
+constexpr size_t kMaxPacketCount = 128 * 1024u;
+// The most packets a single process may have queued with zx_port_queue().
+constexpr size_t kMaxPendingPacketsPerProcess = 16 * 1024u;
+// The slab grows by this many packets at a time.
+constexpr size_t kSlabChunkCount = 256u;
+
+}  // namespace.
+
+// Hands out packets from a per-cpu cached slab, so that an Alloc()/Free()
+// pair normally avoids any shared lock.
+class SlabPortAllocator final : public PortAllocator {
 public:
-    zx_status_t Init();
-    virtual ~ArenaPortAllocator() = default;
+    SlabPortAllocator() : slab_(sizeof(PortPacket), kSlabChunkCount, kMaxPacketCount) {}
+    virtual ~SlabPortAllocator() = default;
 
-    virtual PortPacket* Alloc();
-    virtual void Free(PortPacket* port_packet);
+    PortPacket* Alloc() final { return New(this); }
+    void Free(PortPacket* port_packet) final { Delete(port_packet); }
 
-    size_t DiagnosticCount() const {
-        return arena_.DiagnosticCount();
-    }
+    // Constructs a packet whose Free() is routed through |allocator|.
+    PortPacket* New(PortAllocator* allocator);
+    void Delete(PortPacket* port_packet);
+
+    size_t DiagnosticCount() { return slab_.DiagnosticCount(); }
 
 private:
-    fbl::TypedArena<PortPacket, fbl::Mutex> arena_;
+    SlabAllocator slab_;
 };
 
 namespace {
-constexpr size_t kMaxPendingPacketCount = 16 * 1024u;
-ArenaPortAllocator port_allocator;
+SlabPortAllocator port_allocator;
 }  // namespace.
 
-zx_status_t ArenaPortAllocator::Init() {
-    return arena_.Init("packets", kMaxPendingPacketCount);
+PortPacket* SlabPortAllocator::New(PortAllocator* allocator) {
+    void* storage = slab_.Alloc();
+    if (storage == nullptr) {
+        printf("WARNING: Could not allocate new port packet\n");
+        return nullptr;
+    }
+    return new (storage) PortPacket(nullptr, allocator);
 }
 
-PortPacket* ArenaPortAllocator::Alloc() {
-    PortPacket* packet = arena_.New(nullptr, this);
-    if (packet == nullptr) {
-        printf("WARNING: Could not allocate new port packet\n");
+void SlabPortAllocator::Delete(PortPacket* port_packet) {
+    port_packet->~PortPacket();
+    slab_.Free(port_packet);
+}
+
+// static
+zx_status_t PortPacketQuota::Create(fbl::RefPtr<PortPacketQuota>* quota) {
+    fbl::AllocChecker ac;
+    auto q = new (&ac) PortPacketQuota();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    *quota = fbl::AdoptRef(q);
+    return ZX_OK;
+}
+
+// static
+size_t PortPacketQuota::max_pending_count() {
+    return kMaxPendingPacketsPerProcess;
+}
+
+PortPacket* PortPacketQuota::Alloc() {
+    if (pending_count_.fetch_add(1u) >= kMaxPendingPacketsPerProcess) {
+        pending_count_.fetch_sub(1u);
+        return nullptr;
+    }
+
+    PortPacket* port_packet = port_allocator.New(this);
+    if (port_packet == nullptr) {
+        pending_count_.fetch_sub(1u);
         return nullptr;
     }
-    return packet;
+
+    // Dropped in Free().
+    AddRef();
+    return port_packet;
 }
 
-void ArenaPortAllocator::Free(PortPacket* port_packet) {
-    arena_.Delete(port_packet);
+void PortPacketQuota::Free(PortPacket* port_packet) {
+    port_allocator.Delete(port_packet);
+    pending_count_.fetch_sub(1u);
+    if (Release())
+        delete this;
 }
 
 PortPacket::PortPacket(const void* handle, PortAllocator* allocator)
@@ -156,10 +208,6 @@ StateObserver::Flags PortObserver::MaybeQueue(zx_signals_t new_state, uint64_t c
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-void PortDispatcher::Init() {
-    port_allocator.Init();
-}
-
 PortAllocator* PortDispatcher::DefaultPortAllocator() {
     return &port_allocator;
 }
@@ -208,7 +256,9 @@ void PortDispatcher::on_zero_handles() {
 zx_status_t PortDispatcher::QueueUser(const zx_port_packet_t& packet) {
     canary_.Assert();
 
-    auto port_packet = port_allocator.Alloc();
+    // Charge the packet to the process queueing it. The quota is dropped
+    // when the packet is freed, whichever process dequeues it.
+    auto port_packet = ProcessDispatcher::GetCurrent()->port_packet_quota()->Alloc();
     if (!port_packet)
         return ZX_ERR_NO_MEMORY;
 
@@ -250,36 +300,64 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
     return ZX_OK;
 }
 
+bool PortDispatcher::DequeueOneLocked(zx_port_packet_t* out_packet) {
+    PortPacket* port_packet = packets_.pop_front();
+    if (port_packet == nullptr)
+        return false;
+
+    if (out_packet != nullptr)
+        *out_packet = port_packet->packet;
+
+    PortObserver* observer = port_packet->observer;
+
+    if (observer) {
+        // Deleting the observer under the lock is fine because
+        // the reference that holds to this PortDispatcher is by
+        // construction not the last one. We need to do this under
+        // the lock because another thread can call CanReap().
+        delete observer;
+    } else if (port_packet->is_ephemeral()) {
+        port_packet->Free();
+    }
+    return true;
+}
+
 zx_status_t PortDispatcher::Dequeue(zx_time_t deadline, zx_port_packet_t* out_packet) {
     canary_.Assert();
 
     while (true) {
         {
             AutoLock al(&lock_);
+            if (DequeueOneLocked(out_packet))
+                return ZX_OK;
+        }
 
-            PortPacket* port_packet = packets_.pop_front();
-            if (port_packet == nullptr)
-                goto wait;
-
-            if (out_packet != nullptr)
-                *out_packet = port_packet->packet;
+        zx_status_t st = sema_.Wait(deadline, nullptr);
+        if (st != ZX_OK)
+            return st;
+    }
+}
 
-            PortObserver* observer = port_packet->observer;
+zx_status_t PortDispatcher::DequeueBatch(zx_time_t deadline, zx_port_packet_t* packets,
+                                         size_t count, size_t* actual) {
+    canary_.Assert();
+    DEBUG_ASSERT(count > 0);
 
-            if (observer) {
-                // Deleting the observer under the lock is fine because
-                // the reference that holds to this PortDispatcher is by
-                // construction not the last one. We need to do this under
-                // the lock because another thread can call CanReap().
-                delete observer;
-            } else if (port_packet->is_ephemeral()) {
-                port_packet->Free();
+    while (true) {
+        {
+            AutoLock al(&lock_);
+            size_t n = 0;
+            while (n < count && DequeueOneLocked(&packets[n]))
+                ++n;
+            if (n > 0) {
+                // The semaphore was posted once per packet; the extra posts
+                // for the packets taken here only cost a waiter a spurious
+                // trip around the loop below.
+                *actual = n;
+                return ZX_OK;
             }
         }
 
-        return ZX_OK;
-
-wait:
         zx_status_t st = sema_.Wait(deadline, nullptr);
         if (st != ZX_OK)
             return st;
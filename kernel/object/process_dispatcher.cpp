@@ -148,7 +148,7 @@ zx_status_t ProcessDispatcher::Initialize() {
         return ZX_ERR_NO_MEMORY;
     }
 
-    return ZX_OK;
+    return PortPacketQuota::Create(&port_packet_quota_);
 }
 
 void ProcessDispatcher::Exit(int retcode) {
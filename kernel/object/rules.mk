@@ -30,6 +30,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/log_dispatcher.cpp \
     $(LOCAL_DIR)/mbuf.cpp \
     $(LOCAL_DIR)/message_packet.cpp \
+    $(LOCAL_DIR)/pager_dispatcher.cpp \
     $(LOCAL_DIR)/pci_device_dispatcher.cpp \
     $(LOCAL_DIR)/pci_interrupt_dispatcher.cpp \
     $(LOCAL_DIR)/policy_manager.cpp \
@@ -48,12 +49,14 @@ MODULE_SRCS := \
 
 # Tests
 MODULE_SRCS += \
+    $(LOCAL_DIR)/message_packet_tests.cpp \
     $(LOCAL_DIR)/state_tracker_tests.cpp \
 
 MODULE_DEPS := \
     kernel/lib/hypervisor \
     kernel/lib/fbl \
     kernel/lib/oom \
+    kernel/lib/slab \
     kernel/dev/interrupt \
     kernel/dev/udisplay \
 
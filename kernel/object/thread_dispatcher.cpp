@@ -385,6 +385,22 @@ zx_status_t ThreadDispatcher::Resume() {
     return thread_resume(&thread_);
 }
 
+zx_status_t ThreadDispatcher::SetDeadline(const zx_thread_deadline_params_t& params) {
+    canary_.Assert();
+
+    LTRACE_ENTRY_OBJ;
+
+    AutoLock lock(&state_lock_);
+
+    LTRACEF("%p: state %s period %" PRIi64 " budget %" PRIi64 " deadline %" PRIi64 "\n",
+            this, StateToString(state_), params.period, params.budget, params.deadline);
+
+    if (state_ == State::INITIAL || state_ == State::DYING || state_ == State::DEAD)
+        return ZX_ERR_BAD_STATE;
+
+    return thread_set_deadline(&thread_, params.period, params.budget, params.deadline);
+}
+
 static void ThreadCleanupDpc(dpc_t *d) {
     LTRACEF("dpc %p\n", d);
 
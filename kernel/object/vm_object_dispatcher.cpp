@@ -12,6 +12,7 @@
 #include <zircon/rights.h>
 
 #include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
 
 #include <assert.h>
 #include <err.h>
@@ -104,10 +105,27 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             auto status = vmo_->DecommitRange(offset, size, nullptr);
             return status;
         }
-        case ZX_VMO_OP_LOCK:
+        case ZX_VMO_OP_SET_DISCARDABLE:
+            return vmo_->SetDiscardable();
+        case ZX_VMO_OP_LOCK: {
+            // only discardable VMOs can be locked so far, and always as a whole
+            if (buffer && buffer_size < sizeof(zx_vmo_lock_state_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+
+            bool was_discarded;
+            auto status = vmo_->LockDiscardable(&was_discarded);
+            if (status != ZX_OK || !buffer)
+                return status;
+
+            zx_vmo_lock_state_t state = {};
+            state.discarded = was_discarded;
+            status = buffer.reinterpret<zx_vmo_lock_state_t>().copy_to_user(state);
+            if (status != ZX_OK)
+                vmo_->CancelLockDiscardable(was_discarded);
+            return status;
+        }
         case ZX_VMO_OP_UNLOCK:
-            // TODO: handle
-            return ZX_ERR_NOT_SUPPORTED;
+            return vmo_->UnlockDiscardable();
         case ZX_VMO_OP_LOOKUP:
             // we will be using the user pointer
             if (!buffer)
@@ -130,6 +148,50 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
     }
 }
 
+zx_status_t VmObjectDispatcher::RangeOpBatch(user_in_ptr<const zx_vmo_range_op_t> ops,
+                                             size_t count, size_t* completed) {
+    canary_.Assert();
+
+    LTRACEF("ops %p count %zu\n", ops.get(), count);
+
+    *completed = 0;
+    if (count == 0)
+        return ZX_OK;
+    if (count > ZX_VMO_OP_RANGE_BATCH_MAX)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx_vmo_range_op_t[]> user_ops(new (&ac) zx_vmo_range_op_t[count]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    fbl::unique_ptr<VmRangeOp[]> vm_ops(new (&ac) VmRangeOp[count]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    if (ops.copy_array_from_user(user_ops.get(), count) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    // validate the whole batch up front so that a bad entry doesn't leave it half done
+    for (size_t i = 0; i < count; i++) {
+        if (user_ops[i].reserved != 0)
+            return ZX_ERR_INVALID_ARGS;
+        switch (user_ops[i].op) {
+            case ZX_VMO_OP_COMMIT:
+                vm_ops[i].type = VmRangeOpType::Commit;
+                break;
+            case ZX_VMO_OP_DECOMMIT:
+                vm_ops[i].type = VmRangeOpType::Decommit;
+                break;
+            default:
+                return ZX_ERR_INVALID_ARGS;
+        }
+        vm_ops[i].offset = user_ops[i].offset;
+        vm_ops[i].len = user_ops[i].size;
+    }
+
+    return vmo_->RangeOpBatch(vm_ops.get(), count, completed);
+}
+
 zx_status_t VmObjectDispatcher::SetMappingCachePolicy(uint32_t cache_policy) {
     return vmo_->SetMappingCachePolicy(cache_policy);
 }
@@ -27,6 +27,20 @@ zx_status_t sys_futex_wake(user_in_ptr<const zx_futex_t> value_ptr, uint32_t cou
         value_ptr, count);
 }
 
+zx_status_t sys_futex_wait_pi(user_in_ptr<const zx_futex_t> value_ptr, int current_value,
+                              zx_handle_t self, zx_time_t deadline) {
+    LTRACEF("futex %p current %d self %x\n", value_ptr.get(), current_value, self);
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWaitPi(
+        value_ptr, current_value, self, deadline);
+}
+
+zx_status_t sys_futex_wake_pi(user_inout_ptr<zx_futex_t> value_ptr) {
+    LTRACEF("futex %p\n", value_ptr.get());
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWakePi(value_ptr);
+}
+
 zx_status_t sys_futex_requeue(user_in_ptr<const zx_futex_t> wake_ptr, uint32_t wake_count, int current_value,
                               user_in_ptr<const zx_futex_t> requeue_ptr, uint32_t requeue_count) {
     LTRACEF("futex %p wake_count %" PRIu32 "current_value %d "
@@ -541,6 +541,20 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
         }
+        case ZX_INFO_PROCESS_PORT_STATS: {
+            fbl::RefPtr<ProcessDispatcher> process;
+            auto status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &process);
+            if (status != ZX_OK)
+                return status;
+
+            zx_info_process_port_stats_t info = {
+                .pending_packets = process->port_packet_quota()->pending_count(),
+                .max_pending_packets = PortPacketQuota::max_pending_count(),
+            };
+
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
+        }
 
         default:
             return ZX_ERR_NOT_SUPPORTED;
@@ -13,6 +13,7 @@
 #include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/ref_ptr.h>
@@ -105,6 +106,46 @@ zx_status_t sys_port_wait(zx_handle_t handle, zx_time_t deadline,
     return ZX_OK;
 }
 
+zx_status_t sys_port_wait_batch(zx_handle_t handle, zx_time_t deadline,
+                                user_out_ptr<zx_port_packet_t> packets_out, size_t count,
+                                user_out_ptr<size_t> actual_out) {
+    LTRACEF("handle %x count %zu\n", handle, count);
+
+    if (count == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    count = fbl::min(count, static_cast<size_t>(ZX_PORT_WAIT_BATCH_MAX));
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<PortDispatcher> port;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &port);
+    if (status != ZX_OK)
+        return status;
+
+    ktrace(TAG_PORT_WAIT, (uint32_t)port->get_koid(), 0, 0, 0);
+
+    zx_port_packet_t pp[ZX_PORT_WAIT_BATCH_MAX];
+    size_t actual = 0;
+    zx_status_t st = port->DequeueBatch(deadline, pp, count, &actual);
+
+    ktrace(TAG_PORT_WAIT_DONE, (uint32_t)port->get_koid(), st, (uint32_t)actual, 0);
+
+    if (st != ZX_OK)
+        return st;
+
+    status = packets_out.copy_array_to_user(pp, actual);
+    if (status != ZX_OK)
+        return status;
+
+    if (actual_out) {
+        status = actual_out.copy_to_user(actual);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t sys_port_cancel(zx_handle_t handle, zx_handle_t source, uint64_t key) {
     auto up = ProcessDispatcher::GetCurrent();
 
@@ -21,6 +21,7 @@
 #include <object/job_dispatcher.h>
 #include <object/process_dispatcher.h>
 #include <object/resource_dispatcher.h>
+#include <object/resources.h>
 #include <object/thread_dispatcher.h>
 #include <object/vm_address_region_dispatcher.h>
 
@@ -256,6 +257,32 @@ zx_status_t sys_thread_set_priority(int32_t prio) {
 #endif
 }
 
+zx_status_t sys_thread_set_deadline(zx_handle_t hrsrc, zx_handle_t handle,
+                                    user_in_ptr<const zx_thread_deadline_params_t> _params) {
+    LTRACEF("handle %x\n", handle);
+
+    // Deadline threads run ahead of every priority scheduled thread, so
+    // reserving cpu time is a privilege and not just a right on the thread.
+    // TODO(ZX-971): finer grained validation
+    zx_status_t status;
+    if ((status = validate_resource(hrsrc, ZX_RSRC_KIND_ROOT)) < 0)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> thread;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &thread);
+    if (status != ZX_OK)
+        return status;
+
+    zx_thread_deadline_params_t params;
+    status = _params.copy_from_user(&params);
+    if (status != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    return thread->SetDeadline(params);
+}
+
 zx_status_t sys_task_suspend(zx_handle_t task_handle) {
     LTRACE_ENTRY;
 
@@ -27,7 +27,7 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
                            user_out_handle* out) {
     LTRACEF("size %#" PRIx64 "\n", size);
 
-    if (options != 0u)
+    if (options & ~ZX_VMO_LARGE_PAGES)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -35,9 +35,13 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
     if (res != ZX_OK)
         return res;
 
+    uint32_t vmo_options = 0;
+    if (options & ZX_VMO_LARGE_PAGES)
+        vmo_options |= VmObjectPaged::kLargePages;
+
     // create a vm object
     fbl::RefPtr<VmObject> vmo;
-    res = VmObjectPaged::Create(0, size, &vmo);
+    res = VmObjectPaged::Create(PMM_ALLOC_FLAG_MOVABLE, vmo_options, size, &vmo);
     if (res != ZX_OK)
         return res;
 
@@ -194,6 +198,32 @@ zx_status_t sys_vmo_op_range(zx_handle_t handle, uint32_t op, uint64_t offset, u
     return vmo->RangeOp(op, offset, size, _buffer, buffer_size);
 }
 
+zx_status_t sys_vmo_op_range_batch(zx_handle_t handle, user_in_ptr<const zx_vmo_range_op_t> ops,
+                                   size_t count, user_out_ptr<size_t> actual) {
+    LTRACEF("handle %x ops %p count %zu\n", handle, ops.get(), count);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the dispatcher from handle. every op a batch can hold, commit and
+    // decommit, changes the contents of the vmo
+    fbl::RefPtr<VmObjectDispatcher> vmo;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    size_t completed;
+    status = vmo->RangeOpBatch(ops, count, &completed);
+
+    // report how far we got even if an operation failed, so the caller knows which one
+    if (actual) {
+        zx_status_t copy_status = actual.copy_to_user(completed);
+        if (status == ZX_OK)
+            status = copy_status;
+    }
+
+    return status;
+}
+
 zx_status_t sys_vmo_set_cache_policy(zx_handle_t handle, uint32_t cache_policy) {
     fbl::RefPtr<VmObjectDispatcher> vmo;
     zx_status_t status = ZX_OK;
@@ -9,11 +9,15 @@
 
 #include <arch/ops.h>
 #include <err.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
 #include <inttypes.h>
+#include <kernel/event.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
+#include <kernel/timer.h>
 #include <platform.h>
 #include <rand.h>
 #include <stdio.h>
@@ -235,6 +239,127 @@ __NO_INLINE static void bench_mutex() {
     printf("%" PRIu64 " cycles to acquire/release uncontended mutex %u times (%" PRIu64 " cycles per)\n", c, count, c / count);
 }
 
+struct wakeup_pair {
+    event_t ping;
+    event_t pong;
+    uint count;
+};
+
+static int wakeup_pinger(void* arg) {
+    wakeup_pair* p = static_cast<wakeup_pair*>(arg);
+    for (uint i = 0; i < p->count; i++) {
+        event_signal(&p->ping, true);
+        event_wait(&p->pong);
+    }
+    return 0;
+}
+
+static int wakeup_ponger(void* arg) {
+    wakeup_pair* p = static_cast<wakeup_pair*>(arg);
+    for (uint i = 0; i < p->count; i++) {
+        event_wait(&p->ping);
+        event_signal(&p->pong, true);
+    }
+    return 0;
+}
+
+// ping-pong a pair of threads per cpu through events, each pair straddling two
+// cpus, and report how the aggregate wakeup rate scales as cpus are added.
+__NO_INLINE static void bench_wakeup_scaling() {
+    static const uint count = 64 * 1024;
+    const uint max_cpus = arch_max_num_cpus();
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<wakeup_pair[]> pairs(new (&ac) wakeup_pair[max_cpus]);
+    fbl::unique_ptr<thread_t*[]> threads(new (&ac) thread_t*[max_cpus * 2]);
+    if (!ac.check()) {
+        printf("failed to allocate wakeup benchmark state\n");
+        return;
+    }
+
+    cpu_mask_t mask = 0;
+    for (uint cpus = 1; cpus <= max_cpus; cpus++) {
+        // only measure sets of cpus that are all online
+        mask |= cpu_num_to_mask(cpus - 1);
+        if ((mask & mp_get_active_mask()) != mask)
+            break;
+
+        for (uint i = 0; i < cpus; i++) {
+            event_init(&pairs[i].ping, false, EVENT_FLAG_AUTOUNSIGNAL);
+            event_init(&pairs[i].pong, false, EVENT_FLAG_AUTOUNSIGNAL);
+            pairs[i].count = count;
+
+            threads[i * 2] = thread_create("wakeup pinger", &wakeup_pinger, &pairs[i],
+                                           DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+            threads[i * 2 + 1] = thread_create("wakeup ponger", &wakeup_ponger, &pairs[i],
+                                               DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+            thread_set_cpu_affinity(threads[i * 2], cpu_num_to_mask(i));
+            thread_set_cpu_affinity(threads[i * 2 + 1], cpu_num_to_mask((i + 1) % cpus));
+        }
+
+        zx_time_t t = current_time();
+        for (uint i = 0; i < cpus * 2; i++) {
+            thread_resume(threads[i]);
+        }
+        for (uint i = 0; i < cpus * 2; i++) {
+            thread_join(threads[i], NULL, ZX_TIME_INFINITE);
+        }
+        t = current_time() - t;
+
+        for (uint i = 0; i < cpus; i++) {
+            event_destroy(&pairs[i].ping);
+            event_destroy(&pairs[i].pong);
+        }
+
+        uint64_t wakeups = 2ULL * count * cpus;
+        printf("%u cpus: %" PRIu64 " wakeups in %" PRIu64 " ns (%" PRIu64 " wakeups/sec)\n",
+               cpus, wakeups, t, wakeups * ZX_SEC(1) / t);
+    }
+}
+
+static enum handler_return bench_timer_cb(timer_t* timer, zx_time_t now, void* arg) {
+    return INT_NO_RESCHEDULE;
+}
+
+// set and then cancel a large number of timers with random deadlines and
+// slack, to measure the cost of maintaining a deep per-cpu timer queue.
+__NO_INLINE static void bench_timer_set_cancel() {
+    static const uint count = 16 * 1024;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<timer_t[]> timers(new (&ac) timer_t[count]);
+    if (!ac.check()) {
+        printf("failed to allocate timer benchmark state\n");
+        return;
+    }
+
+    // keep all the timers on one cpu's queue, far enough out that none fire
+    thread_t* t = get_current_thread();
+    cpu_mask_t old_affinity = t->cpu_affinity;
+    thread_set_cpu_affinity(t, cpu_num_to_mask(arch_curr_cpu_num()));
+
+    const zx_time_t base = current_time() + ZX_SEC(3600);
+    uint64_t c = arch_cycle_count();
+    for (uint i = 0; i < count; i++) {
+        timer_init(&timers[i]);
+        timer_set(&timers[i], base + ZX_USEC(rand() % 1000000), TIMER_SLACK_CENTER,
+                  ZX_USEC(rand() % 100), bench_timer_cb, nullptr);
+    }
+    uint64_t set = arch_cycle_count() - c;
+
+    // cancel in an order unrelated to the deadlines
+    c = arch_cycle_count();
+    for (uint i = 0; i < count; i++) {
+        timer_cancel(&timers[(i * 7919) % count]);
+    }
+    uint64_t cancel = arch_cycle_count() - c;
+
+    thread_set_cpu_affinity(t, old_affinity);
+
+    printf("%" PRIu64 " cycles to set %u timers (%" PRIu64 " cycles per)\n", set, count, set / count);
+    printf("%" PRIu64 " cycles to cancel %u timers (%" PRIu64 " cycles per)\n", cancel, count, cancel / count);
+}
+
 void benchmarks() {
     bench_set_overhead();
     bench_memcpy();
@@ -251,4 +376,6 @@ void benchmarks() {
 
     bench_spinlock();
     bench_mutex();
+    bench_wakeup_scaling();
+    bench_timer_set_cancel();
 }
@@ -100,6 +100,223 @@ static int mutex_test(void) {
     return 0;
 }
 
+// Priority inversion test. A low priority thread holds a mutex that a high priority
+// thread wants while medium priority threads hog the cpu. Without priority inheritance
+// the high priority thread waits for the hogs to finish; with it, the holder runs at the
+// waiter's priority and the wait is about as long as the remaining hold time. With
+// |chain| set, the high priority thread waits on a second mutex held by a thread that is
+// itself blocked on the first, to check that inheritance is transitive.
+struct pi_test_state {
+    mutex_t inner = MUTEX_INITIAL_VALUE(inner);
+    mutex_t outer = MUTEX_INITIAL_VALUE(outer);
+    event_t held = EVENT_INITIAL_VALUE(held, false, EVENT_FLAG_AUTOUNSIGNAL);
+    cpu_num_t cpu;
+    bool chain;
+    zx_duration_t hold;
+    zx_time_t hog_until;
+    zx_duration_t latency;
+};
+
+static const zx_duration_t kPiHoldTime = ZX_USEC(200);
+static const zx_duration_t kPiHogTime = ZX_MSEC(10);
+static const int kPiHogCount = 3;
+static const int kPiIterations = 50;
+
+static int pi_holder_thread(void* arg) {
+    pi_test_state* state = static_cast<pi_test_state*>(arg);
+
+    mutex_acquire(&state->inner);
+    // let the waiter in right away, while we still hold the mutex
+    event_signal(&state->held, true);
+    zx_time_t until = current_time() + state->hold;
+    while (current_time() < until)
+        ;
+    mutex_release(&state->inner);
+
+    return 0;
+}
+
+static int pi_middle_thread(void* arg) {
+    pi_test_state* state = static_cast<pi_test_state*>(arg);
+
+    mutex_acquire(&state->outer);
+    // the waiter runs as soon as we block on the inner mutex below
+    event_signal(&state->held, false);
+    mutex_acquire(&state->inner);
+    mutex_release(&state->inner);
+    mutex_release(&state->outer);
+
+    return 0;
+}
+
+static int pi_hog_thread(void* arg) {
+    pi_test_state* state = static_cast<pi_test_state*>(arg);
+
+    while (current_time() < state->hog_until)
+        ;
+
+    return 0;
+}
+
+static thread_t* pi_start_thread(pi_test_state* state, const char* name,
+                                 thread_start_routine entry, int priority) {
+    thread_t* t = thread_create(name, entry, state, priority, DEFAULT_STACK_SIZE);
+    thread_set_cpu_affinity(t, cpu_num_to_mask(state->cpu));
+    thread_resume(t);
+    return t;
+}
+
+static int pi_waiter_thread(void* arg) {
+    pi_test_state* state = static_cast<pi_test_state*>(arg);
+
+    thread_t* holder = pi_start_thread(state, "pi holder", &pi_holder_thread, LOW_PRIORITY);
+    event_wait(&state->held);
+
+    thread_t* middle = nullptr;
+    if (state->chain) {
+        middle = pi_start_thread(state, "pi middle", &pi_middle_thread, LOW_PRIORITY + 1);
+        event_wait(&state->held);
+    }
+
+    state->hog_until = current_time() + kPiHogTime;
+    thread_t* hogs[kPiHogCount];
+    for (auto& t : hogs) {
+        t = pi_start_thread(state, "pi hog", &pi_hog_thread, DEFAULT_PRIORITY);
+    }
+
+    mutex_t* m = state->chain ? &state->outer : &state->inner;
+    zx_time_t start = current_time();
+    mutex_acquire(m);
+    state->latency = current_time() - start;
+    mutex_release(m);
+
+    thread_join(holder, nullptr, ZX_TIME_INFINITE);
+    if (middle)
+        thread_join(middle, nullptr, ZX_TIME_INFINITE);
+    for (auto t : hogs) {
+        thread_join(t, nullptr, ZX_TIME_INFINITE);
+    }
+
+    return 0;
+}
+
+__NO_INLINE static void priority_inheritance_test(bool chain) {
+    printf("starting %s priority inheritance test\n", chain ? "chained" : "direct");
+
+    // run everything on one cpu so the hogs really do compete with the holder
+    cpu_mask_t online = mp_get_online_mask();
+    cpu_num_t cpu = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (online & cpu_num_to_mask(i))
+            cpu = i;
+    }
+
+    zx_duration_t min = ZX_TIME_INFINITE, max = 0, total = 0;
+    for (int i = 0; i < kPiIterations; i++) {
+        pi_test_state state;
+        state.cpu = cpu;
+        state.chain = chain;
+        state.hold = kPiHoldTime;
+
+        thread_t* waiter = pi_start_thread(&state, "pi waiter", &pi_waiter_thread, HIGH_PRIORITY);
+        thread_join(waiter, nullptr, ZX_TIME_INFINITE);
+
+        min = MIN(min, state.latency);
+        max = MAX(max, state.latency);
+        total += state.latency;
+    }
+
+    printf("inversion latency over %d iterations: min %" PRIi64 " avg %" PRIi64
+           " max %" PRIi64 " ns (hold %" PRIi64 " ns, hogs %" PRIi64 " ns)\n",
+           kPiIterations, min, total / kPiIterations, max, kPiHoldTime, kPiHogTime);
+
+    // a waiter that had to sit behind the hogs was not helped by inheritance
+    if (max >= kPiHogTime)
+        printf("FAILED: waiter was blocked behind lower priority threads\n");
+
+    printf("done with priority inheritance test\n");
+}
+
+// Deadline class throttling test. A busy deadline thread with a small budget shares a cpu
+// with a busy fixed priority thread. The deadline thread runs ahead of it, but once its
+// budget is spent it has to be throttled until its next period, which leaves the rest of
+// the cpu to the fixed priority thread.
+struct deadline_test_state {
+    zx_time_t until;
+    zx_duration_t deadline_runtime;
+    zx_duration_t fair_runtime;
+};
+
+static const zx_duration_t kDeadlinePeriod = ZX_MSEC(10);
+static const zx_duration_t kDeadlineBudget = ZX_MSEC(1);
+static const zx_duration_t kDeadlineTestTime = ZX_MSEC(200);
+
+static int deadline_spin_thread(void* arg) {
+    deadline_test_state* state = static_cast<deadline_test_state*>(arg);
+
+    while (current_time() < state->until)
+        ;
+    state->deadline_runtime = thread_runtime(get_current_thread());
+
+    return 0;
+}
+
+static int fair_spin_thread(void* arg) {
+    deadline_test_state* state = static_cast<deadline_test_state*>(arg);
+
+    while (current_time() < state->until)
+        ;
+    state->fair_runtime = thread_runtime(get_current_thread());
+
+    return 0;
+}
+
+__NO_INLINE static void deadline_throttle_test() {
+    printf("starting deadline throttle test\n");
+
+    // put both threads on one cpu so they really do compete
+    cpu_mask_t online = mp_get_online_mask();
+    cpu_num_t cpu = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (online & cpu_num_to_mask(i))
+            cpu = i;
+    }
+
+    deadline_test_state state = {};
+    thread_t* deadline = thread_create("deadline spinner", &deadline_spin_thread, &state,
+                                       DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+    thread_t* fair = thread_create("fair spinner", &fair_spin_thread, &state,
+                                   DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+    thread_set_cpu_affinity(deadline, cpu_num_to_mask(cpu));
+    thread_set_cpu_affinity(fair, cpu_num_to_mask(cpu));
+
+    zx_status_t status = thread_set_deadline(deadline, kDeadlinePeriod, kDeadlineBudget,
+                                             kDeadlinePeriod);
+    if (status != ZX_OK)
+        printf("FAILED: deadline thread was not admitted: %d\n", status);
+
+    state.until = current_time() + kDeadlineTestTime;
+    thread_resume(fair);
+    thread_resume(deadline);
+    thread_join(deadline, nullptr, ZX_TIME_INFINITE);
+    thread_join(fair, nullptr, ZX_TIME_INFINITE);
+
+    printf("over %" PRIi64 " ns the deadline thread ran %" PRIi64 " ns and the fair thread %"
+           PRIi64 " ns\n", kDeadlineTestTime, state.deadline_runtime, state.fair_runtime);
+
+    // every period the deadline thread gets its budget and no more. allow for the period
+    // it was in when the test ended and one more for timer slop.
+    zx_duration_t max_deadline = kDeadlineBudget * (kDeadlineTestTime / kDeadlinePeriod + 2);
+    if (status == ZX_OK && state.deadline_runtime > max_deadline)
+        printf("FAILED: deadline thread was not throttled after its budget ran out\n");
+
+    // the fixed priority thread should have had most of the other 90% of the cpu
+    if (state.fair_runtime < kDeadlineTestTime / 2)
+        printf("FAILED: fixed priority thread was starved by the deadline thread\n");
+
+    printf("done with deadline throttle test\n");
+}
+
 static event_t e;
 
 static int event_signaler(void* arg) {
@@ -697,6 +914,9 @@ int thread_tests(void) {
     kill_tests();
 
     mutex_test();
+    priority_inheritance_test(false);
+    priority_inheritance_test(true);
+    deadline_throttle_test();
     event_test();
 
     spinlock_test();
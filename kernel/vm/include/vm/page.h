@@ -29,6 +29,9 @@ typedef struct vm_page {
         struct {
             // in allocated/just freed state, use a linked list to hold the page in a queue
             struct list_node node;
+            // while free in the pmm, log2 of the size in pages of the free block
+            // this page heads, or VM_PAGE_FREE_NOT_HEAD
+            uint8_t order;
         } free;
         struct {
             // attached to a vm object
@@ -45,6 +48,8 @@ typedef struct vm_page {
     };
 } vm_page_t;
 
+#define VM_PAGE_FREE_NOT_HEAD (0xff)
+
 // pmm will maintain pages of this size
 #define VM_PAGE_STRUCT_SIZE (sizeof(vm_page_t))
 static_assert(sizeof(vm_page_t) == 32, "");
@@ -0,0 +1,89 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <stdint.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+class PageSource;
+
+// A request for a page that an object's PageSource has yet to supply.
+//
+// An operation that finds such a page missing gets ZX_ERR_SHOULD_WAIT back, drops
+// every lock it holds, calls Wait() and then tries again.
+class PageRequest : public fbl::DoublyLinkedListable<PageRequest*> {
+public:
+    PageRequest();
+    ~PageRequest();
+
+    // Blocks until the page has been supplied, returning ZX_OK, or until the
+    // source goes away or the thread is killed, returning an error.
+    //
+    // With |suspendable| set, suspending the thread also ends the wait, with
+    // ZX_ERR_INTERNAL_INTR_RETRY. Only a fault from user mode can take that, since
+    // the faulting instruction can simply be run again once the thread resumes.
+    // Anything else waits the suspension out and lets it take effect on the way
+    // back to user mode.
+    zx_status_t Wait(bool suspendable);
+
+private:
+    friend class PageSource;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageRequest);
+
+    // set while the request is queued with |source_|
+    fbl::RefPtr<PageSource> source_;
+    uint64_t offset_ = 0;
+    event_t event_;
+};
+
+// Supplies the contents of the pages of a VmObjectPaged, in place of zero-filling
+// them, when they are first touched.
+class PageSource : public fbl::RefCounted<PageSource> {
+public:
+    // Queues |request| for the page at |offset|, asking for the page unless it has
+    // already been asked for. Returns ZX_ERR_SHOULD_WAIT, ZX_ERR_BAD_STATE if the
+    // source has been closed, or the error from asking.
+    zx_status_t GetPage(uint64_t offset, PageRequest* request);
+
+    // Completes the requests for the pages in [offset, offset + len), which the
+    // object now holds.
+    void OnPagesSupplied(uint64_t offset, uint64_t len);
+
+    // Detaches the source from its object. Outstanding and later requests fail.
+    void Close();
+
+protected:
+    PageSource() = default;
+    virtual ~PageSource();
+    friend fbl::RefPtr<PageSource>;
+
+    // Asks for the page at |offset| to be supplied.
+    virtual zx_status_t SendRequestLocked(uint64_t offset) TA_REQ(lock_) = 0;
+
+    // Called once, without the lock held, when the source is closed.
+    virtual void OnClose() {}
+
+    fbl::Mutex lock_;
+
+private:
+    friend class PageRequest;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageSource);
+
+    void CancelRequest(PageRequest* request);
+
+    bool closed_ TA_GUARDED(lock_) = false;
+    fbl::DoublyLinkedList<PageRequest*> requests_ TA_GUARDED(lock_);
+};
@@ -31,6 +31,12 @@ zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)  // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_KMAP (0x1) // allocate only from arenas marked KMAP
+#define PMM_ALLOC_FLAG_MOVABLE (0x2) // the pages could be reclaimed or moved; they are
+                                     // grouped apart from pinned kernel allocations
+#define PMM_ALLOC_FLAG_ZEROED (0x4) // return zero-filled pages; movable allocations take
+                                    // them from the pre-zeroed pool when it has any
+#define PMM_ALLOC_FLAG_NO_DRAIN (0x8) // pmm_alloc_contiguous only: fail rather than give the
+                                      // page caches back to the arenas to find a run
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
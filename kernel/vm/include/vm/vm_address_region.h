@@ -42,6 +42,10 @@
 // with execute permissions.  When on a VmMapping, controls whether or not the
 // mapping can gain this permission.
 #define VMAR_FLAG_CAN_MAP_EXECUTE (1 << 6)
+// Only map the faulting page on a page fault, rather than also mapping in the
+// neighbouring pages that are already resident.  When set on a
+// VmAddressRegion, everything later created inside it inherits the flag.
+#define VMAR_FLAG_NO_FAULT_AROUND (1 << 7)
 
 #define VMAR_CAN_RWX_FLAGS (VMAR_FLAG_CAN_MAP_READ |  \
                             VMAR_FLAG_CAN_MAP_WRITE | \
@@ -115,7 +119,9 @@ public:
 
     // Page fault in an address within the region.  Recursively traverses
     // the regions to find the target mapping, if it exists.
-    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags) = 0;
+    // Returns ZX_ERR_SHOULD_WAIT if the page has to come from a page source, in
+    // which case the caller should wait on |page_request| and fault again.
+    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) = 0;
 
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
@@ -197,6 +203,22 @@ protected:
 
     // node for element in list of parent's children.
     fbl::WAVLTreeNodeState<fbl::RefPtr<VmAddressRegionOrMapping>, bool> subregion_list_node_;
+
+    // Summary of the subtree rooted at this node in the parent's child list,
+    // used by the allocators to find free space without walking every child.
+    // Gaps here are the unallocated ranges between two children; the ranges
+    // before the first and after the last child are not included.
+    vaddr_t subtree_min_base_ = 0;  // base of the lowest child in the subtree
+    vaddr_t subtree_max_last_ = 0;  // last byte of the highest child in the subtree
+    size_t subtree_max_gap_ = 0;    // size of the largest gap in the subtree
+    size_t subtree_gap_pages_ = 0;  // total number of pages in all gaps in the subtree
+
+    // keeps the subtree summary above up to date as the child list changes
+    struct WAVLTreeObserver : public fbl::DefaultWAVLTreeObserver {
+        static void UpdateSubtreeState(VmAddressRegionOrMapping* node,
+                                       VmAddressRegionOrMapping* left,
+                                       VmAddressRegionOrMapping* right);
+    };
 };
 
 // A representation of a contiguous range of virtual address space
@@ -235,7 +257,7 @@ public:
     bool is_mapping() const override { return false; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     // constructor for use in creating a VmAddressRegionDummy
@@ -259,7 +281,7 @@ protected:
 private:
     using ChildList = fbl::WAVLTree<vaddr_t, fbl::RefPtr<VmAddressRegionOrMapping>,
                                     fbl::DefaultKeyedObjectTraits<vaddr_t, VmAddressRegionOrMapping>,
-                                    WAVLTreeTraits>;
+                                    WAVLTreeTraits, WAVLTreeObserver>;
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmAddressRegion);
 
@@ -322,9 +344,23 @@ private:
     // Utility for allocators for iterating over gaps between allocations
     // F should have a signature of bool func(vaddr_t gap_base, size_t gap_size).
     // If func returns false, the iteration stops.  gap_base will be aligned in
-    // accordance with align_pow2.
+    // accordance with align_pow2.  Runs of children with no gap of at least
+    // min_gap bytes between them are skipped, so func may not see every gap
+    // smaller than min_gap.
     template <typename F>
-    void ForEachGap(F func, uint8_t align_pow2);
+    void ForEachGap(F func, uint8_t align_pow2, size_t min_gap);
+
+    // Helper for ForEachGap which visits the subtree rooted at |node|.
+    // Returns false if func stopped the iteration.
+    template <typename F>
+    bool ForEachGapInSubtree(const ChildList::iterator& node, F& func, vaddr_t align,
+                             size_t min_gap, vaddr_t* prev_region_end);
+
+    // Find the gap between two children that contains the |*index|th gap page,
+    // counting up from the lowest address.  |*index| must be less than the
+    // root's subtree_gap_pages_.  On return, |*index| is the page's offset in
+    // the gap.
+    void FindGapByPageLocked(size_t* index, vaddr_t* gap_base, size_t* gap_len);
 
     // list of subregions, indexed by base address
     ChildList subregions_;
@@ -368,7 +404,7 @@ public:
         return;
     }
 
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override {
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override {
         // We should never be trying to page fault on this...
         ASSERT(false);
         return ZX_ERR_BAD_STATE;
@@ -432,7 +468,7 @@ public:
     bool is_mapping() const override { return true; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     ~VmMapping() override;
@@ -467,11 +503,27 @@ private:
     // Implementation for Protect().  This does not acquire the aspace lock.
     zx_status_t ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags);
 
+    // Shrink this mapping in place to |size| bytes, keeping its base, and
+    // refresh the parent's bookkeeping of the free space around it.
+    void SetSizeLocked(size_t size);
+
     // Version of AllocatedPages() that does not acquire the aspace lock
     size_t AllocatedPagesLocked() const override;
 
     void Activate() override;
 
+    // Map the resident pages of object_ surrounding the faulting address |va|,
+    // which has just been mapped, with |mmu_flags|.
+    void FaultAroundLocked(vaddr_t va, uint mmu_flags);
+
+    // Whether the large page aligned block around |va| lies entirely within
+    // this mapping at a large page aligned offset of object_.
+    bool CanMapLargePageLocked(vaddr_t va) const;
+
+    // Map the block around |va| with a single large page if object_ holds it
+    // as one physically contiguous run, replacing any smaller mappings, with |mmu_flags|.
+    zx_status_t MapLargePageLocked(vaddr_t va, uint mmu_flags);
+
     // Version of Activate that does not take the object_ lock.
     // Should be annotated TA_REQ(object_->lock()), but due to limitations
     // in Clang around capability aliasing, we need to relax the analysis.
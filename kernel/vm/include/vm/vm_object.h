@@ -24,10 +24,25 @@
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 
+class PageRequest;
+class PageSource;
 class VmMapping;
 
 typedef zx_status_t (*vmo_lookup_fn_t)(void* context, size_t offset, size_t index, paddr_t pa);
 
+// one step of a batch passed to VmObject::RangeOpBatch()
+enum class VmRangeOpType : uint32_t {
+    Commit,
+    Decommit,
+    Pin,
+};
+
+struct VmRangeOp {
+    VmRangeOpType type;
+    uint64_t offset;
+    uint64_t len;
+};
+
 // The base vm object that holds a range of bytes of data
 //
 // Can be created without mapping and used as a container of data, or mappable
@@ -84,6 +99,16 @@ public:
         panic("Unpin should only be called on a pinned range");
     }
 
+    // perform |count| commit, decommit or pin operations in order under a single acquisition
+    // of the object's lock. every range is checked before any is applied; after that the
+    // batch stops at the first operation that fails. |*completed| is set to the
+    // number that succeeded; their effects are kept, so a caller that pinned ranges is
+    // responsible for unpinning them.
+    virtual zx_status_t RangeOpBatch(const VmRangeOp* ops, size_t count, size_t* completed) {
+        *completed = 0;
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // read/write operators against kernel pointers only
     virtual zx_status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read) {
         return ZX_ERR_NOT_SUPPORTED;
@@ -170,11 +195,68 @@ public:
 
     // get a pointer to the page structure and/or physical address at the specified offset.
     // valid flags are VMM_PF_FLAG_*
+    // if the page has to come from the object's page source and |page_request| is not null,
+    // the request is queued and ZX_ERR_SHOULD_WAIT returned; the caller should drop its locks,
+    // wait on |page_request| and try again.
     virtual zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                                      vm_page_t** page, paddr_t* pa) TA_REQ(lock_) {
+                                      PageRequest* page_request, vm_page_t** page,
+                                      paddr_t* pa) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // commit the large page sized, large page aligned block of the object holding |offset| as one
+    // physically contiguous run.  fails if any page of the block is already committed, or if the
+    // object was not created to use large pages.  |faulting| only takes a run that is free right
+    // now, without draining the page caches to find one.
+    virtual zx_status_t CommitLargePageLocked(uint64_t offset, bool faulting) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // if the large page sized, large page aligned block of the object starting at |offset| is
+    // held by this object as one physically contiguous, aligned run, return its base address.
+    virtual zx_status_t GetLargePageLocked(uint64_t offset, paddr_t* pa) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // where the object's missing pages come from, or null if they are zero-filled
+    virtual PageSource* page_source() const { return nullptr; }
+
+    // move the committed pages of [offset, offset + len) out of this object and onto |pages|,
+    // in order, leaving the range empty. fails unless every page of the range is committed.
+    virtual zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) {
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // hand the pages on |pages| to an object with a page source as the contents of
+    // [offset, offset + len), completing the requests waiting on them. pages the object
+    // already holds are kept, and the supplied ones for them freed.
+    virtual zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // scan up to |max_pages| committed pages from object offset |*offset| onward for pages that
+    // are entirely zero and free them, leaving their reads to the shared zero page again.
+    // advances |*offset| past the pages scanned, to UINT64_MAX if the object has nothing
+    // further to scan.  returns the number of pages freed; |*scanned| is the number examined.
+    virtual size_t ReclaimZeroPages(uint64_t* offset, size_t max_pages, size_t* scanned) {
+        *offset = UINT64_MAX;
+        *scanned = 0;
+        return 0;
+    }
+
+    // a discardable object holds contents that its owner can regenerate. marking an object
+    // discardable leaves it locked once; while it is unlocked the kernel may discard its pages
+    // under memory pressure. locks nest, and |*was_discarded| reports whether the contents were
+    // discarded since the object was last unlocked. a caller that could not pass that on backs
+    // its lock out with CancelLockDiscardable(), so that the next lock reports it instead.
+    virtual zx_status_t SetDiscardable() { return ZX_ERR_NOT_SUPPORTED; }
+    virtual zx_status_t LockDiscardable(bool* was_discarded) { return ZX_ERR_NOT_SUPPORTED; }
+    virtual zx_status_t UnlockDiscardable() { return ZX_ERR_NOT_SUPPORTED; }
+    virtual zx_status_t CancelLockDiscardable(bool was_discarded) { return ZX_ERR_NOT_SUPPORTED; }
+
+    // free every page of an unlocked discardable object. returns the number of pages freed.
+    virtual size_t Discard() { return 0; }
+
     fbl::Mutex* lock() TA_RET_CAP(lock_) { return &lock_; }
     fbl::Mutex& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
@@ -194,6 +276,19 @@ public:
     void RemoveChildLocked(VmObject* r) TA_REQ(lock_);
     uint32_t num_children() const;
 
+    // The scan cursor walks every VMO in the system from oldest to newest and
+    // survives the VMO it is at being destroyed. There is a single cursor, for
+    // the zero page scanner.
+    //
+    // Sets |vmo| to the VMO at the cursor, moving past any that are already
+    // being destroyed, and returns true. Returns false once the cursor has moved
+    // past the newest VMO, sending it back to the oldest one.
+    static bool GetScanCursor(fbl::RefPtr<VmObject>* vmo);
+
+    // Moves the scan cursor on from |vmo|, as returned by GetScanCursor(), to
+    // the next newer VMO. Does nothing if the cursor has already moved on.
+    static void AdvanceScanCursor(const VmObject* vmo);
+
     // Calls the provided |func(const VmObject&)| on every VMO in the system,
     // from oldest to newest. Stops if |func| returns an error, returning the
     // error value.
@@ -275,4 +370,10 @@ private:
     using GlobalList = fbl::DoublyLinkedList<VmObject*, GlobalListTraits>;
     static fbl::Mutex all_vmos_lock_;
     static GlobalList all_vmos_ TA_GUARDED(all_vmos_lock_);
+
+    // The VMO the scan cursor is at, or null if it is at the start or, when
+    // |scan_cursor_at_end_| is set, the end of the list.
+    static void AdvanceScanCursorLocked() TA_REQ(all_vmos_lock_);
+    static VmObject* scan_cursor_ TA_GUARDED(all_vmos_lock_);
+    static bool scan_cursor_at_end_ TA_GUARDED(all_vmos_lock_);
 };
@@ -17,6 +17,7 @@
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
 #include <stdint.h>
+#include <vm/page_source.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_object.h>
@@ -27,10 +28,22 @@
 // the main VM object type, holding a list of pages
 class VmObjectPaged final : public VmObject {
 public:
-    static zx_status_t Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* vmo);
+    // options to Create()
+    // back and map large page aligned blocks with large pages where possible
+    static constexpr uint32_t kLargePages = (1u << 0);
+
+    static zx_status_t Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* vmo) {
+        return Create(pmm_alloc_flags, 0u, size, vmo);
+    }
+    static zx_status_t Create(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                              fbl::RefPtr<VmObject>* vmo);
 
     static zx_status_t CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* vmo);
 
+    // create an object whose pages are supplied by |src| rather than zero-filled
+    static zx_status_t CreateExternal(fbl::RefPtr<PageSource> src, uint32_t pmm_alloc_flags,
+                                      uint64_t size, fbl::RefPtr<VmObject>* vmo);
+
     zx_status_t Resize(uint64_t size) override;
     zx_status_t ResizeLocked(uint64_t size) override TA_REQ(lock_);
     uint64_t size() const override
@@ -49,6 +62,8 @@ public:
     zx_status_t Pin(uint64_t offset, uint64_t len) override;
     void Unpin(uint64_t offset, uint64_t len) override;
 
+    zx_status_t RangeOpBatch(const VmRangeOp* ops, size_t count, size_t* completed) override;
+
     zx_status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read) override;
     zx_status_t Write(const void* ptr, uint64_t offset, size_t len, size_t* bytes_written) override;
     zx_status_t Lookup(uint64_t offset, uint64_t len, uint pf_flags,
@@ -70,10 +85,29 @@ public:
     zx_status_t SyncCache(const uint64_t offset, const uint64_t len) override;
 
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                              vm_page_t**, paddr_t*) override
+                              PageRequest* page_request, vm_page_t**, paddr_t*) override
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    size_t ReclaimZeroPages(uint64_t* offset, size_t max_pages, size_t* scanned) override;
+
+    PageSource* page_source() const override { return page_source_.get(); }
+    zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) override;
+    zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) override;
+
+    zx_status_t SetDiscardable() override;
+    zx_status_t LockDiscardable(bool* was_discarded) override;
+    zx_status_t UnlockDiscardable() override;
+    zx_status_t CancelLockDiscardable(bool was_discarded) override;
+    size_t Discard() override;
+
+    // discard unlocked discardable objects, least recently unlocked first, until at least
+    // |max_pages| pages have been freed or none are left. returns the number of pages freed.
+    static size_t EvictDiscardable(size_t max_pages);
+
+    zx_status_t CommitLargePageLocked(uint64_t offset, bool faulting) override TA_REQ(lock_);
+    zx_status_t GetLargePageLocked(uint64_t offset, paddr_t* pa) override TA_REQ(lock_);
+
     zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
         // Calls a Locked method of the child, which confuses analysis.
@@ -107,9 +141,21 @@ private:
     // internal page list routine
     void AddPageToArray(size_t index, vm_page_t* p);
 
+    zx_status_t CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed)
+        TA_REQ(lock_);
+    zx_status_t DecommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* decommitted)
+        TA_REQ(lock_);
+
     zx_status_t PinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
     void UnpinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
 
+    // add or remove the object from the list of unlocked discardable objects
+    void AddToDiscardableListLocked() TA_REQ(lock_);
+    void RemoveFromDiscardableListLocked() TA_REQ(lock_);
+
+    // drop one lock of a discardable object
+    zx_status_t UnlockDiscardableLocked() TA_REQ(lock_);
+
     // internal check if any pages in a range are pinned
     bool AnyPagesPinnedLocked(uint64_t offset, size_t len) TA_REQ(lock_);
 
@@ -131,4 +177,29 @@ private:
 
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
+
+    // where missing pages come from, if not zero-filled. set at creation
+    fbl::RefPtr<PageSource> page_source_;
+
+    // whether aligned blocks are committed as large pages. set at creation
+    bool large_pages_ = false;
+
+    // discardable state: see SetDiscardable()
+    bool discardable_ TA_GUARDED(lock_) = false;
+    bool discarded_ TA_GUARDED(lock_) = false;
+    uint32_t discardable_lock_count_ TA_GUARDED(lock_) = 0;
+
+    // Per-node state for the list of unlocked discardable objects.
+    using DiscardableNodeState = fbl::DoublyLinkedListNodeState<VmObjectPaged*>;
+    DiscardableNodeState discardable_list_state_;
+
+    // The list of unlocked discardable objects, least recently unlocked first.
+    struct DiscardableListTraits {
+        static DiscardableNodeState& node_state(VmObjectPaged& vmo) {
+            return vmo.discardable_list_state_;
+        }
+    };
+    using DiscardableList = fbl::DoublyLinkedList<VmObjectPaged*, DiscardableListTraits>;
+    static fbl::Mutex discardable_list_lock_;
+    static DiscardableList discardable_list_ TA_GUARDED(discardable_list_lock_);
 };
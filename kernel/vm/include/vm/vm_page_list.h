@@ -23,7 +23,9 @@ public:
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmPageListNode);
 
-    static const size_t kPageFanOut = 16;
+    // each node covers 256KB of the object, so that a large object needs few nodes and
+    // sequential walks stay within one node's array for longer
+    static const size_t kPageFanOut = 64;
 
     // accessors
     uint64_t offset() const { return obj_offset_; }
@@ -85,18 +87,14 @@ public:
     vm_page* RemovePage(size_t index);
     zx_status_t AddPage(vm_page* p, size_t index);
 
-    bool IsEmpty() const {
-        for (const auto p : pages_) {
-            if (p)
-                return false;
-        }
-        return true;
-    }
+    bool IsEmpty() const { return page_count_ == 0; }
 
 private:
     fbl::Canary<fbl::magic("PLST")> canary_;
 
     uint64_t obj_offset_ = 0;
+    // number of non-null entries in pages_
+    size_t page_count_ = 0;
     vm_page* pages_[kPageFanOut] = {};
 };
 
@@ -190,8 +188,20 @@ public:
     zx_status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
     zx_status_t FreePage(uint64_t offset);
+    // takes the page at |offset| out of the list without freeing it, returning null if
+    // there is none
+    vm_page* RemovePage(uint64_t offset);
     size_t FreeAllPages();
 
 private:
+    // find the node starting at |node_offset|, or null if there is none
+    VmPageListNode* FindNode(uint64_t node_offset);
+    // remove |node| from the tree and free it
+    void EraseNode(VmPageListNode* node);
+
     fbl::WAVLTree<uint64_t, fbl::unique_ptr<VmPageListNode>> list_;
+
+    // the node most recently found, checked before searching the tree so that
+    // runs of lookups within one node don't each descend it
+    VmPageListNode* cursor_ = nullptr;
 };
@@ -0,0 +1,121 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/page_source.h>
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <fbl/auto_lock.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+using fbl::AutoLock;
+
+PageRequest::PageRequest() {
+    event_init(&event_, false, 0);
+}
+
+PageRequest::~PageRequest() {
+    DEBUG_ASSERT(!InContainer());
+    DEBUG_ASSERT(!source_);
+    event_destroy(&event_);
+}
+
+zx_status_t PageRequest::Wait(bool suspendable) {
+    DEBUG_ASSERT(source_);
+
+    zx_status_t status;
+    if (suspendable) {
+        status = event_wait_deadline(&event_, ZX_TIME_INFINITE, true);
+    } else {
+        // a suspend request that arrives while blocked still wakes us, after which it
+        // is pending and ignored by the next wait
+        do {
+            status = event_wait_with_mask(&event_, THREAD_SIGNAL_SUSPEND);
+        } while (status == ZX_ERR_INTERNAL_INTR_RETRY);
+    }
+
+    // a request that was completed has already been taken off the source's list
+    source_->CancelRequest(this);
+    source_.reset();
+    return status;
+}
+
+PageSource::~PageSource() {
+    DEBUG_ASSERT(requests_.is_empty());
+}
+
+zx_status_t PageSource::GetPage(uint64_t offset, PageRequest* request) {
+    DEBUG_ASSERT(!request->source_);
+
+    AutoLock a(&lock_);
+
+    if (closed_) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // threads faulting on the same page share one request to the provider
+    bool sent = false;
+    for (const auto& r : requests_) {
+        if (r.offset_ == offset) {
+            sent = true;
+            break;
+        }
+    }
+
+    if (!sent) {
+        LTRACEF("source %p requesting offset %#" PRIx64 "\n", this, offset);
+        zx_status_t status = SendRequestLocked(offset);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    request->source_ = fbl::WrapRefPtr(this);
+    request->offset_ = offset;
+    event_unsignal(&request->event_);
+    requests_.push_back(request);
+    return ZX_ERR_SHOULD_WAIT;
+}
+
+void PageSource::OnPagesSupplied(uint64_t offset, uint64_t len) {
+    AutoLock a(&lock_);
+
+    for (auto iter = requests_.begin(); iter != requests_.end();) {
+        auto cur = iter++;
+        if (cur->offset_ >= offset && cur->offset_ - offset < len) {
+            PageRequest* request = requests_.erase(cur);
+            event_signal_etc(&request->event_, false, ZX_OK);
+        }
+    }
+}
+
+void PageSource::Close() {
+    {
+        AutoLock a(&lock_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+
+        while (!requests_.is_empty()) {
+            PageRequest* request = requests_.pop_front();
+            event_signal_etc(&request->event_, false, ZX_ERR_BAD_STATE);
+        }
+    }
+
+    OnClose();
+}
+
+void PageSource::CancelRequest(PageRequest* request) {
+    AutoLock a(&lock_);
+    if (request->InContainer()) {
+        requests_.erase(*request);
+    }
+}
@@ -10,9 +10,16 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <arch/ops.h>
+#include <kernel/align.h>
+#include <kernel/cmdline.h>
+#include <kernel/event.h>
 #include <kernel/mp.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lk/init.h>
 #include <platform.h>
 #include <pow2.h>
@@ -26,6 +33,7 @@
 #include "pmm_arena.h"
 #include "vm_priv.h"
 
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -42,6 +50,67 @@ static fbl::Mutex arena_lock;
 static fbl::DoublyLinkedList<PmmArena*> arena_list TA_GUARDED(arena_lock);
 static size_t arena_cumulative_size TA_GUARDED(arena_lock);
 
+// Per-cpu caches of free pages in front of the arenas, so that single page
+// allocations and frees usually don't need arena_lock.  Each cache refills
+// from and drains to the arenas in batches of kPageCacheBatch pages.
+//
+// As far as the arenas are concerned a cached page is allocated: it is off
+// the arena free list and in the ALLOC state, which keeps the range and
+// contiguous allocators from handing it out.  It is still counted as free.
+// The caches only hold movable pages from KMAP arenas and only serve
+// PMM_ALLOC_FLAG_MOVABLE allocations; pinned allocations go to the arenas.
+namespace {
+
+constexpr size_t kPageCacheBatch = 32;
+constexpr size_t kPageCacheMax = 2 * kPageCacheBatch;
+
+struct PageCache {
+    SpinLock lock;
+    list_node free_list TA_GUARDED(lock) = LIST_INITIAL_VALUE(free_list);
+    size_t count TA_GUARDED(lock) = 0;
+} __CPU_ALIGN;
+
+PageCache page_cache[SMP_MAX_CPUS];
+
+// total number of pages in all of the caches. only updated under the lock of
+// the cache the pages go into or come out of, so it never counts a page
+// twice or goes below zero
+fbl::atomic<size_t> page_cache_count;
+
+// Pool of pages zeroed ahead of time by a low priority thread, which
+// PMM_ALLOC_FLAG_ZEROED allocations take from before zeroing pages
+// themselves.  Like cached pages, pooled pages look allocated to the
+// arenas but are counted as free.  The pool holds movable pages, so only
+// movable allocations take from it; pinned ones zero their own.
+constexpr size_t kZeroPoolBatch = 16;
+
+SpinLock zero_pool_lock;
+list_node zero_pool TA_GUARDED(zero_pool_lock) = LIST_INITIAL_VALUE(zero_pool);
+fbl::atomic<size_t> zero_pool_count;
+
+// number of pages the thread keeps in the pool, from kernel.pmm.zero-pool-pages
+size_t zero_pool_target;
+
+// signaled when the pool falls below half of its target
+event_t zero_pool_event = EVENT_INITIAL_VALUE(zero_pool_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+// set from the time zero_pool_event is signaled until the thread is done
+// refilling, so that allocations draining the pool signal it only once
+fbl::atomic<bool> zero_pool_refill_requested;
+
+// set when the thread stopped refilling for want of free memory. it is only
+// woken again once enough pages have been freed back to the arenas
+fbl::atomic<bool> zero_pool_starved;
+
+} // namespace
+
+KCOUNTER(pmm_cache_hit_count, "kernel.pmm.cache.hit");
+KCOUNTER(pmm_cache_refill_count, "kernel.pmm.cache.refill");
+KCOUNTER(pmm_cache_drain_count, "kernel.pmm.cache.drain");
+KCOUNTER(pmm_zero_pool_hit_count, "kernel.pmm.zero_pool.hit");
+KCOUNTER(pmm_zero_pool_miss_count, "kernel.pmm.zero_pool.miss");
+KCOUNTER(pmm_zero_pool_zeroed_count, "kernel.pmm.zero_pool.zeroed");
+
 #if PMM_ENABLE_FREE_FILL
 static void pmm_enforce_fill(uint level) {
     for (auto& a : arena_list) {
@@ -75,6 +144,18 @@ vm_page_t* paddr_to_vm_page(paddr_t addr) TA_NO_THREAD_SAFETY_ANALYSIS {
     return nullptr;
 }
 
+// Whether |page| may be put in a page cache. Like vm_page_to_paddr, this
+// walks the arena list without the lock; the page block type it reads may
+// be changing underneath it, but a stale answer only costs fragmentation.
+static bool page_is_cacheable(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
+    for (const auto& a : arena_list) {
+        if (a.page_belongs_to_arena(page)) {
+            return (a.flags() & PMM_ARENA_FLAG_KMAP) != 0 && a.page_is_movable(page);
+        }
+    }
+    return false;
+}
+
 // We disable thread safety analysis here, since this function is only called
 // during early boot before threading exists.
 zx_status_t pmm_add_arena(const pmm_arena_info_t* info) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -113,25 +194,287 @@ done_add:
     return ZX_OK;
 }
 
-vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
-    AutoLock al(&arena_lock);
+static void pmm_free_locked(list_node* list) TA_REQ(arena_lock) {
+    while (!list_is_empty(list)) {
+        vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
 
-    /* walk the arenas in order until we find one with a free page */
+        /* see which arena this page belongs to and add it */
+        for (auto& a : arena_list) {
+            if (a.FreePage(page) >= 0) {
+                break;
+            }
+        }
+    }
+}
+
+static size_t pmm_alloc_pages_locked(size_t count, uint alloc_flags, list_node* list)
+    TA_REQ(arena_lock) {
+    /* walk the arenas in order, allocating as many pages as we can from each */
+    size_t allocated = 0;
     for (auto& a : arena_list) {
+        DEBUG_ASSERT(count > allocated);
+
         /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
         if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
             if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
                 continue;
         }
 
-        // try to allocate the page out of the arena
-        vm_page_t* page = a.AllocPage(pa);
-        if (page)
-            return page;
+        // ask the arena to allocate some pages
+        allocated += a.AllocPages(count - allocated, alloc_flags, list);
+        DEBUG_ASSERT(allocated <= count);
+        if (allocated == count)
+            break;
     }
 
-    LTRACEF("failed to allocate page\n");
-    return nullptr;
+    return allocated;
+}
+
+// Takes up to |count| pages out of the current cpu's cache.
+static size_t page_cache_alloc(size_t count, list_node* list) {
+    PageCache& cache = page_cache[arch_curr_cpu_num()];
+
+    size_t allocated = 0;
+    spin_lock_saved_state_t state;
+    cache.lock.AcquireIrqSave(state);
+    while (allocated < count) {
+        vm_page_t* page = list_remove_head_type(&cache.free_list, vm_page_t, free.node);
+        if (!page)
+            break;
+        list_add_tail(list, &page->free.node);
+        allocated++;
+    }
+    cache.count -= allocated;
+    page_cache_count.fetch_sub(allocated);
+    cache.lock.ReleaseIrqRestore(state);
+
+    if (allocated > 0)
+        kcounter_add(pmm_cache_hit_count, allocated);
+    return allocated;
+}
+
+// Refills the current cpu's cache with a batch of pages and takes one of
+// them out again for the caller.
+static vm_page_t* page_cache_refill() {
+    list_node list = LIST_INITIAL_VALUE(list);
+    {
+        AutoLock al(&arena_lock);
+        size_t allocated = pmm_alloc_pages_locked(kPageCacheBatch,
+                                                  PMM_ALLOC_FLAG_KMAP | PMM_ALLOC_FLAG_MOVABLE,
+                                                  &list);
+        if (allocated == 0)
+            return nullptr;
+    }
+    kcounter_add(pmm_cache_refill_count, 1u);
+
+    vm_page_t* page = list_remove_head_type(&list, vm_page_t, free.node);
+
+    // we may have moved to another cpu while refilling; that's fine, these
+    // pages go to whichever cache is local now
+    PageCache& cache = page_cache[arch_curr_cpu_num()];
+    spin_lock_saved_state_t state;
+    cache.lock.AcquireIrqSave(state);
+    while (!list_is_empty(&list)) {
+        vm_page_t* p = list_remove_head_type(&list, vm_page_t, free.node);
+        list_add_tail(&cache.free_list, &p->free.node);
+        cache.count++;
+        page_cache_count.fetch_add(1);
+    }
+    cache.lock.ReleaseIrqRestore(state);
+
+    return page;
+}
+
+// Returns the pages in every cache to the arenas. Used when an allocation
+// can't be satisfied from the arenas alone.
+static void page_cache_drain_all() {
+    list_node list = LIST_INITIAL_VALUE(list);
+    size_t drained = 0;
+    for (auto& cache : page_cache) {
+        spin_lock_saved_state_t state;
+        cache.lock.AcquireIrqSave(state);
+        list_node* node;
+        while ((node = list_remove_head(&cache.free_list))) {
+            list_add_tail(&list, node);
+        }
+        drained += cache.count;
+        page_cache_count.fetch_sub(cache.count);
+        cache.count = 0;
+        cache.lock.ReleaseIrqRestore(state);
+    }
+    if (drained == 0)
+        return;
+
+    AutoLock al(&arena_lock);
+    pmm_free_locked(&list);
+    kcounter_add(pmm_cache_drain_count, 1u);
+}
+
+// Takes up to |count| pages out of the zeroed page pool.
+static size_t zero_pool_alloc(size_t count, list_node* list) {
+    // don't take the lock just to find the pool empty
+    if (zero_pool_count.load() == 0)
+        return 0;
+
+    size_t allocated = 0;
+    spin_lock_saved_state_t state;
+    zero_pool_lock.AcquireIrqSave(state);
+    while (allocated < count) {
+        vm_page_t* page = list_remove_head_type(&zero_pool, vm_page_t, free.node);
+        if (!page)
+            break;
+        list_add_tail(list, &page->free.node);
+        allocated++;
+    }
+    size_t remaining = zero_pool_count.fetch_sub(allocated) - allocated;
+    zero_pool_lock.ReleaseIrqRestore(state);
+
+    kcounter_add(pmm_zero_pool_hit_count, allocated);
+    if (remaining < zero_pool_target / 2 && !zero_pool_starved.load() &&
+        !zero_pool_refill_requested.exchange(true))
+        event_signal(&zero_pool_event, false);
+    return allocated;
+}
+
+// Returns the pages in the zeroed page pool to the arenas.
+static void zero_pool_drain() {
+    list_node list = LIST_INITIAL_VALUE(list);
+    spin_lock_saved_state_t state;
+    zero_pool_lock.AcquireIrqSave(state);
+    list_node* node;
+    while ((node = list_remove_head(&zero_pool))) {
+        list_add_tail(&list, node);
+    }
+    size_t drained = zero_pool_count.load();
+    zero_pool_lock.ReleaseIrqRestore(state);
+    if (drained == 0)
+        return;
+
+    AutoLock al(&arena_lock);
+    pmm_free_locked(&list);
+    zero_pool_count.fetch_sub(drained);
+}
+
+// Gives every free page held outside of the arenas back to them. Used when an
+// allocation can't be satisfied from the arenas alone.
+static void pmm_drain_caches() {
+    page_cache_drain_all();
+    zero_pool_drain();
+}
+
+static void pmm_zero_page(vm_page_t* page) {
+    void* ptr = paddr_to_physmap(vm_page_to_paddr(page));
+    DEBUG_ASSERT(ptr);
+    arch_zero_page(ptr);
+}
+
+static int zero_pool_thread(void* arg) {
+    for (;;) {
+        event_wait(&zero_pool_event);
+
+        bool starved = false;
+        while (zero_pool_count.load() < zero_pool_target) {
+            // leave the last of the free memory alone, or we would just be
+            // drained again by the allocations that are failing for want of it
+            if (pmm_count_free_pages() < 4 * zero_pool_target) {
+                starved = true;
+                break;
+            }
+
+            list_node list = LIST_INITIAL_VALUE(list);
+            size_t count = pmm_alloc_pages(kZeroPoolBatch,
+                                           PMM_ALLOC_FLAG_KMAP | PMM_ALLOC_FLAG_MOVABLE, &list);
+            if (count == 0) {
+                starved = true;
+                break;
+            }
+
+            vm_page_t* page;
+            list_for_every_entry (&list, page, vm_page_t, free.node) {
+                pmm_zero_page(page);
+            }
+            kcounter_add(pmm_zero_pool_zeroed_count, count);
+
+            spin_lock_saved_state_t state;
+            zero_pool_lock.AcquireIrqSave(state);
+            while ((page = list_remove_head_type(&list, vm_page_t, free.node))) {
+                list_add_tail(&zero_pool, &page->free.node);
+            }
+            zero_pool_count.fetch_add(count);
+            zero_pool_lock.ReleaseIrqRestore(state);
+        }
+
+        // a starved pool is woken by pmm_free() rather than by allocations
+        if (starved)
+            zero_pool_starved.store(true);
+        zero_pool_refill_requested.store(false);
+    }
+    return 0;
+}
+
+static void zero_pool_init(uint level) {
+    zero_pool_target = cmdline_get_uint32("kernel.pmm.zero-pool-pages", 1024);
+    if (zero_pool_target == 0)
+        return;
+
+    // just above idle, so that it only runs on otherwise idle cpus
+    thread_t* t = thread_create("pmm-zero", zero_pool_thread, nullptr,
+                                IDLE_PRIORITY + 1, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("PMM: failed to create zero page thread\n");
+        zero_pool_target = 0;
+        return;
+    }
+    thread_detach_and_resume(t);
+    zero_pool_refill_requested.store(true);
+    event_signal(&zero_pool_event, false);
+}
+
+LK_INIT_HOOK(pmm_zero_pool, &zero_pool_init, LK_INIT_LEVEL_THREADING);
+
+vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+    list_node list = LIST_INITIAL_VALUE(list);
+    vm_page_t* page = nullptr;
+    bool zeroed = false;
+    if ((alloc_flags & PMM_ALLOC_FLAG_ZEROED) && (alloc_flags & PMM_ALLOC_FLAG_MOVABLE) &&
+        zero_pool_alloc(1, &list) == 1) {
+        page = list_remove_head_type(&list, vm_page_t, free.node);
+        zeroed = true;
+    }
+    if (!page && (alloc_flags & PMM_ALLOC_FLAG_MOVABLE)) {
+        if (page_cache_alloc(1, &list) == 1) {
+            page = list_remove_head_type(&list, vm_page_t, free.node);
+        } else {
+            page = page_cache_refill();
+        }
+    }
+
+    if (!page) {
+        /* pinned, or the KMAP arenas are exhausted: try everything else and,
+         * failing that, the other cpus' caches */
+        for (int pass = 0; pass < 2 && !page; pass++) {
+            if (pass > 0)
+                pmm_drain_caches();
+
+            AutoLock al(&arena_lock);
+            if (pmm_alloc_pages_locked(1, alloc_flags, &list) == 1)
+                page = list_remove_head_type(&list, vm_page_t, free.node);
+        }
+        if (!page) {
+            LTRACEF("failed to allocate page\n");
+            return nullptr;
+        }
+    }
+
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_ALLOC);
+    if ((alloc_flags & PMM_ALLOC_FLAG_ZEROED) && !zeroed) {
+        pmm_zero_page(page);
+        kcounter_add(pmm_zero_pool_miss_count, 1u);
+    }
+    if (pa) {
+        *pa = vm_page_to_paddr(page);
+    }
+    return page;
 }
 
 size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
@@ -143,27 +486,38 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     if (count == 0)
         return 0;
 
-    AutoLock al(&arena_lock);
-
-    /* walk the arenas in order, allocating as many pages as we can from each */
     size_t allocated = 0;
-    for (auto& a : arena_list) {
-        DEBUG_ASSERT(count > allocated);
+    if ((alloc_flags & PMM_ALLOC_FLAG_ZEROED) && (alloc_flags & PMM_ALLOC_FLAG_MOVABLE))
+        allocated = zero_pool_alloc(count, list);
 
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
+    /* anything that didn't come out of the zero pool needs zeroing */
+    list_node fresh = LIST_INITIAL_VALUE(fresh);
+    list_node* dest = (alloc_flags & PMM_ALLOC_FLAG_ZEROED) ? &fresh : list;
+    size_t fresh_count = 0;
 
-        // ask the arena to allocate some pages
-        allocated += a.AllocPages(count - allocated, list);
-        DEBUG_ASSERT(allocated <= count);
-        if (allocated == count)
-            break;
+    /* small requests are served from the cache first; larger ones would just
+     * empty it and are better off going to the arenas directly */
+    if ((alloc_flags & PMM_ALLOC_FLAG_MOVABLE) && count - allocated <= kPageCacheBatch)
+        fresh_count = page_cache_alloc(count - allocated, dest);
+
+    for (int pass = 0; pass < 2 && allocated + fresh_count < count; pass++) {
+        if (pass > 0)
+            pmm_drain_caches();
+
+        AutoLock al(&arena_lock);
+        fresh_count += pmm_alloc_pages_locked(count - allocated - fresh_count, alloc_flags, dest);
     }
 
-    return allocated;
+    if (alloc_flags & PMM_ALLOC_FLAG_ZEROED) {
+        vm_page_t* page;
+        while ((page = list_remove_head_type(&fresh, vm_page_t, free.node))) {
+            pmm_zero_page(page);
+            list_add_tail(list, &page->free.node);
+        }
+        kcounter_add(pmm_zero_pool_miss_count, fresh_count);
+    }
+
+    return allocated + fresh_count;
 }
 
 size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
@@ -175,6 +529,9 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
 
     address = ROUNDDOWN(address, PAGE_SIZE);
 
+    /* the pages we want may be sitting in a cache */
+    pmm_drain_caches();
+
     AutoLock al(&arena_lock);
 
     /* walk through the arenas, looking to see if the physical page belongs to it */
@@ -217,24 +574,47 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
         return 1;
     }
 
-    AutoLock al(&arena_lock);
+    /* if no run is free, retry with the pages in the caches given back to the arenas */
+    paddr_t run_pa = 0;
+    size_t allocated = 0;
+    const int passes = (alloc_flags & PMM_ALLOC_FLAG_NO_DRAIN) ? 1 : 2;
+    for (int pass = 0; pass < passes && allocated == 0; pass++) {
+        if (pass > 0)
+            pmm_drain_caches();
 
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
+        AutoLock al(&arena_lock);
+
+        for (auto& a : arena_list) {
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
 
-        size_t allocated = a.AllocContiguous(count, alignment_log2, pa, list);
-        if (allocated > 0) {
-            DEBUG_ASSERT(allocated == count);
-            return allocated;
+            allocated = a.AllocContiguous(count, alignment_log2, alloc_flags, &run_pa, list);
+            if (allocated > 0) {
+                DEBUG_ASSERT(allocated == count);
+                break;
+            }
         }
     }
 
-    LTRACEF("couldn't find run\n");
-    return 0;
+    if (allocated == 0) {
+        LTRACEF("couldn't find run\n");
+        return 0;
+    }
+
+    /* the zero pool only holds single pages, so a run is always zeroed here,
+     * outside the arena lock */
+    if (alloc_flags & PMM_ALLOC_FLAG_ZEROED) {
+        for (size_t i = 0; i < allocated; i++)
+            pmm_zero_page(paddr_to_vm_page(run_pa + i * PAGE_SIZE));
+        kcounter_add(pmm_zero_pool_miss_count, allocated);
+    }
+
+    if (pa)
+        *pa = run_pa;
+    return allocated;
 }
 
 /* physically allocate a run from arenas marked as KMAP */
@@ -306,29 +686,90 @@ size_t pmm_free_kpages(void* _ptr, size_t count) {
     return pmm_free(&list);
 }
 
+static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock) {
+    size_t free = page_cache_count.load() + zero_pool_count.load();
+    for (const auto& a : arena_list) {
+        free += a.free_count();
+    }
+    return free;
+}
+
 size_t pmm_free(struct list_node* list) {
     LTRACEF("list %p\n", list);
 
     DEBUG_ASSERT(list);
 
-    AutoLock al(&arena_lock);
-
-    uint count = 0;
-    while (!list_is_empty(list)) {
-        vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
+    /* move pages into the current cpu's cache until it is full. Pages that
+     * don't fit, along with a batch from a full cache, go back to the arenas
+     * under a single acquisition of the arena lock. */
+    list_node arena_free = LIST_INITIAL_VALUE(arena_free);
+    size_t count = 0;
+    size_t cached = 0;
+    size_t drained = 0;
+    bool wake_zero_pool = false;
+    {
+        PageCache& cache = page_cache[arch_curr_cpu_num()];
+        spin_lock_saved_state_t state;
+        cache.lock.AcquireIrqSave(state);
+        while (cache.count < kPageCacheMax) {
+            vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
+            if (!page)
+                break;
 
-        DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
+            DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
+            DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
 
-        /* see which arena this page belongs to and add it */
-        for (auto& a : arena_list) {
-            if (a.FreePage(page) >= 0) {
-                count++;
-                break;
+            count++;
+            if (!page_is_cacheable(page)) {
+                list_add_tail(&arena_free, &page->free.node);
+                continue;
             }
+            page->state = VM_PAGE_STATE_ALLOC;
+            list_add_head(&cache.free_list, &page->free.node);
+            cache.count++;
+            cached++;
         }
+        if (!list_is_empty(list)) {
+            /* the cache is full; the coldest pages make room for the next frees */
+            while (drained < kPageCacheBatch) {
+                vm_page_t* page = list_remove_tail_type(&cache.free_list, vm_page_t, free.node);
+                list_add_tail(&arena_free, &page->free.node);
+                drained++;
+            }
+            cache.count -= drained;
+        }
+        page_cache_count.fetch_add(cached);
+        page_cache_count.fetch_sub(drained);
+        cache.lock.ReleaseIrqRestore(state);
     }
 
-    LTRACEF("returning count %u\n", count);
+    if (!list_is_empty(list) || !list_is_empty(&arena_free)) {
+        if (drained > 0)
+            kcounter_add(pmm_cache_drain_count, 1u);
+
+        AutoLock al(&arena_lock);
+
+        while (!list_is_empty(list)) {
+            vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
+
+            DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
+
+            list_add_tail(&arena_free, &page->free.node);
+            count++;
+        }
+        pmm_free_locked(&arena_free);
+
+        /* enough memory may be back for a starved zero pool to refill */
+        wake_zero_pool = zero_pool_starved.load() &&
+                         pmm_count_free_pages_locked() >= 4 * zero_pool_target;
+    }
+
+    if (wake_zero_pool && zero_pool_starved.exchange(false)) {
+        zero_pool_refill_requested.store(true);
+        event_signal(&zero_pool_event, false);
+    }
+
+    LTRACEF("returning count %zu\n", count);
 
     return count;
 }
@@ -342,14 +783,6 @@ size_t pmm_free_page(vm_page_t* page) {
     return pmm_free(&list);
 }
 
-static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock) {
-    size_t free = 0u;
-    for (const auto& a : arena_list) {
-        free += a.free_count();
-    }
-    return free;
-}
-
 size_t pmm_count_free_pages() {
     AutoLock al(&arena_lock);
     return pmm_count_free_pages_locked();
@@ -376,6 +809,12 @@ void pmm_count_total_states(size_t state_count[_VM_PAGE_STATE_COUNT]) {
     for (auto& a : arena_list) {
         a.CountStates(state_count);
     }
+
+    // cached and pre-zeroed pages look allocated to the arenas but are really free
+    size_t cached = fbl::min(page_cache_count.load() + zero_pool_count.load(),
+                             state_count[VM_PAGE_STATE_ALLOC]);
+    state_count[VM_PAGE_STATE_ALLOC] -= cached;
+    state_count[VM_PAGE_STATE_FREE] += cached;
 }
 
 static enum handler_return pmm_dump_timer(timer_t* t, zx_time_t now, void*) TA_REQ(arena_lock) {
@@ -392,6 +831,8 @@ static void arena_dump(bool is_panic) TA_NO_THREAD_SAFETY_ANALYSIS {
     for (auto& a : arena_list) {
         a.Dump(false, false);
     }
+    printf("per-cpu page caches: %zu pages\n", page_cache_count.load());
+    printf("zeroed page pool: %zu of %zu pages\n", zero_pool_count.load(), zero_pool_target);
     if (!is_panic) {
         arena_lock.Release();
     }
@@ -9,6 +9,8 @@
 
 #include <err.h>
 #include <inttypes.h>
+#include <fbl/algorithm.h>
+#include <pow2.h>
 #include <pretty/sizes.h>
 #include <string.h>
 #include <trace.h>
@@ -18,17 +20,24 @@
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
 PmmArena::PmmArena(const pmm_arena_info_t* info)
-    : info_(*info) {}
+    : info_(*info) {
+    for (auto& type_lists : free_list_) {
+        for (auto& list : type_lists) {
+            list_initialize(&list);
+        }
+    }
+}
 
-PmmArena::~PmmArena() {}
+PmmArena::~PmmArena() = default;
 
 #if PMM_ENABLE_FREE_FILL
 void PmmArena::EnforceFill() {
     DEBUG_ASSERT(!enforce_fill_);
 
-    vm_page_t* page;
-    list_for_every_entry (&free_list_, page, vm_page_t, free.node) {
-        FreeFill(page);
+    for (size_t i = 0; i < page_count(); i++) {
+        if (page_is_free(&page_array_[i])) {
+            FreeFill(&page_array_[i]);
+        }
     }
 
     enforce_fill_ = true;
@@ -58,30 +67,216 @@ void PmmArena::BootAllocArray() {
     LTRACEF("arena for base 0%#" PRIxPTR " size %#zx page array at %p size %zu\n", info_.base, info_.size,
             raw_page_array, size);
 
-    memset(raw_page_array, 0, size);
+    InitArrays(static_cast<vm_page_t*>(raw_page_array),
+               static_cast<uint8_t*>(boot_alloc_mem(block_type_count())));
+}
 
-    page_array_ = (vm_page_t*)raw_page_array;
+void PmmArena::InitArrays(vm_page_t* page_array, uint8_t* block_type) {
+    DEBUG_ASSERT(!page_array_);
 
-    /* add them to the free list */
-    for (size_t i = 0; i < page_count; i++) {
-        auto& p = page_array_[i];
+    size_t page_count = this->page_count();
+    memset(page_array, 0, page_count * VM_PAGE_STRUCT_SIZE);
+    page_array_ = page_array;
 
-        list_add_tail(&free_list_, &p.free.node);
+    /* every page block starts out movable; pinned allocations claim them as needed */
+    block_type_ = block_type;
+    memset(block_type_, kMovable, block_type_count());
+
+    /* carve the arena into the largest aligned blocks that fit */
+    for (size_t i = 0; i < page_count; i++) {
+        page_array_[i].state = VM_PAGE_STATE_FREE;
+        page_array_[i].free.order = VM_PAGE_FREE_NOT_HEAD;
+    }
+    for (size_t i = 0; i < page_count;) {
+        uint order = 0;
+        while (order < kMaxOrder && (page_pfn(i) & ((2ul << order) - 1)) == 0 &&
+               i + (2ul << order) <= page_count) {
+            order++;
+        }
+        AddFreeBlock(i, order);
+        i += 1ul << order;
     }
 
     free_count_ += page_count;
 }
 
-vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
-    vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
-    if (!page)
-        return nullptr;
+// Puts the block of 2^|order| free pages starting at |index| on the free list
+// for its order and page block type.
+void PmmArena::AddFreeBlock(size_t index, uint order) {
+    vm_page_t* page = &page_array_[index];
+    DEBUG_ASSERT(page_is_free(page));
+    DEBUG_ASSERT((page_pfn(index) & ((1ul << order) - 1)) == 0);
 
-    DEBUG_ASSERT(free_count_ > 0);
+    page->free.order = static_cast<uint8_t>(order);
+    list_add_head(&free_list_[block_type_[page_block(index)]][order], &page->free.node);
+}
 
-    free_count_--;
+void PmmArena::RemoveFreeBlock(size_t index) {
+    vm_page_t* page = &page_array_[index];
+    DEBUG_ASSERT(page_is_free(page) && page->free.order <= kMaxOrder);
+
+    list_delete(&page->free.node);
+    page->free.order = VM_PAGE_FREE_NOT_HEAD;
+}
+
+// Returns a block of pages, already marked free, to the free lists, merging
+// it with its buddies for as long as they are free as well.
+void PmmArena::FreeBlock(size_t index, uint order) {
+    while (order < kMaxOrder) {
+        paddr_t buddy_pfn = page_pfn(index) ^ (1ul << order);
+        if (buddy_pfn < page_pfn(0))
+            break;
+        size_t buddy = buddy_pfn - page_pfn(0);
+        if (buddy + (1ul << order) > page_count())
+            break;
+        vm_page_t* buddy_page = &page_array_[buddy];
+        if (!page_is_free(buddy_page) || buddy_page->free.order != order)
+            break;
+
+        RemoveFreeBlock(buddy);
+        if (buddy < index) {
+            page_array_[index].free.order = VM_PAGE_FREE_NOT_HEAD;
+            index = buddy;
+        }
+        order++;
+    }
+    AddFreeBlock(index, order);
+}
+
+// Marks |count| allocated pages starting at |index| free and returns them to
+// the free lists in the largest aligned blocks possible.
+void PmmArena::FreeRange(size_t index, size_t count) {
+    size_t end = index + count;
+    while (index < end) {
+        uint order = 0;
+        while (order < kMaxOrder && (page_pfn(index) & ((2ul << order) - 1)) == 0 &&
+               index + (2ul << order) <= end) {
+            order++;
+        }
+        for (size_t i = index; i < index + (1ul << order); i++) {
+            page_array_[i].state = VM_PAGE_STATE_FREE;
+            page_array_[i].free.order = VM_PAGE_FREE_NOT_HEAD;
+        }
+        free_count_ += 1ul << order;
+        FreeBlock(index, order);
+        index += 1ul << order;
+    }
+}
+
+// Changes the type of a page block, moving the free blocks inside it to the
+// free lists of the new type.
+void PmmArena::SetPageBlockType(size_t block, uint8_t type) {
+    if (block_type_[block] == type)
+        return;
+    block_type_[block] = type;
+
+    paddr_t block_pfn = (page_pfn(0) >> kPageBlockOrder) + block;
+    size_t start = (block_pfn << kPageBlockOrder) > page_pfn(0)
+                       ? (block_pfn << kPageBlockOrder) - page_pfn(0) : 0;
+    size_t end = fbl::min(((block_pfn + 1) << kPageBlockOrder) - page_pfn(0), page_count());
+    for (size_t i = start; i < end; i++) {
+        vm_page_t* page = &page_array_[i];
+        if (page_is_free(page) && page->free.order != VM_PAGE_FREE_NOT_HEAD) {
+            uint order = page->free.order;
+            RemoveFreeBlock(i);
+            AddFreeBlock(i, order);
+            i += (1ul << order) - 1;
+        }
+    }
+}
+
+// Takes a free block of 2^|order| pages for an allocation of type |type|,
+// splitting a larger block if needed. Returns the index of its first page.
+// The pages of the block are left marked free.
+bool PmmArena::AllocBlock(uint order, uint8_t type, size_t* index) {
+    DEBUG_ASSERT(order <= kMaxOrder);
+
+    uint found = order;
+    while (found <= kMaxOrder && list_is_empty(&free_list_[type][found]))
+        found++;
+
+    if (found > kMaxOrder) {
+        /* nothing of our own type; steal from the other type, largest blocks
+         * first so that the types mix in as few page blocks as possible */
+        uint8_t other = (type == kMovable) ? kPinned : kMovable;
+        found = kMaxOrder;
+        while (found >= order && list_is_empty(&free_list_[other][found])) {
+            if (found == 0)
+                return false;
+            found--;
+        }
+        if (found < order)
+            return false;
+
+        vm_page_t* page = list_peek_head_type(&free_list_[other][found], vm_page_t, free.node);
+        size_t head = page_index(page);
+
+        /* claim every page block the stolen block covers; a block that is at
+         * least half a page block claims the page block around it */
+        if (found >= kPageBlockOrder - 1) {
+            size_t last = page_block(head + (1ul << found) - 1);
+            for (size_t b = page_block(head); b <= last; b++) {
+                SetPageBlockType(b, type);
+            }
+        }
+        *index = head;
+    } else {
+        vm_page_t* page = list_peek_head_type(&free_list_[type][found], vm_page_t, free.node);
+        *index = page_index(page);
+    }
+
+    RemoveFreeBlock(*index);
+
+    /* give back the upper halves until the block is the requested size */
+    while (found > order) {
+        found--;
+        AddFreeBlock(*index + (1ul << found), found);
+    }
+    return true;
+}
+
+// Takes the single free page at |index| out of whatever free block contains it.
+bool PmmArena::AllocBlockAt(size_t index) {
+    if (!page_is_free(&page_array_[index]))
+        return false;
+
+    /* find the head of the containing block */
+    size_t head = index;
+    uint order = 0;
+    for (;; order++) {
+        if (order > kMaxOrder)
+            panic("pmm: free page %zu of arena %s is in no free block\n", index, name());
+        paddr_t head_pfn = page_pfn(index) & ~((1ul << order) - 1);
+        if (head_pfn < page_pfn(0))
+            panic("pmm: free page %zu of arena %s is in no free block\n", index, name());
+        head = head_pfn - page_pfn(0);
+        if (page_array_[head].free.order == order && page_is_free(&page_array_[head]))
+            break;
+    }
+
+    RemoveFreeBlock(head);
+
+    /* split it, giving back the half that doesn't contain the page each time */
+    while (order > 0) {
+        order--;
+        size_t half = 1ul << order;
+        if (index >= head + half) {
+            AddFreeBlock(head, order);
+            head += half;
+        } else {
+            AddFreeBlock(head + half, order);
+        }
+    }
+    DEBUG_ASSERT(head == index);
+    return true;
+}
 
+// Finishes the allocation of a page that has been taken off the free lists.
+void PmmArena::TakePage(vm_page_t* page, paddr_t* pa) {
     DEBUG_ASSERT(page_is_free(page));
+    DEBUG_ASSERT(free_count_ > 0);
+
+    free_count_--;
 
     page->state = VM_PAGE_STATE_ALLOC;
 #if PMM_ENABLE_FREE_FILL
@@ -95,7 +290,16 @@ vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
     }
 
     LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page_address_from_arena(page));
+}
+
+vm_page_t* PmmArena::AllocPage(uint alloc_flags, paddr_t* pa) {
+    uint8_t type = (alloc_flags & PMM_ALLOC_FLAG_MOVABLE) ? kMovable : kPinned;
+    size_t index;
+    if (!AllocBlock(0, type, &index))
+        return nullptr;
 
+    vm_page_t* page = &page_array_[index];
+    TakePage(page, pa);
     return page;
 }
 
@@ -107,43 +311,24 @@ vm_page_t* PmmArena::AllocSpecific(paddr_t pa) {
 
     DEBUG_ASSERT(index < size() / PAGE_SIZE);
 
-    vm_page_t* page = get_page(index);
-    if (!page_is_free(page)) {
+    if (!AllocBlockAt(index)) {
         /* we hit an allocated page */
         return nullptr;
     }
 
-    list_delete(&page->free.node);
-
-    page->state = VM_PAGE_STATE_ALLOC;
-
-    DEBUG_ASSERT(free_count_ > 0);
-
-    free_count_--;
-
+    vm_page_t* page = get_page(index);
+    TakePage(page, nullptr);
     return page;
 }
 
-size_t PmmArena::AllocPages(size_t count, list_node* list) {
+size_t PmmArena::AllocPages(size_t count, uint alloc_flags, list_node* list) {
     size_t allocated = 0;
 
     while (allocated < count) {
-        vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
+        vm_page_t* page = AllocPage(alloc_flags, nullptr);
         if (!page)
             return allocated;
 
-        LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page_address_from_arena(page));
-
-        DEBUG_ASSERT(free_count_ > 0);
-
-        free_count_--;
-
-        DEBUG_ASSERT(page_is_free(page));
-#if PMM_ENABLE_FREE_FILL
-        CheckFreeFill(page);
-#endif
-
-        page->state = VM_PAGE_STATE_ALLOC;
         list_add_tail(list, &page->free.node);
 
         allocated++;
@@ -152,25 +337,51 @@ size_t PmmArena::AllocPages(size_t count, list_node* list) {
     return allocated;
 }
 
-size_t PmmArena::AllocContiguous(size_t count, uint8_t alignment_log2, paddr_t* pa, struct list_node* list) {
-    /* walk the list starting at alignment boundaries.
-     * calculate the starting offset into this arena, based on the
-     * base address of the arena to handle the case where the arena
-     * is not aligned on the same boundary requested.
-     */
-    paddr_t rounded_base = ROUNDUP(base(), 1UL << alignment_log2);
-    if (rounded_base < base() || rounded_base > base() + size() - 1)
+size_t PmmArena::AllocContiguous(size_t count, uint8_t alignment_log2, uint alloc_flags, paddr_t* pa,
+                                 struct list_node* list) {
+    size_t start;
+
+    /* the common case: a naturally aligned block from the buddy allocator,
+     * with whatever is beyond |count| given straight back */
+    uint order = fbl::max(log2_ulong_ceil(count),
+                          static_cast<uint>(alignment_log2 - PAGE_SIZE_SHIFT));
+    uint8_t type = (alloc_flags & PMM_ALLOC_FLAG_MOVABLE) ? kMovable : kPinned;
+    if (order <= kMaxOrder && AllocBlock(order, type, &start)) {
+        LTRACEF("found block of order %u at pn %zu\n", order, start);
+        for (size_t i = start; i < start + (1ul << order); i++) {
+            page_array_[i].state = VM_PAGE_STATE_ALLOC;
+        }
+        free_count_ -= 1ul << order;
+        FreeRange(start + count, (1ul << order) - count);
+    } else if (order <= kMaxOrder && count == (1ul << order) &&
+               alignment_log2 - PAGE_SIZE_SHIFT >= order) {
+        /* a power of two run that must also be aligned to its own size would
+         * have been merged into a block if it were all free, so there's no
+         * point scanning for one. a less aligned run can straddle blocks */
         return 0;
+    } else {
+        /* the run is bigger than the largest buddy block, or it is not a power
+         * of two and could fit where no whole block is free: fall back to
+         * scanning the arena for a free run, starting at alignment boundaries.
+         * calculate the starting offset into this arena, based on the
+         * base address of the arena to handle the case where the arena
+         * is not aligned on the same boundary requested.
+         */
+        paddr_t rounded_base = ROUNDUP(base(), 1UL << alignment_log2);
+        if (rounded_base < base() || rounded_base > base() + size() - 1)
+            return 0;
+
+        paddr_t aligned_offset = (rounded_base - base()) / PAGE_SIZE;
+        start = aligned_offset;
+        LTRACEF("starting search at aligned offset %#" PRIxPTR "\n", start);
+        LTRACEF("arena base %#" PRIxPTR " size %zu\n", base(), size());
+
+    retry:
+        /* search while we're still within the arena and have a chance of finding a slot
+           (start + count < end of arena) */
+        if ((start >= size() / PAGE_SIZE) || ((start + count) > size() / PAGE_SIZE))
+            return 0;
 
-    paddr_t aligned_offset = (rounded_base - base()) / PAGE_SIZE;
-    paddr_t start = aligned_offset;
-    LTRACEF("starting search at aligned offset %#" PRIxPTR "\n", start);
-    LTRACEF("arena base %#" PRIxPTR " size %zu\n", base(), size());
-
-retry:
-    /* search while we're still within the arena and have a chance of finding a slot
-       (start + count < end of arena) */
-    while ((start < size() / PAGE_SIZE) && ((start + count) <= size() / PAGE_SIZE)) {
         vm_page_t* p = &page_array_[start];
         for (uint i = 0; i < count; i++) {
             if (!page_is_free(p)) {
@@ -187,34 +398,29 @@ retry:
         /* we found a run */
         LTRACEF("found run from pn %" PRIuPTR " to %" PRIuPTR "\n", start, start + count);
 
-        /* remove the pages from the run out of the free list */
-        for (paddr_t i = start; i < start + count; i++) {
-            p = &page_array_[i];
-            DEBUG_ASSERT(page_is_free(p));
-            DEBUG_ASSERT(list_in_list(&p->free.node));
-
-            list_delete(&p->free.node);
-            p->state = VM_PAGE_STATE_ALLOC;
-
+        /* take the pages of the run out of their free blocks */
+        for (size_t i = start; i < start + count; i++) {
+            __UNUSED bool taken = AllocBlockAt(i);
+            DEBUG_ASSERT(taken);
+            page_array_[i].state = VM_PAGE_STATE_ALLOC;
             DEBUG_ASSERT(free_count_ > 0);
-
             free_count_--;
+        }
+    }
 
+    for (size_t i = start; i < start + count; i++) {
+        vm_page_t* p = &page_array_[i];
 #if PMM_ENABLE_FREE_FILL
-            CheckFreeFill(p);
+        CheckFreeFill(p);
 #endif
-
-            if (list)
-                list_add_tail(list, &p->free.node);
-        }
-
-        if (pa)
-            *pa = base() + start * PAGE_SIZE;
-
-        return count;
+        if (list)
+            list_add_tail(list, &p->free.node);
     }
 
-    return 0;
+    if (pa)
+        *pa = base() + start * PAGE_SIZE;
+
+    return count;
 }
 
 zx_status_t PmmArena::FreePage(vm_page_t* page) {
@@ -229,8 +435,9 @@ zx_status_t PmmArena::FreePage(vm_page_t* page) {
 #endif
 
     page->state = VM_PAGE_STATE_FREE;
+    page->free.order = VM_PAGE_FREE_NOT_HEAD;
 
-    list_add_head(&free_list_, &page->free.node);
+    FreeBlock(page_index(page), 0);
     free_count_++;
     return ZX_OK;
 }
@@ -247,6 +454,14 @@ void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
            format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags());
     printf("\tpage_array %p, free_count %zu\n", page_array_, free_count_);
 
+    /* count the free blocks of every order and type */
+    printf("\tfree blocks (pinned/movable):");
+    for (uint order = 0; order <= kMaxOrder; order++) {
+        printf(" %zu/%zu", list_length(&free_list_[kPinned][order]),
+               list_length(&free_list_[kMovable][order]));
+    }
+    printf("\n");
+
     /* dump all of the pages */
     if (dump_pages) {
         for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
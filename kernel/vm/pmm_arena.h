@@ -15,6 +15,15 @@
 #define PMM_ENABLE_FREE_FILL 0
 #define PMM_FREE_FILL_BYTE 0x42
 
+// The free pages of an arena are managed by a binary buddy allocator: every
+// free page belongs to exactly one naturally aligned block of 2^order pages,
+// and the first page of each block sits on the free list for its order.
+//
+// To keep pinned kernel allocations from scattering across memory, the
+// arena is also split into page blocks of 2^kPageBlockOrder pages, each of
+// which is either movable or pinned.  Allocations are served from page
+// blocks of their own type and only steal from the other type when they
+// have to.
 class PmmArena : public fbl::DoublyLinkedListable<PmmArena*> {
 public:
     PmmArena(const pmm_arena_info_t* info);
@@ -25,6 +34,12 @@ public:
     // set up the per page structures, allocated out of the boot time allocator
     void BootAllocArray();
 
+    // set up the per page structures in caller provided storage: |page_array| holds one
+    // vm_page_t per page of the arena and |block_type| block_type_count() bytes. lets tests
+    // build an arena over physical memory that is never touched
+    void InitArrays(vm_page_t* page_array, uint8_t* block_type);
+    size_t block_type_count() const { return page_block(page_count() - 1) + 1; }
+
 #if PMM_ENABLE_FREE_FILL
     void EnforceFill();
 #endif
@@ -48,12 +63,20 @@ public:
     vm_page_t* get_page(size_t index) { return &page_array_[index]; }
 
     // main allocation routines
-    vm_page_t* AllocPage(paddr_t* pa);
+    vm_page_t* AllocPage(uint alloc_flags, paddr_t* pa);
     vm_page_t* AllocSpecific(paddr_t pa);
-    size_t AllocPages(size_t count, list_node* list);
-    size_t AllocContiguous(size_t count, uint8_t alignment_log2, paddr_t* pa, struct list_node* list);
+    size_t AllocPages(size_t count, uint alloc_flags, list_node* list);
+    size_t AllocContiguous(size_t count, uint8_t alignment_log2, uint alloc_flags, paddr_t* pa,
+                           struct list_node* list);
     zx_status_t FreePage(vm_page_t* page);
 
+    // Whether |page|, which must belong to this arena, is in a movable page
+    // block.  Only a hint unless the caller holds the lock protecting the
+    // arena.
+    bool page_is_movable(const vm_page_t* page) const {
+        return block_type_[page_block(page_index(page))] == kMovable;
+    }
+
     // helpers
     bool page_belongs_to_arena(const vm_page* page) const {
         uintptr_t page_addr = reinterpret_cast<uintptr_t>(page);
@@ -75,16 +98,45 @@ public:
     }
 
 private:
+    // largest block handled by the buddy allocator, 4MB
+    static constexpr uint kMaxOrder = 10;
+    // size of the page blocks that group movable and pinned pages, 2MB
+    static constexpr uint kPageBlockOrder = 9;
+
+    enum : uint8_t {
+        kPinned,
+        kMovable,
+        kBlockTypeCount,
+    };
+
 #if PMM_ENABLE_FREE_FILL
     void FreeFill(vm_page_t* page);
     void CheckFreeFill(vm_page_t* page);
 #endif
 
+    size_t page_count() const { return info_.size / PAGE_SIZE; }
+    size_t page_index(const vm_page_t* page) const { return page - page_array_; }
+    paddr_t page_pfn(size_t index) const { return (info_.base / PAGE_SIZE) + index; }
+    size_t page_block(size_t index) const {
+        return (page_pfn(index) >> kPageBlockOrder) - (page_pfn(0) >> kPageBlockOrder);
+    }
+
+    // buddy allocator internals
+    void AddFreeBlock(size_t index, uint order);
+    void RemoveFreeBlock(size_t index);
+    void FreeBlock(size_t index, uint order);
+    void FreeRange(size_t index, size_t count);
+    bool AllocBlock(uint order, uint8_t type, size_t* index);
+    bool AllocBlockAt(size_t index);
+    void SetPageBlockType(size_t block, uint8_t type);
+    void TakePage(vm_page_t* page, paddr_t* pa);
+
     const pmm_arena_info_t info_;
     vm_page_t* page_array_ = nullptr;
 
     size_t free_count_ = 0;
-    list_node free_list_ = LIST_INITIAL_VALUE(free_list_);
+    list_node free_list_[kBlockTypeCount][kMaxOrder + 1];
+    uint8_t* block_type_ = nullptr;
 
 #if PMM_ENABLE_FREE_FILL
     bool enforce_fill_ = false;
@@ -12,6 +12,7 @@
 #include <err.h>
 #include <fbl/algorithm.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/thread.h>
 #include <lib/console.h>
 #include <lib/crypto/global_prng.h>
@@ -31,6 +32,9 @@
 vm_page_t* zero_page;
 paddr_t zero_page_paddr;
 
+// set in vm_init if aligned regions of user VMOs should use large pages
+bool vm_large_pages;
+
 // set early in arch code to record the start address of the kernel
 paddr_t kernel_base_phys;
 
@@ -174,6 +178,11 @@ void vm_init() {
     zx_status_t status = aspace->ReserveSpace("random_padding", random_size, PHYSMAP_BASE + PHYSMAP_SIZE);
     ASSERT(status == ZX_OK);
     LTRACEF("VM: aspace random padding size: %#" PRIxPTR "\n", random_size);
+
+#if ARCH_X86
+    // only the x86 page tables split a large page on a partial unmap or protect
+    vm_large_pages = cmdline_get_bool("kernel.vm.large-pages", true);
+#endif
 }
 
 paddr_t vaddr_to_paddr(const void* ptr) {
@@ -135,6 +135,9 @@ zx_status_t VmAddressRegion::CreateSubVmarInternal(size_t offset, size_t size, u
         return ZX_ERR_ACCESS_DENIED;
     }
 
+    // Opting out of fault-around applies to the whole subtree
+    vmar_flags |= flags_ & VMAR_FLAG_NO_FAULT_AROUND;
+
     if (offset >= size_ || size > size_ - offset) {
         return ZX_ERR_INVALID_ARGS;
     }
@@ -213,7 +216,8 @@ zx_status_t VmAddressRegion::CreateSubVmar(size_t offset, size_t size, uint8_t a
     }
 
     // Check that only allowed flags have been set
-    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_CAN_MAP_SPECIFIC | VMAR_FLAG_COMPACT | VMAR_CAN_RWX_FLAGS)) {
+    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_CAN_MAP_SPECIFIC | VMAR_FLAG_COMPACT |
+                       VMAR_CAN_RWX_FLAGS | VMAR_FLAG_NO_FAULT_AROUND)) {
         return ZX_ERR_INVALID_ARGS;
     }
 
@@ -236,7 +240,8 @@ zx_status_t VmAddressRegion::CreateVmMapping(size_t mapping_offset, size_t size,
     LTRACEF("%p %#zx %#zx %x\n", this, mapping_offset, size, vmar_flags);
 
     // Check that only allowed flags have been set
-    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS)) {
+    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS |
+                       VMAR_FLAG_NO_FAULT_AROUND)) {
         return ZX_ERR_INVALID_ARGS;
     }
 
@@ -380,7 +385,7 @@ size_t VmAddressRegion::AllocatedPagesLocked() const {
     return sum;
 }
 
-zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
+zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -388,7 +393,7 @@ zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
          auto next = vmar->FindRegionLocked(va);
          vmar = next->as_vm_address_region()) {
         if (next->is_mapping())
-            return next->PageFault(va, pf_flags);
+            return next->PageFault(va, pf_flags, page_request);
     }
 
     return ZX_ERR_NOT_FOUND;
@@ -787,21 +792,15 @@ zx_status_t VmAddressRegion::LinearRegionAllocatorLocked(size_t size, uint8_t al
 }
 
 template <typename F>
-void VmAddressRegion::ForEachGap(F func, uint8_t align_pow2) {
+void VmAddressRegion::ForEachGap(F func, uint8_t align_pow2, size_t min_gap) {
     const vaddr_t align = 1UL << align_pow2;
 
-    // Scan the regions list to find the gap to the left of each region.  We
-    // round up the end of the previous region to the requested alignment, so
-    // all gaps reported will be for aligned ranges.
+    // Walk the regions tree in order to find the gap to the left of each
+    // region.  We round up the end of the previous region to the requested
+    // alignment, so all gaps reported will be for aligned ranges.
     vaddr_t prev_region_end = ROUNDUP(base_, align);
-    for (const auto& region : subregions_) {
-        if (region.base() > prev_region_end) {
-            const size_t gap = region.base() - prev_region_end;
-            if (!func(prev_region_end, gap)) {
-                return;
-            }
-        }
-        prev_region_end = ROUNDUP(region.base() + region.size(), align);
+    if (!ForEachGapInSubtree(subregions_.root(), func, align, min_gap, &prev_region_end)) {
+        return;
     }
 
     // Grab the gap to the right of the last region (note that if there are no
@@ -813,6 +812,86 @@ void VmAddressRegion::ForEachGap(F func, uint8_t align_pow2) {
     }
 }
 
+template <typename F>
+bool VmAddressRegion::ForEachGapInSubtree(const ChildList::iterator& node, F& func, vaddr_t align,
+                                          size_t min_gap, vaddr_t* prev_region_end) {
+    if (!node.IsValid()) {
+        return true;
+    }
+
+    // If none of the gaps between the regions in this subtree are big enough,
+    // only the gap to the left of the whole subtree is worth reporting.
+    const bool skip_subtree = node->subtree_max_gap_ < min_gap;
+
+    if (!skip_subtree &&
+        !ForEachGapInSubtree(node.left(), func, align, min_gap, prev_region_end)) {
+        return false;
+    }
+
+    const vaddr_t region_base = skip_subtree ? node->subtree_min_base_ : node->base();
+    if (region_base > *prev_region_end) {
+        const size_t gap = region_base - *prev_region_end;
+        if (!func(*prev_region_end, gap)) {
+            return false;
+        }
+    }
+
+    if (skip_subtree) {
+        *prev_region_end = ROUNDUP(node->subtree_max_last_ + 1, align);
+        return true;
+    }
+
+    *prev_region_end = ROUNDUP(node->base() + node->size(), align);
+    return ForEachGapInSubtree(node.right(), func, align, min_gap, prev_region_end);
+}
+
+void VmAddressRegion::FindGapByPageLocked(size_t* index, vaddr_t* gap_base, size_t* gap_len) {
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(!subregions_.is_empty());
+    DEBUG_ASSERT(*index < subregions_.root()->subtree_gap_pages_);
+
+    size_t idx = *index;
+    auto node = subregions_.root();
+    for (;;) {
+        DEBUG_ASSERT(node.IsValid());
+        auto left = node.left();
+        auto right = node.right();
+
+        if (left.IsValid()) {
+            // Is the page in the left subtree?
+            if (idx < left->subtree_gap_pages_) {
+                node = left;
+                continue;
+            }
+            idx -= left->subtree_gap_pages_;
+
+            // Is the page in the gap between the left subtree and this node?
+            const vaddr_t base = left->subtree_max_last_ + 1;
+            const size_t pages = (node->base() - base) >> PAGE_SIZE_SHIFT;
+            if (idx < pages) {
+                *gap_base = base;
+                *gap_len = node->base() - base;
+                break;
+            }
+            idx -= pages;
+        }
+
+        // It must be on our right, either just past this node or further on.
+        DEBUG_ASSERT(right.IsValid());
+        const vaddr_t base = node->base() + node->size();
+        const size_t pages = (right->subtree_min_base_ - base) >> PAGE_SIZE_SHIFT;
+        if (idx < pages) {
+            *gap_base = base;
+            *gap_len = right->subtree_min_base_ - base;
+            break;
+        }
+        idx -= pages;
+        node = right;
+    }
+
+    *index = idx;
+}
+
 namespace {
 
 // Compute the number of allocation spots that satisfy the alignment within the
@@ -821,11 +900,23 @@ constexpr size_t AllocationSpotsInRange(size_t range_size, size_t alloc_size, ui
     return ((range_size - alloc_size) >> align_pow2) + 1;
 }
 
+// How many random gap pages the NON-COMPACT allocator will try before falling
+// back to counting every candidate spot.
+constexpr uint kRandomSpotAttempts = 8;
+
 } // namespace {}
 
 // Perform allocations for VMARs that aren't using the COMPACT policy.  This
 // allocator works by choosing uniformly at random from the set of positions
 // that could satisfy the allocation.
+//
+// The fast path draws a random free page, using the gap summaries kept in the
+// regions tree to find its gap in O(log n), and accepts it if it is the n-th
+// page of a gap which has at least n+1 spots for the allocation.  Every gap
+// has at least as many free pages as it has spots, so each spot is equally
+// likely to be accepted.  If enough draws are rejected (say, because of a
+// large alignment), fall back to numbering all of the spots and picking one;
+// the result is uniform either way.
 zx_status_t VmAddressRegion::NonCompactRandomizedRegionAllocatorLocked(size_t size, uint8_t align_pow2,
                                                                        uint arch_mmu_flags,
                                                                        vaddr_t* spot) {
@@ -835,42 +926,94 @@ zx_status_t VmAddressRegion::NonCompactRandomizedRegionAllocatorLocked(size_t si
     align_pow2 = fbl::max(align_pow2, static_cast<uint8_t>(PAGE_SIZE_SHIFT));
     const vaddr_t align = 1UL << align_pow2;
 
-    // Calculate the number of spaces that we can fit this allocation in.
-    size_t candidate_spaces = 0;
-    ForEachGap([align, align_pow2, size, &candidate_spaces](vaddr_t gap_base, size_t gap_len) -> bool {
-        DEBUG_ASSERT(IS_ALIGNED(gap_base, align));
-        if (gap_len >= size) {
-            candidate_spaces += AllocationSpotsInRange(gap_len, size, align_pow2);
+    vaddr_t alloc_spot = static_cast<vaddr_t>(-1);
+
+    if (!subregions_.is_empty()) {
+        const auto root = subregions_.root();
+        const vaddr_t first_base = root->subtree_min_base_;
+        const vaddr_t last_end = root->subtree_max_last_ + 1;
+        const size_t leading_len = first_base - base_;
+        const size_t trailing_len = (base_ + size_) - last_end;
+
+        // Bail out early if there is no gap big enough to hold the allocation,
+        // even ignoring alignment.
+        if (fbl::max(root->subtree_max_gap_, fbl::max(leading_len, trailing_len)) < size) {
+            return ZX_ERR_NO_MEMORY;
         }
-        return true;
-    },
-               align_pow2);
 
-    if (candidate_spaces == 0) {
-        return ZX_ERR_NO_MEMORY;
-    }
+        const size_t leading_pages = leading_len >> PAGE_SIZE_SHIFT;
+        const size_t inner_pages = root->subtree_gap_pages_;
+        const size_t total_pages = leading_pages + inner_pages + (trailing_len >> PAGE_SIZE_SHIFT);
+
+        for (uint i = 0; i < kRandomSpotAttempts; ++i) {
+            size_t index = aspace_->AslrPrng().RandInt(total_pages);
+
+            vaddr_t gap_base;
+            size_t gap_len;
+            if (index < leading_pages) {
+                gap_base = base_;
+                gap_len = leading_len;
+            } else if (index - leading_pages < inner_pages) {
+                index -= leading_pages;
+                FindGapByPageLocked(&index, &gap_base, &gap_len);
+            } else {
+                index -= leading_pages + inner_pages;
+                gap_base = last_end;
+                gap_len = trailing_len;
+            }
 
-    // Choose the index of the allocation to use.
-    size_t selected_index = aspace_->AslrPrng().RandInt(candidate_spaces);
-    DEBUG_ASSERT(selected_index < candidate_spaces);
+            // Only consider the part of the gap that starts on an aligned
+            // address, as ForEachGap() would.
+            const vaddr_t aligned_base = ROUNDUP(gap_base, align);
+            const size_t skipped = aligned_base - gap_base;
+            if (skipped >= gap_len || gap_len - skipped < size) {
+                continue;
+            }
 
-    // Find which allocation we picked.
-    vaddr_t alloc_spot = static_cast<vaddr_t>(-1);
-    ForEachGap([align_pow2, size, &alloc_spot, &selected_index](vaddr_t gap_base,
-                                                                size_t gap_len) -> bool {
-        if (gap_len < size) {
-            return true;
+            if (index < AllocationSpotsInRange(gap_len - skipped, size, align_pow2)) {
+                alloc_spot = aligned_base + (index << align_pow2);
+                break;
+            }
         }
+    }
 
-        const size_t spots = AllocationSpotsInRange(gap_len, size, align_pow2);
-        if (selected_index < spots) {
-            alloc_spot = gap_base + (selected_index << align_pow2);
-            return false;
+    if (alloc_spot == static_cast<vaddr_t>(-1)) {
+        // Calculate the number of spaces that we can fit this allocation in.
+        size_t candidate_spaces = 0;
+        ForEachGap([align, align_pow2, size, &candidate_spaces](vaddr_t gap_base, size_t gap_len) -> bool {
+            DEBUG_ASSERT(IS_ALIGNED(gap_base, align));
+            if (gap_len >= size) {
+                candidate_spaces += AllocationSpotsInRange(gap_len, size, align_pow2);
+            }
+            return true;
+        },
+                   align_pow2, size);
+
+        if (candidate_spaces == 0) {
+            return ZX_ERR_NO_MEMORY;
         }
-        selected_index -= spots;
-        return true;
-    },
-               align_pow2);
+
+        // Choose the index of the allocation to use.
+        size_t selected_index = aspace_->AslrPrng().RandInt(candidate_spaces);
+        DEBUG_ASSERT(selected_index < candidate_spaces);
+
+        // Find which allocation we picked.
+        ForEachGap([align_pow2, size, &alloc_spot, &selected_index](vaddr_t gap_base,
+                                                                    size_t gap_len) -> bool {
+            if (gap_len < size) {
+                return true;
+            }
+
+            const size_t spots = AllocationSpotsInRange(gap_len, size, align_pow2);
+            if (selected_index < spots) {
+                alloc_spot = gap_base + (selected_index << align_pow2);
+                return false;
+            }
+            selected_index -= spots;
+            return true;
+        },
+                   align_pow2, size);
+    }
     ASSERT(alloc_spot != static_cast<vaddr_t>(-1));
     ASSERT(IS_ALIGNED(alloc_spot, align));
 
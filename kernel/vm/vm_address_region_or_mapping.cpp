@@ -9,6 +9,7 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
@@ -93,3 +94,33 @@ size_t VmAddressRegionOrMapping::AllocatedPages() const {
     }
     return AllocatedPagesLocked();
 }
+
+void VmAddressRegionOrMapping::WAVLTreeObserver::UpdateSubtreeState(
+    VmAddressRegionOrMapping* node, VmAddressRegionOrMapping* left,
+    VmAddressRegionOrMapping* right) {
+    const vaddr_t node_last = node->base_ + node->size_ - 1;
+
+    size_t max_gap = 0;
+    size_t gap_pages = 0;
+
+    if (left) {
+        const size_t gap = node->base_ - left->subtree_max_last_ - 1;
+        max_gap = fbl::max(left->subtree_max_gap_, gap);
+        gap_pages += left->subtree_gap_pages_ + (gap >> PAGE_SIZE_SHIFT);
+        node->subtree_min_base_ = left->subtree_min_base_;
+    } else {
+        node->subtree_min_base_ = node->base_;
+    }
+
+    if (right) {
+        const size_t gap = right->subtree_min_base_ - node_last - 1;
+        max_gap = fbl::max(max_gap, fbl::max(right->subtree_max_gap_, gap));
+        gap_pages += right->subtree_gap_pages_ + (gap >> PAGE_SIZE_SHIFT);
+        node->subtree_max_last_ = right->subtree_max_last_;
+    } else {
+        node->subtree_max_last_ = node_last;
+    }
+
+    node->subtree_max_gap_ = max_gap;
+    node->subtree_gap_pages_ = gap_pages;
+}
@@ -25,6 +25,7 @@
 #include <string.h>
 #include <trace.h>
 #include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_object.h>
@@ -544,12 +545,29 @@ zx_status_t VmAspace::PageFault(vaddr_t va, uint flags) {
         flags |= VMM_PF_FLAG_GUEST;
     }
 
-    // for now, hold the aspace lock across the page fault operation,
-    // which stops any other operations on the address space from moving
-    // the region out from underneath it
-    AutoLock a(&lock_);
+    // a page that has to come from a page source is waited for with no locks held,
+    // after which the fault starts over
+    PageRequest page_request;
+    for (;;) {
+        zx_status_t status;
+        {
+            // for now, hold the aspace lock across the page fault operation,
+            // which stops any other operations on the address space from moving
+            // the region out from underneath it
+            AutoLock a(&lock_);
+
+            status = root_vmar_->PageFault(va, flags, &page_request);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT)
+            return status;
 
-    return root_vmar_->PageFault(va, flags);
+        // a user_copy cannot be run again after the thread is suspended, because the
+        // syscall around it would have to be restarted, so only a fault from user mode
+        // gives up the wait
+        status = page_request.Wait((flags & VMM_PF_FLAG_USER) != 0);
+        if (status != ZX_OK)
+            return status;
+    }
 }
 
 void VmAspace::Dump(bool verbose) const {
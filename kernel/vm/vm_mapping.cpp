@@ -9,10 +9,15 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <pow2.h>
 #include <safeint/safe_math.h>
 #include <trace.h>
 #include <vm/fault.h>
@@ -25,6 +30,28 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+// Size in pages of the aligned window around a read fault in which already resident pages are
+// mapped along with the faulting one.  Set with kernel.vm.fault-around; 0 or 1 turns it off.
+static const size_t kFaultAroundMaxPages = 64;
+static size_t fault_around_pages = 16;
+
+// counts read faults that mapped in neighbouring pages.
+KCOUNTER(vm_fault_around_count, "kernel.vm.fault_around.faults");
+// counts neighbouring pages mapped ahead of use, each of which is a fault avoided once touched.
+KCOUNTER(vm_fault_around_pages_count, "kernel.vm.fault_around.pages");
+
+// counts large pages mapped in place of a block of single pages.
+KCOUNTER(vm_large_page_map_count, "kernel.vm.large_page.map");
+
+static void fault_around_init(uint level) {
+    uint32_t pages = cmdline_get_uint32("kernel.vm.fault-around", (uint32_t)fault_around_pages);
+    pages = fbl::min(pages, (uint32_t)kFaultAroundMaxPages);
+    // keep the window a power of two so it can be aligned cheaply
+    fault_around_pages = pages ? (1ul << log2_uint_floor(pages)) : 0;
+}
+
+LK_INIT_HOOK(vm_fault_around, &fault_around_init, LK_INIT_LEVEL_VM);
+
 VmMapping::VmMapping(VmAddressRegion& parent, vaddr_t base, size_t size, uint32_t vmar_flags,
                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset, uint arch_mmu_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags,
@@ -161,7 +188,7 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         LTRACEF("arch_mmu_protect returns %d\n", status);
         arch_mmu_flags_ = new_arch_mmu_flags;
 
-        size_ = size;
+        SetSizeLocked(size);
         mapping->ActivateLocked();
         return ZX_OK;
     }
@@ -182,7 +209,7 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
         LTRACEF("arch_mmu_protect returns %d\n", status);
 
-        size_ -= size;
+        SetSizeLocked(size_ - size);
         mapping->ActivateLocked();
         return ZX_OK;
     }
@@ -211,7 +238,7 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
     LTRACEF("arch_mmu_protect returns %d\n", status);
 
     // Turn us into the left half
-    size_ = left_size;
+    SetSizeLocked(left_size);
 
     center_mapping->ActivateLocked();
     right_mapping->ActivateLocked();
@@ -283,10 +310,12 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
             // since base_ is the tree key.
             fbl::RefPtr<VmAddressRegionOrMapping> ref(parent_->subregions_.erase(*this));
             base_ += size;
+            size_ -= size;
             object_offset_ += size;
             parent_->subregions_.insert(fbl::move(ref));
+        } else {
+            SetSizeLocked(size_ - size);
         }
-        size_ -= size;
 
         return ZX_OK;
     }
@@ -314,11 +343,23 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
     }
 
     // Turn us into the left half
-    size_ = base - base_;
+    SetSizeLocked(base - base_);
     mapping->ActivateLocked();
     return ZX_OK;
 }
 
+void VmMapping::SetSizeLocked(size_t size) {
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(size <= size_);
+
+    size_ = size;
+
+    // Our parent tracks the free space between its children, which just grew.
+    if (subregion_list_node_.InContainer()) {
+        parent_->subregions_.update_subtree_state(*this);
+    }
+}
+
 zx_status_t VmMapping::UnmapVmoRangeLocked(uint64_t offset, uint64_t len) const {
     canary_.Assert();
 
@@ -504,7 +545,7 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
 
         zx_status_t status;
         paddr_t pa;
-        status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa);
+        status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, nullptr, &pa);
         if (status < 0) {
             // no page to map
             if (commit) {
@@ -518,6 +559,31 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
         }
 
         vaddr_t va = base_ + o;
+
+        // map whole blocks the object holds as contiguous runs with a single large page
+        if (IS_ALIGNED(va, VM_LARGE_PAGE_SIZE) && offset + len - o >= VM_LARGE_PAGE_SIZE &&
+            CanMapLargePageLocked(va) && (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_RWX_MASK)) {
+            paddr_t large_pa;
+            if (object_->GetLargePageLocked(vmo_offset, &large_pa) == ZX_OK) {
+                status = coalescer.Flush();
+                if (status != ZX_OK) {
+                    return status;
+                }
+
+                size_t mapped;
+                status = aspace_->arch_aspace().MapContiguous(va, large_pa,
+                                                              VM_LARGE_PAGE_SIZE / PAGE_SIZE,
+                                                              arch_mmu_flags_, &mapped);
+                if (status != ZX_OK) {
+                    return status;
+                }
+                kcounter_add(vm_large_page_map_count, 1u);
+
+                o += VM_LARGE_PAGE_SIZE - PAGE_SIZE;
+                continue;
+            }
+        }
+
         LTRACEF_LEVEL(2, "mapping pa %#" PRIxPTR " to va %#" PRIxPTR "\n", pa, va);
         status = coalescer.Append(va, pa);
         if (status != ZX_OK) {
@@ -595,7 +661,105 @@ zx_status_t VmMapping::DestroyLocked() {
     return ZX_OK;
 }
 
-zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
+void VmMapping::FaultAroundLocked(vaddr_t va, uint mmu_flags) {
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    const size_t window = fault_around_pages * PAGE_SIZE;
+    vaddr_t start = fbl::max(ROUNDDOWN(va, window), base_);
+    vaddr_t end = fbl::min(ROUNDDOWN(va, window) + window, base_ + size_);
+    if (end - base_ + object_offset_ > object_->size())
+        end = base_ + ROUNDDOWN(object_->size() - object_offset_, PAGE_SIZE);
+
+    // pages are collected into runs of consecutive addresses and mapped a run at a time
+    paddr_t pa_run[kFaultAroundMaxPages];
+    size_t run = 0;
+    vaddr_t run_start = 0;
+    size_t total = 0;
+
+    auto flush_run = [&]() {
+        if (run == 0)
+            return;
+        size_t mapped;
+        zx_status_t status = aspace_->arch_aspace().Map(run_start, pa_run, run, mmu_flags, &mapped);
+        if (status == ZX_OK) {
+            total += mapped;
+#if ARCH_ARM64
+            if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)
+                arch_sync_cache_range(run_start, mapped * PAGE_SIZE);
+#endif
+        }
+        run = 0;
+    };
+
+    for (vaddr_t addr = start; addr < end; addr += PAGE_SIZE) {
+        if (addr == va) {
+            flush_run();
+            continue;
+        }
+
+        // only take pages that are already there; with no fault flags the object will not
+        // allocate, and will not hand out the zero page
+        paddr_t pa;
+        zx_status_t status = object_->GetPageLocked(addr - base_ + object_offset_, 0, nullptr,
+                                                    nullptr, nullptr, &pa);
+        paddr_t mapped_pa;
+        uint page_flags;
+        if (status != ZX_OK || aspace_->arch_aspace().Query(addr, &mapped_pa, &page_flags) == ZX_OK) {
+            flush_run();
+            continue;
+        }
+
+        if (run == 0)
+            run_start = addr;
+        pa_run[run++] = pa;
+    }
+    flush_run();
+
+    if (total > 0) {
+        kcounter_add(vm_fault_around_count, 1u);
+        kcounter_add(vm_fault_around_pages_count, total);
+    }
+}
+
+bool VmMapping::CanMapLargePageLocked(vaddr_t va) const {
+    if (!vm_large_pages_enabled() || !aspace_->is_user())
+        return false;
+
+    const vaddr_t block = ROUNDDOWN(va, VM_LARGE_PAGE_SIZE);
+    if (block < base_ || block + VM_LARGE_PAGE_SIZE - 1 > base_ + size_ - 1)
+        return false;
+
+    return IS_ALIGNED(block - base_ + object_offset_, VM_LARGE_PAGE_SIZE);
+}
+
+zx_status_t VmMapping::MapLargePageLocked(vaddr_t va, uint mmu_flags) {
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+    DEBUG_ASSERT(CanMapLargePageLocked(va));
+
+    const vaddr_t block = ROUNDDOWN(va, VM_LARGE_PAGE_SIZE);
+    paddr_t pa;
+    zx_status_t status = object_->GetLargePageLocked(block - base_ + object_offset_, &pa);
+    if (status != ZX_OK)
+        return status;
+
+    const size_t count = VM_LARGE_PAGE_SIZE / PAGE_SIZE;
+    status = aspace_->arch_aspace().Unmap(block, count, nullptr);
+    if (status != ZX_OK)
+        return status;
+
+    size_t mapped;
+    status = aspace_->arch_aspace().MapContiguous(block, pa, count, mmu_flags, &mapped);
+    if (status != ZX_OK) {
+        TRACEF("failed to map large page at va %#" PRIxPTR "\n", block);
+        return status;
+    }
+    DEBUG_ASSERT(mapped == count);
+
+    kcounter_add(vm_large_page_map_count, 1u);
+    return ZX_OK;
+}
+
+zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -634,6 +798,15 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     // grab the lock for the vmo
     AutoLock al(object_->lock());
 
+    // the first write to an empty block that we could map whole commits it as one large page,
+    // if the object uses them and a run is free. this happens before we mark ourself as faulting
+    // so that any pages of the block we have mapped to the zero page get unmapped along with
+    // everyone else's.
+    const bool large_page = CanMapLargePageLocked(va);
+    if (large_page && (pf_flags & VMM_PF_FLAG_WRITE)) {
+        object_->CommitLargePageLocked(vmo_offset, true);
+    }
+
     // set the currently faulting flag for any recursive calls the vmo may make back into us
     // The specific path we're avoiding is if the VMO calls back into us during vmo->GetPageLocked()
     // via UnmapVmoRangeLocked(). Since we're responsible for that page, signal to ourself to skip
@@ -645,7 +818,12 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     // fault in or grab an existing page
     paddr_t new_pa;
     vm_page_t* page;
-    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, page_request,
+                                                &page, &new_pa);
+    if (status == ZX_ERR_SHOULD_WAIT) {
+        // the page has been asked for; the caller waits for it and faults again
+        return status;
+    }
     if (status < 0) {
         TRACEF("ERROR: failed to fault in or grab existing page\n");
         TRACEF("%p vmo_offset %#" PRIx64 ", pf_flags %#x\n", this, vmo_offset, pf_flags);
@@ -666,6 +844,17 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     uint page_flags;
     paddr_t pa;
     zx_status_t err = aspace_->arch_aspace().Query(va, &pa, &page_flags);
+
+    // unless the page is already mapped the way we want, try to map its whole block at once
+    const bool already_mapped = err >= 0 && pa == new_pa &&
+                                (page_flags == arch_mmu_flags_ || page_flags == mmu_flags);
+    if (large_page && !already_mapped) {
+        if (MapLargePageLocked(va, mmu_flags) == ZX_OK)
+            return ZX_OK;
+        // the block may have been unmapped before the large mapping failed
+        err = aspace_->arch_aspace().Query(va, &pa, &page_flags);
+    }
+
     if (err >= 0) {
         LTRACEF("queried va, page at pa %#" PRIxPTR ", flags %#x is already there\n", pa,
                 page_flags);
@@ -726,6 +915,12 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
             return ZX_ERR_NO_MEMORY;
         }
         DEBUG_ASSERT(mapped == 1);
+
+        // a read fault is often the first of a run, so map what else is already resident nearby
+        if (!(pf_flags & (VMM_PF_FLAG_WRITE | VMM_PF_FLAG_GUEST)) &&
+            !(flags_ & VMAR_FLAG_NO_FAULT_AROUND) && fault_around_pages > 1) {
+            FaultAroundLocked(va, mmu_flags);
+        }
     }
 
 // TODO: figure out what to do with this
@@ -29,6 +29,8 @@ using fbl::AutoLock;
 
 fbl::Mutex VmObject::all_vmos_lock_ = {};
 VmObject::GlobalList VmObject::all_vmos_ = {};
+VmObject* VmObject::scan_cursor_ = nullptr;
+bool VmObject::scan_cursor_at_end_ = false;
 
 VmObject::VmObject(fbl::RefPtr<VmObject> parent)
     : lock_(parent ? parent->lock_ref() : local_lock_),
@@ -68,6 +70,9 @@ VmObject::~VmObject() {
     {
         AutoLock a(&all_vmos_lock_);
         DEBUG_ASSERT(global_list_state_.InContainer() == true);
+        if (scan_cursor_ == this) {
+            AdvanceScanCursorLocked();
+        }
         all_vmos_.erase(*this);
     }
 }
@@ -137,6 +142,44 @@ uint32_t VmObject::num_mappings() const {
     return mapping_list_len_;
 }
 
+bool VmObject::GetScanCursor(fbl::RefPtr<VmObject>* vmo) {
+    AutoLock a(&all_vmos_lock_);
+    if (!scan_cursor_ && !scan_cursor_at_end_ && !all_vmos_.is_empty()) {
+        scan_cursor_ = &all_vmos_.front();
+    }
+    while (scan_cursor_) {
+        // the list holds raw pointers, so the object may be on its way out
+        *vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(scan_cursor_, all_vmos_lock_);
+        if (*vmo) {
+            return true;
+        }
+        AdvanceScanCursorLocked();
+    }
+    scan_cursor_at_end_ = false;
+    return false;
+}
+
+void VmObject::AdvanceScanCursor(const VmObject* vmo) {
+    AutoLock a(&all_vmos_lock_);
+    if (scan_cursor_ == vmo) {
+        AdvanceScanCursorLocked();
+    }
+}
+
+void VmObject::AdvanceScanCursorLocked() {
+    if (!scan_cursor_) {
+        return;
+    }
+    auto iter = all_vmos_.make_iterator(*scan_cursor_);
+    ++iter;
+    if (iter.IsValid()) {
+        scan_cursor_ = &*iter;
+    } else {
+        scan_cursor_ = nullptr;
+        scan_cursor_at_end_ = true;
+    }
+}
+
 bool VmObject::IsMappedByUser() const {
     canary_.Assert();
     AutoLock a(&lock_);
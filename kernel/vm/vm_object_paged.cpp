@@ -11,15 +11,18 @@
 #include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <safeint/safe_math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
 #include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -29,6 +32,11 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+// counts blocks committed as one physically contiguous large page.
+KCOUNTER(vm_large_page_alloc_count, "kernel.vm.large_page.alloc");
+// counts blocks that were eligible but fell back to single pages.
+KCOUNTER(vm_large_page_alloc_fail_count, "kernel.vm.large_page.alloc_fail");
+
 namespace {
 
 void ZeroPage(paddr_t pa) {
@@ -43,6 +51,18 @@ void ZeroPage(vm_page_t* p) {
     ZeroPage(pa);
 }
 
+bool PageIsZero(vm_page_t* p) {
+    const uint64_t* ptr = static_cast<const uint64_t*>(paddr_to_physmap(vm_page_to_paddr(p)));
+    DEBUG_ASSERT(ptr);
+
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (ptr[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void InitializeVmPage(vm_page_t* p) {
     DEBUG_ASSERT(p->state == VM_PAGE_STATE_ALLOC);
     p->state = VM_PAGE_STATE_OBJECT;
@@ -52,6 +72,9 @@ void InitializeVmPage(vm_page_t* p) {
 
 } // namespace
 
+fbl::Mutex VmObjectPaged::discardable_list_lock_ = {};
+VmObjectPaged::DiscardableList VmObjectPaged::discardable_list_ = {};
+
 VmObjectPaged::VmObjectPaged(uint32_t pmm_alloc_flags, fbl::RefPtr<VmObject> parent)
     : VmObject(fbl::move(parent)), pmm_alloc_flags_(pmm_alloc_flags) {
     LTRACEF("%p\n", this);
@@ -71,20 +94,61 @@ VmObjectPaged::~VmObjectPaged() {
             return ZX_ERR_NEXT;
         });
 
+    {
+        AutoLock a(&discardable_list_lock_);
+        if (discardable_list_state_.InContainer()) {
+            discardable_list_.erase(*this);
+        }
+    }
+
+    // nothing is left to supply pages to
+    if (page_source_) {
+        page_source_->Close();
+    }
+
     // free all of the pages attached to us
     page_list_.FreeAllPages();
 }
 
-zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* obj) {
+zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                                  fbl::RefPtr<VmObject>* obj) {
     // there's a max size to keep indexes within range
     if (size > MAX_SIZE)
         return ZX_ERR_INVALID_ARGS;
+    if (options & ~kLargePages)
+        return ZX_ERR_INVALID_ARGS;
 
     fbl::AllocChecker ac;
-    auto vmo = fbl::AdoptRef<VmObject>(new (&ac) VmObjectPaged(pmm_alloc_flags, nullptr));
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(pmm_alloc_flags, nullptr));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    // set before anyone else can see the object, so it needs no lock
+    vmo->large_pages_ = (options & kLargePages) != 0;
+
+    auto err = vmo->Resize(size);
+    if (err != ZX_OK)
+        return err;
+
+    *obj = fbl::move(vmo);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::CreateExternal(fbl::RefPtr<PageSource> src, uint32_t pmm_alloc_flags,
+                                          uint64_t size, fbl::RefPtr<VmObject>* obj) {
+    // there's a max size to keep indexes within range
+    if (size > MAX_SIZE)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(pmm_alloc_flags, nullptr));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    // set before anyone else can see the object, so it needs no lock
+    vmo->page_source_ = fbl::move(src);
+
     auto err = vmo->Resize(size);
     if (err != ZX_OK)
         return err;
@@ -99,6 +163,11 @@ zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_na
 
     canary_.Assert();
 
+    // a clone only looks for pages its parent already holds, and would zero-fill
+    // the ones that the page source has yet to supply
+    if (page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
     fbl::AllocChecker ac;
     auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(pmm_alloc_flags_, fbl::WrapRefPtr(this)));
     if (!ac.check())
@@ -264,7 +333,8 @@ zx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, fbl::
 // and will not fail if |free_list| is a non-empty list, faulting in was requested,
 // and offset is in range.
 zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                                         vm_page_t** const page_out, paddr_t* const pa_out) {
+                                         PageRequest* page_request, vm_page_t** const page_out,
+                                         paddr_t* const pa_out) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
 
@@ -298,7 +368,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         uint parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
 
         zx_status_t status = parent_->GetPageLocked(parent_offset.ValueOrDie(), parent_pf_flags,
-                                                    nullptr, &p, &pa);
+                                                    nullptr, nullptr, &p, &pa);
         if (status == ZX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -359,6 +429,13 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     if ((pf_flags & VMM_PF_FLAG_FAULT_MASK) == 0)
         return ZX_ERR_NOT_FOUND;
 
+    // the contents of a missing page of an object with a page source come from the source
+    if (page_source_) {
+        if (!page_request)
+            return ZX_ERR_NOT_FOUND;
+        return page_source_->GetPage(offset, page_request);
+    }
+
     // if we're read faulting, we don't already have a page, and the parent doesn't have it,
     // return the single global zero page
     if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
@@ -370,7 +447,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
-    // allocate a page
+    // allocate a zeroed page; pages on |free_list| were allocated zeroed
     if (free_list) {
         p = list_remove_head_type(free_list, vm_page_t, free.node);
         if (p) {
@@ -378,7 +455,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
     if (!p) {
-        p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+        p = pmm_alloc_page(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &pa);
     }
     if (!p) {
         return ZX_ERR_NO_MEMORY;
@@ -386,9 +463,6 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     InitializeVmPage(p);
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
     zx_status_t status = AddPageLocked(p, offset);
     DEBUG_ASSERT(status == ZX_OK);
 
@@ -405,15 +479,109 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::CommitLargePageLocked(uint64_t offset, bool faulting) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // a sparse object would have every block it touches committed whole, so only objects
+    // created for it are backed with large runs. clones share their parent's pages, and the
+    // pages of an object with a page source are only ever supplied by the source
+    if (!vm_large_pages_enabled() || !large_pages_ || parent_ || page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    const uint64_t start = ROUNDDOWN(offset, VM_LARGE_PAGE_SIZE);
+    if (start + VM_LARGE_PAGE_SIZE > size_ || start + VM_LARGE_PAGE_SIZE < start)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    bool empty = true;
+    page_list_.ForEveryPageInRange(
+        [&empty](const auto p, uint64_t off) {
+            empty = false;
+            return ZX_ERR_STOP;
+        },
+        start, start + VM_LARGE_PAGE_SIZE);
+    if (!empty)
+        return ZX_ERR_ALREADY_EXISTS;
+
+    list_node page_list;
+    list_initialize(&page_list);
+
+    const size_t count = VM_LARGE_PAGE_SIZE / PAGE_SIZE;
+    const uint32_t alloc_flags = pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED |
+                                 (faulting ? PMM_ALLOC_FLAG_NO_DRAIN : 0);
+    if (pmm_alloc_contiguous(count, alloc_flags, VM_LARGE_PAGE_SHIFT, nullptr, &page_list) < count) {
+        kcounter_add(vm_large_page_alloc_fail_count, 1u);
+        pmm_free(&page_list);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    for (uint64_t o = start; o < start + VM_LARGE_PAGE_SIZE; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(&page_list, vm_page_t, free.node);
+        DEBUG_ASSERT(p);
+
+        InitializeVmPage(p);
+
+        zx_status_t status = page_list_.AddPage(p, o);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+    kcounter_add(vm_large_page_alloc_count, 1u);
+
+    // the block may have been mapped to the zero page, so unmap it everywhere
+    RangeChangeUpdateLocked(start, VM_LARGE_PAGE_SIZE);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::GetLargePageLocked(uint64_t offset, paddr_t* pa) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(IS_ALIGNED(offset, VM_LARGE_PAGE_SIZE));
+
+    // only objects created to use large pages are committed in runs worth mapping whole
+    if (!large_pages_)
+        return ZX_ERR_NOT_FOUND;
+    if (offset + VM_LARGE_PAGE_SIZE > size_ || offset + VM_LARGE_PAGE_SIZE < offset)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    // only our own pages count; pages borrowed from a parent must still be copied on write
+    vm_page_t* first = page_list_.GetPage(offset);
+    if (!first)
+        return ZX_ERR_NOT_FOUND;
+    const paddr_t base = vm_page_to_paddr(first);
+    if (!IS_ALIGNED(base, VM_LARGE_PAGE_SIZE))
+        return ZX_ERR_NOT_FOUND;
+
+    size_t found = 0;
+    page_list_.ForEveryPageInRange(
+        [base, offset, &found](const auto p, uint64_t off) {
+            if (vm_page_to_paddr(p) != base + (off - offset))
+                return ZX_ERR_STOP;
+            found++;
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + VM_LARGE_PAGE_SIZE);
+    if (found != VM_LARGE_PAGE_SIZE / PAGE_SIZE)
+        return ZX_ERR_NOT_FOUND;
+
+    *pa = base;
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) {
     canary_.Assert();
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
+    AutoLock a(&lock_);
+    return CommitRangeLocked(offset, len, committed);
+}
+
+zx_status_t VmObjectPaged::CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
     if (committed)
         *committed = 0;
 
-    AutoLock a(&lock_);
-
     // trim the size
     uint64_t new_len;
     if (!TrimRange(offset, len, size_, &new_len))
@@ -428,6 +596,45 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     DEBUG_ASSERT(end > offset);
     offset = ROUNDDOWN(offset, PAGE_SIZE);
 
+    // the pages of an object with a page source have to come from the source
+    if (page_source_) {
+        PageRequest page_request;
+        uint64_t o = offset;
+        while (o < end) {
+            if (page_list_.GetPage(o)) {
+                o += PAGE_SIZE;
+                continue;
+            }
+            const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
+            zx_status_t status = GetPageLocked(o, flags, nullptr, &page_request, nullptr, nullptr);
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                // wait for the page without holding our lock, then look again
+                lock_.Release();
+                status = page_request.Wait(false);
+                lock_.Acquire();
+                if (status != ZX_OK)
+                    return status;
+                if (committed && page_list_.GetPage(o))
+                    *committed += PAGE_SIZE;
+                continue;
+            }
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
+
+    // back whole, empty, aligned blocks of the range with large pages first, and commit
+    // whatever is left a page at a time
+    uint64_t large_committed = 0;
+    for (uint64_t o = ROUNDUP(offset, VM_LARGE_PAGE_SIZE);
+         o >= offset && end - o >= VM_LARGE_PAGE_SIZE && o < end; o += VM_LARGE_PAGE_SIZE) {
+        if (CommitLargePageLocked(o, false) == ZX_OK)
+            large_committed += VM_LARGE_PAGE_SIZE;
+    }
+    if (committed)
+        *committed = large_committed;
+
     // make a pass through the list, counting the number of pages we need to allocate
     size_t count = 0;
     uint64_t expected_next_off = offset;
@@ -451,7 +658,10 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    // GetPageLocked counts on these being zeroed. Those that end up as copies
+    // of a parent's pages are zeroed for nothing, but that's the rarer case.
+    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED,
+                                       &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
         pmm_free(&page_list);
@@ -474,7 +684,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
         const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
         // Should not be able to fail, since we're providing it memory and the
         // range should be valid.
-        zx_status_t status = GetPageLocked(o, flags, &page_list, &p, &pa);
+        zx_status_t status = GetPageLocked(o, flags, &page_list, nullptr, &p, &pa);
         ASSERT(status == ZX_OK);
 
         if (committed)
@@ -484,7 +694,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     DEBUG_ASSERT(list_is_empty(&page_list));
 
     // for now we only support committing as much as we were asked for
-    DEBUG_ASSERT(!committed || *committed == count * PAGE_SIZE);
+    DEBUG_ASSERT(!committed || *committed == count * PAGE_SIZE + large_committed);
 
     return ZX_OK;
 }
@@ -533,7 +743,8 @@ zx_status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len,
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_contiguous(count, pmm_alloc_flags_, alignment_log2, nullptr, &page_list);
+    size_t allocated = pmm_alloc_contiguous(count, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED,
+                                            alignment_log2, nullptr, &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
         pmm_free(&page_list);
@@ -552,9 +763,6 @@ zx_status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len,
 
         InitializeVmPage(p);
 
-        // TODO: remove once pmm returns zeroed pages
-        ZeroPage(p);
-
         auto status = page_list_.AddPage(p, o);
         DEBUG_ASSERT(status == ZX_OK);
 
@@ -577,11 +785,18 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
     canary_.Assert();
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
+    AutoLock a(&lock_);
+    return DecommitRangeLocked(offset, len, decommitted);
+}
+
+zx_status_t VmObjectPaged::DecommitRangeLocked(uint64_t offset, uint64_t len,
+                                               uint64_t* decommitted) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
     if (decommitted)
         *decommitted = 0;
 
-    AutoLock a(&lock_);
-
     // trim the size
     uint64_t new_len;
     if (!TrimRange(offset, len, size_, &new_len))
@@ -623,6 +838,316 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::RangeOpBatch(const VmRangeOp* ops, size_t count, size_t* completed) {
+    canary_.Assert();
+    LTRACEF("count %zu\n", count);
+
+    *completed = 0;
+
+    // one lock acquisition for the whole batch. only commits from a page source
+    // ever drop it, to wait for their pages
+    AutoLock a(&lock_);
+
+    // check every range before applying any, so that a bad one doesn't leave the batch half done
+    for (size_t i = 0; i < count; i++) {
+        const VmRangeOp& op = ops[i];
+        uint64_t trimmed_len;
+        bool valid = (op.type == VmRangeOpType::Pin) ? InRange(op.offset, op.len, size_)
+                                                      : TrimRange(op.offset, op.len, size_,
+                                                                  &trimmed_len);
+        if (!valid)
+            return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const VmRangeOp& op = ops[i];
+        LTRACEF("op %u offset %#" PRIx64 ", len %#" PRIx64 "\n",
+                static_cast<uint32_t>(op.type), op.offset, op.len);
+
+        zx_status_t status;
+        switch (op.type) {
+        case VmRangeOpType::Commit:
+            status = CommitRangeLocked(op.offset, op.len, nullptr);
+            break;
+        case VmRangeOpType::Decommit:
+            status = DecommitRangeLocked(op.offset, op.len, nullptr);
+            break;
+        case VmRangeOpType::Pin:
+            status = PinLocked(op.offset, op.len);
+            break;
+        default:
+            status = ZX_ERR_INVALID_ARGS;
+            break;
+        }
+        if (status != ZX_OK)
+            return status;
+
+        *completed = i + 1;
+    }
+
+    return ZX_OK;
+}
+
+size_t VmObjectPaged::ReclaimZeroPages(uint64_t* offset, size_t max_pages, size_t* scanned) {
+    canary_.Assert();
+
+    // scan in small chunks so that the lock is never held for long
+    static constexpr size_t kMaxCandidates = 64;
+    max_pages = fbl::min(max_pages, kMaxCandidates);
+    *scanned = 0;
+
+    AutoLock a(&lock_);
+
+    // only user memory qualifies: the pages of a clone may be hiding different
+    // contents in the parent, and the kernel may touch its own memory where it
+    // can't take a fault to bring a page back
+    bool eligible = !parent_ && !page_source_ && (pmm_alloc_flags_ & PMM_ALLOC_FLAG_MOVABLE);
+    for (const auto& m : mapping_list_) {
+        if (!m.aspace()->is_user()) {
+            eligible = false;
+            break;
+        }
+    }
+    if (!eligible || *offset >= size_) {
+        *offset = UINT64_MAX;
+        return 0;
+    }
+
+    // first pass: find pages that look zero. they can still be written
+    // through existing mappings, so this is only a hint
+    uint64_t candidates[kMaxCandidates];
+    size_t candidate_count = 0;
+    uint64_t next = UINT64_MAX;
+    page_list_.ForEveryPageInRange(
+        [&](const auto p, uint64_t off) {
+            if (*scanned == max_pages) {
+                next = off;
+                return ZX_ERR_STOP;
+            }
+            (*scanned)++;
+            if (p->object.pin_count == 0 && PageIsZero(p)) {
+                candidates[candidate_count++] = off;
+            }
+            return ZX_ERR_NEXT;
+        },
+        *offset, ROUNDUP_PAGE_SIZE(size_));
+    *offset = next;
+
+    // second pass: unmap each candidate so that it can no longer change, then
+    // check it again before freeing it
+    size_t reclaimed = 0;
+    for (size_t i = 0; i < candidate_count; i++) {
+        uint64_t off = candidates[i];
+        RangeChangeUpdateLocked(off, PAGE_SIZE);
+
+        vm_page_t* p = page_list_.GetPage(off);
+        DEBUG_ASSERT(p);
+        if (PageIsZero(p)) {
+            page_list_.FreePage(off);
+            reclaimed++;
+        }
+    }
+
+    return reclaimed;
+}
+
+zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    // the pages must be ours alone
+    if (parent_ || children_list_len_ > 0)
+        return ZX_ERR_BAD_STATE;
+
+    size_t count = 0;
+    page_list_.ForEveryPageInRange(
+        [&count](const auto p, uint64_t off) {
+            if (p->object.pin_count == 0)
+                count++;
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + len);
+    if (count != len / PAGE_SIZE)
+        return ZX_ERR_BAD_STATE;
+
+    // unmap all of the pages in this range on all the mapping regions
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = page_list_.RemovePage(o);
+        DEBUG_ASSERT(p);
+        list_add_tail(pages, &p->free.node);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    if (!page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    list_node redundant;
+    list_initialize(&redundant);
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(pages, vm_page_t, free.node);
+        DEBUG_ASSERT(p);
+
+        // a page that is already there may have been written since, so it stays
+        if (page_list_.GetPage(o)) {
+            list_add_tail(&redundant, &p->free.node);
+            continue;
+        }
+        zx_status_t status = AddPageLocked(p, o);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+    DEBUG_ASSERT(list_is_empty(pages));
+
+    page_source_->OnPagesSupplied(offset, len);
+
+    pmm_free(&redundant);
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SetDiscardable() {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    // a clone's contents partly live in its parent, and a parent's pages are
+    // seen through its clones, so neither can be thrown away on its own. the
+    // pages of an object with a page source already come back on their own
+    if (discardable_ || parent_ || children_list_len_ > 0 || page_source_) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    discardable_ = true;
+    discardable_lock_count_ = 1;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::LockDiscardable(bool* was_discarded) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    if (!discardable_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (discardable_lock_count_ == UINT32_MAX) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    if (discardable_lock_count_++ == 0) {
+        RemoveFromDiscardableListLocked();
+    }
+    *was_discarded = discarded_;
+    discarded_ = false;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::UnlockDiscardable() {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+    return UnlockDiscardableLocked();
+}
+
+zx_status_t VmObjectPaged::CancelLockDiscardable(bool was_discarded) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    zx_status_t status = UnlockDiscardableLocked();
+    if (status == ZX_OK && was_discarded) {
+        discarded_ = true;
+    }
+    return status;
+}
+
+zx_status_t VmObjectPaged::UnlockDiscardableLocked() {
+    if (!discardable_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (discardable_lock_count_ == 0) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    if (--discardable_lock_count_ == 0) {
+        AddToDiscardableListLocked();
+    }
+    return ZX_OK;
+}
+
+size_t VmObjectPaged::Discard() {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    if (!discardable_ || discardable_lock_count_ > 0 || children_list_len_ > 0) {
+        return 0;
+    }
+    if (AnyPagesPinnedLocked(0, ROUNDUP_PAGE_SIZE(size_))) {
+        return 0;
+    }
+
+    // unmap everything, then let go of the pages. touching the object before
+    // locking it again just finds fresh zero pages
+    RangeChangeUpdateLocked(0, ROUNDUP_PAGE_SIZE(size_));
+    size_t freed = page_list_.FreeAllPages();
+
+    discarded_ = true;
+    RemoveFromDiscardableListLocked();
+    return freed;
+}
+
+size_t VmObjectPaged::EvictDiscardable(size_t max_pages) {
+    size_t freed = 0;
+    while (freed < max_pages) {
+        fbl::RefPtr<VmObjectPaged> vmo;
+        {
+            AutoLock a(&discardable_list_lock_);
+            if (discardable_list_.is_empty()) {
+                break;
+            }
+            // an object that can't be discarded right now (relocked, pinned or
+            // cloned in the meantime) simply drops off the list until its next
+            // unlock puts it back
+            VmObjectPaged* oldest = discardable_list_.pop_front();
+            vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(oldest, discardable_list_lock_);
+        }
+        if (vmo) {
+            freed += vmo->Discard();
+        }
+    }
+    return freed;
+}
+
+void VmObjectPaged::AddToDiscardableListLocked() {
+    AutoLock a(&discardable_list_lock_);
+    DEBUG_ASSERT(!discardable_list_state_.InContainer());
+    discardable_list_.push_back(this);
+}
+
+void VmObjectPaged::RemoveFromDiscardableListLocked() {
+    AutoLock a(&discardable_list_lock_);
+    if (discardable_list_state_.InContainer()) {
+        discardable_list_.erase(*this);
+    }
+}
+
 zx_status_t VmObjectPaged::Pin(uint64_t offset, uint64_t len) {
     canary_.Assert();
 
@@ -834,6 +1359,7 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t
     // walk the list of pages and do the write
     uint64_t src_offset = offset;
     size_t dest_offset = 0;
+    PageRequest page_request;
     while (new_len > 0) {
         size_t page_offset = src_offset % PAGE_SIZE;
         size_t tocopy = MIN(PAGE_SIZE - page_offset, new_len);
@@ -842,7 +1368,15 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t
         paddr_t pa;
         auto status = GetPageLocked(src_offset,
                                     VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
-                                    nullptr, nullptr, &pa);
+                                    nullptr, &page_request, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            // wait for the page source without holding our lock, then try again
+            lock_.Release();
+            status = page_request.Wait(false);
+            lock_.Acquire();
+            if (status == ZX_OK)
+                continue;
+        }
         if (status < 0)
             return status;
 
@@ -927,7 +1461,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
 
                 paddr_t pa;
                 zx_status_t status = this->GetPageLocked(missing_off, pf_flags, nullptr,
-                                                         nullptr, &pa);
+                                                         nullptr, nullptr, &pa);
                 if (status != ZX_OK) {
                     return ZX_ERR_NO_MEMORY;
                 }
@@ -962,7 +1496,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
     // If expected_next_off isn't at the end, there's a gap to process
     for (uint64_t off = expected_next_off; off < end_page_offset; off += PAGE_SIZE) {
         paddr_t pa;
-        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, &pa);
+        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, nullptr, &pa);
         if (status != ZX_OK) {
             return ZX_ERR_NO_MEMORY;
         }
@@ -1063,7 +1597,7 @@ zx_status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t l
 
         // lookup the physical address of the page, careful not to fault in a new one
         paddr_t pa;
-        auto status = GetPageLocked(op_start_offset, 0, nullptr, nullptr, &pa);
+        auto status = GetPageLocked(op_start_offset, 0, nullptr, nullptr, nullptr, &pa);
 
         if (likely(status == ZX_OK)) {
             // Convert the page address to a Kernel virtual address.
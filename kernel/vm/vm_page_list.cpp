@@ -47,6 +47,7 @@ vm_page* VmPageListNode::RemovePage(size_t index) {
         return nullptr;
 
     pages_[index] = nullptr;
+    page_count_--;
 
     return p;
 }
@@ -57,6 +58,7 @@ zx_status_t VmPageListNode::AddPage(vm_page* p, size_t index) {
     if (pages_[index])
         return ZX_ERR_ALREADY_EXISTS;
     pages_[index] = p;
+    page_count_++;
     return ZX_OK;
 }
 
@@ -69,6 +71,25 @@ VmPageList::~VmPageList() {
     DEBUG_ASSERT(list_.is_empty());
 }
 
+VmPageListNode* VmPageList::FindNode(uint64_t node_offset) {
+    if (cursor_ && cursor_->offset() == node_offset)
+        return cursor_;
+
+    auto pln = list_.find(node_offset);
+    if (!pln.IsValid())
+        return nullptr;
+
+    cursor_ = &*pln;
+    return cursor_;
+}
+
+void VmPageList::EraseNode(VmPageListNode* node) {
+    LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
+    if (cursor_ == node)
+        cursor_ = nullptr;
+    list_.erase(*node);
+}
+
 zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
     uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
@@ -77,8 +98,8 @@ zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
                   node_offset, index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    auto pln = FindNode(node_offset);
+    if (!pln) {
         fbl::AllocChecker ac;
         fbl::unique_ptr<VmPageListNode> pl =
             fbl::unique_ptr<VmPageListNode>(new (&ac) VmPageListNode(node_offset));
@@ -89,6 +110,7 @@ zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
         __UNUSED auto status = pl->AddPage(p, index);
         DEBUG_ASSERT(status == ZX_OK);
 
+        cursor_ = pl.get();
         list_.insert(fbl::move(pl));
     } else {
         pln->AddPage(p, index);
@@ -105,8 +127,8 @@ vm_page* VmPageList::GetPage(uint64_t offset) {
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    auto pln = FindNode(node_offset);
+    if (!pln) {
         return nullptr;
     }
 
@@ -121,8 +143,8 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    auto pln = FindNode(node_offset);
+    if (!pln) {
         return ZX_ERR_NOT_FOUND;
     }
 
@@ -131,8 +153,7 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
     if (page) {
         // if it was the last page in the node, remove the node from the tree
         if (pln->IsEmpty()) {
-            LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
-            list_.erase(*pln);
+            EraseNode(pln);
         }
 
         pmm_free_page(page);
@@ -141,6 +162,26 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
     return ZX_OK;
 }
 
+vm_page* VmPageList::RemovePage(uint64_t offset) {
+    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+    size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
+
+    LTRACEF_LEVEL(2, "%p offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, offset, node_offset,
+                  index);
+
+    // lookup the tree node that holds this page
+    auto pln = FindNode(node_offset);
+    if (!pln) {
+        return nullptr;
+    }
+
+    auto page = pln->RemovePage(index);
+    if (page && pln->IsEmpty()) {
+        EraseNode(pln);
+    }
+    return page;
+}
+
 size_t VmPageList::FreeAllPages() {
     LTRACEF("%p\n", this);
 
@@ -166,6 +207,7 @@ size_t VmPageList::FreeAllPages() {
     DEBUG_ASSERT(freed == count);
 
     // empty the tree
+    cursor_ = nullptr;
     list_.clear();
 
     return count;
@@ -117,6 +117,16 @@ static inline bool GetIntersect(O offset1, L len1, O offset2, L len2, O* offset_
     return true;
 }
 
+// size and alignment of the large pages that user VMOs are committed and mapped with when possible
+#define VM_LARGE_PAGE_SHIFT 21
+#define VM_LARGE_PAGE_SIZE (1ul << VM_LARGE_PAGE_SHIFT)
+
+// whether aligned regions of user VMOs created for it should be backed by and mapped as large pages
+static inline bool vm_large_pages_enabled(void) {
+    extern bool vm_large_pages;
+    return vm_large_pages;
+}
+
 // return a pointer to the zero page
 static inline vm_page_t* vm_get_zero_page(void) {
     extern vm_page_t* zero_page;
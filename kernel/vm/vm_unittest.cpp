@@ -4,11 +4,19 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include "pmm_arena.h"
+#include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <fbl/auto_lock.h>
+#include <inttypes.h>
+#include <platform.h>
 #include <unittest.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
+#include <vm/page_source.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
@@ -72,6 +80,114 @@ static bool pmm_oversized_alloc_test(void* context) {
     END_TEST;
 }
 
+// Allocates and frees single pages, one at a time and in bulk, enough to
+// cycle them through the per-cpu page caches and back to the arenas.
+static bool pmm_page_cache_test(void* context) {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 256;
+
+    for (size_t i = 0; i < alloc_count; i++) {
+        paddr_t pa;
+        vm_page_t* page = pmm_alloc_page(PMM_ALLOC_FLAG_MOVABLE, &pa);
+        REQUIRE_NE(nullptr, page, "pmm_alloc_page");
+        EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "allocated page state");
+        EXPECT_EQ(page, paddr_to_vm_page(pa), "paddr_to_vm_page on cached page");
+        list_add_tail(&list, &page->free.node);
+    }
+
+    // give half of them back one at a time and the rest as a list
+    for (size_t i = 0; i < alloc_count / 2; i++) {
+        vm_page_t* page = list_remove_head_type(&list, vm_page_t, free.node);
+        EXPECT_EQ(1u, pmm_free_page(page), "pmm_free_page");
+    }
+    EXPECT_EQ(alloc_count / 2, pmm_free(&list), "pmm_free on a list of pages");
+
+    // the freed pages are counted as free wherever they ended up
+    size_t state_count[_VM_PAGE_STATE_COUNT] = {};
+    pmm_count_total_states(state_count);
+    EXPECT_LE(alloc_count, state_count[VM_PAGE_STATE_FREE], "free page state count");
+    END_TEST;
+}
+
+// Allocates aligned contiguous runs of a few different shapes and checks
+// their alignment and contiguity.
+static bool pmm_alloc_contiguous_test(void* context) {
+    BEGIN_TEST;
+
+    static const struct {
+        size_t count;
+        uint8_t alignment_log2;
+        uint flags;
+    } cases[] = {
+        {1, PAGE_SIZE_SHIFT + 4, PMM_ALLOC_FLAG_ANY},
+        {3, PAGE_SIZE_SHIFT, PMM_ALLOC_FLAG_ANY},
+        {5, PAGE_SIZE_SHIFT + 3, PMM_ALLOC_FLAG_KMAP},
+        {512, 21, PMM_ALLOC_FLAG_MOVABLE},
+        {1500, PAGE_SIZE_SHIFT, PMM_ALLOC_FLAG_ANY},
+    };
+
+    for (const auto& c : cases) {
+        list_node list = LIST_INITIAL_VALUE(list);
+        paddr_t pa;
+        size_t count = pmm_alloc_contiguous(c.count, c.flags, c.alignment_log2, &pa, &list);
+        REQUIRE_EQ(c.count, count, "pmm_alloc_contiguous count");
+        EXPECT_EQ(0u, pa & ((1ul << c.alignment_log2) - 1), "pmm_alloc_contiguous alignment");
+
+        paddr_t expected = pa;
+        vm_page_t* p;
+        list_for_every_entry (&list, p, vm_page_t, free.node) {
+            EXPECT_EQ(expected, vm_page_to_paddr(p), "pmm_alloc_contiguous contiguity");
+            EXPECT_EQ(VM_PAGE_STATE_ALLOC, p->state, "allocated page state");
+            expected += PAGE_SIZE;
+        }
+
+        EXPECT_EQ(c.count, pmm_free(&list), "pmm_free on a contiguous run");
+    }
+    END_TEST;
+}
+
+// Builds an arena over physical memory that is never touched, fragments it so
+// that a free run of four pages straddles buddy blocks, and checks that a
+// contiguous allocation with no more than page alignment still finds the run.
+static bool pmm_arena_alloc_contiguous_fragmented_test(void* context) {
+    BEGIN_TEST;
+
+    static const size_t page_count = 16;
+    pmm_arena_info_t info = {"test", 0, 0, 1ul << 32, page_count * PAGE_SIZE};
+    PmmArena arena(&info);
+    static vm_page_t page_array[page_count];
+    uint8_t block_type[1];
+    REQUIRE_EQ(1u, arena.block_type_count(), "page blocks in test arena");
+    arena.InitArrays(page_array, block_type);
+
+    // leave pages 1 through 4 free. they sit in blocks of 1, 2 and 1 pages
+    for (size_t i = 0; i < page_count; i++) {
+        if (i < 1 || i > 4) {
+            REQUIRE_NE(nullptr, arena.AllocSpecific(info.base + i * PAGE_SIZE),
+                       "fragmenting arena");
+        }
+    }
+    EXPECT_EQ(4u, arena.free_count(), "free pages left");
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    paddr_t pa;
+    EXPECT_EQ(4u, arena.AllocContiguous(4, PAGE_SIZE_SHIFT, PMM_ALLOC_FLAG_ANY, &pa, &list),
+              "run straddling buddy blocks");
+    EXPECT_EQ(info.base + PAGE_SIZE, pa, "run address");
+    EXPECT_EQ(0u, arena.free_count(), "free pages left");
+
+    // a run that also has to be aligned to its size can't be found
+    vm_page_t* p;
+    while ((p = list_remove_head_type(&list, vm_page_t, free.node))) {
+        EXPECT_EQ(ZX_OK, arena.FreePage(p), "freeing run");
+    }
+    EXPECT_EQ(0u, arena.AllocContiguous(4, PAGE_SIZE_SHIFT + 2, PMM_ALLOC_FLAG_ANY, &pa, nullptr),
+              "size aligned run");
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -305,6 +421,61 @@ static bool vmaspace_alloc_smoke_test(void* context) {
     END_TEST;
 }
 
+// Allocates many randomly placed regions in a user address space, frees some
+// of them to fragment it, and checks that further allocations (including
+// aligned ones) land in free space.
+static bool vmaspace_alloc_fragmented_test(void* context) {
+    BEGIN_TEST;
+    static const size_t kNumRegions = 256;
+
+    auto aspace = VmAspace::Create(VmAspace::TYPE_USER, "test aspace3");
+    REQUIRE_NONNULL(aspace, "VmAspace::Create pointer");
+
+    vaddr_t bases[kNumRegions];
+    size_t sizes[kNumRegions];
+    uint32_t seed = 0x1234;
+
+    auto overlaps_any = [&bases, &sizes](size_t count, vaddr_t base, size_t size) {
+        for (size_t j = 0; j < count; ++j) {
+            if (bases[j] != 0 && base < bases[j] + sizes[j] && bases[j] < base + size) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (size_t i = 0; i < kNumRegions; ++i) {
+        seed = test_rand(seed);
+        sizes[i] = ((seed % 16) + 1) * PAGE_SIZE;
+        void* ptr;
+        auto err = aspace->Alloc("test", sizes[i], &ptr, 0, 0, kArchRwFlags);
+        REQUIRE_EQ(ZX_OK, err, "allocating region\n");
+        bases[i] = reinterpret_cast<vaddr_t>(ptr);
+        EXPECT_FALSE(overlaps_any(i, bases[i], sizes[i]), "region overlaps another\n");
+    }
+
+    // Free every other region, then fill the holes back in with allocations
+    // of varying alignment.
+    for (size_t i = 0; i < kNumRegions; i += 2) {
+        EXPECT_EQ(ZX_OK, aspace->FreeRegion(bases[i]), "freeing region\n");
+        bases[i] = 0;
+    }
+    for (size_t i = 0; i < kNumRegions; i += 2) {
+        seed = test_rand(seed);
+        const uint8_t align_pow2 = static_cast<uint8_t>(PAGE_SIZE_SHIFT + (seed % 8));
+        void* ptr;
+        auto err = aspace->Alloc("test", sizes[i], &ptr, align_pow2, 0, kArchRwFlags);
+        REQUIRE_EQ(ZX_OK, err, "allocating aligned region\n");
+        const vaddr_t base = reinterpret_cast<vaddr_t>(ptr);
+        EXPECT_TRUE(IS_ALIGNED(base, 1UL << align_pow2), "region is misaligned\n");
+        EXPECT_FALSE(overlaps_any(kNumRegions, base, sizes[i]), "region overlaps another\n");
+        bases[i] = base;
+    }
+
+    aspace->Destroy();
+    END_TEST;
+}
+
 // Doesn't do anything, just prints all aspaces.
 // Should be run after all other tests so that people can manually comb
 // through the output for leaked test aspaces.
@@ -342,6 +513,203 @@ static bool vmo_commit_test(void* context) {
     END_TEST;
 }
 
+// Commits a user-style VMO, dirties some of its pages and checks that the
+// zero page scanner frees exactly the ones that are still zero.
+static bool vmo_zero_page_reclaim_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 16;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_MOVABLE, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    REQUIRE_TRUE(vmo, "vmobject creation\n");
+
+    uint64_t committed;
+    status = vmo->CommitRange(0, alloc_size, &committed);
+    REQUIRE_EQ(ZX_OK, status, "committing vm object\n");
+
+    // dirty every fourth page
+    const uint8_t byte = 0xa5;
+    for (size_t i = 0; i < alloc_size / PAGE_SIZE; i += 4) {
+        size_t written;
+        status = vmo->Write(&byte, i * PAGE_SIZE + 7, 1, &written);
+        REQUIRE_EQ(ZX_OK, status, "writing to vm object\n");
+    }
+
+    uint64_t offset = 0;
+    size_t reclaimed = 0;
+    size_t scanned_total = 0;
+    while (offset != UINT64_MAX) {
+        size_t scanned;
+        reclaimed += vmo->ReclaimZeroPages(&offset, 5, &scanned);
+        scanned_total += scanned;
+    }
+    EXPECT_EQ(alloc_size / PAGE_SIZE, scanned_total, "pages scanned\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE / 4 * 3, reclaimed, "pages reclaimed\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE / 4, vmo->AllocatedPages(), "pages left committed\n");
+
+    // the dirty pages kept their contents and the reclaimed ones read as zero
+    for (size_t i = 0; i < alloc_size / PAGE_SIZE; i++) {
+        uint8_t val;
+        size_t read;
+        status = vmo->Read(&val, i * PAGE_SIZE + 7, 1, &read);
+        REQUIRE_EQ(ZX_OK, status, "reading from vm object\n");
+        EXPECT_EQ((i % 4 == 0) ? byte : 0, val, "page contents\n");
+    }
+    END_TEST;
+}
+
+// Creates a discardable VMO and checks that it is only discarded while unlocked.
+static bool vmo_discardable_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 16;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_MOVABLE, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    REQUIRE_TRUE(vmo, "vmobject creation\n");
+
+    bool discarded;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->LockDiscardable(&discarded), "locking\n");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->UnlockDiscardable(), "unlocking\n");
+
+    // the object starts out locked
+    status = vmo->SetDiscardable();
+    REQUIRE_EQ(ZX_OK, status, "making vm object discardable\n");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, vmo->SetDiscardable(), "making it discardable twice\n");
+
+    uint64_t committed;
+    status = vmo->CommitRange(0, alloc_size, &committed);
+    REQUIRE_EQ(ZX_OK, status, "committing vm object\n");
+    EXPECT_EQ(0u, vmo->Discard(), "discarding while locked\n");
+
+    // locks nest
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&discarded), "locking\n");
+    EXPECT_FALSE(discarded, "contents discarded\n");
+    EXPECT_EQ(ZX_OK, vmo->UnlockDiscardable(), "unlocking\n");
+    EXPECT_EQ(0u, vmo->Discard(), "discarding while locked\n");
+
+    EXPECT_EQ(ZX_OK, vmo->UnlockDiscardable(), "unlocking\n");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, vmo->UnlockDiscardable(), "unlocking too often\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->Discard(), "discarding while unlocked\n");
+    EXPECT_EQ(0u, vmo->AllocatedPages(), "pages left committed\n");
+
+    // the next lock reports the discard, once
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&discarded), "locking\n");
+    EXPECT_TRUE(discarded, "contents discarded\n");
+    EXPECT_EQ(ZX_OK, vmo->UnlockDiscardable(), "unlocking\n");
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&discarded), "locking\n");
+    EXPECT_FALSE(discarded, "contents discarded\n");
+
+    // backing out of a lock hands what it reported on to the next one
+    EXPECT_EQ(ZX_OK, vmo->CancelLockDiscardable(true), "cancelling lock\n");
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&discarded), "locking\n");
+    EXPECT_TRUE(discarded, "contents discarded\n");
+    END_TEST;
+}
+
+namespace {
+
+// A page source that records the pages it is asked for.
+class TestPageSource : public PageSource {
+public:
+    TestPageSource() {
+        event_init(&requested_, false, 0);
+    }
+
+    // Waits for a request and returns its offset.
+    uint64_t WaitForRequest() {
+        event_wait(&requested_);
+        fbl::AutoLock a(&lock_);
+        event_unsignal(&requested_);
+        return last_offset_;
+    }
+
+    size_t requests() {
+        fbl::AutoLock a(&lock_);
+        return requests_;
+    }
+
+private:
+    ~TestPageSource() {
+        event_destroy(&requested_);
+    }
+    friend fbl::RefPtr<TestPageSource>;
+
+    zx_status_t SendRequestLocked(uint64_t offset) final TA_REQ(lock_) {
+        requests_++;
+        last_offset_ = offset;
+        event_signal(&requested_, false);
+        return ZX_OK;
+    }
+
+    event_t requested_;
+    size_t requests_ TA_GUARDED(lock_) = 0;
+    uint64_t last_offset_ TA_GUARDED(lock_) = 0;
+};
+
+} // namespace
+
+// Reads from a VMO with a page source, supplying the page it waits on from another VMO.
+static bool vmo_page_source_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    static const uint8_t byte = 0x5a;
+
+    fbl::AllocChecker ac;
+    auto source = fbl::AdoptRef(new (&ac) TestPageSource());
+    REQUIRE_TRUE(ac.check(), "allocating page source\n");
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::CreateExternal(source, PMM_ALLOC_FLAG_ANY, alloc_size,
+                                                       &vmo);
+    REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+    EXPECT_EQ(source.get(), vmo->page_source(), "page source\n");
+
+    fbl::RefPtr<VmObject> clone;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->CloneCOW(0, alloc_size, false, &clone), "cloning\n");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, vmo->SetDiscardable(), "making it discardable\n");
+
+    // a reader of the second page blocks until it is supplied
+    struct ReadArgs {
+        fbl::RefPtr<VmObject> vmo;
+        uint8_t val;
+    } args = {vmo, 0};
+    thread_t* reader = thread_create("page source reader", [](void* arg) -> int {
+        auto args = static_cast<ReadArgs*>(arg);
+        size_t read;
+        return args->vmo->Read(&args->val, PAGE_SIZE + 7, 1, &read);
+    }, &args, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+    REQUIRE_NONNULL(reader, "creating reader thread\n");
+    thread_resume(reader);
+
+    EXPECT_EQ(PAGE_SIZE, source->WaitForRequest(), "requested offset\n");
+
+    fbl::RefPtr<VmObject> aux;
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &aux);
+    REQUIRE_EQ(ZX_OK, status, "aux vmobject creation\n");
+
+    list_node pages;
+    list_initialize(&pages);
+    EXPECT_EQ(ZX_ERR_BAD_STATE, aux->TakePages(0, PAGE_SIZE, &pages), "taking missing pages\n");
+
+    size_t written;
+    status = aux->Write(&byte, 7, 1, &written);
+    REQUIRE_EQ(ZX_OK, status, "writing to aux vm object\n");
+    status = aux->TakePages(0, PAGE_SIZE, &pages);
+    REQUIRE_EQ(ZX_OK, status, "taking pages\n");
+    EXPECT_EQ(0u, aux->AllocatedPages(), "pages left in aux vm object\n");
+
+    status = vmo->SupplyPages(PAGE_SIZE, PAGE_SIZE, &pages);
+    REQUIRE_EQ(ZX_OK, status, "supplying pages\n");
+
+    int retcode;
+    thread_join(reader, &retcode, ZX_TIME_INFINITE);
+    EXPECT_EQ(ZX_OK, retcode, "reading from vm object\n");
+    EXPECT_EQ(byte, args.val, "page contents\n");
+    EXPECT_EQ(1u, source->requests(), "requests sent\n");
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "pages committed\n");
+    END_TEST;
+}
+
 // Creates a paged VMO, pins it, and tries operations that should unpin it.
 static bool vmo_pin_test(void* context) {
     BEGIN_TEST;
@@ -455,6 +823,61 @@ static bool vmo_multiple_pin_test(void* context) {
     END_TEST;
 }
 
+// Commits, pins and decommits discontiguous ranges of a VMO in one batch.
+static bool vmo_range_op_batch_test(void* context) {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 16;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    REQUIRE_TRUE(vmo, "vmobject creation\n");
+
+    const VmRangeOp ops[] = {
+        {VmRangeOpType::Commit, 0, 2 * PAGE_SIZE},
+        {VmRangeOpType::Commit, 4 * PAGE_SIZE, PAGE_SIZE},
+        {VmRangeOpType::Commit, 8 * PAGE_SIZE, 4 * PAGE_SIZE},
+        {VmRangeOpType::Pin, PAGE_SIZE, PAGE_SIZE},
+        {VmRangeOpType::Pin, 8 * PAGE_SIZE, 2 * PAGE_SIZE},
+        {VmRangeOpType::Decommit, 10 * PAGE_SIZE, 2 * PAGE_SIZE},
+    };
+    size_t completed;
+    status = vmo->RangeOpBatch(ops, fbl::count_of(ops), &completed);
+    EXPECT_EQ(ZX_OK, status, "batch\n");
+    EXPECT_EQ(fbl::count_of(ops), completed, "operations completed\n");
+    EXPECT_EQ(5u, vmo->AllocatedPages(), "pages committed\n");
+
+    uint64_t n;
+    status = vmo->DecommitRange(PAGE_SIZE, PAGE_SIZE, &n);
+    EXPECT_EQ(ZX_ERR_BAD_STATE, status, "decommitting pinned range\n");
+    status = vmo->DecommitRange(8 * PAGE_SIZE, 2 * PAGE_SIZE, &n);
+    EXPECT_EQ(ZX_ERR_BAD_STATE, status, "decommitting pinned range\n");
+
+    // the batch stops at the first failure and keeps what came before it
+    const VmRangeOp failing_ops[] = {
+        {VmRangeOpType::Commit, 12 * PAGE_SIZE, PAGE_SIZE},
+        {VmRangeOpType::Pin, 2 * PAGE_SIZE, PAGE_SIZE},
+        {VmRangeOpType::Commit, 13 * PAGE_SIZE, PAGE_SIZE},
+    };
+    status = vmo->RangeOpBatch(failing_ops, fbl::count_of(failing_ops), &completed);
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "pinning uncommitted range\n");
+    EXPECT_EQ(1u, completed, "operations completed\n");
+    EXPECT_EQ(6u, vmo->AllocatedPages(), "pages committed\n");
+
+    vmo->Unpin(PAGE_SIZE, PAGE_SIZE);
+    vmo->Unpin(8 * PAGE_SIZE, 2 * PAGE_SIZE);
+
+    const VmRangeOp decommit_ops[] = {
+        {VmRangeOpType::Decommit, 0, 8 * PAGE_SIZE},
+        {VmRangeOpType::Decommit, 8 * PAGE_SIZE, alloc_size - 8 * PAGE_SIZE},
+    };
+    status = vmo->RangeOpBatch(decommit_ops, fbl::count_of(decommit_ops), &completed);
+    EXPECT_EQ(ZX_OK, status, "decommitting unpinned ranges\n");
+    EXPECT_EQ(0u, vmo->AllocatedPages(), "pages committed\n");
+
+    END_TEST;
+}
+
 // Creates a vm object, commits odd sized memory.
 static bool vmo_odd_size_commit_test(void* context) {
     BEGIN_TEST;
@@ -489,6 +912,123 @@ static bool vmo_contiguous_commit_test(void* context) {
     END_TEST;
 }
 
+// Creates a vm object spanning two large page blocks and commits it.  When
+// large pages are in use, a block of an object created for them should be held
+// as one aligned run until a page in it is decommitted.  A plain object never
+// is.
+static bool vmo_large_page_commit_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = VM_LARGE_PAGE_SIZE * 2;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+
+    uint64_t committed;
+    auto ret = vmo->CommitRange(0, alloc_size, &committed);
+    EXPECT_EQ(ZX_OK, ret, "committing vm object\n");
+    EXPECT_EQ(alloc_size, committed, "committing vm object\n");
+
+    paddr_t pa;
+    {
+        fbl::AutoLock a(vmo->lock());
+        EXPECT_NE(ZX_OK, vmo->GetLargePageLocked(0, &pa), "large page without kLargePages\n");
+    }
+
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, VmObjectPaged::kLargePages, alloc_size,
+                                   &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+
+    ret = vmo->CommitRange(0, alloc_size, &committed);
+    EXPECT_EQ(ZX_OK, ret, "committing vm object\n");
+    EXPECT_EQ(alloc_size, committed, "committing vm object\n");
+
+    {
+        fbl::AutoLock a(vmo->lock());
+        status = vmo->GetLargePageLocked(0, &pa);
+    }
+    if (!vm_large_pages_enabled()) {
+        EXPECT_NE(ZX_OK, status, "large page with large pages disabled\n");
+        END_TEST;
+    }
+    REQUIRE_EQ(ZX_OK, status, "large page\n");
+    EXPECT_TRUE(IS_ALIGNED(pa, VM_LARGE_PAGE_SIZE), "large page alignment\n");
+
+    ret = vmo->DecommitRange(PAGE_SIZE, PAGE_SIZE, nullptr);
+    EXPECT_EQ(ZX_OK, ret, "decommitting page\n");
+
+    fbl::AutoLock a(vmo->lock());
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, vmo->GetLargePageLocked(0, &pa), "large page after decommit\n");
+    END_TEST;
+}
+
+// Maps a vm object created for large pages into a user aspace and write faults
+// one page of a committed block, which should map the whole block at once, as
+// one large page.  A write fault into a plain object must commit just the one
+// page.
+static bool vmo_large_page_map_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = VM_LARGE_PAGE_SIZE;
+    static const uint kArchUserRwFlags = kArchRwFlags | ARCH_MMU_FLAG_PERM_USER;
+    static const uint kWriteFault = VMM_PF_FLAG_WRITE | VMM_PF_FLAG_USER;
+
+    auto aspace = VmAspace::Create(VmAspace::TYPE_USER, "test aspace large");
+    REQUIRE_NONNULL(aspace, "VmAspace::Create pointer");
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+
+    fbl::RefPtr<VmMapping> mapping;
+    status = aspace->RootVmar()->CreateVmMapping(0, alloc_size, VM_LARGE_PAGE_SHIFT, 0, vmo, 0,
+                                                 kArchUserRwFlags, "test", &mapping);
+    REQUIRE_EQ(ZX_OK, status, "mapping object\n");
+    EXPECT_EQ(ZX_OK, aspace->PageFault(mapping->base() + PAGE_SIZE, kWriteFault),
+              "write fault\n");
+    EXPECT_EQ(1u, vmo->AllocatedPagesInRange(0, alloc_size),
+              "pages committed by a fault without kLargePages\n");
+    EXPECT_EQ(ZX_OK, mapping->Destroy(), "unmapping object\n");
+
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, VmObjectPaged::kLargePages, alloc_size,
+                                   &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    EXPECT_EQ(ZX_OK, vmo->CommitRange(0, alloc_size, nullptr), "committing vm object\n");
+
+    status = aspace->RootVmar()->CreateVmMapping(0, alloc_size, VM_LARGE_PAGE_SHIFT, 0, vmo, 0,
+                                                 kArchUserRwFlags, "test", &mapping);
+    REQUIRE_EQ(ZX_OK, status, "mapping object\n");
+    const vaddr_t base = mapping->base();
+    EXPECT_TRUE(IS_ALIGNED(base, VM_LARGE_PAGE_SIZE), "mapping alignment\n");
+    EXPECT_EQ(ZX_OK, aspace->PageFault(base + PAGE_SIZE, kWriteFault), "write fault\n");
+
+    if (vm_large_pages_enabled()) {
+        paddr_t large_pa;
+        {
+            fbl::AutoLock a(vmo->lock());
+            status = vmo->GetLargePageLocked(0, &large_pa);
+        }
+        REQUIRE_EQ(ZX_OK, status, "large page\n");
+
+        // a single fault can only have mapped every page of the block through one entry
+        for (size_t o = 0; o < alloc_size; o += PAGE_SIZE) {
+            paddr_t pa;
+            uint flags;
+            status = aspace->arch_aspace().Query(base + o, &pa, &flags);
+            if (status != ZX_OK || pa != large_pa + o) {
+                unittest_printf("offset %#zx not mapped as part of the large page\n", o);
+                EXPECT_EQ(ZX_OK, status, "query\n");
+                EXPECT_EQ(large_pa + o, pa, "large page mapping\n");
+                break;
+            }
+        }
+    } else {
+        unittest_printf("large pages disabled, mapping not checked\n");
+    }
+
+    EXPECT_EQ(ZX_OK, mapping->Destroy(), "unmapping object\n");
+    aspace->Destroy();
+    END_TEST;
+}
+
 // Creats a vm object, maps it, precommitted.
 static bool vmo_precommitted_map_test(void* context) {
     BEGIN_TEST;
@@ -887,6 +1427,96 @@ static bool vmo_lookup_test(void* context) {
     END_TEST;
 }
 
+// Measures how long it takes to change the permissions of and unmap a large,
+// fully populated region.  Kernel mappings are global, so every invalidation
+// has to reach every cpu.  Only reports numbers; it never fails on timing.
+static bool vmm_unmap_benchmark(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = 16 * 1024 * 1024;
+    static const size_t count = alloc_size / PAGE_SIZE;
+
+    auto ka = VmAspace::kernel_aspace();
+    void* ptr;
+    zx_status_t status = ka->Alloc("unmap benchmark", alloc_size, &ptr, 0,
+                                   VmAspace::VMM_FLAG_COMMIT, kArchRwFlags);
+    REQUIRE_EQ(ZX_OK, status, "allocating region\n");
+    const vaddr_t base = reinterpret_cast<vaddr_t>(ptr);
+
+    zx_time_t t = current_time();
+    status = ka->arch_aspace().Protect(base, count, ARCH_MMU_FLAG_PERM_READ);
+    const zx_time_t protect_time = current_time() - t;
+    EXPECT_EQ(ZX_OK, status, "protecting region\n");
+
+    t = current_time();
+    status = ka->arch_aspace().Unmap(base, count, nullptr);
+    const zx_time_t unmap_time = current_time() - t;
+    EXPECT_EQ(ZX_OK, status, "unmapping region\n");
+
+    unittest_printf("%zu pages: protect %" PRIi64 " ns (%" PRIi64 " ns/page), "
+                    "unmap %" PRIi64 " ns (%" PRIi64 " ns/page)\n",
+                    count, protect_time, protect_time / static_cast<zx_time_t>(count),
+                    unmap_time, unmap_time / static_cast<zx_time_t>(count));
+
+    status = ka->FreeRegion(base);
+    EXPECT_EQ(ZX_OK, status, "freeing region\n");
+    END_TEST;
+}
+
+// Times looking up every page of a committed VMO in order and in a random order.
+static bool vmo_page_lookup_benchmark(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = 16 * 1024 * 1024;
+    static const size_t count = alloc_size / PAGE_SIZE;
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+    status = vmo->CommitRange(0, alloc_size, nullptr);
+    REQUIRE_EQ(ZX_OK, status, "committing vmo\n");
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint64_t> offsets(new (&ac) uint64_t[count], count);
+    REQUIRE_TRUE(ac.check(), "allocating offsets\n");
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = i * PAGE_SIZE;
+    }
+
+    auto time_lookups = [&]() -> zx_time_t {
+        fbl::AutoLock a(vmo->lock());
+        zx_time_t t = current_time();
+        for (size_t i = 0; i < count; i++) {
+            vm_page_t* p;
+            status = vmo->GetPageLocked(offsets[i], VMM_PF_FLAG_SW_FAULT, nullptr, nullptr,
+                                        &p, nullptr);
+            if (status != ZX_OK)
+                break;
+        }
+        return current_time() - t;
+    };
+
+    const zx_time_t sequential_time = time_lookups();
+    EXPECT_EQ(ZX_OK, status, "looking up pages in order\n");
+
+    // shuffle the offsets
+    uint32_t val = 0;
+    for (size_t i = count - 1; i > 0; i--) {
+        val = test_rand(val);
+        size_t j = val % (i + 1);
+        uint64_t tmp = offsets[i];
+        offsets[i] = offsets[j];
+        offsets[j] = tmp;
+    }
+
+    const zx_time_t random_time = time_lookups();
+    EXPECT_EQ(ZX_OK, status, "looking up pages at random\n");
+
+    unittest_printf("%zu pages: sequential %" PRIi64 " ns (%" PRIi64 " ns/page), "
+                    "random %" PRIi64 " ns (%" PRIi64 " ns/page)\n",
+                    count, sequential_time, sequential_time / static_cast<zx_time_t>(count),
+                    random_time, random_time / static_cast<zx_time_t>(count));
+    END_TEST;
+}
+
 // TODO(ZX-1431): The ARM code's error codes are always ZX_ERR_INTERNAL, so
 // special case that.
 #if ARCH_ARM64
@@ -971,6 +1601,9 @@ UNITTEST_START_TESTCASE(vm_tests)
 VM_UNITTEST(pmm_smoke_test)
 VM_UNITTEST(pmm_large_alloc_test)
 VM_UNITTEST(pmm_oversized_alloc_test)
+VM_UNITTEST(pmm_page_cache_test)
+VM_UNITTEST(pmm_alloc_contiguous_test)
+VM_UNITTEST(pmm_arena_alloc_contiguous_fragmented_test)
 VM_UNITTEST(vmm_alloc_smoke_test)
 VM_UNITTEST(vmm_alloc_contiguous_smoke_test)
 VM_UNITTEST(multiple_regions_test)
@@ -980,12 +1613,19 @@ VM_UNITTEST(vmm_alloc_contiguous_missing_flag_commit_fails)
 VM_UNITTEST(vmm_alloc_contiguous_zero_size_fails)
 VM_UNITTEST(vmaspace_create_smoke_test)
 VM_UNITTEST(vmaspace_alloc_smoke_test)
+VM_UNITTEST(vmaspace_alloc_fragmented_test)
 VM_UNITTEST(vmo_create_test)
 VM_UNITTEST(vmo_pin_test)
 VM_UNITTEST(vmo_multiple_pin_test)
+VM_UNITTEST(vmo_range_op_batch_test)
 VM_UNITTEST(vmo_commit_test)
+VM_UNITTEST(vmo_zero_page_reclaim_test)
+VM_UNITTEST(vmo_discardable_test)
+VM_UNITTEST(vmo_page_source_test)
 VM_UNITTEST(vmo_odd_size_commit_test)
 VM_UNITTEST(vmo_contiguous_commit_test)
+VM_UNITTEST(vmo_large_page_commit_test)
+VM_UNITTEST(vmo_large_page_map_test)
 VM_UNITTEST(vmo_precommitted_map_test)
 VM_UNITTEST(vmo_demand_paged_map_test)
 VM_UNITTEST(vmo_dropped_ref_test)
@@ -995,6 +1635,8 @@ VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
 VM_UNITTEST(vmo_lookup_test)
 VM_UNITTEST(arch_noncontiguous_map)
+VM_UNITTEST(vmm_unmap_benchmark)
+VM_UNITTEST(vmo_page_lookup_benchmark)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
 UNITTEST_END_TESTCASE(vm_tests, "vmtests", "Virtual memory tests", nullptr, nullptr);
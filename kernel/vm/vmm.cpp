@@ -60,6 +60,14 @@ zx_status_t vmm_page_fault_handler(vaddr_t addr, uint flags) {
     // page fault it
     zx_status_t status = aspace->PageFault(addr, flags);
 
+    // A user mode fault waiting on a page source was interrupted to suspend or kill the
+    // thread. Go back to user mode without the page: the signal is processed on the way
+    // out, and if the thread is resumed the instruction faults again.
+    if ((status == ZX_ERR_INTERNAL_INTR_RETRY || status == ZX_ERR_INTERNAL_INTR_KILLED) &&
+        (flags & VMM_PF_FLAG_USER)) {
+        status = ZX_OK;
+    }
+
     // If it's a user fault, dump info about process memory usage.
     // If it's a kernel fault, the kernel could possibly already
     // hold locks on VMOs, Aspaces, etc, so we can't safely do
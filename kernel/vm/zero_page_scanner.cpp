@@ -0,0 +1,110 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+// Background scanner that gives back the memory of committed user pages that
+// have gone back to being all zeroes.  Such pages are freed from their VMO,
+// after which reads are served by the shared zero page and a write commits a
+// fresh page, just as if the page had never been touched.
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <err.h>
+#include <fbl/ref_ptr.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <trace.h>
+#include <vm/vm.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(zero_scan_scanned_count, "kernel.vm.zero_scan.scanned");
+KCOUNTER(zero_scan_reclaimed_bytes, "kernel.vm.zero_scan.reclaimed_bytes");
+
+namespace {
+
+// the scanner works in rounds of this length, scanning at most
+// |pages_per_round| pages each round
+constexpr zx_duration_t kRoundInterval = ZX_MSEC(100);
+
+size_t pages_per_round;
+
+int zero_page_scanner(void* arg) {
+    // position of the scan: the VMO at the global scan cursor, and the offset
+    // within it. |vmo_at| is only ever compared, to tell when the VMO we were
+    // part way through has been destroyed and the cursor moved on without us.
+    const VmObject* vmo_at = nullptr;
+    uint64_t vmo_offset = 0;
+
+    for (;;) {
+        thread_sleep_relative(kRoundInterval);
+
+        size_t budget = pages_per_round;
+        size_t reclaimed = 0;
+        while (budget > 0) {
+            fbl::RefPtr<VmObject> vmo;
+            if (!VmObject::GetScanCursor(&vmo)) {
+                // end of a pass, start over with the oldest VMO next round
+                vmo_at = nullptr;
+                vmo_offset = 0;
+                break;
+            }
+            if (vmo.get() != vmo_at) {
+                vmo_at = vmo.get();
+                vmo_offset = 0;
+            }
+
+            // visiting a VMO costs something even if it has no pages
+            budget--;
+
+            if (budget > 0) {
+                size_t scanned;
+                reclaimed += vmo->ReclaimZeroPages(&vmo_offset, budget, &scanned);
+                DEBUG_ASSERT(scanned <= budget);
+                budget -= scanned;
+                kcounter_add(zero_scan_scanned_count, scanned);
+            }
+            if (vmo_offset == UINT64_MAX) {
+                VmObject::AdvanceScanCursor(vmo_at);
+                vmo_at = nullptr;
+                vmo_offset = 0;
+            }
+        }
+
+        if (reclaimed > 0) {
+            LTRACEF("reclaimed %zu zero pages\n", reclaimed);
+            kcounter_add(zero_scan_reclaimed_bytes, reclaimed * PAGE_SIZE);
+        }
+    }
+    return 0;
+}
+
+void zero_page_scanner_init(uint level) {
+    if (!cmdline_get_bool("kernel.vm.zero-scan", false))
+        return;
+
+    uint32_t pages_per_second = cmdline_get_uint32("kernel.vm.zero-scan-rate", 4096);
+    pages_per_round = pages_per_second / (ZX_SEC(1) / kRoundInterval);
+    if (pages_per_round == 0)
+        return;
+
+    thread_t* t = thread_create("zero-page-scanner", zero_page_scanner, nullptr,
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("VM: failed to create zero page scanner thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+
+} // namespace
+
+LK_INIT_HOOK(zero_page_scanner, &zero_page_scanner_init, LK_INIT_LEVEL_THREADING);
@@ -77,3 +77,6 @@
 
 #define ZX_DEFAULT_IOMMU_RIGHTS \
     (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER)
+
+#define ZX_DEFAULT_PAGER_RIGHTS \
+    (ZX_RIGHTS_BASIC | ZX_RIGHT_WRITE)
@@ -31,6 +31,7 @@ typedef enum {
     ZX_INFO_KMEM_STATS                 = 17, // zx_info_kmem_stats_t[1]
     ZX_INFO_RESOURCE                   = 18, // zx_info_resource_t[1]
     ZX_INFO_HANDLE_COUNT               = 19, // zx_info_handle_count_t[1]
+    ZX_INFO_PROCESS_PORT_STATS         = 20, // zx_info_process_port_stats_t[1]
     ZX_INFO_LAST
 } zx_object_info_topic_t;
 
@@ -55,6 +56,7 @@ typedef enum {
     ZX_OBJ_TYPE_VCPU                = 21,
     ZX_OBJ_TYPE_TIMER               = 22,
     ZX_OBJ_TYPE_IOMMU               = 23,
+    ZX_OBJ_TYPE_PAGER               = 24,
     ZX_OBJ_TYPE_LAST
 } zx_obj_type_t;
 
@@ -354,6 +356,16 @@ typedef struct zx_info_resource {
     uint64_t high;
 } zx_info_resource_t;
 
+typedef struct zx_info_process_port_stats {
+    // The number of packets the process has queued with zx_port_queue()
+    // that have not yet been read or discarded.
+    uint64_t pending_packets;
+
+    // The most packets the process may have pending at once. Further calls
+    // to zx_port_queue() fail with ZX_ERR_NO_MEMORY.
+    uint64_t max_pending_packets;
+} zx_info_process_port_stats_t;
+
 #define ZX_INFO_CPU_STATS_FLAG_ONLINE       (1u<<0)
 
 // Object properties.
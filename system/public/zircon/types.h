@@ -170,6 +170,13 @@ typedef struct {
     uint32_t rd_num_handles;
 } zx_channel_call_args_t;
 
+// Structure for zx_thread_set_deadline():
+typedef struct zx_thread_deadline_params {
+    zx_duration_t period;   // length of each period, or 0 to leave the deadline class
+    zx_duration_t budget;   // cpu time guaranteed in each period
+    zx_duration_t deadline; // delivered within this long of the start of the period
+} zx_thread_deadline_params_t;
+
 // Maximum number of wait items allowed for zx_object_wait_many()
 // TODO(ZX-1349) Re-lower this.
 #define ZX_WAIT_MANY_MAX_ITEMS 16
@@ -215,6 +222,9 @@ typedef uint32_t zx_rights_t;
     (ZX_RIGHT_GET_POLICY | ZX_RIGHT_SET_POLICY)
 
 
+// VM Object creation options
+#define ZX_VMO_LARGE_PAGES               1u
+
 // VM Object opcodes
 #define ZX_VMO_OP_COMMIT                 1u
 #define ZX_VMO_OP_DECOMMIT               2u
@@ -225,6 +235,26 @@ typedef uint32_t zx_rights_t;
 #define ZX_VMO_OP_CACHE_INVALIDATE       7u
 #define ZX_VMO_OP_CACHE_CLEAN            8u
 #define ZX_VMO_OP_CACHE_CLEAN_INVALIDATE 9u
+#define ZX_VMO_OP_SET_DISCARDABLE        10u
+
+// Written by ZX_VMO_OP_LOCK on a discardable VMO.
+typedef struct zx_vmo_lock_state {
+    // Nonzero if the VMO's contents were discarded while it was unlocked.
+    uint32_t discarded;
+    uint32_t reserved;
+} zx_vmo_lock_state_t;
+
+// One operation of a zx_vmo_op_range_batch() call.
+typedef struct zx_vmo_range_op {
+    // ZX_VMO_OP_COMMIT or ZX_VMO_OP_DECOMMIT.
+    uint32_t op;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+} zx_vmo_range_op_t;
+
+// The most operations a single zx_vmo_op_range_batch() call accepts.
+#define ZX_VMO_OP_RANGE_BATCH_MAX        256u
 
 // VM Object clone flags
 #define ZX_VMO_CLONE_COPY_ON_WRITE       1u
@@ -241,6 +271,7 @@ typedef uint32_t zx_rights_t;
 #define ZX_VM_FLAG_CAN_MAP_WRITE      (1u << 8)
 #define ZX_VM_FLAG_CAN_MAP_EXECUTE    (1u << 9)
 #define ZX_VM_FLAG_MAP_RANGE          (1u << 10)
+#define ZX_VM_FLAG_NO_FAULT_AROUND    (1u << 11)
 
 // clock ids
 #define ZX_CLOCK_MONOTONIC        (0u)
@@ -341,4 +372,8 @@ typedef atomic_int zx_futex_t;
 #endif
 #endif
 
+// A priority inheritance futex holds the handle of its owning thread, or 0 when
+// unlocked.  ZX_FUTEX_PI_WAITERS is ORed in while other threads are waiting on it.
+#define ZX_FUTEX_PI_WAITERS INT32_MIN
+
 __END_CDECLS
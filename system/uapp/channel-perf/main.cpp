@@ -10,7 +10,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <launchpad/launchpad.h>
 #include <zircon/compiler.h>
+#include <zircon/process.h>
+#include <zircon/processargs.h>
 #include <zircon/syscalls.h>
 #include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
@@ -112,6 +115,122 @@ void do_test(uint32_t duration, const TestArgs& test_args) {
            test_args.size, test_args.handles, test_args.queue, its_per_second);
 }
 
+// Echoes every message received on |channel| back to the sender until the
+// other end goes away.  This is the body of the child process used by -p.
+int run_echo(zx_handle_t channel) {
+    static uint8_t data[ZX_CHANNEL_MAX_MSG_BYTES];
+    static zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+
+    for (;;) {
+        zx_signals_t pending;
+        zx_status_t status = zx_object_wait_one(channel,
+                                                ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                                ZX_TIME_INFINITE, &pending);
+        if (status != ZX_OK)
+            return EXIT_FAILURE;
+        if (!(pending & ZX_CHANNEL_READABLE))
+            return EXIT_SUCCESS;
+
+        uint32_t r_size, r_handles;
+        status = zx_channel_read(channel, 0u, data, handles, sizeof(data),
+                                 fbl::count_of(handles), &r_size, &r_handles);
+        if (status != ZX_OK)
+            return EXIT_FAILURE;
+        status = zx_channel_write(channel, 0u, data, r_size, handles, r_handles);
+        if (status != ZX_OK)
+            return EXIT_FAILURE;
+    }
+}
+
+// Measures message round trips to a copy of this program running in another
+// process, so that every iteration includes two address space switches.
+void do_process_test(const char* argv0, uint32_t duration, const TestArgs& test_args) {
+    __UNUSED zx_status_t status;
+
+    uint64_t duration_ns = duration * 1000000000ull;
+
+    zx_handle_t mp[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    status = zx_channel_create(0u, &mp[0], &mp[1]);
+    assert(status == ZX_OK);
+
+    launchpad_t* lp;
+    launchpad_create(ZX_HANDLE_INVALID, "channel-perf-echo", &lp);
+    launchpad_load_from_file(lp, argv0);
+    launchpad_set_args(lp, 1, &argv0);
+    launchpad_clone(lp, LP_CLONE_FDIO_STDIO);
+    launchpad_add_handle(lp, mp[1], PA_HND(PA_USER0, 0));
+    zx_handle_t proc;
+    const char* errmsg;
+    if (launchpad_go(lp, &proc, &errmsg) != ZX_OK) {
+        fprintf(stderr, "%s: error: failed to launch echo process: %s\n", argv0, errmsg);
+        exit(EXIT_FAILURE);
+    }
+
+    zx_handle_t event;
+    assert(zx_event_create(0u, &event) == ZX_OK);
+
+    fbl::unique_ptr<uint8_t[]> data;
+    if (test_args.size) {
+        data.reset(new uint8_t[test_args.size]);
+        for (uint32_t i = 0; i < test_args.size; i++)
+            data[i] = static_cast<uint8_t>(i);
+    }
+    fbl::unique_ptr<zx_handle_t[]> handles;
+    if (test_args.handles)
+        handles.reset(new zx_handle_t[test_args.handles]);
+
+    duplicate_handles(test_args.handles, event, handles.get());
+
+    static constexpr uint32_t big_it_size = 1000;
+    uint64_t big_its = 0;
+    uint64_t start_ns = zx_time_get(ZX_CLOCK_MONOTONIC);
+    uint64_t end_ns;
+    for (;;) {
+        big_its++;
+        for (uint32_t i = 0; i < big_it_size; i++) {
+            status = zx_channel_write(mp[0], 0, data.get(), test_args.size,
+                                      handles.get(), test_args.handles);
+            assert(status == ZX_OK);
+
+            status = zx_object_wait_one(mp[0], ZX_CHANNEL_READABLE, ZX_TIME_INFINITE, nullptr);
+            assert(status == ZX_OK);
+
+            uint32_t r_size = test_args.size;
+            uint32_t r_handles = test_args.handles;
+            status = zx_channel_read(mp[0], 0u, data.get(), handles.get(), r_size,
+                                     r_handles, &r_size, &r_handles);
+            assert(status == ZX_OK);
+            assert(r_size == test_args.size);
+            assert(r_handles == test_args.handles);
+        }
+
+        end_ns = zx_time_get(ZX_CLOCK_MONOTONIC);
+        if ((end_ns - start_ns) >= duration_ns)
+            break;
+    }
+
+    for (uint32_t i = 0; i < test_args.handles; i++) {
+        status = zx_handle_close(handles[i]);
+        assert(status == ZX_OK);
+    }
+    status = zx_handle_close(event);
+    assert(status == ZX_OK);
+
+    // Closing our end makes the echo process exit.
+    status = zx_handle_close(mp[0]);
+    assert(status == ZX_OK);
+    status = zx_object_wait_one(proc, ZX_PROCESS_TERMINATED, ZX_TIME_INFINITE, nullptr);
+    assert(status == ZX_OK);
+    status = zx_handle_close(proc);
+    assert(status == ZX_OK);
+
+    double real_duration = static_cast<double>(end_ns - start_ns) / 1000000000.0;
+    double its_per_second = static_cast<double>(big_its) * big_it_size / real_duration;
+    printf("cross-process round trip %" PRIu32 " bytes, %" PRIu32 " handles: "
+               "%.0f round trips/second\n",
+           test_args.size, test_args.handles, its_per_second);
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -122,13 +241,20 @@ int main(int argc, char** argv) {
         "  -h    show help (this)\n"
         "  -o    run single test (default)\n"
         "  -s    run suite (ignores -S/-H/-Q)\n"
+        "  -p    measure round trips to another process (ignores -Q)\n"
         "  -n N  set test repetition count to N (default: 1)\n"
         "  -d N  set test duration to N seconds (default: 5)\n"
         "  -S N  set message size to N bytes (default: 10)\n"
         "  -H N  set message handle count to N handles (default: 0)\n"
         "  -Q N  set message pre-queue count to N messages (default: 0)\n";
 
+    // When started by -p, we are the echo process.
+    zx_handle_t echo_channel = zx_get_startup_handle(PA_HND(PA_USER0, 0));
+    if (echo_channel != ZX_HANDLE_INVALID)
+        return run_echo(echo_channel);
+
     bool run_suite = false;  // -o/-s
+    bool cross_process = false;  // -p
     uint32_t duration = 5;   // -d
     uint32_t repeats = 1;    // -n
     // Ignored when running a suite:
@@ -139,7 +265,7 @@ int main(int argc, char** argv) {
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
+    while ((opt = getopt(argc, argv, "+hospn:d:S:H:Q:")) != -1) {
         // Our option values are always unsigned numbers.
         uint32_t value = 0;
         if (optarg) {
@@ -161,6 +287,9 @@ int main(int argc, char** argv) {
             case 's':
                 run_suite = true;
                 break;
+            case 'p':
+                cross_process = true;
+                break;
             case 'n':
                 assert(optarg);
                 repeats = value;
@@ -214,9 +343,21 @@ int main(int argc, char** argv) {
                 {10, 0, 1},
                 {100, 0, 1},
                 {1000, 0, 1},
+                // The largest message the kernel keeps in a size-classed
+                // slab, and one big enough to come from the heap.
+                {4000, 0, 0},
+                {16000, 0, 0},
             };
-            for (size_t i = 0; i < fbl::count_of(suite); i++)
-                do_test(duration, suite[i]);
+            for (size_t i = 0; i < fbl::count_of(suite); i++) {
+                if (cross_process) {
+                    if (suite[i].queue == 0u)
+                        do_process_test(argv[0], duration, suite[i]);
+                } else {
+                    do_test(duration, suite[i]);
+                }
+            }
+        } else if (cross_process) {
+            do_process_test(argv[0], duration, test_args);
         } else {
             do_test(duration, test_args);
         }
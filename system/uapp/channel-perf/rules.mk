@@ -12,7 +12,7 @@ MODULE_GROUP := misc
 MODULE_SRCS += \
     $(LOCAL_DIR)/main.cpp \
 
-MODULE_LIBS := system/ulib/zircon system/ulib/fdio system/ulib/c
+MODULE_LIBS := system/ulib/zircon system/ulib/fdio system/ulib/launchpad system/ulib/c
 MODULE_STATIC_LIBS := system/ulib/zxcpp system/ulib/fbl
 
 include make/module.mk
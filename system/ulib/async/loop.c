@@ -7,10 +7,12 @@
 #include <assert.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zircon/assert.h>
 #include <zircon/listnode.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
 
 #include <async/receiver.h>
 #include <async/task.h>
@@ -19,6 +21,10 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The most packets the loop takes from its port at once.  Packets beyond the
+// one being dispatched are parked in the loop until a thread gets to them.
+#define PACKET_BATCH (ZX_PORT_WAIT_BATCH_MAX)
+
 static zx_status_t async_loop_begin_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_post_task(async_t* async, async_task_t* task);
@@ -53,9 +59,14 @@ typedef struct async_loop {
     list_node_t task_list; // pending tasks, earliest deadline first
     list_node_t due_list; // due tasks, earliest deadline first
     list_node_t thread_list; // earliest created thread first
+    zx_port_packet_t ready[PACKET_BATCH]; // dequeued packets not yet dispatched, oldest first
+    size_t ready_count; // number of packets in |ready|
+    size_t ready_reserved; // slots in |ready| promised to threads waiting on the port
 } async_loop_t;
 
 static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_next_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
@@ -220,7 +231,7 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
         return ZX_ERR_CANCELED;
 
     zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet, 0);
+    zx_status_t status = async_loop_next_packet(loop, deadline, &packet);
     if (status != ZX_OK)
         return status;
 
@@ -252,6 +263,77 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
     return ZX_ERR_INTERNAL;
 }
 
+static zx_status_t async_loop_next_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet) {
+    // Take a packet parked by an earlier batch if there is one.
+    mtx_lock(&loop->lock);
+    if (loop->ready_count) {
+        *out_packet = loop->ready[0];
+        loop->ready_count--;
+        memmove(&loop->ready[0], &loop->ready[1], loop->ready_count * sizeof(zx_port_packet_t));
+        mtx_unlock(&loop->lock);
+        return ZX_OK;
+    }
+
+    // Otherwise wait for one on the port, along with as many more as we have
+    // room to park.  Packets parked here can't be picked up by other threads
+    // blocked on the port, so only batch when we are the only thread, and wake
+    // any that joined in the meantime once the packets are parked.
+    size_t room = 0u;
+    if (atomic_load_explicit(&loop->active_threads, memory_order_acquire) == 1u) {
+        room = PACKET_BATCH - loop->ready_reserved;
+        loop->ready_reserved += room;
+    }
+    mtx_unlock(&loop->lock);
+
+    zx_port_packet_t packets[PACKET_BATCH + 1];
+    size_t actual = 0u;
+    zx_status_t status = zx_port_wait_batch(loop->port, deadline, packets, room + 1u, &actual);
+
+    mtx_lock(&loop->lock);
+    loop->ready_reserved -= room;
+    uint32_t wake_count = 0u;
+    if (status == ZX_OK) {
+        ZX_DEBUG_ASSERT(actual >= 1u && actual <= room + 1u);
+        *out_packet = packets[0];
+        memcpy(&loop->ready[loop->ready_count], &packets[1],
+               (actual - 1u) * sizeof(zx_port_packet_t));
+        loop->ready_count += actual - 1u;
+
+        // Threads that joined while we were blocked are waiting on the port
+        // and won't look at what we just parked, so wake as many of them as
+        // there are packets for.  A thread that joins from here on checks
+        // |ready| first.
+        uint32_t others = atomic_load_explicit(&loop->active_threads,
+                                               memory_order_acquire) - 1u;
+        if (actual > 1u && others > 0u)
+            wake_count = (actual - 1u) < others ? (uint32_t)(actual - 1u) : others;
+    }
+    mtx_unlock(&loop->lock);
+
+    for (uint32_t i = 0u; i < wake_count; i++) {
+        zx_port_packet_t packet = {
+            .key = KEY_CONTROL,
+            .type = ZX_PKT_TYPE_USER,
+            .status = ZX_OK};
+        zx_status_t wake_status = zx_port_queue(loop->port, &packet, 0u);
+        ZX_DEBUG_ASSERT_MSG(wake_status == ZX_OK, "status=%d", wake_status);
+    }
+    return status;
+}
+
+// Drops any parked packets for |key|.  Returns true if there were any.
+static bool async_loop_cancel_ready_locked(async_loop_t* loop, uint64_t key) {
+    size_t kept = 0u;
+    for (size_t i = 0u; i < loop->ready_count; i++) {
+        if (loop->ready[i].key != key)
+            loop->ready[kept++] = loop->ready[i];
+    }
+    bool canceled = kept != loop->ready_count;
+    loop->ready_count = kept;
+    return canceled;
+}
+
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal) {
     async_loop_invoke_prologue(loop);
@@ -458,11 +540,15 @@ static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait) {
     // invoked again past this point.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
-    if (status == ZX_OK && (wait->flags & ASYNC_FLAG_HANDLE_SHUTDOWN)) {
-        mtx_lock(&loop->lock);
+
+    // The wait's packet may already have been taken from the port as part
+    // of a batch, in which case it has to be dropped from the loop instead.
+    mtx_lock(&loop->lock);
+    if (async_loop_cancel_ready_locked(loop, (uintptr_t)wait))
+        status = ZX_OK;
+    if (status == ZX_OK && (wait->flags & ASYNC_FLAG_HANDLE_SHUTDOWN))
         list_delete(wait_to_node(wait));
-        mtx_unlock(&loop->lock);
-    }
+    mtx_unlock(&loop->lock);
     return status;
 }
 
@@ -105,7 +105,7 @@ template <typename _KeyType,
                                     _KeyType,
                                     typename internal::ContainerPtrTraits<_PtrType>::ValueType>,
           typename _NodeTraits = DefaultWAVLTreeTraits<_PtrType>,
-          typename _Observer   = tests::intrusive_containers::DefaultWAVLTreeObserver>
+          typename _Observer   = DefaultWAVLTreeObserver>
 class WAVLTree {
 private:
     // Private fwd decls of the iterator implementation.
@@ -183,6 +183,24 @@ public:
     // make_iterator : construct an iterator out of a pointer to an object
     iterator make_iterator(ValueType& obj) { return iterator(&obj); }
 
+    // root : an iterator to the element at the root of the tree, or end() if
+    // the tree is empty.  Together with iterator::left() and iterator::right(),
+    // this allows users to descend the tree themselves; for example, guided by
+    // subtree state maintained by the tree's Observer.
+    iterator       root()       { return iterator(root_ ? PtrTraits::GetRaw(root_) : sentinel()); }
+    const_iterator root() const { return const_iterator(root_ ? PtrTraits::GetRaw(root_) : sentinel()); }
+
+    // update_subtree_state
+    //
+    // Let the Observer recompute the subtree state of an element in the tree
+    // and of all of its ancestors.  Users must call this after changing any of
+    // an element's properties (other than its key) which its subtree state is
+    // derived from.
+    void update_subtree_state(ValueType& obj) {
+        ZX_DEBUG_ASSERT(NodeTraits::node_state(obj).InContainer());
+        UpdateSubtreeStateToRoot(&obj);
+    }
+
     // is_empty : True if the tree has at least one element in it, false otherwise.
     bool is_empty() const { return root_ == nullptr; }
 
@@ -603,6 +621,18 @@ private:
             return IsValid() ? PtrTraits::Copy(node_) : nullptr;
         }
 
+        // The left and right children of the element in the tree.  The
+        // iterator returned is not valid if there is no such child.  Only
+        // meaningful for valid iterators.
+        iterator_impl left() const {
+            ZX_DEBUG_ASSERT(IsValid());
+            return iterator_impl(ForwardTraits::LRRawChild(NodeTraits::node_state(*node_)));
+        }
+        iterator_impl right() const {
+            ZX_DEBUG_ASSERT(IsValid());
+            return iterator_impl(ForwardTraits::RLRawChild(NodeTraits::node_state(*node_)));
+        }
+
         typename IterTraits::RefType operator*()     const { ZX_DEBUG_ASSERT(node_); return *node_; }
         typename IterTraits::RawPtrType operator->() const { ZX_DEBUG_ASSERT(node_); return node_; }
 
@@ -694,6 +724,7 @@ private:
 
             ++count_;
             Observer::RecordInsert();
+            UpdateSubtreeState(PtrTraits::GetRaw(root_));
             return;
         }
 
@@ -770,6 +801,11 @@ private:
         ++count_;
         Observer::RecordInsert();
 
+        // The new node, and every node above it, has a new member in its
+        // subtree.  This has to be accounted for before rebalancing, which only
+        // updates the pairs of nodes it rotates.
+        UpdateSubtreeStateToRoot(PtrTraits::GetRaw(*owner));
+
         // Finally, perform post-insert balance operations.
         BalancePostInsert(PtrTraits::GetRaw(*owner));
     }
@@ -910,6 +946,11 @@ private:
         --count_;
         Observer::RecordErase();
 
+        // Every node above the one we removed has lost a member from its
+        // subtree.  As with insert, account for this before rebalancing.
+        if (!PtrTraits::IsSentinel(parent))
+            UpdateSubtreeStateToRoot(parent);
+
         // Time to rebalance.  We know that we don't need to rebalance if we
         // just removed the root (IOW - its parent was the sentinel value).
         if (!PtrTraits::IsSentinel(parent)) {
@@ -990,6 +1031,9 @@ private:
         // caller.
         PtrTraits::Swap(GetLinkPtrToNode(old_node), new_node);
         pod_swap(old_ns.parent_, new_ns.parent_);
+
+        // The replacement may summarize differently than the node it replaced.
+        UpdateSubtreeStateToRoot(new_raw);
         return fbl::move(new_node);
     }
 
@@ -1348,6 +1392,26 @@ private:
         Z_ns.parent_ = X;
         if (Y)
             NodeTraits::node_state(*Y).parent_ = Z;
+
+        // Z is now beneath X, and has traded X for Y as a child.  X's subtree
+        // now holds exactly what Z's did, so nothing above X changes.
+        UpdateSubtreeState(Z);
+        UpdateSubtreeState(X);
+    }
+
+    // Subtree state bookkeeping.  See DefaultWAVLTreeObserver.
+    void UpdateSubtreeState(RawPtrType node) {
+        auto& ns = NodeTraits::node_state(*node);
+        RawPtrType left  = PtrTraits::IsValid(ns.left_)  ? PtrTraits::GetRaw(ns.left_)  : nullptr;
+        RawPtrType right = PtrTraits::IsValid(ns.right_) ? PtrTraits::GetRaw(ns.right_) : nullptr;
+        Observer::UpdateSubtreeState(node, left, right);
+    }
+
+    void UpdateSubtreeStateToRoot(RawPtrType node) {
+        while (PtrTraits::IsValid(node)) {
+            UpdateSubtreeState(node);
+            node = NodeTraits::node_state(*node).parent_;
+        }
     }
 
     // PostInsertFixupLR<LRTraits>
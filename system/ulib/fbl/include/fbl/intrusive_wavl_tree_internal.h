@@ -12,13 +12,16 @@ namespace tests {
 namespace intrusive_containers {
 // Fwd decl of sanity checker class used by tests.
 class WAVLTreeChecker;
+}  // namespace tests
+}  // namespace intrusive_containers
 
 // Definition of the default (no-op) Observer.
 //
-// Observers are used by the test framework to record the number of insert,
-// erase, rank-promote, rank-demote and rotation operations performed during
-// usage.  The DefaultWAVLTreeObserver does nothing and should fall out of the
-// code during template expansion.
+// Observers are notified of the insert, erase, rank-promote, rank-demote and
+// rotation operations performed during usage; the test framework uses this to
+// record how many of each took place.  The DefaultWAVLTreeObserver does
+// nothing and should fall out of the code during template expansion.  Users
+// which only need some of the hooks may derive from it and hide the others.
 //
 // Note: Records of promotions and demotions are used by tests to demonstrate
 // that the computational complexity of insert/erase rebalancing is amortized
@@ -26,6 +29,12 @@ class WAVLTreeChecker;
 // phase of rebalancing are considered to be part of the cost of rotation and
 // are not tallied in the overall promote/demote accounting.
 //
+// Observers may also maintain per-node state which summarizes a node's whole
+// subtree (an augmented tree).  UpdateSubtreeState is called for a node
+// whenever the set of nodes beneath it may have changed, after it has been
+// called for any of its children which changed as well.  |left| and |right|
+// are the node's children, or nullptr if it has none.
+//
 struct DefaultWAVLTreeObserver {
     static void RecordInsert()               { }
     static void RecordInsertPromote()        { }
@@ -37,6 +46,9 @@ struct DefaultWAVLTreeObserver {
     static void RecordEraseRotation()        { }
     static void RecordEraseDoubleRotation()  { }
 
+    template <typename RawPtrType>
+    static void UpdateSubtreeState(RawPtrType node, RawPtrType left, RawPtrType right) { }
+
     template <typename TreeType>
     static bool VerifyRankRule(const TreeType& tree, typename TreeType::RawPtrType node) {
         return true;
@@ -48,9 +60,6 @@ struct DefaultWAVLTreeObserver {
     }
 };
 
-}  // namespace tests
-}  // namespace intrusive_containers
-
 // Prototypes for the WAVL tree node state.  By default, we just use a bool to
 // record the rank parity of a node.  During testing, however, we actually use a
 // specialized version of the node state in which the rank is stored as an
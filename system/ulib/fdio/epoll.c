@@ -0,0 +1,350 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <threads.h>
+
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+#include <fdio/limits.h>
+#include <fdio/util.h>
+
+#include "private.h"
+#include "unistd.h"
+
+// An epoll instance is a port with one async wait registered per fd in the
+// interest list. Registering an fd costs one zx_object_wait_async() and
+// epoll_wait() costs one zx_port_wait_batch() plus one re-arm per reported
+// fd, however many fds are registered.
+//
+// Level-triggered registrations use ZX_WAIT_ASYNC_ONCE and are re-armed once
+// reported. If the fd is still ready the kernel queues a new packet straight
+// away, so the fd is reported again by the next epoll_wait(). EPOLLET
+// registrations use ZX_WAIT_ASYNC_REPEATING, which only queues a packet on a
+// state change. EPOLLONESHOT registrations stay disarmed after they are
+// reported until the next EPOLL_CTL_MOD.
+
+#define EPOLL_EVENTS_MASK (EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLRDHUP | EPOLLERR | EPOLLHUP)
+#define EPOLL_FLAGS_MASK (EPOLLET | EPOLLONESHOT)
+
+typedef struct epoll_reg {
+    // The registered fd's io object, or NULL if the slot is unused.
+    fdio_t* io;
+    zx_handle_t handle;
+    zx_signals_t signals;
+    uint32_t events;
+    epoll_data_t data;
+    // Bumped each time the slot's wait is cancelled, so packets that were
+    // dequeued before the cancel can be told apart and dropped.
+    uint32_t gen;
+    bool armed;
+} epoll_reg_t;
+
+typedef struct fdio_epoll {
+    fdio_t io;
+    zx_handle_t port;
+    mtx_t lock;
+    epoll_reg_t regs[FDIO_MAX_FD];
+} fdio_epoll_t;
+
+static uint64_t epoll_key(int fd, uint32_t gen) {
+    return ((uint64_t)gen << 32) | (uint32_t)fd;
+}
+
+static zx_status_t epoll_arm_locked(fdio_epoll_t* ep, int fd, epoll_reg_t* reg) {
+    reg->io->ops->wait_begin(reg->io, reg->events & EPOLL_EVENTS_MASK, &reg->handle,
+                             &reg->signals);
+    if (reg->handle == ZX_HANDLE_INVALID) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    uint32_t options = (reg->events & EPOLLET) ? ZX_WAIT_ASYNC_REPEATING : ZX_WAIT_ASYNC_ONCE;
+    zx_status_t r = zx_object_wait_async(reg->handle, ep->port, epoll_key(fd, reg->gen),
+                                         reg->signals, options);
+    reg->armed = (r == ZX_OK);
+    return r;
+}
+
+static void epoll_disarm_locked(fdio_epoll_t* ep, int fd, epoll_reg_t* reg) {
+    if (reg->armed) {
+        // Also removes a packet that is still queued for this registration.
+        zx_port_cancel(ep->port, reg->handle, epoll_key(fd, reg->gen));
+        reg->armed = false;
+    }
+    reg->gen++;
+}
+
+static void epoll_remove_locked(fdio_epoll_t* ep, int fd, epoll_reg_t* reg) {
+    epoll_disarm_locked(ep, fd, reg);
+    fdio_release(reg->io);
+    reg->io = NULL;
+}
+
+static zx_status_t fdio_epoll_close(fdio_t* io) {
+    fdio_epoll_t* ep = (fdio_epoll_t*)io;
+    mtx_lock(&ep->lock);
+    for (int fd = 0; fd < FDIO_MAX_FD; fd++) {
+        if (ep->regs[fd].io != NULL) {
+            fdio_release(ep->regs[fd].io);
+            ep->regs[fd].io = NULL;
+        }
+    }
+    mtx_unlock(&ep->lock);
+    // Closing the port cancels every outstanding wait.
+    zx_handle_t port = ep->port;
+    ep->port = ZX_HANDLE_INVALID;
+    return zx_handle_close(port);
+}
+
+static fdio_ops_t fdio_epoll_ops = {
+    .read = fdio_default_read,
+    .read_at = fdio_default_read_at,
+    .write = fdio_default_write,
+    .write_at = fdio_default_write_at,
+    .recvfrom = fdio_default_recvfrom,
+    .sendto = fdio_default_sendto,
+    .recvmsg = fdio_default_recvmsg,
+    .sendmsg = fdio_default_sendmsg,
+    .seek = fdio_default_seek,
+    .misc = fdio_default_misc,
+    .close = fdio_epoll_close,
+    .open = fdio_default_open,
+    .clone = fdio_default_clone,
+    .ioctl = fdio_default_ioctl,
+    .unwrap = fdio_default_unwrap,
+    .shutdown = fdio_default_shutdown,
+    .wait_begin = fdio_default_wait_begin,
+    .wait_end = fdio_default_wait_end,
+    .posix_ioctl = fdio_default_posix_ioctl,
+    .get_vmo = fdio_default_get_vmo,
+};
+
+// Looks up the epoll instance behind |epfd| and takes a reference to it.
+// Returns 0 or an errno value.
+static int fd_to_epoll(int epfd, fdio_epoll_t** out) {
+    fdio_t* io = fd_to_io(epfd);
+    if (io == NULL) {
+        return EBADF;
+    }
+    if (!(io->flags & FDIO_FLAG_EPOLL)) {
+        fdio_release(io);
+        return EINVAL;
+    }
+    *out = (fdio_epoll_t*)io;
+    return 0;
+}
+
+int epoll_create1(int flags) {
+    if (flags & ~EPOLL_CLOEXEC) {
+        return ERRNO(EINVAL);
+    }
+    fdio_epoll_t* ep = calloc(1, sizeof(*ep));
+    if (ep == NULL) {
+        return ERRNO(ENOMEM);
+    }
+    zx_status_t r = zx_port_create(0, &ep->port);
+    if (r != ZX_OK) {
+        free(ep);
+        return ERROR(r);
+    }
+    mtx_init(&ep->lock, mtx_plain);
+    ep->io.ops = &fdio_epoll_ops;
+    ep->io.magic = FDIO_MAGIC;
+    ep->io.refcount = 1;
+    ep->io.flags = FDIO_FLAG_EPOLL;
+    if (flags & EPOLL_CLOEXEC) {
+        ep->io.flags |= FDIO_FLAG_CLOEXEC;
+    }
+
+    int fd = fdio_bind_to_fd(&ep->io, -1, 0);
+    if (fd < 0) {
+        fdio_close(&ep->io);
+        fdio_release(&ep->io);
+    }
+    return fd;
+}
+
+int epoll_create(int size) {
+    if (size <= 0) {
+        return ERRNO(EINVAL);
+    }
+    return epoll_create1(0);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+    if ((op != EPOLL_CTL_DEL) && (event == NULL)) {
+        return ERRNO(EFAULT);
+    }
+    fdio_epoll_t* ep;
+    int e = fd_to_epoll(epfd, &ep);
+    if (e != 0) {
+        return ERRNO(e);
+    }
+    if (fd == epfd) {
+        fdio_release(&ep->io);
+        return ERRNO(EINVAL);
+    }
+    fdio_t* io = (fd >= 0 && fd < FDIO_MAX_FD) ? fd_to_io(fd) : NULL;
+    if (io == NULL) {
+        fdio_release(&ep->io);
+        return ERRNO(EBADF);
+    }
+
+    int result = 0;
+    mtx_lock(&ep->lock);
+    epoll_reg_t* reg = &ep->regs[fd];
+    if ((reg->io != NULL) && (reg->io != io)) {
+        // |fd| was closed and reused since it was registered.
+        epoll_remove_locked(ep, fd, reg);
+    }
+
+    switch (op) {
+    case EPOLL_CTL_ADD: {
+        if (reg->io != NULL) {
+            result = ERRNO(EEXIST);
+            break;
+        }
+        reg->io = io;
+        io = NULL;
+        reg->events = event->events & (EPOLL_EVENTS_MASK | EPOLL_FLAGS_MASK);
+        reg->data = event->data;
+        zx_status_t r = epoll_arm_locked(ep, fd, reg);
+        if (r != ZX_OK) {
+            // The fd cannot be waited on.
+            epoll_remove_locked(ep, fd, reg);
+            result = (r == ZX_ERR_NOT_SUPPORTED) ? ERRNO(EPERM) : ERROR(r);
+        }
+        break;
+    }
+    case EPOLL_CTL_MOD:
+        if (reg->io == NULL) {
+            result = ERRNO(ENOENT);
+            break;
+        }
+        epoll_disarm_locked(ep, fd, reg);
+        reg->events = event->events & (EPOLL_EVENTS_MASK | EPOLL_FLAGS_MASK);
+        reg->data = event->data;
+        result = STATUS(epoll_arm_locked(ep, fd, reg));
+        break;
+    case EPOLL_CTL_DEL:
+        if (reg->io == NULL) {
+            result = ERRNO(ENOENT);
+            break;
+        }
+        epoll_remove_locked(ep, fd, reg);
+        break;
+    default:
+        result = ERRNO(EINVAL);
+        break;
+    }
+    mtx_unlock(&ep->lock);
+
+    if (io != NULL) {
+        fdio_release(io);
+    }
+    fdio_release(&ep->io);
+    return result;
+}
+
+// Turns the packets in |packets| into ready events, re-arming level-triggered
+// registrations. Returns the number of events stored in |events|.
+static int epoll_report_locked(fdio_epoll_t* ep, const zx_port_packet_t* packets, size_t count,
+                               struct epoll_event* events) {
+    int n = 0;
+    for (size_t i = 0; i < count; i++) {
+        int fd = (int)(uint32_t)packets[i].key;
+        uint32_t gen = (uint32_t)(packets[i].key >> 32);
+        epoll_reg_t* reg = &ep->regs[fd];
+        if ((reg->io == NULL) || (reg->gen != gen)) {
+            // Queued before the registration was changed or removed.
+            continue;
+        }
+
+        fdio_t* io = fd_to_io(fd);
+        if (io != NULL) {
+            fdio_release(io);
+        }
+        if (io != reg->io) {
+            // Closed since it was registered.
+            epoll_remove_locked(ep, fd, reg);
+            continue;
+        }
+
+        zx_signals_t observed = packets[i].signal.observed;
+        if (!(reg->events & EPOLLET)) {
+            // The fd may have stopped being ready while the packet sat in
+            // the port; level-triggered results reflect its current state.
+            zx_object_wait_one(reg->handle, reg->signals, 0, &observed);
+        }
+        uint32_t ready = 0;
+        reg->io->ops->wait_end(reg->io, observed, &ready);
+        ready &= (reg->events & EPOLL_EVENTS_MASK) | EPOLLHUP | EPOLLERR;
+        if (ready != 0) {
+            events[n].events = ready;
+            events[n].data = reg->data;
+            n++;
+        }
+
+        bool oneshot = (ready != 0) && (reg->events & EPOLLONESHOT);
+        if (reg->events & EPOLLET) {
+            if (oneshot) {
+                epoll_disarm_locked(ep, fd, reg);
+            }
+        } else {
+            // The ONCE wait that queued this packet is gone.
+            reg->armed = false;
+            if (!oneshot) {
+                epoll_arm_locked(ep, fd, reg);
+            }
+        }
+    }
+    return n;
+}
+
+int epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout,
+                const sigset_t* sigmask) {
+    if (sigmask) {
+        return ERRNO(ENOSYS);
+    }
+    if (maxevents <= 0) {
+        return ERRNO(EINVAL);
+    }
+    fdio_epoll_t* ep;
+    int e = fd_to_epoll(epfd, &ep);
+    if (e != 0) {
+        return ERRNO(e);
+    }
+
+    zx_time_t deadline = (timeout < 0) ? ZX_TIME_INFINITE : zx_deadline_after(ZX_MSEC(timeout));
+    size_t count = (size_t)maxevents < ZX_PORT_WAIT_BATCH_MAX ? (size_t)maxevents
+                                                              : ZX_PORT_WAIT_BATCH_MAX;
+    zx_port_packet_t packets[ZX_PORT_WAIT_BATCH_MAX];
+    int n = 0;
+    zx_status_t r;
+    // Stale packets can leave a batch with nothing to report; keep waiting
+    // until something is or the deadline passes.
+    do {
+        size_t actual;
+        r = zx_port_wait_batch(ep->port, deadline, packets, count, &actual);
+        if (r != ZX_OK) {
+            break;
+        }
+        mtx_lock(&ep->lock);
+        n = epoll_report_locked(ep, packets, actual, events);
+        mtx_unlock(&ep->lock);
+    } while (n == 0);
+
+    fdio_release(&ep->io);
+    if (n > 0) {
+        return n;
+    }
+    return (r == ZX_ERR_TIMED_OUT) ? 0 : ERROR(r);
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout) {
+    return epoll_pwait(epfd, events, maxevents, timeout, NULL);
+}
@@ -13,6 +13,7 @@ MODULE_TYPE := userlib
 MODULE_SRCS += \
     $(LOCAL_DIR)/bootfs.c \
     $(LOCAL_DIR)/dispatcher.c \
+    $(LOCAL_DIR)/epoll.c \
     $(LOCAL_DIR)/get-vmo.c \
     $(LOCAL_DIR)/logger.c \
     $(LOCAL_DIR)/namespace.c \
@@ -27,6 +27,7 @@
 #include <zircon/process.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
 #include <zircon/thread_annotations.h>
 
 #include <fdio/debug.h>
@@ -1865,6 +1866,46 @@ void __fdio_release(fdio_t* io) {
 // TODO: getrlimit(RLIMIT_NOFILE, ...)
 #define MAX_POLL_NFDS 1024
 
+// Like zx_object_wait_many(), but without its limit on |count|. Larger sets
+// are waited on through a port, so the cost of finding the ready items is
+// proportional to how many are ready rather than to |count|.
+static zx_status_t fdio_wait_many(zx_wait_item_t* items, size_t count, zx_time_t deadline) {
+    if (count <= ZX_WAIT_MANY_MAX_ITEMS) {
+        return zx_object_wait_many(items, count, deadline);
+    }
+
+    zx_handle_t port;
+    zx_status_t r = zx_port_create(0, &port);
+    if (r != ZX_OK) {
+        return r;
+    }
+    for (size_t i = 0; i < count; i++) {
+        items[i].pending = 0;
+        r = zx_object_wait_async(items[i].handle, port, i, items[i].waitfor,
+                                 ZX_WAIT_ASYNC_ONCE);
+        if (r != ZX_OK) {
+            zx_handle_close(port);
+            return r;
+        }
+    }
+
+    // Items that are already ready queued their packets when their wait was
+    // registered, so once the first batch arrives the rest can be collected
+    // without blocking.
+    zx_port_packet_t packets[ZX_PORT_WAIT_BATCH_MAX];
+    size_t actual;
+    r = zx_port_wait_batch(port, deadline, packets, countof(packets), &actual);
+    zx_status_t status = r;
+    while (r == ZX_OK) {
+        for (size_t i = 0; i < actual; i++) {
+            items[packets[i].key].pending = packets[i].signal.observed;
+        }
+        r = zx_port_wait_batch(port, 0, packets, countof(packets), &actual);
+    }
+    zx_handle_close(port);
+    return status;
+}
+
 int ppoll(struct pollfd* fds, nfds_t n,
           const struct timespec* timeout_ts, const sigset_t* sigmask) {
     if (sigmask) {
@@ -1926,7 +1967,7 @@ int ppoll(struct pollfd* fds, nfds_t n,
                 tmo = zx_deadline_after(duration);
             }
         }
-        r = zx_object_wait_many(items, nvalid, tmo);
+        r = fdio_wait_many(items, nvalid, tmo);
         // pending signals could be reported on ZX_ERR_TIMED_OUT case as well
         if (r == ZX_OK || r == ZX_ERR_TIMED_OUT) {
             nfds_t j = 0; // j counts up on a valid entry
@@ -2021,7 +2062,7 @@ int select(int n, fd_set* restrict rfds, fd_set* restrict wfds, fd_set* restrict
     if (r == ZX_OK && nvalid > 0) {
         zx_time_t tmo = (tv == NULL) ? ZX_TIME_INFINITE :
             zx_deadline_after(ZX_SEC(tv->tv_sec) + ZX_USEC(tv->tv_usec));
-        r = zx_object_wait_many(items, nvalid, tmo);
+        r = fdio_wait_many(items, nvalid, tmo);
         // pending signals could be reported on ZX_ERR_TIMED_OUT case as well
         if (r == ZX_OK || r == ZX_ERR_TIMED_OUT) {
             int j = 0; // j counts up on a valid entry
@@ -57,6 +57,11 @@ public:
                          void* buffer, size_t buffer_size) const {
         return zx_vmo_op_range(get(), op, offset, size, buffer, buffer_size);
     }
+
+    zx_status_t op_range_batch(const zx_vmo_range_op_t* ops, size_t count,
+                               size_t* actual) const {
+        return zx_vmo_op_range_batch(get(), ops, count, actual);
+    }
 };
 
 using unowned_vmo = const unowned<vmo>;
@@ -665,6 +665,67 @@ bool receiver_shutdown_test() {
     END_TEST;
 }
 
+// The loop takes several packets from its port at once when it is the only
+// thread running it, and parks all but the first.  They have to be dispatched
+// in order by whichever thread gets to the loop next.
+bool parked_packets_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    TestReceiver receiver;
+    for (uint32_t i = 0; i < 3; i++) {
+        zx_packet_user_t data{};
+        data.u32[0] = i;
+        EXPECT_EQ(ZX_OK, receiver.op.Queue(loop.async(), &data), "queue packet");
+    }
+
+    EXPECT_EQ(ZX_OK, loop.Run(ZX_TIME_INFINITE, true /*once*/), "run once");
+    EXPECT_EQ(1u, receiver.run_count, "run count");
+    EXPECT_EQ(0u, receiver.last_data->u32[0], "first packet");
+
+    // The other two are no longer on the port, so a thread started now has
+    // to find them in the loop before it blocks waiting for the quit task.
+    QuitTask quit_task;
+    EXPECT_EQ(ZX_OK, quit_task.op.Post(loop.async()), "post task");
+    EXPECT_EQ(ZX_OK, loop.StartThread(), "start thread");
+    loop.JoinThreads();
+
+    EXPECT_EQ(3u, receiver.run_count, "run count");
+    EXPECT_EQ(2u, receiver.last_data->u32[0], "last packet");
+    EXPECT_EQ(1u, quit_task.run_count, "quit task ran");
+
+    END_TEST;
+}
+
+// Canceling a wait whose packet has been taken from the port but is still
+// parked in the loop must drop the packet.
+bool parked_wait_cancel_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    zx::event event;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_0), "signal");
+
+    TestWait wait1(event.get(), ZX_USER_SIGNAL_0);
+    TestWait wait2(event.get(), ZX_USER_SIGNAL_0);
+    EXPECT_EQ(ZX_OK, wait1.op.Begin(loop.async()), "wait 1");
+    EXPECT_EQ(ZX_OK, wait2.op.Begin(loop.async()), "wait 2");
+
+    EXPECT_EQ(ZX_OK, loop.Run(ZX_TIME_INFINITE, true /*once*/), "run once");
+    EXPECT_EQ(1u, wait1.run_count, "run count 1");
+    EXPECT_EQ(0u, wait2.run_count, "run count 2");
+
+    EXPECT_EQ(ZX_OK, wait2.op.Cancel(loop.async()), "cancel parked wait");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, wait2.op.Cancel(loop.async()), "cancel again");
+
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait1.run_count, "run count 1");
+    EXPECT_EQ(0u, wait2.run_count, "run count 2");
+
+    END_TEST;
+}
+
 class GetDefaultDispatcherTask : public QuitTask {
 public:
     async_t* last_default_dispatcher;
@@ -941,6 +1002,55 @@ bool threads_receivers_run_concurrently_test() {
     END_TEST;
 }
 
+// The first handler to run blocks until the second one has run, which it
+// can only do on another thread.  A thread that started the loop on its own
+// may take both packets from the port at once, and a thread that joined
+// while it was blocked there must still be woken to run the parked one.
+class RendezvousReceiver : public TestReceiver {
+public:
+    RendezvousReceiver(zx_handle_t event)
+        : event_(event) {}
+
+    zx_status_t rendezvous_status = ZX_ERR_INTERNAL;
+
+protected:
+    zx_handle_t event_;
+    fbl::atomic_uint32_t count_{};
+
+    void Handle(async_t* async, zx_status_t status, const zx_packet_user_t* data) override {
+        if (fbl::atomic_fetch_add(&count_, 1u, fbl::memory_order_acq_rel) == 0u) {
+            rendezvous_status = zx_object_wait_one(event_, ZX_USER_SIGNAL_0,
+                                                   zx_deadline_after(ZX_SEC(5)), nullptr);
+            async_loop_quit(async);
+        } else {
+            zx_object_signal(event_, 0u, ZX_USER_SIGNAL_0);
+        }
+    }
+};
+
+bool threads_parked_packets_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    zx::event event;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+    RendezvousReceiver receiver(event.get());
+
+    // Give each thread time to block on the port before the next one joins.
+    EXPECT_EQ(ZX_OK, loop.StartThread(), "start thread");
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+    EXPECT_EQ(ZX_OK, loop.StartThread(), "start thread");
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+
+    EXPECT_EQ(ZX_OK, receiver.op.Queue(loop.async()), "queue packet");
+    EXPECT_EQ(ZX_OK, receiver.op.Queue(loop.async()), "queue packet");
+
+    loop.JoinThreads();
+    EXPECT_EQ(ZX_OK, receiver.rendezvous_status, "second packet ran on another thread");
+
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(loop_tests)
@@ -956,6 +1066,8 @@ RUN_TEST(task_test)
 RUN_TEST(task_shutdown_test)
 RUN_TEST(receiver_test)
 RUN_TEST(receiver_shutdown_test)
+RUN_TEST(parked_packets_test)
+RUN_TEST(parked_wait_cancel_test)
 RUN_TEST(threads_have_default_dispatcher)
 for (int i = 0; i < 3; i++) {
     RUN_TEST(threads_quit)
@@ -963,5 +1075,6 @@ for (int i = 0; i < 3; i++) {
     RUN_TEST(threads_waits_run_concurrently_test)
     RUN_TEST(threads_tasks_run_sequentially_test)
     RUN_TEST(threads_receivers_run_concurrently_test)
+    RUN_TEST(threads_parked_packets_test)
 }
 END_TEST_CASE(loop_tests)
@@ -4,6 +4,7 @@
 
 #include <inttypes.h>
 #include <limits.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/threads.h>
 #include <unittest/unittest.h>
@@ -526,6 +527,97 @@ static bool test_event_signaling() {
     END_TEST;
 }
 
+// Priority inheritance futexes hold the owner's thread handle.
+static int pi_futex_lock(zx_futex_t* futex) {
+    zx_handle_t self = zx_thread_self();
+    for (;;) {
+        int value = 0;
+        if (__atomic_compare_exchange_n(futex, &value, (int)self, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return ZX_OK;
+        if (!(value & ZX_FUTEX_PI_WAITERS) &&
+            !__atomic_compare_exchange_n(futex, &value, value | ZX_FUTEX_PI_WAITERS, false,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            continue;
+        zx_status_t rc = zx_futex_wait_pi(futex, value | ZX_FUTEX_PI_WAITERS, self,
+                                          ZX_TIME_INFINITE);
+        if (rc == ZX_OK)
+            return ZX_OK;
+        if (rc != ZX_ERR_BAD_STATE)
+            return rc;
+    }
+}
+
+static int pi_futex_unlock(zx_futex_t* futex) {
+    int value = (int)zx_thread_self();
+    if (__atomic_compare_exchange_n(futex, &value, 0, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return ZX_OK;
+    return zx_futex_wake_pi(futex);
+}
+
+static zx_futex_t pi_futex;
+
+static int pi_waiter_thread(void* arg) {
+    if (pi_futex_lock(&pi_futex) != ZX_OK)
+        return -1;
+    // the futex was handed straight to us
+    if (__atomic_load_n(&pi_futex, __ATOMIC_RELAXED) != (int)zx_thread_self())
+        return -2;
+    return pi_futex_unlock(&pi_futex);
+}
+
+static bool test_futex_pi_handoff() {
+    BEGIN_TEST;
+
+    pi_futex = 0;
+    ASSERT_EQ(pi_futex_lock(&pi_futex), ZX_OK, "");
+    EXPECT_EQ(pi_futex, (int)zx_thread_self(), "");
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_create_with_name(&thread, pi_waiter_thread, NULL, "pi waiter"),
+              thrd_success, "");
+
+    // wait for the waiter to block on us
+    while (!(__atomic_load_n(&pi_futex, __ATOMIC_RELAXED) & ZX_FUTEX_PI_WAITERS))
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+
+    ASSERT_EQ(pi_futex_unlock(&pi_futex), ZX_OK, "");
+
+    int result;
+    ASSERT_EQ(thrd_join(thread, &result), thrd_success, "");
+    EXPECT_EQ(result, 0, "");
+    EXPECT_EQ(pi_futex, 0, "");
+
+    END_TEST;
+}
+
+static bool test_futex_pi_bad_args() {
+    BEGIN_TEST;
+
+    zx_futex_t futex = (int)zx_thread_self() | ZX_FUTEX_PI_WAITERS;
+
+    // only waits on a contended futex make sense
+    EXPECT_EQ(zx_futex_wait_pi(&futex, (int)zx_thread_self(), zx_thread_self(), 0),
+              ZX_ERR_INVALID_ARGS, "");
+    // a thread can't wait on a futex it owns
+    EXPECT_EQ(zx_futex_wait_pi(&futex, futex, zx_thread_self(), 0), ZX_ERR_BAD_STATE, "");
+    // the handle passed as self has to be the caller's
+    EXPECT_EQ(zx_futex_wait_pi(&futex, futex, zx_process_self(), 0), ZX_ERR_WRONG_TYPE, "");
+
+    // only the owner may release it
+    zx_futex_t not_ours = (int)zx_process_self() | ZX_FUTEX_PI_WAITERS;
+    EXPECT_EQ(zx_futex_wake_pi(&not_ours), ZX_ERR_ACCESS_DENIED, "");
+    EXPECT_EQ(not_ours, (int)zx_process_self() | ZX_FUTEX_PI_WAITERS, "");
+
+    // releasing with nobody waiting just unlocks it
+    EXPECT_EQ(zx_futex_wake_pi(&futex), ZX_OK, "");
+    EXPECT_EQ(futex, 0, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(futex_tests)
 RUN_TEST(test_futex_wait_value_mismatch);
 RUN_TEST(test_futex_wait_timeout);
@@ -545,6 +637,8 @@ RUN_TEST(test_futex_thread_killed);
 RUN_TEST(test_futex_thread_suspended);
 RUN_TEST(test_futex_misaligned);
 RUN_TEST(test_event_signaling);
+RUN_TEST(test_futex_pi_handoff);
+RUN_TEST(test_futex_pi_bad_args);
 END_TEST_CASE(futex_tests)
 
 #ifndef BUILD_COMBINED_TESTS
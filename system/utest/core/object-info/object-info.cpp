@@ -7,11 +7,13 @@
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/exception.h>
 #include <zircon/syscalls/object.h>
+#include <zircon/syscalls/port.h>
 #include <mini-process/mini-process.h>
 #include <unittest/unittest.h>
 
 #include <inttypes.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -893,6 +895,40 @@ bool handle_count_valid() {
     return true;
 }
 
+uint64_t pending_port_packets() {
+    zx_info_process_port_stats_t info;
+    if (ZX_OK != zx_object_get_info(zx_process_self(), ZX_INFO_PROCESS_PORT_STATS,
+                                    &info, sizeof(info), nullptr, nullptr)) {
+        return UINT64_MAX;
+    }
+    return info.pending_packets;
+}
+
+bool process_port_stats_smoke() {
+    BEGIN_TEST;
+    // Packets queued by this process are charged to it until they are read,
+    // and discarded when the port goes away.
+    const uint64_t base = pending_port_packets();
+    ASSERT_NE(base, UINT64_MAX);
+
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0u, &port), ZX_OK);
+
+    zx_port_packet_t packet = {};
+    packet.type = ZX_PKT_TYPE_USER;
+    for (uint64_t i = 1; i <= 3; ++i) {
+        ASSERT_EQ(zx_port_queue(port, &packet, 0u), ZX_OK);
+        EXPECT_EQ(pending_port_packets(), base + i);
+    }
+
+    ASSERT_EQ(zx_port_wait(port, 0u, &packet, 0u), ZX_OK);
+    EXPECT_EQ(pending_port_packets(), base + 2);
+
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(pending_port_packets(), base);
+    END_TEST;
+}
+
 } // namespace
 
 // Tests that should pass for any topic. Use the wrappers below instead of
@@ -970,6 +1006,11 @@ RUN_SINGLE_ENTRY_TESTS(ZX_INFO_HANDLE_BASIC, zx_info_handle_basic_t, zx_vmar_roo
 
 RUN_SINGLE_ENTRY_TESTS(ZX_INFO_HANDLE_COUNT, zx_info_handle_count_t, zx_thread_self);
 
+RUN_TEST(process_port_stats_smoke);
+RUN_SINGLE_ENTRY_TESTS(ZX_INFO_PROCESS_PORT_STATS, zx_info_process_port_stats_t, zx_process_self);
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_PROCESS_PORT_STATS, zx_info_process_port_stats_t,
+                                  zx_thread_self>));
+
 RUN_SINGLE_ENTRY_TESTS(ZX_INFO_PROCESS, zx_info_process_t, get_test_process);
 RUN_TEST((wrong_handle_type_fails<ZX_INFO_PROCESS, zx_info_process_t, get_test_job>));
 RUN_TEST((wrong_handle_type_fails<ZX_INFO_PROCESS, zx_info_process_t, zx_thread_self>));
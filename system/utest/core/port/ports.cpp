@@ -139,6 +139,60 @@ static bool wait_count_invalid_test() {
     END_TEST;
 }
 
+static bool wait_batch_test() {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    zx_status_t status = zx_port_create(0u, &port);
+    EXPECT_EQ(status, ZX_OK);
+
+    zx_port_packet_t out[ZX_PORT_WAIT_BATCH_MAX + 1] = {};
+    size_t actual = 0u;
+
+    status = zx_port_wait_batch(port, ZX_TIME_INFINITE, out, 0u, &actual);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS);
+
+    status = zx_port_wait_batch(port, zx_deadline_after(ZX_USEC(1)), out, 4u, &actual);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    // Queue more packets than a single call hands out.
+    const size_t queued = ZX_PORT_WAIT_BATCH_MAX + 5u;
+    for (size_t ix = 0; ix != queued; ++ix) {
+        const zx_port_packet_t in = {ix, ZX_PKT_TYPE_USER, 0, {{}}};
+        status = zx_port_queue(port, &in, 1u);
+        EXPECT_EQ(status, ZX_OK);
+    }
+
+    // A short batch takes the oldest packets, in order.
+    status = zx_port_wait_batch(port, ZX_TIME_INFINITE, out, 3u, &actual);
+    EXPECT_EQ(status, ZX_OK);
+    ASSERT_EQ(actual, 3u);
+    for (size_t ix = 0; ix != actual; ++ix) {
+        EXPECT_EQ(out[ix].key, ix);
+        EXPECT_EQ(out[ix].type, ZX_PKT_TYPE_USER);
+    }
+
+    // A long one is capped at ZX_PORT_WAIT_BATCH_MAX.
+    status = zx_port_wait_batch(port, ZX_TIME_INFINITE, out, fbl::count_of(out), &actual);
+    EXPECT_EQ(status, ZX_OK);
+    ASSERT_EQ(actual, ZX_PORT_WAIT_BATCH_MAX);
+    for (size_t ix = 0; ix != actual; ++ix) {
+        EXPECT_EQ(out[ix].key, ix + 3u);
+    }
+
+    // The rest come back without waiting, and |actual| is optional.
+    status = zx_port_wait_batch(port, 0u, out, fbl::count_of(out), nullptr);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(out[0].key, ZX_PORT_WAIT_BATCH_MAX + 3u);
+
+    status = zx_port_wait(port, 0u, out, 1u);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
 static bool queue_and_close_test(void) {
     BEGIN_TEST;
     zx_status_t status;
@@ -746,6 +800,7 @@ RUN_TEST(wait_count_valid_test<0u>)
 RUN_TEST(wait_count_valid_test<1u>)
 RUN_TEST(wait_count_invalid_test<2u>)
 RUN_TEST(wait_count_invalid_test<23u>)
+RUN_TEST(wait_batch_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(async_wait_channel_test)
 RUN_TEST(async_wait_event_test_single)
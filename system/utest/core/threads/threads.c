@@ -19,6 +19,8 @@
 #include "register-set.h"
 #include "test-threads/threads.h"
 
+extern zx_handle_t get_root_resource(void);
+
 static const char kThreadName[] = "test-thread";
 
 static const unsigned kExceptionPortKey = 42u;
@@ -262,6 +264,70 @@ static bool test_kill_wait_thread(void) {
     END_TEST;
 }
 
+static bool test_set_deadline(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rsrc = get_root_resource();
+    zxr_thread_t thread;
+    zx_handle_t thread_h;
+    ASSERT_TRUE(start_thread(threads_test_busy_fn, NULL, &thread, &thread_h), "");
+
+    // A busy thread held to 1ms out of every 10ms.
+    zx_thread_deadline_params_t params = {
+        .period = ZX_MSEC(10), .budget = ZX_MSEC(1), .deadline = ZX_MSEC(5)};
+
+    // Entering the class takes the root resource, not just a thread handle.
+    EXPECT_EQ(zx_thread_set_deadline(ZX_HANDLE_INVALID, thread_h, &params),
+              ZX_ERR_BAD_HANDLE, "");
+    EXPECT_EQ(zx_thread_set_deadline(thread_h, thread_h, &params), ZX_ERR_WRONG_TYPE, "");
+
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &params), ZX_OK, "");
+
+    // Let it run through a few periods, including being throttled.
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(50)));
+
+    // Changing the parameters of a thread already in the class.
+    params.budget = ZX_MSEC(2);
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &params), ZX_OK, "");
+
+    // Parameters that cannot be met.
+    zx_thread_deadline_params_t bad = {
+        .period = ZX_MSEC(10), .budget = ZX_MSEC(6), .deadline = ZX_MSEC(5)};
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &bad), ZX_ERR_INVALID_ARGS, "");
+    bad.budget = 0;
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &bad), ZX_ERR_INVALID_ARGS, "");
+    bad = (zx_thread_deadline_params_t){
+        .period = ZX_SEC(2), .budget = ZX_MSEC(1), .deadline = ZX_MSEC(5)};
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &bad), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, NULL), ZX_ERR_INVALID_ARGS, "");
+
+    // No thread may reserve a whole cpu.
+    bad = (zx_thread_deadline_params_t){
+        .period = ZX_MSEC(10), .budget = ZX_MSEC(10), .deadline = ZX_MSEC(10)};
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &bad), ZX_ERR_INVALID_ARGS, "");
+
+    // A zero period puts it back to priority based scheduling.
+    zx_thread_deadline_params_t revert = {};
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &revert), ZX_OK, "");
+
+    // Exiting while in the deadline class releases the reservation.
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &params), ZX_OK, "");
+    ASSERT_EQ(zx_task_kill(thread_h), ZX_OK, "");
+    ASSERT_EQ(zx_object_wait_one(thread_h, ZX_THREAD_TERMINATED,
+                                 ZX_TIME_INFINITE, NULL),
+              ZX_OK, "");
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, thread_h, &params), ZX_ERR_BAD_STATE, "");
+    zxr_thread_destroy(&thread);
+    ASSERT_EQ(zx_handle_close(thread_h), ZX_OK, "");
+
+    // The calling thread can put itself in the class too.
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, zx_thread_self(), &params), ZX_OK, "");
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(20)));
+    EXPECT_EQ(zx_thread_set_deadline(rsrc, zx_thread_self(), &revert), ZX_OK, "");
+
+    END_TEST;
+}
+
 static bool test_bad_state_nonstarted_thread(void) {
     BEGIN_TEST;
 
@@ -1046,6 +1112,7 @@ RUN_TEST_ENABLE_CRASH_HANDLER(test_thread_start_with_zero_instruction_pointer)
 RUN_TEST(test_kill_busy_thread)
 RUN_TEST(test_kill_sleep_thread)
 RUN_TEST(test_kill_wait_thread)
+RUN_TEST(test_set_deadline)
 RUN_TEST(test_bad_state_nonstarted_thread)
 RUN_TEST(test_thread_kills_itself)
 RUN_TEST(test_info_task_stats_fails)
@@ -138,6 +138,14 @@ public:
     static void RecordEraseRotation()           { ++op_counts_.erase_rotations_; }
     static void RecordEraseDoubleRotation()     { ++op_counts_.erase_double_rotations_; }
 
+    // Keep track of the number of nodes in each subtree, so that the test can
+    // check that the tree reports every change to a subtree.
+    template <typename RawPtrType>
+    static void UpdateSubtreeState(RawPtrType node, RawPtrType left, RawPtrType right) {
+        node->subtree_count_ = 1 + (left ? left->subtree_count_ : 0)
+                                 + (right ? right->subtree_count_ : 0);
+    }
+
     template <typename TreeType>
     static bool VerifyRankRule(const TreeType& tree, typename TreeType::RawPtrType node) {
         BEGIN_TEST;
@@ -261,8 +269,11 @@ public:
 
     bool InContainer() const { return wavl_node_state_.InContainer(); }
 
+    size_t SubtreeCount() const { return subtree_count_; }
+
 private:
     friend DefaultWAVLTreeTraits<BalanceTestObjPtr, int32_t>;
+    friend class WAVLBalanceTestObserver;
 
     static void operator delete(void* ptr) {
         // Deliberate no-op
@@ -272,9 +283,39 @@ private:
 
     BalanceTestKeyType key_;
     BalanceTestObj* erase_deck_ptr_;
+    size_t subtree_count_ = 0;
     WAVLTreeNodeState<BalanceTestObjPtr, int32_t> wavl_node_state_;
 };
 
+// Count the nodes beneath |iter| by walking the tree, checking the subtree
+// state maintained by the observer along the way.
+static bool CheckSubtreeCount(BalanceTestTree::const_iterator iter, size_t* count) {
+    BEGIN_TEST;
+
+    *count = 0;
+    if (!iter.IsValid())
+        return true;
+
+    size_t left_count, right_count;
+    ASSERT_TRUE(CheckSubtreeCount(iter.left(), &left_count));
+    ASSERT_TRUE(CheckSubtreeCount(iter.right(), &right_count));
+
+    *count = 1 + left_count + right_count;
+    ASSERT_EQ(*count, iter->SubtreeCount(), "Stale subtree state!");
+
+    END_TEST;
+}
+
+static bool CheckSubtreeState(const BalanceTestTree& tree) {
+    BEGIN_TEST;
+
+    size_t count;
+    ASSERT_TRUE(CheckSubtreeCount(tree.root(), &count));
+    ASSERT_EQ(tree.size(), count);
+
+    END_TEST;
+}
+
 static constexpr size_t kBalanceTestSize = 2048;
 
 static bool DoBalanceTestInsert(BalanceTestTree& tree, BalanceTestObj* ptr) {
@@ -288,6 +329,7 @@ static bool DoBalanceTestInsert(BalanceTestTree& tree, BalanceTestObj* ptr) {
     // sanity check the tree.
     ASSERT_TRUE(tree.insert_or_find(BalanceTestObjPtr(ptr)));
     ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree));
+    ASSERT_TRUE(CheckSubtreeState(tree));
 
     END_TEST;
 }
@@ -308,6 +350,7 @@ static bool DoBalanceTestErase(BalanceTestTree& tree, BalanceTestObj* ptr) {
     // Run a full sanity check on the tree.  Its depth should be
     // consistent with a tree which has seen both inserts and erases.
     ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree));
+    ASSERT_TRUE(CheckSubtreeState(tree));
 
     END_TEST;
 }
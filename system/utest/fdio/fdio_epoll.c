@@ -0,0 +1,97 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <zircon/syscalls.h>
+#include <fdio/io.h>
+#include <unittest/unittest.h>
+
+bool epoll_level_triggered_test(void) {
+    BEGIN_TEST;
+
+    int epfd = epoll_create1(0);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+
+    enum { kCount = 32 };
+    zx_handle_t events[kCount];
+    int fds[kCount];
+    for (int i = 0; i < kCount; i++) {
+        ASSERT_EQ(ZX_OK, zx_event_create(0u, &events[i]), "zx_event_create() failed");
+        fds[i] = fdio_handle_fd(events[i], ZX_USER_SIGNAL_0, 0, true);
+        ASSERT_GE(fds[i], 0, "fdio_handle_fd() failed");
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (uint32_t)i};
+        ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev), "EPOLL_CTL_ADD failed");
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN};
+    EXPECT_EQ(-1, epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev), "duplicate add should fail");
+    EXPECT_EQ(EEXIST, errno, "");
+
+    struct epoll_event out[kCount];
+    EXPECT_EQ(0, epoll_wait(epfd, out, kCount, 0), "nothing should be ready");
+
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[20], 0, ZX_USER_SIGNAL_0), "");
+    ASSERT_EQ(1, epoll_wait(epfd, out, kCount, -1), "one fd should be ready");
+    EXPECT_EQ(20u, out[0].data.u32, "wrong fd reported");
+    EXPECT_EQ((uint32_t)EPOLLIN, out[0].events, "wrong events reported");
+
+    // Still ready, so reported again.
+    ASSERT_EQ(1, epoll_wait(epfd, out, kCount, 0), "fd should still be ready");
+    EXPECT_EQ(20u, out[0].data.u32, "wrong fd reported");
+
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[20], ZX_USER_SIGNAL_0, 0), "");
+    EXPECT_EQ(0, epoll_wait(epfd, out, kCount, 0), "nothing should be ready");
+
+    // Removed fds are not reported.
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_DEL, fds[5], NULL), "EPOLL_CTL_DEL failed");
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[5], 0, ZX_USER_SIGNAL_0), "");
+    EXPECT_EQ(0, epoll_wait(epfd, out, kCount, 0), "removed fd should not be reported");
+
+    for (int i = 0; i < kCount; i++) {
+        close(fds[i]);
+        zx_handle_close(events[i]);
+    }
+    close(epfd);
+
+    END_TEST;
+}
+
+bool epoll_oneshot_test(void) {
+    BEGIN_TEST;
+
+    int epfd = epoll_create1(0);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+
+    zx_handle_t event;
+    ASSERT_EQ(ZX_OK, zx_event_create(0u, &event), "zx_event_create() failed");
+    int fd = fdio_handle_fd(event, ZX_USER_SIGNAL_0, 0, true);
+    ASSERT_GE(fd, 0, "fdio_handle_fd() failed");
+
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.u32 = 7u};
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev), "EPOLL_CTL_ADD failed");
+    ASSERT_EQ(ZX_OK, zx_object_signal(event, 0, ZX_USER_SIGNAL_0), "");
+
+    struct epoll_event out;
+    ASSERT_EQ(1, epoll_wait(epfd, &out, 1, -1), "fd should be ready");
+    EXPECT_EQ(7u, out.data.u32, "wrong fd reported");
+    EXPECT_EQ(0, epoll_wait(epfd, &out, 1, 0), "oneshot fd should be disarmed");
+
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev), "EPOLL_CTL_MOD failed");
+    EXPECT_EQ(1, epoll_wait(epfd, &out, 1, 0), "re-armed fd should be ready");
+
+    close(fd);
+    zx_handle_close(event);
+    close(epfd);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(fdio_epoll_test)
+RUN_TEST(epoll_level_triggered_test);
+RUN_TEST(epoll_oneshot_test);
+END_TEST_CASE(fdio_epoll_test)
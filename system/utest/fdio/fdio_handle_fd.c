@@ -150,6 +150,37 @@ bool ppoll_immediate_timeout_test(void) {
     END_TEST;
 }
 
+bool poll_many_test(void) {
+    BEGIN_TEST;
+
+    // More fds than zx_object_wait_many() takes in one call.
+    enum { kCount = 40 };
+    zx_handle_t events[kCount];
+    struct pollfd poll_fds[kCount];
+    for (int i = 0; i < kCount; i++) {
+        ASSERT_EQ(ZX_OK, zx_event_create(0u, &events[i]), "zx_event_create() failed");
+        poll_fds[i].fd = fdio_handle_fd(events[i], ZX_USER_SIGNAL_0, 0, true);
+        ASSERT_GE(poll_fds[i].fd, 0, "fdio_handle_fd() failed");
+        poll_fds[i].events = POLLIN;
+    }
+
+    EXPECT_EQ(0, poll(poll_fds, kCount, 0), "no fds should be readable");
+
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[3], 0, ZX_USER_SIGNAL_0), "");
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[37], 0, ZX_USER_SIGNAL_0), "");
+    EXPECT_EQ(2, poll(poll_fds, kCount, -1), "two fds should be readable");
+    for (int i = 0; i < kCount; i++) {
+        EXPECT_EQ((i == 3 || i == 37) ? POLLIN : 0, poll_fds[i].revents, "wrong revents");
+    }
+
+    for (int i = 0; i < kCount; i++) {
+        close(poll_fds[i].fd);
+        zx_handle_close(events[i]);
+    }
+
+    END_TEST;
+}
+
 bool transfer_fd_test(void) {
     BEGIN_TEST;
 
@@ -198,5 +229,6 @@ RUN_TEST(ppoll_negative_test);
 RUN_TEST(ppoll_null_test);
 RUN_TEST(ppoll_overflow_test);
 RUN_TEST(ppoll_immediate_timeout_test);
+RUN_TEST(poll_many_test);
 RUN_TEST(transfer_fd_test);
 END_TEST_CASE(fdio_handle_fd_test)
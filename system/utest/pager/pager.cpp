@@ -0,0 +1,316 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+#include <zircon/threads.h>
+#include <unittest/unittest.h>
+
+static const uint64_t kKey = 0x5a5a;
+
+// Waits for the next packet from a pager's VMO and checks it is a page request.
+static bool wait_for_request(zx_handle_t port, uint16_t command, uint64_t offset) {
+    BEGIN_HELPER;
+
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(port, zx_deadline_after(ZX_SEC(10)), &packet, 0), ZX_OK, "");
+    EXPECT_EQ(packet.key, kKey, "");
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST, "");
+    EXPECT_EQ(packet.page_request.command, command, "");
+    if (command == ZX_PAGER_VMO_READ) {
+        EXPECT_EQ(packet.page_request.offset, offset, "");
+        EXPECT_EQ(packet.page_request.length, (uint64_t)PAGE_SIZE, "");
+    }
+
+    END_HELPER;
+}
+
+// Supplies one page of |pager_vmo| at |offset|, filled with |value|.
+static bool supply_page(zx_handle_t pager, zx_handle_t pager_vmo, uint64_t offset,
+                        uint8_t value) {
+    BEGIN_HELPER;
+
+    zx_handle_t aux;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &aux), ZX_OK, "");
+    uint8_t data[PAGE_SIZE];
+    memset(data, value, sizeof(data));
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(aux, data, 0, sizeof(data), &actual), ZX_OK, "");
+    EXPECT_EQ(zx_pager_supply_pages(pager, pager_vmo, offset, PAGE_SIZE, aux, 0), ZX_OK, "");
+
+    // the page was moved out, not copied
+    memset(data, 0xff, sizeof(data));
+    ASSERT_EQ(zx_vmo_read(aux, data, 0, sizeof(data), &actual), ZX_OK, "");
+    for (size_t i = 0; i < sizeof(data); i++) {
+        if (data[i] != 0) {
+            EXPECT_EQ(data[i], 0, "aux vmo kept its page");
+            break;
+        }
+    }
+    EXPECT_EQ(zx_handle_close(aux), ZX_OK, "");
+
+    END_HELPER;
+}
+
+struct read_args {
+    zx_handle_t vmo;
+    uint64_t offset;
+    volatile uint8_t* ptr;
+    zx_status_t status;
+    uint8_t value;
+};
+
+// Reads a byte of the VMO through zx_vmo_read, which waits in the kernel.
+static int vmo_read_thread(void* arg) {
+    read_args* args = static_cast<read_args*>(arg);
+    uint8_t value = 0;
+    size_t actual;
+    args->status = zx_vmo_read(args->vmo, &value, args->offset, 1, &actual);
+    args->value = value;
+    return 0;
+}
+
+// Reads a byte of the VMO through a mapping, which waits in the page fault handler.
+static int fault_thread(void* arg) {
+    read_args* args = static_cast<read_args*>(arg);
+    args->value = *args->ptr;
+    args->status = ZX_OK;
+    return 0;
+}
+
+static bool pager_create_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK, "");
+
+    EXPECT_EQ(zx_pager_create(1, &pager), ZX_ERR_INVALID_ARGS, "");
+
+    END_TEST;
+}
+
+static bool pager_create_vmo_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK, "");
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK, "");
+
+    EXPECT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 1, &vmo),
+              ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_pager_create_vmo(port, port, kKey, PAGE_SIZE, 0, &vmo),
+              ZX_ERR_WRONG_TYPE, "");
+    EXPECT_EQ(zx_pager_create_vmo(pager, pager, kKey, PAGE_SIZE, 0, &vmo),
+              ZX_ERR_WRONG_TYPE, "");
+
+    // making VMOs takes ZX_RIGHT_WRITE on both the pager and the port
+    zx_handle_t ro;
+    ASSERT_EQ(zx_handle_duplicate(pager, ZX_RIGHTS_BASIC, &ro), ZX_OK, "");
+    EXPECT_EQ(zx_pager_create_vmo(ro, port, kKey, PAGE_SIZE, 0, &vmo),
+              ZX_ERR_ACCESS_DENIED, "");
+    EXPECT_EQ(zx_handle_close(ro), ZX_OK, "");
+    ASSERT_EQ(zx_handle_duplicate(port, ZX_RIGHTS_BASIC, &ro), ZX_OK, "");
+    EXPECT_EQ(zx_pager_create_vmo(pager, ro, kKey, PAGE_SIZE, 0, &vmo),
+              ZX_ERR_ACCESS_DENIED, "");
+    EXPECT_EQ(zx_handle_close(ro), ZX_OK, "");
+
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK, "");
+    uint64_t size;
+    EXPECT_EQ(zx_vmo_get_size(vmo, &size), ZX_OK, "");
+    EXPECT_EQ(size, (uint64_t)PAGE_SIZE, "");
+
+    // pager VMOs cannot be cloned
+    zx_handle_t clone;
+    EXPECT_NE(zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, PAGE_SIZE, &clone), ZX_OK, "");
+
+    // destroying the VMO tells the pager it is done
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    EXPECT_TRUE(wait_for_request(port, ZX_PAGER_VMO_COMPLETE, 0), "");
+
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool pager_supply_pages_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK, "");
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK, "");
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, 2 * PAGE_SIZE, 0, &vmo), ZX_OK, "");
+
+    // a read of a missing page blocks until the pager supplies it
+    read_args args = {vmo, PAGE_SIZE + 1, nullptr, ZX_ERR_INTERNAL, 0};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, vmo_read_thread, &args), thrd_success, "");
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, PAGE_SIZE), "");
+    ASSERT_TRUE(supply_page(pager, vmo, PAGE_SIZE, 0x42), "");
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success, "");
+    EXPECT_EQ(args.status, ZX_OK, "");
+    EXPECT_EQ(args.value, 0x42, "");
+
+    // the page stays; reading it again does not ask for it again
+    uint8_t value;
+    size_t actual;
+    EXPECT_EQ(zx_vmo_read(vmo, &value, PAGE_SIZE, 1, &actual), ZX_OK, "");
+    EXPECT_EQ(value, 0x42, "");
+
+    // a page that is already present is left alone
+    ASSERT_TRUE(supply_page(pager, vmo, PAGE_SIZE, 0x17), "");
+    EXPECT_EQ(zx_vmo_read(vmo, &value, PAGE_SIZE, 1, &actual), ZX_OK, "");
+    EXPECT_EQ(value, 0x42, "");
+
+    // a fault through a mapping waits for the page the same way
+    uintptr_t ptr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, 2 * PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ, &ptr), ZX_OK, "");
+    args = {vmo, 0, reinterpret_cast<volatile uint8_t*>(ptr), ZX_ERR_INTERNAL, 0};
+    ASSERT_EQ(thrd_create(&thread, fault_thread, &args), thrd_success, "");
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, 0), "");
+    ASSERT_TRUE(supply_page(pager, vmo, 0, 0x99), "");
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success, "");
+    EXPECT_EQ(args.status, ZX_OK, "");
+    EXPECT_EQ(args.value, 0x99, "");
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), ptr, 2 * PAGE_SIZE), ZX_OK, "");
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool pager_supply_pages_errors_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK, "");
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK, "");
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK, "");
+
+    zx_handle_t aux;
+    ASSERT_EQ(zx_vmo_create(2 * PAGE_SIZE, 0, &aux), ZX_OK, "");
+    ASSERT_EQ(zx_vmo_op_range(aux, ZX_VMO_OP_COMMIT, 0, PAGE_SIZE, nullptr, 0), ZX_OK, "");
+
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 1, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, aux, 1), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, PAGE_SIZE, PAGE_SIZE, aux, 0),
+              ZX_ERR_OUT_OF_RANGE, "");
+
+    // the second page of the aux VMO was never committed
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, aux, PAGE_SIZE),
+              ZX_ERR_BAD_STATE, "");
+
+    // only the pager that made a VMO supplies it, and only VMOs made by a pager
+    zx_handle_t other;
+    ASSERT_EQ(zx_pager_create(0, &other), ZX_OK, "");
+    EXPECT_EQ(zx_pager_supply_pages(other, vmo, 0, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_handle_close(other), ZX_OK, "");
+    EXPECT_EQ(zx_pager_supply_pages(pager, aux, 0, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS, "");
+
+    // rights on each of the three handles
+    zx_handle_t ro;
+    ASSERT_EQ(zx_handle_duplicate(pager, ZX_RIGHTS_BASIC, &ro), ZX_OK, "");
+    EXPECT_EQ(zx_pager_supply_pages(ro, vmo, 0, PAGE_SIZE, aux, 0), ZX_ERR_ACCESS_DENIED, "");
+    EXPECT_EQ(zx_handle_close(ro), ZX_OK, "");
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_READ, &ro), ZX_OK, "");
+    EXPECT_EQ(zx_pager_supply_pages(pager, ro, 0, PAGE_SIZE, aux, 0), ZX_ERR_ACCESS_DENIED, "");
+    EXPECT_EQ(zx_handle_close(ro), ZX_OK, "");
+    ASSERT_EQ(zx_handle_duplicate(aux, ZX_RIGHT_READ, &ro), ZX_OK, "");
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, ro, 0), ZX_ERR_ACCESS_DENIED, "");
+    EXPECT_EQ(zx_handle_close(ro), ZX_OK, "");
+
+    EXPECT_EQ(zx_pager_supply_pages(port, vmo, 0, PAGE_SIZE, aux, 0), ZX_ERR_WRONG_TYPE, "");
+
+    EXPECT_EQ(zx_handle_close(aux), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
+// A thread waiting in the page fault handler can still be suspended. It goes back to
+// user mode without the page and faults again once resumed.
+static bool pager_suspend_fault_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK, "");
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK, "");
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK, "");
+
+    uintptr_t ptr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ, &ptr), ZX_OK, "");
+
+    read_args args = {vmo, 0, reinterpret_cast<volatile uint8_t*>(ptr), ZX_ERR_INTERNAL, 0};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, fault_thread, &args), thrd_success, "");
+    zx_handle_t thread_h = thrd_get_zx_handle(thread);
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, 0), "");
+
+    ASSERT_EQ(zx_task_suspend(thread_h), ZX_OK, "");
+    EXPECT_EQ(zx_object_wait_one(thread_h, ZX_THREAD_SUSPENDED,
+                                 zx_deadline_after(ZX_SEC(10)), nullptr), ZX_OK, "");
+
+    // the abandoned fault's request is gone, so the retried fault asks again
+    ASSERT_EQ(zx_task_resume(thread_h, 0), ZX_OK, "");
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, 0), "");
+    ASSERT_TRUE(supply_page(pager, vmo, 0, 0x33), "");
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success, "");
+    EXPECT_EQ(args.value, 0x33, "");
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), ptr, PAGE_SIZE), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
+// Closing the pager fails the reads still waiting on it.
+static bool pager_close_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK, "");
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK, "");
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK, "");
+
+    read_args args = {vmo, 0, nullptr, ZX_OK, 0};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, vmo_read_thread, &args), thrd_success, "");
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, 0), "");
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK, "");
+    ASSERT_EQ(thrd_join(thread, nullptr), thrd_success, "");
+    EXPECT_NE(args.status, ZX_OK, "");
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(pager_tests)
+RUN_TEST(pager_create_test);
+RUN_TEST(pager_create_vmo_test);
+RUN_TEST(pager_supply_pages_test);
+RUN_TEST(pager_supply_pages_errors_test);
+RUN_TEST(pager_suspend_fault_test);
+RUN_TEST(pager_close_test);
+END_TEST_CASE(pager_tests)
+
+int main(int argc, char** argv) {
+    bool success = unittest_run_all_tests(argc, argv);
+    return success ? 0 : -1;
+}
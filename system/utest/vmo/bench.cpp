@@ -188,6 +188,50 @@ int vmo_run_benchmark() {
 
     zx_handle_close(vmo);
 
+    // commit and decommit a scatter list of discontiguous ranges, one syscall per range
+    // and then all of them in a single batch
+    zx_vmo_create(size, 0, &vmo);
+
+    zx_vmo_range_op_t commit_ops[64];
+    zx_vmo_range_op_t decommit_ops[64];
+    const size_t stride = size / fbl::count_of(commit_ops);
+    for (size_t i = 0; i < fbl::count_of(commit_ops); i++) {
+        commit_ops[i] = {ZX_VMO_OP_COMMIT, 0, i * stride, 4 * PAGE_SIZE};
+        decommit_ops[i] = {ZX_VMO_OP_DECOMMIT, 0, i * stride, 4 * PAGE_SIZE};
+    }
+
+    t = time_it([&](){
+        for (const auto& op : commit_ops) {
+            zx_vmo_op_range(vmo, op.op, op.offset, op.size, nullptr, 0);
+        }
+    });
+    printf("\ttook %" PRIu64 " nsecs to commit %zu ranges one at a time\n", t, fbl::count_of(commit_ops));
+
+    t = time_it([&](){
+        for (const auto& op : decommit_ops) {
+            zx_vmo_op_range(vmo, op.op, op.offset, op.size, nullptr, 0);
+        }
+    });
+    printf("\ttook %" PRIu64 " nsecs to decommit %zu ranges one at a time\n", t, fbl::count_of(decommit_ops));
+
+    t = time_it([&](){
+        zx_status_t status = zx_vmo_op_range_batch(vmo, commit_ops, fbl::count_of(commit_ops), nullptr);
+        if (status != ZX_OK) {
+            __builtin_trap();
+        }
+    });
+    printf("\ttook %" PRIu64 " nsecs to commit %zu ranges in one batch\n", t, fbl::count_of(commit_ops));
+
+    t = time_it([&](){
+        zx_status_t status = zx_vmo_op_range_batch(vmo, decommit_ops, fbl::count_of(decommit_ops), nullptr);
+        if (status != ZX_OK) {
+            __builtin_trap();
+        }
+    });
+    printf("\ttook %" PRIu64 " nsecs to decommit %zu ranges in one batch\n", t, fbl::count_of(decommit_ops));
+
+    zx_handle_close(vmo);
+
     printf("done with benchmark\n");
 
     return 0;
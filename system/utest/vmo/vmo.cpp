@@ -1157,6 +1157,60 @@ bool vmo_decommit_misaligned_test() {
     END_TEST;
 }
 
+bool vmo_op_range_batch_test() {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    EXPECT_EQ(ZX_OK, zx_vmo_create(PAGE_SIZE * 16, 0, &vmo), "creation for batch test");
+
+    const zx_vmo_range_op_t ops[] = {
+        {ZX_VMO_OP_COMMIT, 0, 0, PAGE_SIZE * 2},
+        {ZX_VMO_OP_COMMIT, 0, PAGE_SIZE * 4, PAGE_SIZE},
+        {ZX_VMO_OP_DECOMMIT, 0, PAGE_SIZE, PAGE_SIZE},
+        {ZX_VMO_OP_COMMIT, 0, PAGE_SIZE * 8, 0x10},
+    };
+    size_t actual = 0;
+    zx_status_t status = zx_vmo_op_range_batch(vmo, ops, fbl::count_of(ops), &actual);
+    EXPECT_EQ(ZX_OK, status, "batch");
+    EXPECT_EQ(fbl::count_of(ops), actual, "operations completed");
+
+    // a range past the end is rejected before any operation is done
+    const zx_vmo_range_op_t out_of_range_ops[] = {
+        {ZX_VMO_OP_DECOMMIT, 0, 0, PAGE_SIZE * 16},
+        {ZX_VMO_OP_COMMIT, 0, PAGE_SIZE * 17, PAGE_SIZE},
+        {ZX_VMO_OP_COMMIT, 0, 0, PAGE_SIZE},
+    };
+    status = zx_vmo_op_range_batch(vmo, out_of_range_ops, fbl::count_of(out_of_range_ops),
+                                   &actual);
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, status, "out of range batch");
+    EXPECT_EQ(0u, actual, "operations completed");
+
+    // operations that can't be batched are rejected before any are done
+    const zx_vmo_range_op_t bad_ops[] = {
+        {ZX_VMO_OP_COMMIT, 0, 0, PAGE_SIZE},
+        {ZX_VMO_OP_LOOKUP, 0, 0, PAGE_SIZE},
+    };
+    status = zx_vmo_op_range_batch(vmo, bad_ops, fbl::count_of(bad_ops), &actual);
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, status, "unsupported op");
+    EXPECT_EQ(0u, actual, "operations completed");
+
+    status = zx_vmo_op_range_batch(vmo, ops, ZX_VMO_OP_RANGE_BATCH_MAX + 1, nullptr);
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, status, "too many ops");
+
+    status = zx_vmo_op_range_batch(vmo, nullptr, 0, nullptr);
+    EXPECT_EQ(ZX_OK, status, "empty batch");
+
+    // committing and decommitting need a writable handle
+    zx_handle_t read_only;
+    ASSERT_EQ(ZX_OK, zx_handle_duplicate(vmo, ZX_RIGHT_READ, &read_only), "duplicate");
+    status = zx_vmo_op_range_batch(read_only, ops, fbl::count_of(ops), nullptr);
+    EXPECT_EQ(ZX_ERR_ACCESS_DENIED, status, "batch without write right");
+    EXPECT_EQ(ZX_OK, zx_handle_close(read_only), "close handle");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "close handle");
+    END_TEST;
+}
+
 // test set 4: deal with clones with nonzero offsets and offsets that extend beyond the original
 bool vmo_clone_test_4() {
     BEGIN_TEST;
@@ -1419,6 +1473,7 @@ RUN_TEST(vmo_rights_test);
 RUN_TEST(vmo_lookup_test);
 RUN_TEST(vmo_commit_test);
 RUN_TEST(vmo_decommit_misaligned_test);
+RUN_TEST(vmo_op_range_batch_test);
 RUN_TEST(vmo_cache_test);
 RUN_TEST(vmo_cache_op_test);
 RUN_TEST(vmo_cache_flush_test);